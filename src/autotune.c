@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the DAMON attributes auto-tuner. It adjusts the
+ * sampling/aggregation intervals and the max regions at runtime, driven
+ * by a kdamond CPU target (--autotune cpu=N%) and a desired region
+ * resolution (regions=N). The feedback is the kdamond CPU usage from
+ * /proc/<pid>/stat and the regions observed in the trace stream.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/proc.h"
+#include "include/damon.h"
+#include "include/stats.h"
+#include "include/autotune.h"
+
+typedef struct _autotune {
+	boolean_t enabled;
+	double cpu_target;		/* % of one CPU */
+	uint64_t regions_target;	/* 0: keep the max regions */
+	uint64_t attrs_base[ATTR_NUM];
+	uint64_t attrs_cur[ATTR_NUM];
+	boolean_t changed;
+	boolean_t refused;
+	int streak;			/* >0: over target, <0: under */
+	int pid_last;
+	uint64_t ns_last;
+	uint64_t slice_last;
+	uint64_t regions_last;
+	double cpu_cur;
+	double regions_cur;		/* regions per aggregation */
+} autotune_t;
+
+static autotune_t s_autotune;
+static pthread_mutex_t s_autotune_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Parse the auto-tune specification, e.g. "cpu=1%,regions=200".
+ */
+int autotune_parse(const char *spec)
+{
+	char buf[128], *token, *saveptr = NULL, *end;
+	double v;
+
+	if (spec == NULL || strlen(spec) >= sizeof(buf)) {
+		return (-1);
+	}
+
+	(void)strncpy(buf, spec, sizeof(buf));
+	for (token = strtok_r(buf, ",", &saveptr); token != NULL;
+	    token = strtok_r(NULL, ",", &saveptr)) {
+		if (strncasecmp(token, "cpu=", 4) == 0) {
+			if (pct_parse(token + 4, &s_autotune.cpu_target) != 0) {
+				return (-1);
+			}
+		} else if (strncasecmp(token, "regions=", 8) == 0) {
+			v = strtod(token + 8, &end);
+			if (end == token + 8 || *end != 0 ||
+			    v < AUTOTUNE_REGIONS_MIN) {
+				return (-1);
+			}
+			s_autotune.regions_target = (uint64_t)v;
+		} else {
+			return (-1);
+		}
+	}
+
+	if (s_autotune.cpu_target == 0.0) {
+		return (-1);
+	}
+
+	s_autotune.enabled = B_TRUE;
+	return (0);
+}
+
+boolean_t autotune_enabled(void)
+{
+	return (s_autotune.enabled);
+}
+
+/*
+ * Called after the command line is parsed, the attributes set by
+ * the user (e.g. -r) are the base of the tuning.
+ */
+void autotune_init(void)
+{
+	autotune_t *at = &s_autotune;
+
+	if (!at->enabled) {
+		return;
+	}
+
+	memset(at->attrs_base, 0, sizeof(at->attrs_base));
+	read_damon_attrs(DAMON_ATTRS_PATH, &at->attrs_base[ATTR_SAMPLE],
+			&at->attrs_base[ATTR_AGGR], &at->attrs_base[ATTR_UPDATE],
+			&at->attrs_base[ATTR_MIN], &at->attrs_base[ATTR_MAX]);
+	memcpy(at->attrs_cur, at->attrs_base, sizeof(at->attrs_cur));
+
+	if (at->attrs_base[ATTR_SAMPLE] == 0 ||
+	    at->attrs_base[ATTR_AGGR] == 0) {
+		at->refused = B_TRUE;
+	}
+
+	debug_print(NULL, 2, "autotune: cpu %.2f%%, regions %" PRIu64 "\n",
+			at->cpu_target, at->regions_target);
+}
+
+/*
+ * Restore the attributes which were there before tuning. It must be
+ * called after monitoring has been stopped.
+ */
+void autotune_fini(void)
+{
+	autotune_t *at = &s_autotune;
+
+	if (!at->enabled || !at->changed) {
+		return;
+	}
+
+	write_damon_attrs(at->attrs_base[ATTR_SAMPLE],
+			at->attrs_base[ATTR_AGGR], at->attrs_base[ATTR_UPDATE],
+			at->attrs_base[ATTR_MIN], at->attrs_base[ATTR_MAX]);
+	at->changed = B_FALSE;
+}
+
+/*
+ * Compute the next attributes. Over the CPU target, the max regions
+ * is first brought down to the wanted resolution, then the sampling
+ * is made coarser, and the max regions is cut as the last resort.
+ * Under the target, the same steps are undone in reverse order.
+ */
+static void autotune_next(autotune_t *at, uint64_t *want, int dir)
+{
+	uint64_t ceiling, floor, v;
+
+	memcpy(want, at->attrs_cur, sizeof(uint64_t) * ATTR_NUM);
+	ceiling = (at->regions_target != 0) ?
+	    at->regions_target : at->attrs_base[ATTR_MAX];
+	floor = MIN(at->attrs_base[ATTR_MIN], ceiling);
+	if (floor < AUTOTUNE_REGIONS_MIN) {
+		floor = MIN(AUTOTUNE_REGIONS_MIN, ceiling);
+	}
+
+	if (dir > 0) {
+		if (want[ATTR_MAX] > ceiling) {
+			want[ATTR_MAX] = ceiling;
+		} else if (want[ATTR_SAMPLE] * 2 <= AUTOTUNE_SAMPLE_MAX) {
+			want[ATTR_SAMPLE] *= 2;
+			want[ATTR_AGGR] *= 2;
+		} else {
+			v = want[ATTR_MAX] * 3 / 4;
+			want[ATTR_MAX] = (v > floor) ? v : floor;
+		}
+	} else {
+		if (want[ATTR_MAX] < ceiling &&
+		    want[ATTR_SAMPLE] * 2 > AUTOTUNE_SAMPLE_MAX) {
+			/* Undo the last resort first */
+			want[ATTR_MAX] = MIN(want[ATTR_MAX] * 2, ceiling);
+		} else if (want[ATTR_SAMPLE] > at->attrs_base[ATTR_SAMPLE]) {
+			want[ATTR_SAMPLE] /= 2;
+			want[ATTR_AGGR] /= 2;
+		} else if (want[ATTR_MAX] < ceiling &&
+		    at->regions_cur * 10 >= (double)want[ATTR_MAX] * 9) {
+			/* DAMON uses all the regions it is allowed to */
+			want[ATTR_MAX] = MIN(want[ATTR_MAX] * 2, ceiling);
+		}
+	}
+
+	want[ATTR_MIN] = MIN(at->attrs_base[ATTR_MIN], want[ATTR_MAX]);
+}
+
+static void autotune_apply(autotune_t *at, uint64_t *want)
+{
+	if (memcmp(want, at->attrs_cur, sizeof(uint64_t) * ATTR_NUM) == 0) {
+		return;
+	}
+
+	debug_print(NULL, 2, "autotune: cpu %.2f%%, regions %.0f -> "
+			"sample %" PRIu64 " aggr %" PRIu64 " regions %" PRIu64
+			"-%" PRIu64 "\n", at->cpu_cur, at->regions_cur,
+			want[ATTR_SAMPLE], want[ATTR_AGGR], want[ATTR_MIN],
+			want[ATTR_MAX]);
+
+	at->changed = B_TRUE;
+	if (write_damon_attrs_check(want[ATTR_SAMPLE], want[ATTR_AGGR],
+			want[ATTR_UPDATE], want[ATTR_MIN], want[ATTR_MAX]) != 0) {
+		debug_print(NULL, 2, "autotune: DAMON attrs are not updated\n");
+		at->refused = B_TRUE;
+		return;
+	}
+
+	memcpy(at->attrs_cur, want, sizeof(uint64_t) * ATTR_NUM);
+}
+
+/*
+ * Called by the perf thread on every sampling, the attributes are
+ * reconsidered every AUTOTUNE_PERIOD_MS.
+ */
+void autotune_tick(void)
+{
+	autotune_t *at = &s_autotune;
+	uint64_t ns, slice, regions, want[ATTR_NUM];
+	double secs, cpu;
+	int pid, dir = 0;
+
+	if (!at->enabled || at->refused) {
+		return;
+	}
+
+	ns = stats_ns();
+	if (at->ns_last != 0 &&
+	    ns - at->ns_last < (uint64_t)AUTOTUNE_PERIOD_MS * NS_MS) {
+		return;
+	}
+
+	if ((pid = get_kdamon_pid()) <= 0 ||
+	    proc_slice_read(pid, &slice) != 0) {
+		return;
+	}
+
+	regions = kdamon_regions_get(pid);
+	if (pid != at->pid_last || at->ns_last == 0 ||
+	    slice < at->slice_last) {
+		at->pid_last = pid;
+		at->streak = 0;
+		goto L_EXIT;
+	}
+
+	secs = (double)(ns - at->ns_last) / NS_SEC;
+	cpu = (double)(slice - at->slice_last) * 100.0 /
+	    sysconf(_SC_CLK_TCK) / secs;
+
+	(void)pthread_mutex_lock(&s_autotune_mutex);
+	at->cpu_cur = cpu;
+	at->regions_cur = (double)(regions - at->regions_last) / secs *
+	    at->attrs_cur[ATTR_AGGR] / 1000000.0;
+	(void)pthread_mutex_unlock(&s_autotune_mutex);
+
+	if (cpu * 100.0 > at->cpu_target * AUTOTUNE_HIGH_PCT) {
+		dir = 1;
+	} else if (cpu * 100.0 < at->cpu_target * AUTOTUNE_LOW_PCT) {
+		dir = -1;
+	}
+
+	/* Act only when the direction holds for a few periods. */
+	if (dir == 0 || (dir > 0) != (at->streak > 0)) {
+		at->streak = dir;
+	} else {
+		at->streak += dir;
+	}
+
+	if (abs(at->streak) >= AUTOTUNE_STREAK) {
+		at->streak = 0;
+		autotune_next(at, want, dir);
+		autotune_apply(at, want);
+	}
+
+L_EXIT:
+	at->ns_last = ns;
+	at->slice_last = slice;
+	at->regions_last = regions;
+}
+
+/*
+ * Build the tuning status, written as a curses format string.
+ */
+int autotune_status_build(char *buf, int size)
+{
+	autotune_t *at = &s_autotune;
+	int len;
+
+	if (!at->enabled) {
+		buf[0] = 0;
+		return (0);
+	}
+
+	(void)pthread_mutex_lock(&s_autotune_mutex);
+	len = snprintf(buf, size, "Autotune%s: kdamond cpu %.2f%%%%/%.2f%%%%, "
+			"regions %.0f/%" PRIu64 ", sample %" PRIu64 "us, "
+			"aggr %" PRIu64 "us", at->refused ? " (off)" : "",
+			at->cpu_cur, at->cpu_target, at->regions_cur,
+			at->attrs_cur[ATTR_MAX], at->attrs_cur[ATTR_SAMPLE],
+			at->attrs_cur[ATTR_AGGR]);
+	(void)pthread_mutex_unlock(&s_autotune_mutex);
+	return (len);
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the headless batch mode (--batch count[,secs]).
+ * There is no curses, no cons thread and no disp thread: a single loop
+ * asks the perf thread for one sampling per interval and writes the
+ * process and region tables directly (see emit.c for the formats).
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/proc.h"
+#include "include/disp.h"
+#include "include/perf.h"
+#include "include/stats.h"
+#include "include/emit.h"
+#include "include/batch.h"
+#include "include/cgroup.h"
+#include "include/os/os_perf.h"
+
+/*
+ * Consecutive failed intervals tolerated before batch mode gives up.
+ */
+#define BATCH_FAIL_MAX	3
+
+static int s_batch_count;
+static int s_batch_intval = DISP_DEFAULT_INTVAL;
+static FILE *s_batch_out;
+static volatile sig_atomic_t s_batch_quit;
+
+/*
+ * Parse "count[,secs]".
+ */
+int batch_parse(const char *spec)
+{
+	char *end;
+	long v;
+
+	if (spec == NULL) {
+		return (-1);
+	}
+
+	v = strtol(spec, &end, 10);
+	if (end == spec || v <= 0 || v > INT32_MAX) {
+		return (-1);
+	}
+
+	s_batch_count = (int)v;
+	if (*end == 0) {
+		return (0);
+	}
+
+	if (*end != ',') {
+		return (-1);
+	}
+
+	spec = end + 1;
+	v = strtol(spec, &end, 10);
+	if (end == spec || *end != 0 || v <= 0 || v > INT32_MAX / MS_SEC) {
+		return (-1);
+	}
+
+	s_batch_intval = (int)v;
+	return (0);
+}
+
+boolean_t batch_enabled(void)
+{
+	return (s_batch_count > 0);
+}
+
+/*
+ * The records go to stdout, or to the -d file.
+ */
+void batch_output_set(FILE *out)
+{
+	s_batch_out = out;
+}
+
+/*
+ * Called from the signal handler.
+ */
+void batch_quit(void)
+{
+	s_batch_quit = 1;
+}
+
+/*
+ * Sleep until 'deadline' (CLOCK_MONOTONIC), or until a signal asks
+ * to quit.
+ */
+static void batch_sleep_until(struct timespec *deadline)
+{
+	while (!s_batch_quit) {
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+		    deadline, NULL) != EINTR) {
+			break;
+		}
+	}
+}
+
+/*
+ * Copy the process and region tables of one interval into the epoch,
+ * then serialize and write it out of the proc group lock.
+ */
+static int batch_emit(int fd, emit_epoch_t *ep, uint32_t seq, uint64_t ms)
+{
+	track_proc_t *proc;
+	uint64_t start_ns = stats_ns();
+	int nprocs, nr_nonzero, i, j, ret = 0;
+
+	emit_epoch_begin(ep, seq, ms);
+	proc_count(&nprocs);
+
+	proc_group_lock();
+	proc_resort(g_sortkey);
+	for (i = 0; i < nprocs && ret == 0; i++) {
+		if ((proc = proc_sort_next()) == NULL) {
+			break;
+		}
+
+		proc_countvalue_sort(proc->countval_arr, &nr_nonzero);
+		proc->nr_nonzero = nr_nonzero;
+		ret = emit_proc_add(ep, proc->pid, proc->name,
+		    proc->countval_arr[0].counts[PERF_COUNT_DAMON_NR_REGIONS]);
+
+		for (j = 0; j < nr_nonzero && ret == 0; j++) {
+			ret = emit_region_add(ep, &proc->countval_arr[j]);
+		}
+	}
+	proc_group_unlock();
+
+	if (ret == 0) {
+		ret = emit_epoch_write(fd, ep);
+	}
+
+	stats_stage_end(STATS_STAGE_EMIT, start_ns);
+	return (ret);
+}
+
+/*
+ * The batch loop, it runs in the main thread after proc_group_init().
+ * Returns 0 when all the intervals (or the -t time) are done or a
+ * signal stopped it.
+ */
+int batch_run(void)
+{
+	FILE *out = (s_batch_out != NULL) ? s_batch_out : stdout;
+	struct timespec deadline;
+	emit_epoch_t epoch;
+	char comment[64];
+	uint64_t start_ms, deadline_ns;
+	int fd = fileno(out), seq = 0, nfail = 0, ret = -1;
+
+	if (disp_sync_init() != 0) {
+		return (-1);
+	}
+
+	if (perf_init() != 0) {
+		debug_print(NULL, 2, "batch: perf_init() is failed\n");
+		goto L_EXIT;
+	}
+
+	emit_epoch_init(&epoch);
+	(void)snprintf(comment, sizeof(comment),
+		       "datop batch: %d intervals of %ds",
+		       s_batch_count, s_batch_intval);
+	ret = emit_header_write(fd, &epoch, comment);
+
+	deadline_ns = stats_ns();
+	start_ms = current_ms(&g_tvbase);
+	while (ret == 0 && !s_batch_quit && seq < s_batch_count) {
+		if ((current_ms(&g_tvbase) - start_ms) / MS_SEC >=
+		    (uint64_t)g_run_secs) {
+			break;
+		}
+
+		deadline_ns += (uint64_t)s_batch_intval * NS_SEC;
+		stats_ts(deadline_ns, &deadline);
+		batch_sleep_until(&deadline);
+		if (s_batch_quit) {
+			break;
+		}
+
+		/* Follow the cgroup membership (-g), no-op otherwise. */
+		cgroup_events_handle();
+
+		if (perf_profiling_smpl(B_FALSE) != 0 ||
+		    disp_flag2_wait() != DISP_FLAG_PROFILING_DATA_READY) {
+			/*
+			 * The interval is spent either way: count it, so a
+			 * perf thread that never answers can't keep us here.
+			 */
+			debug_print(NULL, 2, "batch: sampling failed\n");
+			seq++;
+			if (++nfail >= BATCH_FAIL_MAX) {
+				stderr_print("batch: %d intervals failed "
+				    "in a row\n", nfail);
+				ret = -1;
+			}
+			continue;
+		}
+
+		nfail = 0;
+
+		if (batch_emit(fd, &epoch, ++seq,
+		    current_ms(&g_tvbase) - start_ms) != 0) {
+			debug_print(NULL, 2, "batch: write failed\n");
+			ret = -1;
+		}
+	}
+
+	emit_epoch_fini(&epoch);
+	perf_fini();
+
+L_EXIT:
+	disp_sync_fini();
+	if (out != stdout) {
+		(void)fclose(out);
+	}
+
+	s_batch_out = NULL;
+	return (ret);
+}
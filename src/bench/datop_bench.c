@@ -0,0 +1,781 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the microbenchmarks for the datop hot paths
+ * (built by "make bench").
+ *
+ * The ring decoding and ingest benchmarks run on a synthetic perf ring
+ * filled with "damon:damon_aggregated" samples. map_read() parses the
+ * maps file captured from a python3 process (src/bench/fixtures), so its
+ * numbers don't depend on the machine. map_proc_load() and procfs_walk()
+ * have to go through the live /proc (the pid is validated there), so they
+ * run on the benchmark process itself, which maps a batch of extra regions
+ * so that /proc/self/maps is non-trivial.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include "../include/types.h"
+#include "../include/util.h"
+#include "../include/proc.h"
+#include "../include/proc_map.h"
+#include "../include/pfwrapper.h"
+#include "../include/win.h"
+#include "../include/stats.h"
+#include "../include/os/os_perf.h"
+#include "../include/os/os_win.h"
+
+#define	BENCH_NAME_SIZE		32
+#define	BENCH_MIN_MS		200
+#define	BENCH_RING_NREC		4096
+#define	BENCH_RAW_SIZE		68
+#define	BENCH_MAP_NREGIONS	1024
+#define	BENCH_MAPLIST_NLINES	1024
+#define	BENCH_LINE_NUM		256
+
+#ifndef BENCH_FIXTURE_DIR
+#define	BENCH_FIXTURE_DIR	"src/bench/fixtures"
+#endif
+#define	BENCH_MAPS_FIXTURE	BENCH_FIXTURE_DIR "/python3.maps"
+
+int numa_stat = 1;
+extern perf_damon_event_t *perf_damon_conf;
+extern int get_perf_ringsize(void);
+
+typedef struct _bench {
+	char name[BENCH_NAME_SIZE];
+	int items;		/* work items handled by one op */
+	int (*setup)(struct _bench *);
+	void (*run)(void);
+	void (*teardown)(void);
+} bench_t;
+
+typedef struct _bench_result {
+	uint64_t iters;
+	double ns_per_op;
+	double allocs_per_op;
+	double bytes_per_op;
+} bench_result_t;
+
+/*
+ * Allocation accounting. The benchmark interposes the libc allocator so
+ * that allocations made inside libdatop (and inside libc on its behalf,
+ * e.g. fopen) are counted.
+ */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void __libc_free(void *);
+
+static uint64_t s_nallocs;
+static uint64_t s_nbytes;
+
+void *malloc(size_t n)
+{
+	__atomic_add_fetch(&s_nallocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&s_nbytes, n, __ATOMIC_RELAXED);
+	return (__libc_malloc(n));
+}
+
+void *calloc(size_t nmemb, size_t n)
+{
+	__atomic_add_fetch(&s_nallocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&s_nbytes, nmemb * n, __ATOMIC_RELAXED);
+	return (__libc_calloc(nmemb, n));
+}
+
+void *realloc(void *p, size_t n)
+{
+	__atomic_add_fetch(&s_nallocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&s_nbytes, n, __ATOMIC_RELAXED);
+	return (__libc_realloc(p, n));
+}
+
+void free(void *p)
+{
+	__libc_free(p);
+}
+
+/*
+ * Synthetic perf ring buffer.
+ */
+static struct perf_event_mmap_page *s_ring;
+static uint64_t s_ring_head;
+static pf_profiling_rec_t *s_recbuf;
+static pid_t s_target_pid;
+
+static void ring_put(void **pp, const void *src, int size)
+{
+	memcpy(*pp, src, size);
+	*pp = (char *)*pp + size;
+}
+
+/*
+ * Each sample has the layout decoded by profiling_sample_read():
+ * header, ip, pid/tid, time, cpu/res, period, raw size, raw data.
+ */
+static int ring_fill(pid_t target)
+{
+	struct perf_event_header ehdr;
+	unsigned char raw[BENCH_RAW_SIZE];
+	uint64_t u64, start;
+	uint32_t u32[2];
+	void *p;
+	int i, ringsize, recsize;
+
+	recsize = sizeof(ehdr) + 5 * sizeof(uint64_t) +
+	    sizeof(uint32_t) + BENCH_RAW_SIZE;
+	ringsize = get_perf_ringsize();
+	if (ringsize < recsize * BENCH_RING_NREC) {
+		return (-1);
+	}
+
+	p = (char *)s_ring + g_pagesize;
+	start = 0x7f0000000000ULL;
+	for (i = 0; i < BENCH_RING_NREC; i++) {
+		ehdr.type = PERF_RECORD_SAMPLE;
+		ehdr.misc = 0;
+		ehdr.size = recsize;
+		ring_put(&p, &ehdr, sizeof(ehdr));
+
+		u64 = 0xffffffff81000000ULL;
+		ring_put(&p, &u64, sizeof(u64));
+		u32[0] = u32[1] = 2;	/* kdamond pid/tid */
+		ring_put(&p, u32, sizeof(u32));
+		u64 = (uint64_t)i * 1000;
+		ring_put(&p, &u64, sizeof(u64));
+		u32[0] = i % 8;
+		u32[1] = 0;
+		ring_put(&p, u32, sizeof(u32));
+		u64 = 1;
+		ring_put(&p, &u64, sizeof(u64));
+		u32[0] = BENCH_RAW_SIZE;
+		ring_put(&p, u32, sizeof(uint32_t));
+
+		memset(raw, 0, sizeof(raw));
+		u64 = target;
+		memcpy(&raw[8], &u64, 8);
+		u32[0] = BENCH_RING_NREC;
+		memcpy(&raw[16], &u32[0], 4);
+		u64 = start + (uint64_t)i * 0x200000;
+		memcpy(&raw[24], &u64, 8);
+		u64 += 0x200000;
+		memcpy(&raw[32], &u64, 8);
+		u32[0] = i % 21;
+		memcpy(&raw[40], &u32[0], 4);
+		u32[0] = i % 97;
+		memcpy(&raw[44], &u32[0], 4);
+		u64 = i * 3;
+		memcpy(&raw[48], &u64, 8);
+		u64 = i * 5;
+		memcpy(&raw[56], &u64, 8);
+		ring_put(&p, raw, BENCH_RAW_SIZE);
+	}
+
+	s_ring_head = (uint64_t)recsize * BENCH_RING_NREC;
+	return (0);
+}
+
+static void ring_rewind(void)
+{
+	s_ring->data_tail = 0;
+	s_ring->data_head = s_ring_head;
+}
+
+static int ring_setup(void)
+{
+	int size = pf_ringsize_init() + g_pagesize;
+
+	if (posix_memalign((void **)&s_ring, g_pagesize, size) != 0) {
+		return (-1);
+	}
+
+	memset(s_ring, 0, size);
+	return (0);
+}
+
+/*
+ * Benchmark: pf_profiling_record() decodes the whole ring.
+ */
+static int bench_record_setup(bench_t *b)
+{
+	if (ring_fill(s_target_pid) != 0) {
+		return (-1);
+	}
+
+	if ((s_recbuf = zalloc(sizeof(pf_profiling_rec_t) *
+	    (BENCH_RING_NREC + 1))) == NULL) {
+		return (-1);
+	}
+
+	/* One kdamond, its ring is the first one. */
+	perf_damon_conf->map_base = s_ring;
+	perf_damon_conf->rings = NULL;
+	perf_damon_conf->nrings = 0;
+	return (0);
+}
+
+static void bench_record_run(void)
+{
+	int nrec;
+
+	ring_rewind();
+	pf_profiling_record(0, s_recbuf, &nrec);
+}
+
+static void bench_record_teardown(void)
+{
+	free(s_recbuf);
+	s_recbuf = NULL;
+	perf_damon_conf->map_base = MAP_FAILED;
+}
+
+/*
+ * Benchmark: __profiling_smpl() decodes the ring and ingests the records
+ * into the tracked process.
+ */
+static int bench_smpl_setup(bench_t *b)
+{
+	if (ring_fill(s_target_pid) != 0) {
+		return (-1);
+	}
+
+	perf_damon_conf->map_base = s_ring;
+	perf_damon_conf->rings = NULL;
+	perf_damon_conf->nrings = 0;
+	return (0);
+}
+
+static void bench_smpl_run(void)
+{
+	ring_rewind();
+	(void)__profiling_smpl();
+}
+
+static void bench_smpl_teardown(void)
+{
+	perf_damon_conf->map_base = MAP_FAILED;
+}
+
+/*
+ * Benchmark: proc_countvalue_sort() on a full record array with
+ * overlapped regions.
+ */
+static count_value_t *s_countval_tmpl;
+static count_value_t *s_countval_arr;
+
+static int bench_cvsort_setup(bench_t *b)
+{
+	count_value_t *cv;
+	uint64_t start;
+	int i;
+
+	s_countval_tmpl = zalloc(sizeof(count_value_t) * PROC_RECORD_MAX);
+	s_countval_arr = zalloc(sizeof(count_value_t) * PROC_RECORD_MAX);
+	if (s_countval_tmpl == NULL || s_countval_arr == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < PROC_RECORD_MAX; i++) {
+		cv = &s_countval_tmpl[i];
+		/* Every 4th region is contained by its successor. */
+		start = 0x7f0000000000ULL +
+		    (uint64_t)((i * 7919) % PROC_RECORD_MAX) * 0x100000;
+		cv->counts[PERF_COUNT_DAMON_NR_REGIONS] = PROC_RECORD_MAX;
+		cv->counts[PERF_COUNT_DAMON_START] = start;
+		cv->counts[PERF_COUNT_DAMON_END] = start +
+		    ((i % 4 == 0) ? 0x80000 : 0x100000);
+		cv->counts[PERF_COUNT_DAMON_NR_ACCESS] = i % 21;
+		cv->counts[PERF_COUNT_DAMON_AGE] = i % 97;
+		cv->counts[PERF_COUNT_DAMON_LOCAL] = i * 3;
+		cv->counts[PERF_COUNT_DAMON_REMOTE] = i * 5;
+	}
+
+	return (0);
+}
+
+static void bench_cvsort_run(void)
+{
+	int nonzero;
+
+	memcpy(s_countval_arr, s_countval_tmpl,
+	       sizeof(count_value_t) * PROC_RECORD_MAX);
+	proc_countvalue_sort(s_countval_arr, &nonzero);
+}
+
+static void bench_cvsort_teardown(void)
+{
+	free(s_countval_tmpl);
+	free(s_countval_arr);
+	s_countval_tmpl = s_countval_arr = NULL;
+}
+
+/*
+ * Benchmark: proc_resort() over all processes in /proc.
+ */
+static int bench_resort_setup(bench_t *b)
+{
+	proc_count(&b->items);
+	return (0);
+}
+
+static void bench_resort_run(void)
+{
+	proc_group_lock();
+	proc_resort(SORT_KEY_CPU);
+	proc_group_unlock();
+}
+
+/*
+ * Benchmark: map_read() on the captured maps file.
+ */
+static track_proc_t s_map_file;
+
+static int bench_map_read_setup(bench_t *b)
+{
+	memset(&s_map_file, 0, sizeof(s_map_file));
+	if (map_file_read(BENCH_MAPS_FIXTURE, &s_map_file.map) != 0) {
+		return (-1);
+	}
+
+	b->items = s_map_file.map.nentry_cur;
+	(void)map_proc_fini(&s_map_file);
+	return (0);
+}
+
+static void bench_map_read_run(void)
+{
+	(void)map_file_read(BENCH_MAPS_FIXTURE, &s_map_file.map);
+	(void)map_proc_fini(&s_map_file);
+}
+
+/*
+ * Benchmark: map_proc_load() on /proc/self/maps.
+ */
+static track_proc_t s_map_proc;
+
+static int bench_map_setup(bench_t *b)
+{
+	memset(&s_map_proc, 0, sizeof(s_map_proc));
+	s_map_proc.pid = getpid();
+	if (map_read(s_map_proc.pid, &s_map_proc.map) != 0) {
+		return (-1);
+	}
+
+	b->items = s_map_proc.map.nentry_cur;
+	return (0);
+}
+
+static void bench_map_load_run(void)
+{
+	(void)map_proc_load(&s_map_proc);
+}
+
+static void bench_map_teardown(void)
+{
+	(void)map_proc_fini(&s_map_proc);
+}
+
+/*
+ * Benchmark: procfs_walk() on /proc. The DAMON status probe prints to
+ * stderr when debugfs is absent, so stderr is muted while it runs.
+ */
+static int s_stderr_fd = -1;
+
+static int bench_walk_setup(bench_t *b)
+{
+	pid_t *ids;
+	int fd;
+
+	if ((fd = open("/dev/null", O_WRONLY)) < 0) {
+		return (-1);
+	}
+
+	fflush(stderr);
+	s_stderr_fd = dup(STDERR_FILENO);
+	(void)dup2(fd, STDERR_FILENO);
+	close(fd);
+
+	if (b != NULL && procfs_proc_enum(&ids, &b->items) == 0) {
+		free(ids);
+	}
+
+	return (0);
+}
+
+static void bench_walk_run(void)
+{
+	int *ids, num = PROCFS_ID_NUM;
+
+	if ((ids = zalloc(PROCFS_ID_NUM * sizeof(int))) == NULL) {
+		return;
+	}
+
+	if (procfs_walk("/proc", &ids, &num) == 0) {
+		free(ids);
+	}
+}
+
+static void bench_walk_teardown(void)
+{
+	if (s_stderr_fd >= 0) {
+		fflush(stderr);
+		(void)dup2(s_stderr_fd, STDERR_FILENO);
+		close(s_stderr_fd);
+		s_stderr_fd = -1;
+	}
+}
+
+/*
+ * Benchmark: os_maplist_buf_hit() for every line of a map-list window.
+ */
+static maplist_line_t *s_maplist;
+static track_proc_t s_hit_proc;
+
+static int bench_bufhit_setup(bench_t *b)
+{
+	int i;
+
+	if (bench_cvsort_setup(b) != 0) {
+		return (-1);
+	}
+
+	memset(&s_hit_proc, 0, sizeof(s_hit_proc));
+	s_hit_proc.countval_arr = s_countval_arr;
+	memcpy(s_countval_arr, s_countval_tmpl,
+	       sizeof(count_value_t) * PROC_RECORD_MAX);
+	proc_countvalue_sort(s_countval_arr, &s_hit_proc.nr_nonzero);
+
+	if ((s_maplist = zalloc(sizeof(maplist_line_t) *
+	    BENCH_MAPLIST_NLINES)) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < BENCH_MAPLIST_NLINES; i++) {
+		s_maplist[i].bufaddr.addr = 0x7f0000000000ULL +
+		    (uint64_t)i * 0x40000;
+		s_maplist[i].bufaddr.size = 0x40000;
+	}
+
+	return (0);
+}
+
+static void bench_bufhit_run(void)
+{
+	uint64_t total = 0;
+	int i;
+
+	for (i = 0; i < BENCH_MAPLIST_NLINES; i++) {
+		os_maplist_buf_hit(&s_maplist[i], BENCH_MAPLIST_NLINES,
+				   NULL, &s_hit_proc, &total);
+	}
+}
+
+static void bench_bufhit_teardown(void)
+{
+	free(s_maplist);
+	s_maplist = NULL;
+	bench_cvsort_teardown();
+}
+
+/*
+ * Benchmarks: line formatting of the process and region windows.
+ */
+static topnproc_line_t *s_topn_lines;
+static moni_line_t *s_moni_lines;
+static int s_line_idx;
+
+static void line_value_fill(win_countvalue_t *value, int i)
+{
+	value->start = 0x7f0000000000ULL + (uint64_t)i * 0x200000;
+	value->end = value->start + 0x200000;
+	value->nr_access = i % 21;
+	value->age = i % 97;
+	value->local = (i % 3) ? i * 3 : 0;
+	value->remote = (i % 3) ? i * 5 : 0;
+}
+
+static int bench_line_setup(bench_t *b)
+{
+	int i;
+
+	s_topn_lines = zalloc(sizeof(topnproc_line_t) * BENCH_LINE_NUM);
+	s_moni_lines = zalloc(sizeof(moni_line_t) * BENCH_LINE_NUM);
+	if (s_topn_lines == NULL || s_moni_lines == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < BENCH_LINE_NUM; i++) {
+		line_value_fill(&s_topn_lines[i].value, i);
+		s_topn_lines[i].pid = 1000 + i;
+		(void)snprintf(s_topn_lines[i].proc_name,
+			       WIN_PROCNAME_SIZE, "proc-%d", i);
+		(void)strcpy(s_topn_lines[i].map_attr, "rw-p");
+
+		line_value_fill(&s_moni_lines[i].value, i);
+		s_moni_lines[i].pid = 1000;
+		(void)strcpy(s_moni_lines[i].map_attr, "r-xp");
+	}
+
+	s_line_idx = 0;
+	return (0);
+}
+
+static void bench_topn_str_run(void)
+{
+	char line[WIN_LINECHAR_MAX];
+
+	topnproc_str_build(line, sizeof(line), s_line_idx, s_topn_lines);
+	s_line_idx = (s_line_idx + 1) % BENCH_LINE_NUM;
+}
+
+static void bench_moni_str_run(void)
+{
+	char line[WIN_LINECHAR_MAX];
+
+	moni_str_build(line, sizeof(line), s_line_idx, s_moni_lines);
+	s_line_idx = (s_line_idx + 1) % BENCH_LINE_NUM;
+}
+
+static void bench_line_teardown(void)
+{
+	free(s_topn_lines);
+	free(s_moni_lines);
+	s_topn_lines = NULL;
+	s_moni_lines = NULL;
+}
+
+static bench_t s_bench_arr[] = {
+	{ "pf_profiling_record", BENCH_RING_NREC,
+	  bench_record_setup, bench_record_run, bench_record_teardown },
+	{ "profiling_smpl", BENCH_RING_NREC,
+	  bench_smpl_setup, bench_smpl_run, bench_smpl_teardown },
+	{ "proc_countvalue_sort", PROC_RECORD_MAX,
+	  bench_cvsort_setup, bench_cvsort_run, bench_cvsort_teardown },
+	{ "proc_resort", 0,
+	  bench_resort_setup, bench_resort_run, NULL },
+	{ "map_read", 0,
+	  bench_map_read_setup, bench_map_read_run, NULL },
+	{ "map_proc_load", 0,
+	  bench_map_setup, bench_map_load_run, bench_map_teardown },
+	{ "procfs_walk", 0,
+	  bench_walk_setup, bench_walk_run, bench_walk_teardown },
+	{ "os_maplist_buf_hit", BENCH_MAPLIST_NLINES,
+	  bench_bufhit_setup, bench_bufhit_run, bench_bufhit_teardown },
+	{ "topnproc_str_build", 1,
+	  bench_line_setup, bench_topn_str_run, bench_line_teardown },
+	{ "moni_str_build", 1,
+	  bench_line_setup, bench_moni_str_run, bench_line_teardown },
+};
+
+#define	BENCH_NUM	(sizeof(s_bench_arr) / sizeof(bench_t))
+
+/*
+ * Run 'b' with doubling iteration counts until one batch takes at
+ * least 'min_ms'.
+ */
+static void bench_exec(bench_t *b, int min_ms, bench_result_t *res)
+{
+	uint64_t iters = 1, i, t0, t1, nallocs, nbytes;
+
+	/* warm up */
+	b->run();
+
+	for (;;) {
+		nallocs = s_nallocs;
+		nbytes = s_nbytes;
+		t0 = stats_ns();
+		for (i = 0; i < iters; i++) {
+			b->run();
+		}
+		t1 = stats_ns();
+
+		if (t1 - t0 >= (uint64_t)min_ms * NS_MS || iters >= (1ULL << 30)) {
+			break;
+		}
+
+		iters <<= 1;
+	}
+
+	res->iters = iters;
+	res->ns_per_op = (double)(t1 - t0) / iters;
+	res->allocs_per_op = (double)(s_nallocs - nallocs) / iters;
+	res->bytes_per_op = (double)(s_nbytes - nbytes) / iters;
+}
+
+/*
+ * Map a batch of small regions with alternating protection so that
+ * the kernel can't merge them, which makes /proc/self/maps long.
+ */
+static void maps_fixture_init(void)
+{
+	char *base;
+	int i;
+
+	base = mmap(NULL, BENCH_MAP_NREGIONS * g_pagesize, PROT_READ,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		return;
+	}
+
+	for (i = 0; i < BENCH_MAP_NREGIONS; i += 2) {
+		(void)mprotect(base + i * g_pagesize, g_pagesize,
+			       PROT_READ | PROT_WRITE);
+	}
+}
+
+/*
+ * Pick a tracked process as the target of the synthetic samples.
+ */
+static pid_t target_pid_get(void)
+{
+	track_proc_t *proc;
+	pid_t pid = getppid();
+
+	if ((proc = proc_find(pid)) != NULL) {
+		proc_refcount_dec(proc);
+		return (pid);
+	}
+
+	proc_group_lock();
+	proc_resort(SORT_KEY_PID);
+	proc = proc_sort_next();
+	pid = (proc != NULL) ? proc->pid : 0;
+	proc_group_unlock();
+	return (pid);
+}
+
+static void print_usage(const char *exec_name)
+{
+	stderr_print("Usage: %s [option(s)]\n", exec_name);
+	stderr_print("  -h    print help\n"
+		     "  -m    machine-readable output (CSV)\n"
+		     "  -t    minimal running time in ms per benchmark\n"
+		     "        (default %d)\n"
+		     "  -b    run only the benchmark with this name\n",
+		     BENCH_MIN_MS);
+}
+
+int main(int argc, char *argv[])
+{
+	bench_result_t res;
+	bench_t *b;
+	boolean_t machine = B_FALSE;
+	char *only = NULL;
+	int min_ms = BENCH_MIN_MS, c, ret = 0;
+	unsigned int i;
+
+	while ((c = getopt(argc, argv, "hmt:b:")) != EOF) {
+		switch (c) {
+		case 'm':
+			machine = B_TRUE;
+			break;
+		case 't':
+			if ((min_ms = atoi(optarg)) <= 0) {
+				min_ms = BENCH_MIN_MS;
+			}
+			break;
+		case 'b':
+			only = optarg;
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			return (c == 'h' ? 0 : 1);
+		}
+	}
+
+	g_precise = PRECISE_NORMAL;
+	damontop_pid = getpid();
+	pagesize_init();
+	maps_fixture_init();
+
+	if (proc_group_init() != 0 || os_perf_init() != 0 ||
+	    ring_setup() != 0) {
+		stderr_print("Failed to initialize the benchmark.\n");
+		return (1);
+	}
+
+	(void)bench_walk_setup(NULL);
+	proc_enum_update(0);
+	bench_walk_teardown();
+	s_target_pid = target_pid_get();
+
+	if (machine) {
+		(void)printf("name,iters,items_per_op,ns_per_op,"
+			     "allocs_per_op,bytes_per_op\n");
+	} else {
+		(void)printf("%-22s%12s%8s%14s%12s%14s\n", "BENCH", "ITERS",
+			     "ITEMS", "NS/OP", "ALLOCS/OP", "BYTES/OP");
+	}
+
+	for (i = 0; i < BENCH_NUM; i++) {
+		b = &s_bench_arr[i];
+		if (only != NULL && strcmp(only, b->name) != 0) {
+			continue;
+		}
+
+		if (b->setup != NULL && b->setup(b) != 0) {
+			stderr_print("%s: setup failed.\n", b->name);
+			ret = 1;
+			continue;
+		}
+
+		bench_exec(b, min_ms, &res);
+
+		if (b->teardown != NULL) {
+			b->teardown();
+		}
+
+		if (machine) {
+			(void)printf("%s,%" PRIu64 ",%d,%.1f,%.2f,%.1f\n",
+				     b->name, res.iters, b->items,
+				     res.ns_per_op, res.allocs_per_op,
+				     res.bytes_per_op);
+		} else {
+			(void)printf("%-22s%12" PRIu64 "%8d%14.1f%12.2f%14.1f\n",
+				     b->name, res.iters, b->items,
+				     res.ns_per_op, res.allocs_per_op,
+				     res.bytes_per_op);
+		}
+		fflush(stdout);
+	}
+
+	os_perf_fini();
+	proc_group_fini();
+	free(s_ring);
+	return (ret);
+}
@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the self-overhead budget of datop. When the budget
+ * (--budget cpu=N%,rss=NM) is exceeded, datop degrades itself step by step
+ * (see BUDGET_LEVEL_*) and restores the full fidelity once the overhead
+ * stays well below the budget for a few ticks.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/damon.h"
+#include "include/stats.h"
+#include "include/autotune.h"
+#include "include/budget.h"
+
+#define	BUDGET_THREAD_MAX	8
+
+typedef struct _budget_thread {
+	char name[16];
+	clockid_t clk;
+	uint64_t cpu_ns_last;
+} budget_thread_t;
+
+typedef struct _budget {
+	boolean_t enabled;
+	double cpu_pct;			/* 0: no CPU budget */
+	uint64_t rss_bytes;		/* 0: no RSS budget */
+	int level;
+	int calm_ticks;
+	uint64_t ticks;
+	double cpu_pct_cur;
+	uint64_t rss_bytes_cur;
+	uint64_t cpu_ns_last;
+	uint64_t wall_ns_last;
+	budget_thread_t threads[BUDGET_THREAD_MAX];
+	int nthreads;
+	uint64_t attrs_base[ATTR_NUM];
+	boolean_t attrs_changed;
+} budget_t;
+
+static budget_t s_budget;
+static pthread_mutex_t s_budget_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t s_attrs_cur[ATTR_NUM];
+static boolean_t s_attrs_refused;
+
+/*
+ * Parse the budget specification, e.g. "cpu=2%,rss=64M". The CPU budget
+ * is the percent of one CPU, the RSS budget accepts K/M/G suffixes.
+ */
+int budget_parse(const char *spec)
+{
+	char buf[128], *token, *saveptr = NULL, *end;
+	double v;
+
+	if (spec == NULL || strlen(spec) >= sizeof(buf)) {
+		return (-1);
+	}
+
+	(void)strncpy(buf, spec, sizeof(buf));
+	for (token = strtok_r(buf, ",", &saveptr); token != NULL;
+	    token = strtok_r(NULL, ",", &saveptr)) {
+		if (strncasecmp(token, "cpu=", 4) == 0) {
+			if (pct_parse(token + 4, &s_budget.cpu_pct) != 0) {
+				return (-1);
+			}
+		} else if (strncasecmp(token, "rss=", 4) == 0) {
+			v = strtod(token + 4, &end);
+			if (end == token + 4 || v <= 0.0) {
+				return (-1);
+			}
+			switch (*end) {
+			case 'g':
+			case 'G':
+				v *= 1024.0;
+				/* FALLTHROUGH */
+			case 'm':
+			case 'M':
+				v *= 1024.0;
+				/* FALLTHROUGH */
+			case 'k':
+			case 'K':
+				v *= 1024.0;
+				end++;
+				break;
+			case 0:
+				break;
+			default:
+				return (-1);
+			}
+			if (*end != 0) {
+				return (-1);
+			}
+			s_budget.rss_bytes = (uint64_t)v;
+		} else {
+			return (-1);
+		}
+	}
+
+	if (s_budget.cpu_pct == 0.0 && s_budget.rss_bytes == 0) {
+		return (-1);
+	}
+
+	s_budget.enabled = B_TRUE;
+	return (0);
+}
+
+/*
+ * Called after the command line is parsed, so the DAMON attributes
+ * which are read here already include the user settings (e.g. -r).
+ */
+void budget_init(void)
+{
+	if (!s_budget.enabled) {
+		return;
+	}
+
+	memset(s_budget.attrs_base, 0, sizeof(s_budget.attrs_base));
+	read_damon_attrs(DAMON_ATTRS_PATH, &s_budget.attrs_base[ATTR_SAMPLE],
+			&s_budget.attrs_base[ATTR_AGGR],
+			&s_budget.attrs_base[ATTR_UPDATE],
+			&s_budget.attrs_base[ATTR_MIN],
+			&s_budget.attrs_base[ATTR_MAX]);
+	memcpy(s_attrs_cur, s_budget.attrs_base, sizeof(s_attrs_cur));
+
+	/* Without valid attributes, never touch the DAMON settings. */
+	if (s_budget.attrs_base[ATTR_SAMPLE] == 0 ||
+	    s_budget.attrs_base[ATTR_AGGR] == 0) {
+		s_attrs_refused = B_TRUE;
+	}
+
+	debug_print(NULL, 2, "budget: cpu %.1f%%, rss %" PRIu64 " bytes\n",
+			s_budget.cpu_pct, s_budget.rss_bytes);
+}
+
+/*
+ * Restore the DAMON attributes if they were changed by the budget.
+ * It must be called after monitoring has been stopped.
+ */
+void budget_fini(void)
+{
+	if (!s_budget.enabled || !s_budget.attrs_changed) {
+		return;
+	}
+
+	write_damon_attrs(s_budget.attrs_base[ATTR_SAMPLE],
+			s_budget.attrs_base[ATTR_AGGR],
+			s_budget.attrs_base[ATTR_UPDATE],
+			s_budget.attrs_base[ATTR_MIN],
+			s_budget.attrs_base[ATTR_MAX]);
+	s_budget.attrs_changed = B_FALSE;
+}
+
+/*
+ * Register the calling thread, its CPU time is reported separately
+ * in the debug log.
+ */
+void budget_thread_register(const char *name)
+{
+	budget_thread_t *t;
+
+	if (!s_budget.enabled) {
+		return;
+	}
+
+	(void)pthread_mutex_lock(&s_budget_mutex);
+	if (s_budget.nthreads < BUDGET_THREAD_MAX) {
+		t = &s_budget.threads[s_budget.nthreads];
+		if (pthread_getcpuclockid(pthread_self(), &t->clk) == 0) {
+			(void)strncpy(t->name, name, sizeof(t->name) - 1);
+			t->cpu_ns_last = 0;
+			s_budget.nthreads++;
+		}
+	}
+	(void)pthread_mutex_unlock(&s_budget_mutex);
+}
+
+static uint64_t rss_read(void)
+{
+	FILE *fp;
+	unsigned long size, resident;
+	uint64_t rss = 0;
+
+	if ((fp = fopen("/proc/self/statm", "r")) == NULL) {
+		return (0);
+	}
+
+	if (fscanf(fp, "%lu %lu", &size, &resident) == 2) {
+		rss = (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE);
+	}
+
+	(void)fclose(fp);
+	return (rss);
+}
+
+static void threads_log(void)
+{
+	budget_thread_t *t;
+	struct timespec ts;
+	uint64_t ns;
+	int i;
+
+	(void)pthread_mutex_lock(&s_budget_mutex);
+	for (i = 0; i < s_budget.nthreads; i++) {
+		t = &s_budget.threads[i];
+		if (clock_gettime(t->clk, &ts) != 0) {
+			continue;
+		}
+
+		ns = (uint64_t)ts.tv_sec * NS_SEC + (uint64_t)ts.tv_nsec;
+		debug_print(NULL, 2, "budget: thread %s cpu %" PRIu64 "us\n",
+				t->name, (ns - t->cpu_ns_last) / 1000);
+		t->cpu_ns_last = ns;
+	}
+	(void)pthread_mutex_unlock(&s_budget_mutex);
+}
+
+/*
+ * Apply the DAMON attributes for the current level. The attributes are
+ * written only if they differ from what was written last time.
+ */
+static void attrs_apply(int level)
+{
+	uint64_t want[ATTR_NUM];
+
+	/* The auto-tuner owns the attributes when it is enabled. */
+	if (s_attrs_refused || autotune_enabled()) {
+		return;
+	}
+
+	memcpy(want, s_budget.attrs_base, sizeof(want));
+	if (level >= BUDGET_LEVEL_REGIONS) {
+		want[ATTR_MAX] = (want[ATTR_MAX] / 2 > want[ATTR_MIN]) ?
+		    want[ATTR_MAX] / 2 : want[ATTR_MIN];
+	}
+
+	if (level >= BUDGET_LEVEL_SAMPLE) {
+		want[ATTR_SAMPLE] *= 2;
+		want[ATTR_AGGR] *= 2;
+	}
+
+	if (memcmp(want, s_attrs_cur, sizeof(want)) == 0) {
+		return;
+	}
+
+	/* Stop trying if the kernel refuses the update. */
+	s_budget.attrs_changed = B_TRUE;
+	if (write_damon_attrs_check(want[ATTR_SAMPLE], want[ATTR_AGGR],
+			want[ATTR_UPDATE], want[ATTR_MIN], want[ATTR_MAX]) != 0) {
+		debug_print(NULL, 2, "budget: DAMON attrs are not updated\n");
+		s_attrs_refused = B_TRUE;
+		return;
+	}
+
+	memcpy(s_attrs_cur, want, sizeof(s_attrs_cur));
+}
+
+/*
+ * Measure the overhead of the last tick and adjust the level.
+ * Called by the perf thread on every sampling.
+ */
+void budget_tick(void)
+{
+	uint64_t cpu_ns, wall_ns;
+	boolean_t over = B_FALSE, calm = B_TRUE;
+	int level;
+
+	if (!s_budget.enabled) {
+		return;
+	}
+
+	if ((cpu_ns = stats_cpu_ns()) == 0) {
+		return;
+	}
+
+	wall_ns = stats_ns();
+	s_budget.rss_bytes_cur = rss_read();
+	threads_log();
+
+	if (s_budget.wall_ns_last == 0 || wall_ns <= s_budget.wall_ns_last) {
+		s_budget.cpu_ns_last = cpu_ns;
+		s_budget.wall_ns_last = wall_ns;
+		return;
+	}
+
+	s_budget.cpu_pct_cur = (double)(cpu_ns - s_budget.cpu_ns_last) * 100.0 /
+	    (double)(wall_ns - s_budget.wall_ns_last);
+	s_budget.cpu_ns_last = cpu_ns;
+	s_budget.wall_ns_last = wall_ns;
+	__atomic_add_fetch(&s_budget.ticks, 1, __ATOMIC_RELAXED);
+
+	if (s_budget.cpu_pct > 0.0) {
+		if (s_budget.cpu_pct_cur > s_budget.cpu_pct) {
+			over = B_TRUE;
+		} else if (s_budget.cpu_pct_cur * 100.0 >
+		    s_budget.cpu_pct * BUDGET_CALM_PCT) {
+			calm = B_FALSE;
+		}
+	}
+
+	if (s_budget.rss_bytes > 0) {
+		if (s_budget.rss_bytes_cur > s_budget.rss_bytes) {
+			over = B_TRUE;
+		} else if (s_budget.rss_bytes_cur * 100 >
+		    s_budget.rss_bytes * BUDGET_CALM_PCT) {
+			calm = B_FALSE;
+		}
+	}
+
+	level = budget_level();
+	if (over) {
+		s_budget.calm_ticks = 0;
+		if (level < BUDGET_LEVEL_MAX) {
+			level++;
+		}
+	} else if (calm) {
+		if (++s_budget.calm_ticks >= BUDGET_CALM_TICKS) {
+			s_budget.calm_ticks = 0;
+			if (level > BUDGET_LEVEL_NONE) {
+				level--;
+			}
+		}
+	} else {
+		s_budget.calm_ticks = 0;
+	}
+
+	if (level != budget_level()) {
+		debug_print(NULL, 2, "budget: level %d -> %d "
+				"(cpu %.2f%%, rss %" PRIu64 "KB)\n",
+				budget_level(), level, s_budget.cpu_pct_cur,
+				s_budget.rss_bytes_cur / 1024);
+		__atomic_store_n(&s_budget.level, level, __ATOMIC_RELEASE);
+	}
+
+	attrs_apply(level);
+}
+
+int budget_level(void)
+{
+	return (__atomic_load_n(&s_budget.level, __ATOMIC_ACQUIRE));
+}
+
+/*
+ * The display interval (in seconds) for the current level.
+ */
+int budget_disp_intval(int intval)
+{
+	if (budget_level() >= BUDGET_LEVEL_INTVAL) {
+		return (intval * 2);
+	}
+
+	return (intval);
+}
+
+/*
+ * Return B_TRUE if the maps which have been loaded can be kept
+ * without reloading in this tick.
+ */
+boolean_t budget_maps_skip(void)
+{
+	uint64_t ticks;
+
+	if (budget_level() < BUDGET_LEVEL_MAPS) {
+		return (B_FALSE);
+	}
+
+	ticks = __atomic_load_n(&s_budget.ticks, __ATOMIC_RELAXED);
+	return ((ticks % BUDGET_MAPS_PERIOD) != 0);
+}
+
+/*
+ * The number of lines to show in the data region.
+ */
+int budget_rows(int nlines)
+{
+	if (budget_level() >= BUDGET_LEVEL_ROWS) {
+		return (MIN(nlines, BUDGET_ROWS_MAX));
+	}
+
+	return (nlines);
+}
+
+/*
+ * Build the budget status which is appended to the title.
+ */
+int budget_title_build(char *buf, int size)
+{
+	if (!s_budget.enabled) {
+		buf[0] = 0;
+		return (0);
+	}
+
+	/* The title is written as a curses format string, keep '%%' */
+	return (snprintf(buf, size, "[budget L%d: cpu %.1f%%%%/%.1f%%%% "
+			"rss %" PRIu64 "M/%" PRIu64 "M]", budget_level(),
+			s_budget.cpu_pct_cur, s_budget.cpu_pct,
+			s_budget.rss_bytes_cur >> 20, s_budget.rss_bytes >> 20));
+}
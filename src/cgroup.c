@@ -0,0 +1,559 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * This file contains the cgroup monitoring: the processes of a set of
+ * cgroups (or of whole cgroup subtrees) are the DAMON targets, the
+ * membership is kept current by inotify and a periodic re-read, and
+ * the region statistics are aggregated per cgroup for the cgroup view.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/proc.h"
+#include "include/damon.h"
+#include "include/win.h"
+#include "include/stats.h"
+#include "include/cgroup.h"
+
+static cgroup_group_t s_cgroup_group = { .ifd = -1 };
+
+static int pid_cmp(const void *a, const void *b)
+{
+	const pid_t *pid1 = (const pid_t *)a;
+	const pid_t *pid2 = (const pid_t *)b;
+
+	return ((*pid1 > *pid2) - (*pid1 < *pid2));
+}
+
+/*
+ * Re-read the processes of a cgroup. cgroup.procs is parsed line by
+ * line, there is no limit of its size.
+ */
+static void cgroup_procs_read(cgroup_t *cg)
+{
+	char path[PATH_MAX], line[32];
+	pid_t pid, *arr;
+	FILE *fp;
+
+	cg->npids = 0;
+	if ((snprintf(path, sizeof(path), "%s/cgroup.procs",
+		      cg->path) >= (int)sizeof(path)) ||
+	    ((fp = fopen(path, "r")) == NULL)) {
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if ((pid = atoi(line)) <= 0) {
+			continue;
+		}
+
+		if (cg->npids >= cg->pids_size) {
+			cg->pids_size = MAX(cg->pids_size * 2, 16);
+			if ((arr = realloc(cg->pids,
+			    sizeof(pid_t) * cg->pids_size)) == NULL) {
+				cg->pids_size = cg->npids;
+				break;
+			}
+
+			cg->pids = arr;
+		}
+
+		cg->pids[cg->npids++] = pid;
+	}
+
+	(void)fclose(fp);
+	qsort(cg->pids, cg->npids, sizeof(pid_t), pid_cmp);
+}
+
+static cgroup_t *cgroup_find(const char *path)
+{
+	int i;
+
+	for (i = 0; i < s_cgroup_group.ncgroups; i++) {
+		if (strcmp(s_cgroup_group.cgroups[i]->path, path) == 0) {
+			return (s_cgroup_group.cgroups[i]);
+		}
+	}
+
+	return (NULL);
+}
+
+static int cgroup_watch(const char *dir, const char *file, uint32_t mask)
+{
+	char path[PATH_MAX];
+
+	if (file == NULL) {
+		return (inotify_add_watch(s_cgroup_group.ifd, dir, mask));
+	}
+
+	if (snprintf(path, sizeof(path), "%s/%s", dir, file) >=
+	    (int)sizeof(path)) {
+		return (-1);
+	}
+
+	return (inotify_add_watch(s_cgroup_group.ifd, path, mask));
+}
+
+/*
+ * Add the cgroup 'path' and all the cgroups below it.
+ */
+static int cgroup_tree_add(const char *path)
+{
+	char sub[PATH_MAX];
+	cgroup_t *cg, **arr;
+	struct dirent *dentp;
+	DIR *dirp;
+	int n = 0;
+
+	if ((cgroup_find(path) != NULL) || (strlen(path) >= PATH_MAX)) {
+		return (0);
+	}
+
+	if (s_cgroup_group.ncgroups >= s_cgroup_group.size) {
+		s_cgroup_group.size = MAX(s_cgroup_group.size * 2, 8);
+		if ((arr = realloc(s_cgroup_group.cgroups,
+		    sizeof(cgroup_t *) * s_cgroup_group.size)) == NULL) {
+			return (-1);
+		}
+
+		s_cgroup_group.cgroups = arr;
+	}
+
+	if ((cg = zalloc(sizeof(cgroup_t))) == NULL) {
+		return (-1);
+	}
+
+	(void)strncpy(cg->path, path, sizeof(cg->path) - 1);
+	if (strncmp(path, CGROUP_MOUNT "/", strlen(CGROUP_MOUNT) + 1) == 0) {
+		path += strlen(CGROUP_MOUNT) + 1;
+	}
+
+	(void)strncpy(cg->name, path, sizeof(cg->name) - 1);
+	cg->wd_dir = cgroup_watch(cg->path, NULL,
+				  IN_CREATE | IN_DELETE_SELF | IN_ONLYDIR);
+	cg->wd_procs = cgroup_watch(cg->path, "cgroup.procs", IN_MODIFY);
+	cg->wd_events = cgroup_watch(cg->path, "cgroup.events", IN_MODIFY);
+	cgroup_procs_read(cg);
+	s_cgroup_group.cgroups[s_cgroup_group.ncgroups++] = cg;
+	n++;
+
+	if ((dirp = opendir(cg->path)) == NULL) {
+		return (n);
+	}
+
+	while ((dentp = readdir(dirp)) != NULL) {
+		if ((dentp->d_name[0] == '.') || (dentp->d_type != DT_DIR)) {
+			continue;
+		}
+
+		if (snprintf(sub, sizeof(sub), "%s/%s", cg->path,
+			     dentp->d_name) < (int)sizeof(sub)) {
+			n += MAX(cgroup_tree_add(sub), 0);
+		}
+	}
+
+	(void)closedir(dirp);
+	return (n);
+}
+
+static void cgroup_free(cgroup_t *cg)
+{
+	free(cg->pids);
+	free(cg);
+}
+
+/*
+ * The cgroup is removed, its watches are gone with it.
+ */
+static void cgroup_remove(int idx)
+{
+	cgroup_free(s_cgroup_group.cgroups[idx]);
+	s_cgroup_group.cgroups[idx] =
+	    s_cgroup_group.cgroups[--s_cgroup_group.ncgroups];
+}
+
+/*
+ * Rebuild target_procs from the processes of all cgroups. Return
+ * B_TRUE if the set differs from the one DAMON monitors.
+ */
+static boolean_t cgroup_targets_build(void)
+{
+	cgroup_t *cg;
+	boolean_t changed;
+	int i, j;
+
+	target_procs_reset();
+	for (i = 0; i < s_cgroup_group.ncgroups; i++) {
+		cg = s_cgroup_group.cgroups[i];
+		for (j = 0; j < cg->npids; j++) {
+			if (target_procs_add(cg->pids[j]) != 0) {
+				break;
+			}
+		}
+	}
+
+	target_procs_uniq();
+	changed = (target_procs.nr_proc != s_cgroup_group.ntargets) ||
+	    ((target_procs.nr_proc > 0) &&
+	     (memcmp(target_procs.pid, s_cgroup_group.targets,
+		     sizeof(pid_t) * target_procs.nr_proc) != 0));
+
+	if (changed) {
+		free(s_cgroup_group.targets);
+		s_cgroup_group.targets = NULL;
+		s_cgroup_group.ntargets = 0;
+		if ((target_procs.nr_proc > 0) &&
+		    ((s_cgroup_group.targets = malloc(sizeof(pid_t) *
+		     target_procs.nr_proc)) != NULL)) {
+			(void)memcpy(s_cgroup_group.targets, target_procs.pid,
+				     sizeof(pid_t) * target_procs.nr_proc);
+			s_cgroup_group.ntargets = target_procs.nr_proc;
+		}
+	}
+
+	target_procs.ready = 1;
+	return (changed);
+}
+
+/*
+ * Parse the argument of '-g': a comma separated list of cgroup
+ * directories (each one with its whole subtree) or cgroup.procs files.
+ * Return the number of target processes, or -1 on error.
+ */
+int cgroup_parse(const char *arg)
+{
+	char *args, *token, *saveptr = NULL, *p;
+	char path[PATH_MAX];
+	struct stat st;
+	int ret = -1;
+
+	if ((s_cgroup_group.ifd < 0) &&
+	    ((s_cgroup_group.ifd =
+	      inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)) {
+		stderr_print("inotify_init1 failed!\n");
+		return (-1);
+	}
+
+	if ((args = strdup(arg)) == NULL) {
+		return (-1);
+	}
+
+	for (token = strtok_r(args, ",", &saveptr); token != NULL;
+	     token = strtok_r(NULL, ",", &saveptr)) {
+		if (realpath(token, path) == NULL || stat(path, &st) != 0) {
+			stderr_print("Found cgroup: %s failed!\n", token);
+			goto L_EXIT;
+		}
+
+		/* "<cgroup>/cgroup.procs" stands for "<cgroup>". */
+		if (!S_ISDIR(st.st_mode) &&
+		    ((p = strrchr(path, '/')) != NULL)) {
+			*p = '\0';
+		}
+
+		if (cgroup_tree_add(path) < 0) {
+			goto L_EXIT;
+		}
+	}
+
+	(void)cgroup_targets_build();
+	s_cgroup_group.rescan_ns = stats_ns();
+	ret = target_procs.nr_proc;
+
+L_EXIT:
+	free(args);
+	return (ret);
+}
+
+void cgroup_fini(void)
+{
+	int i;
+
+	for (i = 0; i < s_cgroup_group.ncgroups; i++) {
+		cgroup_free(s_cgroup_group.cgroups[i]);
+	}
+
+	free(s_cgroup_group.cgroups);
+	free(s_cgroup_group.targets);
+	if (s_cgroup_group.ifd >= 0) {
+		(void)close(s_cgroup_group.ifd);
+	}
+
+	(void)memset(&s_cgroup_group, 0, sizeof(s_cgroup_group));
+	s_cgroup_group.ifd = -1;
+}
+
+int cgroup_num(void)
+{
+	return (s_cgroup_group.ncgroups);
+}
+
+/*
+ * The inotify fd to poll, -1 if no cgroup is monitored.
+ */
+int cgroup_fd(void)
+{
+	return (s_cgroup_group.ifd);
+}
+
+/*
+ * Drain the inotify events. A process moving between two cgroups only
+ * shows up in the destination's cgroup.procs, so the membership of all
+ * cgroups is re-read on any event. inotify doesn't report fork() or
+ * exit() though, so the membership is also re-read every
+ * CGROUP_RESCAN_SECS. If the set of processes changes, DAMON is
+ * restarted with the new targets.
+ */
+void cgroup_events_handle(void)
+{
+	char buf[CGROUP_EVBUF_SIZE]
+	    __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	char path[PATH_MAX];
+	struct inotify_event *ev;
+	boolean_t changed = B_FALSE;
+	cgroup_t *cg;
+	uint64_t now;
+	ssize_t len;
+	char *p;
+	int i;
+
+	if (s_cgroup_group.ifd < 0) {
+		return;
+	}
+
+	while ((len = read(s_cgroup_group.ifd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len;
+		     p += sizeof(struct inotify_event) + ev->len) {
+			ev = (struct inotify_event *)p;
+			changed = B_TRUE;
+			for (i = 0; i < s_cgroup_group.ncgroups; i++) {
+				if (s_cgroup_group.cgroups[i]->wd_dir == ev->wd) {
+					break;
+				}
+			}
+
+			if (i == s_cgroup_group.ncgroups) {
+				continue;
+			}
+
+			cg = s_cgroup_group.cgroups[i];
+			if (ev->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+				debug_print(NULL, 2, "cgroup %s is removed\n",
+					    cg->name);
+				cgroup_remove(i);
+			} else if ((ev->mask & IN_CREATE) &&
+			    (ev->mask & IN_ISDIR) && (ev->len > 0)) {
+				if (snprintf(path, sizeof(path), "%s/%s",
+					     cg->path, ev->name) <
+				    (int)sizeof(path)) {
+					debug_print(NULL, 2,
+						    "cgroup %s is created\n",
+						    path);
+					(void)cgroup_tree_add(path);
+				}
+			}
+		}
+	}
+
+	now = stats_ns();
+	if (!changed && (now - s_cgroup_group.rescan_ns <
+	    (uint64_t)CGROUP_RESCAN_SECS * NS_SEC)) {
+		return;
+	}
+
+	s_cgroup_group.rescan_ns = now;
+	for (i = 0; i < s_cgroup_group.ncgroups; i++) {
+		cgroup_procs_read(s_cgroup_group.cgroups[i]);
+	}
+
+	if (!cgroup_targets_build()) {
+		return;
+	}
+
+	debug_print(NULL, 2, "cgroup: %d target processes now\n",
+		    target_procs.nr_proc);
+	if (monitor_update() < 0) {
+		debug_print(NULL, 2, "cgroup: update DAMON targets failed\n");
+	}
+}
+
+static int cgroup_line_cmp(const void *a, const void *b)
+{
+	const cgroup_line_t *l1 = (const cgroup_line_t *)a;
+	const cgroup_line_t *l2 = (const cgroup_line_t *)b;
+
+	if (l1->hot != l2->hot) {
+		return ((l1->hot < l2->hot) ? 1 : -1);
+	}
+
+	if (l1->wss != l2->wss) {
+		return ((l1->wss < l2->wss) ? 1 : -1);
+	}
+
+	return (strcmp(l1->name, l2->name));
+}
+
+/*
+ * Add the regions of process 'pid' to the line. A region is hot if it
+ * was accessed in at least 'hot_access' of the samples of the last
+ * aggregation.
+ */
+static void cgroup_proc_account(pid_t pid, cgroup_line_t *line,
+				count_value_t *cv_arr, uint64_t hot_access)
+{
+	track_proc_t *proc;
+	count_value_t *cv;
+	uint64_t size;
+	int i, nr_nonzero;
+
+	if ((proc = proc_find(pid)) == NULL) {
+		return;
+	}
+
+	(void)pthread_mutex_lock(&proc->mutex);
+	(void)memcpy(cv_arr, proc->countval_arr,
+		     sizeof(count_value_t) * MIN(proc->record_max,
+						 PROC_RECORD_MAX));
+	(void)pthread_mutex_unlock(&proc->mutex);
+	proc_refcount_dec(proc);
+
+	proc_countvalue_sort(cv_arr, &nr_nonzero);
+	for (i = 0; i < nr_nonzero; i++) {
+		cv = &cv_arr[i];
+		if (cv->counts[PERF_COUNT_DAMON_END] <=
+		    cv->counts[PERF_COUNT_DAMON_START]) {
+			continue;
+		}
+
+		size = cv->counts[PERF_COUNT_DAMON_END] -
+		    cv->counts[PERF_COUNT_DAMON_START];
+		line->nregions++;
+		if (cv->counts[PERF_COUNT_DAMON_NR_ACCESS] > 0) {
+			line->wss += size;
+		}
+
+		if (cv->counts[PERF_COUNT_DAMON_NR_ACCESS] >= hot_access) {
+			line->hot += size;
+		}
+
+		line->local += cv->counts[PERF_COUNT_DAMON_LOCAL];
+		line->remote += cv->counts[PERF_COUNT_DAMON_REMOTE];
+	}
+}
+
+/*
+ * Aggregate the region statistics per cgroup into 'lines', the cgroups
+ * without process are skipped. The lines are sorted by the hot bytes.
+ * Return the number of lines.
+ */
+int cgroup_lines_fill(cgroup_line_t *lines, int nlines)
+{
+	uint64_t sample = 0, aggr = 0, regions = 0, min = 0, max = 0;
+	uint64_t hot_access;
+	count_value_t *cv_arr;
+	cgroup_line_t *line;
+	cgroup_t *cg;
+	int i, j, n = 0;
+
+	if ((cv_arr = zalloc(sizeof(count_value_t) * PROC_RECORD_MAX)) == NULL) {
+		return (0);
+	}
+
+	/*
+	 * A region can be found accessed at most aggr / sample times in
+	 * one aggregation, the hot ones reach half of that.
+	 */
+	read_damon_attrs(DAMON_ATTRS_PATH, &sample, &aggr,
+			 &regions, &min, &max);
+	hot_access = (sample > 0) ? MAX(aggr / sample / 2, 1) : 1;
+
+	for (i = 0; (i < s_cgroup_group.ncgroups) && (n < nlines); i++) {
+		cg = s_cgroup_group.cgroups[i];
+		if (cg->npids == 0) {
+			continue;
+		}
+
+		line = &lines[n++];
+		(void)memset(line, 0, sizeof(cgroup_line_t));
+		(void)strncpy(line->name, cg->name, sizeof(line->name) - 1);
+		line->nprocs = cg->npids;
+		for (j = 0; j < cg->npids; j++) {
+			cgroup_proc_account(cg->pids[j], line, cv_arr,
+					    hot_access);
+		}
+	}
+
+	free(cv_arr);
+	qsort(lines, n, sizeof(cgroup_line_t), cgroup_line_cmp);
+	return (n);
+}
+
+void cgroup_caption_build(char *buf, int size)
+{
+	(void)snprintf(buf, size, "%-28s%6s%8s%9s%9s%10s%10s",
+		       "CGROUP", "NPROC", "REGIONS", "WSS", "HOT",
+		       CAPTION_LOCAL, CAPTION_REMOTE);
+}
+
+/*
+ * Build the readable string for line 'idx' of the cgroup view. A long
+ * name is cut from the left, the leaf is what tells the cgroups apart.
+ */
+void cgroup_str_build(char *buf, int size, int idx, void *pv)
+{
+	cgroup_line_t *line = &((cgroup_line_t *)pv)[idx];
+	char name[32], wss[16], hot[16];
+	int len = strlen(line->name);
+
+	if (len > 27) {
+		(void)snprintf(name, sizeof(name), "..%.25s",
+			       line->name + len - 25);
+	} else {
+		(void)snprintf(name, sizeof(name), "%.27s", line->name);
+	}
+
+	win_size2str(line->wss, wss, sizeof(wss));
+	win_size2str(line->hot, hot, sizeof(hot));
+	(void)snprintf(buf, size,
+		       "%-28s%6d%8d%9s%9s%10" PRIu64 "%10" PRIu64,
+		       name, line->nprocs, line->nregions, wss, hot,
+		       line->local, line->remote);
+}
@@ -44,6 +44,9 @@
 #include "include/os/os_page.h"
 #include "include/os/os_cmd.h"
 #include "include/plat.h"
+#include "include/stats.h"
+#include "include/util.h"
+#include "include/warm.h"
 
 int g_sortkey;
 
@@ -166,6 +169,36 @@ static int op_switch2ml(cmd_t * cmd, boolean_t smpl)
 	return (os_op_switch2ml(cmd, smpl));
 }
 
+/*
+ * Zoom DAMON into the range of the highlighted line.
+ */
+static int op_zoom(cmd_t * cmd, boolean_t smpl __attribute__ ((unused)))
+{
+	uint64_t start, end;
+	page_t *cur;
+	pid_t pid;
+
+	if ((cur = page_current_get()) == NULL ||
+	    win_zoom_range(cur, &pid, &start, &end) != 0) {
+		return (0);
+	}
+
+	if (warm_zoom(pid, start, end) != 0) {
+		debug_print(NULL, 2, "zoom into %d failed\n", pid);
+	}
+
+	return (op_refresh(cmd, B_FALSE));
+}
+
+static int op_unzoom(cmd_t * cmd, boolean_t smpl __attribute__ ((unused)))
+{
+	if (warm_unzoom() != 0) {
+		debug_print(NULL, 2, "zoom out failed\n");
+	}
+
+	return (op_refresh(cmd, B_FALSE));
+}
+
 /*
  * Initialize for the "window switching" table.
  */
@@ -183,6 +216,13 @@ void switch_table_init(void)
 		s_switch[i][CMD_DAMON_OVERVIEW_ID].preop =
 		    preop_switch2profiling;
 		s_switch[i][CMD_DAMON_OVERVIEW_ID].op = op_page_next;
+		s_switch[i][CMD_SELFSTATS_ID].preop = preop_switch2profiling;
+		s_switch[i][CMD_SELFSTATS_ID].op = op_page_next;
+		s_switch[i][CMD_CGROUP_ID].preop = preop_switch2profiling;
+		s_switch[i][CMD_CGROUP_ID].op = op_page_next;
+		s_switch[i][CMD_PADDR_ID].preop = preop_switch2profiling;
+		s_switch[i][CMD_PADDR_ID].op = op_page_next;
+		s_switch[i][CMD_UNZOOM_ID].op = op_unzoom;
 	}
 
 	/*
@@ -205,6 +245,7 @@ void switch_table_init(void)
 	s_switch[WIN_TYPE_MONIPROC][CMD_3_ID].op = op_sort;
 	s_switch[WIN_TYPE_MONIPROC][CMD_4_ID].op = op_sort;
 	s_switch[WIN_TYPE_MONIPROC][CMD_5_ID].op = op_sort;
+	s_switch[WIN_TYPE_MONIPROC][CMD_ZOOM_ID].op = op_zoom;
 
 	/*
 	 * Initialize for window type "WIN_TYPE_MAPLIST_PROC"
@@ -214,6 +255,7 @@ void switch_table_init(void)
 	s_switch[WIN_TYPE_MAPLIST_PROC][CMD_MAP_GET_ID].preop = preop_mlmap_get;
 	s_switch[WIN_TYPE_MAPLIST_PROC][CMD_MAP_GET_ID].op = op_refresh;
 	s_switch[WIN_TYPE_MAPLIST_PROC][CMD_MAP_STOP_ID].op = op_mlmap_stop;
+	s_switch[WIN_TYPE_MAPLIST_PROC][CMD_ZOOM_ID].op = op_zoom;
 	s_switch[WIN_TYPE_MAPLIST_PROC][CMD_DAMON_OVERVIEW_ID].preop = NULL;
 	s_switch[WIN_TYPE_MAPLIST_PROC][CMD_DAMON_OVERVIEW_ID].op = NULL;
 
@@ -231,6 +273,24 @@ void switch_table_init(void)
 	 */
 	s_switch[WIN_TYPE_DAMON_DETAIL][CMD_BACK_ID].preop =
 	    preop_switch2profiling;
+
+	/*
+	 * Initialize for window type "WIN_TYPE_SELFSTATS"
+	 */
+	s_switch[WIN_TYPE_SELFSTATS][CMD_SELFSTATS_ID].preop = NULL;
+	s_switch[WIN_TYPE_SELFSTATS][CMD_SELFSTATS_ID].op = NULL;
+
+	/*
+	 * Initialize for window type "WIN_TYPE_CGROUP"
+	 */
+	s_switch[WIN_TYPE_CGROUP][CMD_CGROUP_ID].preop = NULL;
+	s_switch[WIN_TYPE_CGROUP][CMD_CGROUP_ID].op = NULL;
+
+	/*
+	 * Initialize for window type "WIN_TYPE_PADDR"
+	 */
+	s_switch[WIN_TYPE_PADDR][CMD_PADDR_ID].preop = NULL;
+	s_switch[WIN_TYPE_PADDR][CMD_PADDR_ID].op = NULL;
 }
 
 /*
@@ -263,6 +323,24 @@ int cmd_id_get(char ch)
 	case CMD_MAP_STOP_CHAR:
 		return (CMD_MAP_STOP_ID);
 
+	case CMD_SELFSTATS_CHAR:
+		return (CMD_SELFSTATS_ID);
+
+	case CMD_CGROUP_CHAR:
+		return (CMD_CGROUP_ID);
+
+	case CMD_SAVE_CHAR:
+		return (CMD_SAVE_ID);
+
+	case CMD_ZOOM_CHAR:
+		return (CMD_ZOOM_ID);
+
+	case CMD_UNZOOM_CHAR:
+		return (CMD_UNZOOM_ID);
+
+	case CMD_PADDR_CHAR:
+		return (CMD_PADDR_ID);
+
 	case CMD_1_CHAR:
 		return (CMD_1_ID);
 
@@ -293,6 +371,7 @@ void cmd_execute(cmd_t * cmd, boolean_t * badcmd)
 	page_t *cur;
 	switch_t *s;
 	boolean_t b = B_TRUE, smpl = B_FALSE;
+	uint64_t start_ns = stats_ns();
 
 	if ((cmd_id = CMD_ID(cmd)) == CMD_INVALID_ID) {
 		goto L_EXIT;
@@ -316,6 +395,8 @@ void cmd_execute(cmd_t * cmd, boolean_t * badcmd)
 		(void)s->op(cmd, smpl);
 	}
 
+	stats_stage_end(STATS_STAGE_CMD, start_ns);
+
 L_EXIT:
 	if (badcmd != NULL) {
 		*badcmd = b;
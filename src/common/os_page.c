@@ -53,6 +53,12 @@ boolean_t os_page_smpl_start(page_t * page)
 	case CMD_MONITOR_ID:
 		/* fall through */
 	case CMD_DAMON_OVERVIEW_ID:
+		/* fall through */
+	case CMD_SELFSTATS_ID:
+		/* fall through */
+	case CMD_CGROUP_ID:
+		/* fall through */
+	case CMD_PADDR_ID:
 		if (perf_profiling_smpl(B_TRUE) == 0) {
 			return (B_TRUE);
 		}
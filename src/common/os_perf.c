@@ -43,6 +43,12 @@
 #include "../include/plat.h"
 #include "../include/pfwrapper.h"
 #include "../include/damon.h"
+#include "../include/damon_sysfs.h"
+#include "../include/paddr.h"
+#include "../include/idle.h"
+#include "../include/stats.h"
+#include "../include/autotune.h"
+#include "../include/budget.h"
 #include "../include/os/os_perf.h"
 #include "../include/os/os_util.h"
 
@@ -54,6 +60,9 @@ typedef struct _profiling_conf {
 } profiling_conf_t;
 
 static pf_profiling_rec_t *s_profiling_recbuf = NULL;
+static damon_sysfs_region_t *s_profiling_snapbuf = NULL;
+static int s_profiling_reccap;
+static proc_commit_t *s_profiling_commitbuf = NULL;
 static profiling_conf_t s_profiling_conf;
 static boolean_t s_partpause_enabled;
 
@@ -98,31 +107,26 @@ static void countval_max(pf_profiling_rec_t * record,
 }
 
 /*
- * smpl: update perf data for each core.
+ * Commit the 'record_num' records in the record buffer to the targets.
  */
-static int __profiling_smpl(void)
+static void profiling_ingest(int record_num)
 {
 	pf_profiling_rec_t *record;
-	track_proc_t *proc;
-	count_value_t max_record;
-	int i, j, record_num;
+	proc_commit_t *commit;
+	int i, ncommits = 0;
+	uint64_t start_ns;
 
-	if (!damon_event_valid()) {
-		return (0);
-	}
-
-	/*
-	 * The record is grouped by pid/tid.
-	 */
-	pf_profiling_record(s_profiling_recbuf, &record_num);
-	if (record_num == 0) {
-		return 0;
-	}
+	start_ns = stats_ns();
 
 	/* FIXME */
 	countval_diff_base(&s_profiling_recbuf[0]);
 
 	debug_print(NULL, 2, "record number: %d\n", record_num);
+	if (s_partpause_enabled) {
+		stats_stage_end(STATS_STAGE_INGEST, start_ns);
+		return;
+	}
+
 	for (i = 1; i < record_num; i++) {
 		record = &s_profiling_recbuf[i];
 
@@ -131,31 +135,192 @@ static int __profiling_smpl(void)
 			continue;
 		}
 
-		countval_max(record, &max_record);
+		/*
+		 * The max value goes to the slot 'i' of the target.
+		 */
+		commit = &s_profiling_commitbuf[ncommits++];
+		commit->pid = record->pid;
+		commit->num = i;
+		countval_max(record, &commit->countval);
+	}
 
-		if ((proc = proc_find(record->pid)) == NULL) {
-			return 0;
+	/*
+	 * Commit the whole batch, one lookup and one lock per target.
+	 */
+	proc_commit(s_profiling_commitbuf, ncommits);
+
+	stats_stage_end(STATS_STAGE_INGEST, start_ns);
+}
+
+/*
+ * Update the perf data from the ring buffer of one kdamond.
+ */
+static void profiling_smpl_ring(int ring)
+{
+	int record_num;
+	uint64_t start_ns;
+
+	/*
+	 * The record is grouped by pid/tid.
+	 */
+	start_ns = stats_ns();
+	pf_profiling_record(ring, s_profiling_recbuf, &record_num);
+	stats_stage_end(STATS_STAGE_DRAIN, start_ns);
+	if (record_num > 0) {
+		profiling_ingest(record_num);
+	}
+}
+
+/*
+ * Commit the 'n' regions of a snapshot to the targets. A region of a
+ * snapshot is already an aggregation, so it's committed as it is (no
+ * max against the previous record as for the trace events), and the
+ * regions of a target take its slots from 0 in their order.
+ */
+static void profiling_snapshot_commit(int n)
+{
+	damon_sysfs_region_t *r;
+	proc_commit_t *commit;
+	int i, slot = 0, ncommits = 0, nskipped = 0;
+	uint64_t start_ns;
+
+	start_ns = stats_ns();
+	if (s_partpause_enabled) {
+		stats_stage_end(STATS_STAGE_INGEST, start_ns);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		r = &s_profiling_snapbuf[i];
+		if (i > 0 && r->pid == s_profiling_snapbuf[i - 1].pid) {
+			slot++;
+		} else {
+			slot = 0;
 		}
 
-		pthread_mutex_lock(&proc->mutex);
-		for (j = 0; j < PERF_COUNT_NUM; j++) {
-			if (!s_partpause_enabled) {
-				/*
-				 * The max value in 'max_record' now.
-				 * Here, the perf data will be updated to proc->countval_arr.
-				 */
-				proc_countval_update(proc, i, j,
-						     max_record.counts[j]);
-			}
+		if (slot >= PROC_RECORD_MAX) {
+			nskipped++;
+			continue;
 		}
 
-		pthread_mutex_unlock(&proc->mutex);
-		proc_refcount_dec(proc);
+		commit = &s_profiling_commitbuf[ncommits++];
+		(void)memset(commit, 0, sizeof(proc_commit_t));
+		commit->pid = r->pid;
+		commit->num = slot;
+		commit->countval.counts[PERF_COUNT_DAMON_NR_REGIONS] =
+		    r->nr_regions;
+		commit->countval.counts[PERF_COUNT_DAMON_START] = r->start;
+		commit->countval.counts[PERF_COUNT_DAMON_END] = r->end;
+		commit->countval.counts[PERF_COUNT_DAMON_NR_ACCESS] =
+		    r->nr_accesses;
+		commit->countval.counts[PERF_COUNT_DAMON_AGE] = r->age;
+	}
+
+	if (nskipped > 0) {
+		debug_print(NULL, 2, "snapshot: %d regions over %d of a "
+			    "target are skipped\n", nskipped, PROC_RECORD_MAX);
+	}
+
+	proc_commit(s_profiling_commitbuf, ncommits);
+	stats_stage_end(STATS_STAGE_INGEST, start_ns);
+}
+
+/*
+ * Update the perf data from a snapshot of the regions of the kdamond
+ * 'k' (--source regions), or of the page idle engine. It's pulled once
+ * per refresh, nothing is decoded in between.
+ */
+static void profiling_smpl_snapshot(int k)
+{
+	int n;
+	uint64_t start_ns;
+
+	if (s_profiling_snapbuf == NULL &&
+	    (s_profiling_snapbuf = zalloc(sizeof(damon_sysfs_region_t) *
+					  s_profiling_reccap)) == NULL) {
+		return;
+	}
+
+	start_ns = stats_ns();
+	if (idle_enabled()) {
+		n = idle_snapshot(s_profiling_snapbuf, s_profiling_reccap);
+	} else {
+		n = damon_sysfs_snapshot(k, s_profiling_snapbuf,
+					 s_profiling_reccap);
+	}
+
+	stats_stage_end(STATS_STAGE_DRAIN, start_ns);
+	if (n > 0) {
+		stats_count_add(STATS_COUNT_DRAIN_RECS, n);
+		profiling_snapshot_commit(n);
+	}
+}
+
+/*
+ * Update the view of the physical memory from the snapshots of the
+ * 'paddr' kdamonds (--paddr), no process is behind the regions.
+ */
+static void profiling_smpl_paddr(void)
+{
+	uint64_t start_ns;
+	int n;
+
+	start_ns = stats_ns();
+	n = paddr_smpl();
+	stats_stage_end(STATS_STAGE_DRAIN, start_ns);
+	if (n > 0) {
+		stats_count_add(STATS_COUNT_DRAIN_RECS, n);
+	}
+}
+
+/*
+ * smpl: update perf data for each core.
+ */
+int __profiling_smpl(void)
+{
+	int k, ring;
+
+	if (paddr_enabled()) {
+		profiling_smpl_paddr();
+		return (0);
+	}
+
+	if (idle_enabled()) {
+		profiling_smpl_snapshot(0);
+		return (0);
+	}
+
+	if (damon_sysfs_snapshot_on()) {
+		for (k = 0; k < damon_sysfs_nkdamonds(); k++) {
+			profiling_smpl_snapshot(k);
+		}
+
+		return (0);
+	}
+
+	if (!damon_event_valid()) {
+		return (0);
+	}
+
+	for (ring = 0; ring < pf_profiling_nrings(); ring++) {
+		profiling_smpl_ring(ring);
 	}
 
 	return 0;
 }
 
+/*
+ * Discard the existing records in the ring buffers.
+ */
+static void profiling_discard(void)
+{
+	int ring;
+
+	for (ring = 0; ring < pf_profiling_nrings(); ring++) {
+		pf_profiling_record(ring, NULL, NULL);
+	}
+}
+
 static int __profiling_partpause(void *arg)
 {
 	perf_count_id_t perf_count_id = (perf_count_id_t) arg;
@@ -222,7 +387,7 @@ static int __profiling_restore(void *arg)
 	/*
 	 * Discard the existing records in ring buffer.
 	 */
-	pf_profiling_record(NULL, NULL);
+	profiling_discard();
 
 	for (i = 1; i < PERF_COUNT_NUM; i++) {
 		pf_profiling_start();
@@ -246,7 +411,7 @@ static int __profiling_multi_restore(void *arg)
 	/*
 	 * Discard the existing records in ring buffer.
 	 */
-	pf_profiling_record(NULL, NULL);
+	profiling_discard();
 
 	for (i = 1; i < PERF_COUNT_NUM; i++) {
 		pf_profiling_start();
@@ -273,6 +438,15 @@ static int profiling_start(perf_ctl_t * ctl,
 {
 	pf_conf_t *conf_arr = s_profiling_conf.conf_arr;
 
+	/*
+	 * The region snapshots are pulled through sysfs or from the page
+	 * idle engine, no events.
+	 */
+	if (damon_sysfs_snapshot_on() || idle_enabled()) {
+		ctl->last_ms = current_ms(&g_tvbase);
+		return 0;
+	}
+
 	if (conf_arr[1].config == INVALID_CONFIG) {
 		/*
 		 * Invalid config is at the end of array.
@@ -402,8 +576,14 @@ int os_profiling_smpl(perf_ctl_t * ctl, perf_task_t * task, int *intval_ms)
 {
 	task_profiling_t *t = (task_profiling_t *) task;
 	int ret = -1;
+	uint64_t start_ns, walk_ns;
+
+	start_ns = stats_ns();
+	stats_count_add(STATS_COUNT_TICK, 1);
 
+	walk_ns = stats_ns();
 	proc_enum_update(0);
+	stats_stage_end(STATS_STAGE_PROCWALK, walk_ns);
 	proc_profiling_clear();
 
 	if (profiling_smpl(ctl, t, intval_ms) != 0) {
@@ -414,6 +594,9 @@ int os_profiling_smpl(perf_ctl_t * ctl, perf_task_t * task, int *intval_ms)
 	ret = 0;
 
 L_EXIT:
+	stats_stage_end(STATS_STAGE_SMPL, start_ns);
+	budget_tick();
+	autotune_tick();
 	if (ret == 0)
 		if (t->use_dispflag1)
 			disp_profiling_data_ready(*intval_ms);
@@ -499,8 +682,12 @@ static void profiling_init(profiling_conf_t * conf)
 	plat_event_config_t cfg;
 	pf_conf_t *conf_arr = conf->conf_arr;
 	FILE *fp = NULL;
-	char *damon_format =
-	    "/sys/kernel/debug/tracing/events/damon/damon_aggregated/format";
+	/* tracefs is also mounted by itself when debugfs isn't there. */
+	char *damon_formats[] = {
+	    "/sys/kernel/debug/tracing/events/damon/damon_aggregated/format",
+	    "/sys/kernel/tracing/events/damon/damon_aggregated/format"
+	};
+	char *damon_format = damon_formats[0];
 	char line[32] = { 0 };
 	char key[32];
 	char value[32];
@@ -512,7 +699,15 @@ static void profiling_init(profiling_conf_t * conf)
 	switch (conf_arr[1].type) {
 	case PERF_TYPE_TRACEPOINT:
 		/* The event ID must been checked here. */
-		fp = fopen(damon_format, "r");
+		if ((fp = fopen(damon_format, "r")) == NULL) {
+			damon_format = damon_formats[1];
+			fp = fopen(damon_format, "r");
+		}
+
+		if (fp == NULL) {
+			debug_print(NULL, 2, "Failed to open %s\n", damon_format);
+			break;
+		}
 		while (fgets(line, 32, fp)) {
 			memset(key, 0, sizeof(char) * 32);
 			memset(value, 0, sizeof(char) * 32);
@@ -548,6 +743,7 @@ int os_perf_init(void)
 	int ringsize, size;
 
 	s_profiling_recbuf = NULL;
+	s_profiling_commitbuf = NULL;
 	s_partpause_enabled = B_FALSE;
 
 	ringsize = pf_ringsize_init();
@@ -557,6 +753,15 @@ int os_perf_init(void)
 	if ((s_profiling_recbuf = zalloc(size)) == NULL) {
 		return (-1);
 	}
+
+	s_profiling_reccap = size / sizeof(pf_profiling_rec_t);
+
+	if ((s_profiling_commitbuf = zalloc((size / sizeof(pf_profiling_rec_t)) *
+					    sizeof(proc_commit_t))) == NULL) {
+		free(s_profiling_recbuf);
+		s_profiling_recbuf = NULL;
+		return (-1);
+	}
 	if ((perf_damon_conf = zalloc(sizeof(perf_damon_event_t))) == NULL) {
 		return (-1);
 	}
@@ -574,6 +779,14 @@ void os_perf_fini(void)
 		free(s_profiling_recbuf);
 		s_profiling_recbuf = NULL;
 	}
+
+	if (s_profiling_commitbuf != NULL) {
+		free(s_profiling_commitbuf);
+		s_profiling_commitbuf = NULL;
+	}
+
+	free(s_profiling_snapbuf);
+	s_profiling_snapbuf = NULL;
 }
 
 void os_perfthr_quit_wait(void)
@@ -590,8 +803,8 @@ int os_perf_profiling_partpause(perf_count_id_t perf_count_id)
 	t = (task_partpause_t *) & task;
 	t->task_id = PERF_PROFILING_PARTPAUSE_ID;
 	t->perf_count_id = perf_count_id;
-	perf_task_set(&task);
-	return (perf_status_wait(PERF_STATUS_PROFILING_PART_STARTED));
+	return (perf_status_wait(perf_task_set(&task),
+				 PERF_STATUS_PROFILING_PART_STARTED));
 }
 
 int os_perf_profiling_multipause(perf_count_id_t * perf_count_ids)
@@ -603,8 +816,8 @@ int os_perf_profiling_multipause(perf_count_id_t * perf_count_ids)
 	t = (task_multipause_t *) & task;
 	t->task_id = PERF_PROFILING_MULTIPAUSE_ID;
 	t->perf_count_ids = perf_count_ids;
-	perf_task_set(&task);
-	return (perf_status_wait(PERF_STATUS_PROFILING_MULTI_STARTED));
+	return (perf_status_wait(perf_task_set(&task),
+				 PERF_STATUS_PROFILING_MULTI_STARTED));
 }
 
 int os_perf_profiling_restore(perf_count_id_t perf_count_id)
@@ -616,8 +829,8 @@ int os_perf_profiling_restore(perf_count_id_t perf_count_id)
 	t = (task_restore_t *) & task;
 	t->task_id = PERF_PROFILING_RESTORE_ID;
 	t->perf_count_id = perf_count_id;
-	perf_task_set(&task);
-	return (perf_status_wait(PERF_STATUS_PROFILING_STARTED));
+	return (perf_status_wait(perf_task_set(&task),
+				 PERF_STATUS_PROFILING_STARTED));
 }
 
 int os_perf_profiling_multi_restore(perf_count_id_t * perf_count_ids)
@@ -629,8 +842,8 @@ int os_perf_profiling_multi_restore(perf_count_id_t * perf_count_ids)
 	t = (task_multi_restore_t *) & task;
 	t->task_id = PERF_PROFILING_MULTI_RESTORE_ID;
 	t->perf_count_ids = perf_count_ids;
-	perf_task_set(&task);
-	return (perf_status_wait(PERF_STATUS_PROFILING_STARTED));
+	return (perf_status_wait(perf_task_set(&task),
+				 PERF_STATUS_PROFILING_STARTED));
 }
 
 int
@@ -639,7 +852,6 @@ os_perf_maplist_smpl(perf_ctl_t * ctl __attribute__ ((unused)), pid_t pid)
 	perf_task_t task;
 	task_ml_t *t;
 
-	perf_smpl_wait();
 	memset(&task, 0, sizeof(perf_task_t));
 	t = (task_ml_t *) & task;
 	t->task_id = PERF_MAPLIST_SMPL_ID;
@@ -665,8 +877,8 @@ int os_perf_allstop(void)
 	memset(&task, 0, sizeof(perf_task_t));
 	t = (task_allstop_t *) & task;
 	t->task_id = PERF_STOP_ID;
-	perf_task_set(&task);
-	return (perf_status_wait(PERF_STATUS_IDLE));
+	return (perf_status_wait(perf_task_set(&task),
+				 PERF_STATUS_IDLE));
 }
 
 void *os_perf_priv_alloc(boolean_t * supported)
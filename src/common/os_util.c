@@ -419,6 +419,11 @@ boolean_t os_sysfs_cpu_enum(int nid, int *cpu_arr, int arr_size, int *num)
 	return (file_int_extract(path, cpu_arr, arr_size, num));
 }
 
+boolean_t os_sysfs_node_enum(int *node_arr, int arr_size, int *num)
+{
+	return (file_int_extract(NODE_NONLINE_PATH, node_arr, arr_size, num));
+}
+
 int os_sysfs_online_ncpus(void)
 {
 	int cpu_arr[NCPUS_MAX], num;
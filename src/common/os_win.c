@@ -30,9 +30,10 @@
 void os_damon_overview_caption_build(char *buf, int size)
 {
 	(void)snprintf(buf, size,
-		       "%6s%12s%12s%11s%11s%11s%12s",
-		       CAPTION_PID, CAPTION_NPROC, CAPTION_RSS,
-		       CAPTION_SAMPLE, CAPTION_AGGR, CAPTION_UPDATE, CAPTION_CPU);
+		       "%8s%7s%10s%10s%10s%9s%12s%12s",
+		       CAPTION_PID, CAPTION_NPROC, CAPTION_SAMPLE, CAPTION_AGGR,
+		       CAPTION_UPDATE, CAPTION_CPU, CAPTION_REGIONS_SEC,
+		       CAPTION_COST);
 }
 
 void os_damon_overview_data_build(char *buf, int size,
@@ -49,9 +50,9 @@ void os_damon_overview_data_build(char *buf, int size,
 	sprintf(a_intval_str, "%.1fms", a_intval);
 	sprintf(u_intval_str, "%.1fms", u_intval);
 	(void)snprintf(buf, size,
-			"%6d%12d%12f%11s%11s%11s%11.1f",
-			kda->pid, line->nr_proc, line->rss, s_intval_str,
-			a_intval_str, u_intval_str, value->cpu);
+			"%8d%7d%10s%10s%10s%8.2f%12.0f%12.2f",
+			kda->pid, line->nr_proc, s_intval_str, a_intval_str,
+			u_intval_str, value->cpu, line->regions_sec, line->cost);
 }
 
 static void damon_detail_line_show(win_reg_t * reg, char *title,
@@ -69,10 +70,16 @@ static void damon_detail_line_show(win_reg_t * reg, char *title,
  */
 void os_damondetail_data(dyn_damondetail_t * dyn, win_reg_t * seg)
 {
-	char s1[256];
+	char s1[64];
 	int i = 1;
+	kdamon_t *kda;
 
 	reg_erase(seg);
+	kdamon_refresh();
+	if ((kda = kdamon_get(dyn->kid)) == NULL) {
+		reg_refresh_nout(seg);
+		return;
+	}
 
 	/* Display the DAMON mode */
 	damon_detail_line_show(seg, "mode (virt/phys):", "virt", i++);
@@ -80,23 +87,32 @@ void os_damondetail_data(dyn_damondetail_t * dyn, win_reg_t * seg)
 	/*
 	 * Display the sampling interval
 	 */
-	damon_detail_line_show(seg, "sampling interval:", "5000", i++);
+	(void)snprintf(s1, sizeof(s1), "%d", kda->sampling_intval);
+	damon_detail_line_show(seg, "sampling interval:", s1, i++);
 
 	/*
 	 * Display the aggregation interval
 	 */
-	damon_detail_line_show(seg, "aggregation interval:", "100000", i++);
+	(void)snprintf(s1, sizeof(s1), "%d", kda->aggregation_intval);
+	damon_detail_line_show(seg, "aggregation interval:", s1, i++);
 
 	/*
 	 * Display the regions update interval
 	 */
-	damon_detail_line_show(seg, "regions update interval:", "1000000", i++);
+	(void)snprintf(s1, sizeof(s1), "%d", kda->regions_update_intval);
+	damon_detail_line_show(seg, "regions update interval:", s1, i++);
 
 	/*
-	 * Display the CPU utilization
+	 * Display the CPU utilization and the cost of region checks
 	 */
-	(void)snprintf(s1, sizeof(s1), "%.1f%%", 0.1 * 100.0);
-	damon_detail_line_show(seg, "CPU%:", s1, i++);
+	(void)snprintf(s1, sizeof(s1), "%.2f%%%%", kda->cpu_usage);
+	damon_detail_line_show(seg, "CPU%%:", s1, i++);
+
+	(void)snprintf(s1, sizeof(s1), "%.0f", kda->regions_sec);
+	damon_detail_line_show(seg, "region checks/s:", s1, i++);
+
+	(void)snprintf(s1, sizeof(s1), "%.2f", kda->cost);
+	damon_detail_line_show(seg, "CPU ms per 1M region checks:", s1, i++);
 
 	reg_refresh_nout(seg);
 }
@@ -38,6 +38,7 @@
 #include <pthread.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 #include "./include/types.h"
 #include "./include/util.h"
 #include "./include/proc.h"
@@ -45,9 +46,22 @@
 #include "./include/pfwrapper.h"
 #include "./include/os/os_util.h"
 #include "./include/damon.h"
+#include "./include/damon_sysfs.h"
+#include "./include/stats.h"
+#include "./include/idle.h"
 
-const char *damon_kdamon_pid = "/sys/kernel/debug/damon/kdamond_pid";
+const char *damon_kdamon_pid = DAMON_DEBUGFS "/kdamond_pid";
 static kdamon_group_t s_kdamon_group;
+
+/*
+ * The attributes datop uses when there is no debugfs 'attrs' to hold
+ * them, i.e. DAMON is only driven through sysfs.
+ */
+static uint64_t s_damon_attrs[ATTR_NUM] = {
+	DAMON_DEF_SAMPLE_US, DAMON_DEF_AGGR_US, DAMON_DEF_UPDATE_US,
+	DAMON_DEF_MIN_REGIONS, DAMON_DEF_MAX_REGIONS
+};
+static kdamon_regions_chunk_t s_kdamon_regions;
 int g_ncpus;
 
 int online_ncpu_refresh(void)
@@ -57,14 +71,40 @@ int online_ncpu_refresh(void)
 	return 0;
 }
 
+boolean_t damon_debugfs_supported(void)
+{
+	return (access(DAMON_DEBUGFS "/monitor_on", F_OK) == 0);
+}
+
 void read_damon_attrs(const char *attrs, uint64_t *sample, uint64_t *aggr,
 		uint64_t *regi, uint64_t *min, uint64_t *max)
 {
+	uint64_t val[ATTR_NUM];
 	int fd;
 	char data[32];
 	char *token;
 	int ret;
 
+	if (idle_enabled()) {
+		idle_attrs_get(sample, aggr, regi, min, max);
+		return;
+	}
+
+	/* No debugfs: the running kdamonds, or what datop keeps. */
+	if (!damon_debugfs_supported()) {
+		(void)memcpy(val, s_damon_attrs, sizeof(val));
+		if (damon_sysfs_active()) {
+			(void)damon_sysfs_attrs_read(0, val);
+		}
+
+		*sample = val[ATTR_SAMPLE];
+		*aggr = val[ATTR_AGGR];
+		*regi = val[ATTR_UPDATE];
+		*min = val[ATTR_MIN];
+		*max = val[ATTR_MAX];
+		return;
+	}
+
 	if ((fd = open(attrs, O_RDONLY)) < 0) {
 		stderr_print("%s: No such file!\n", attrs);
 		return;
@@ -101,16 +141,197 @@ fail:
 	stderr_print("%s: failed!", __func__);
 }
 
-void write_damon_attrs(uint64_t sample, uint64_t aggr,
+/*
+ * The debugfs 'attrs' (s_damon_attrs without debugfs) always holds the
+ * attributes datop uses, a DAMON started through sysfs gets them
+ * committed in addition. Return -1 if the commit fails.
+ */
+static int damon_attrs_apply(uint64_t sample, uint64_t aggr,
 		uint64_t regi, uint64_t min, uint64_t max)
 {
 	char cmd[100] = {0};
-	char *attr = "/sys/kernel/debug/damon/attrs";
+	char *attr = DAMON_ATTRS_PATH;
+
+	if (idle_enabled()) {
+		return (idle_attrs_set(sample, aggr, regi, min, max));
+	}
+
+	if (damon_debugfs_supported()) {
+		sprintf(cmd, "echo %ld %ld %ld %ld %ld > %s",
+				sample, aggr, regi, min, max,
+				attr);
+		system(cmd);
+	} else {
+		s_damon_attrs[ATTR_SAMPLE] = sample;
+		s_damon_attrs[ATTR_AGGR] = aggr;
+		s_damon_attrs[ATTR_UPDATE] = regi;
+		s_damon_attrs[ATTR_MIN] = min;
+		s_damon_attrs[ATTR_MAX] = max;
+	}
+
+	if (damon_sysfs_active()) {
+		return (damon_sysfs_attrs_commit(sample, aggr, regi, min, max));
+	}
+
+	return (0);
+}
+
+void write_damon_attrs(uint64_t sample, uint64_t aggr,
+		uint64_t regi, uint64_t min, uint64_t max)
+{
+	if (monitor_attached()) {
+		/* Never touch a session which datop doesn't own. */
+		return;
+	}
+
+	(void)damon_attrs_apply(sample, aggr, regi, min, max);
+}
+
+/*
+ * Write the attributes and read them back. Some kernels refuse to
+ * change them while DAMON is running, return -1 in that case, and
+ * also when datop is only attached to the session.
+ */
+int write_damon_attrs_check(uint64_t sample, uint64_t aggr,
+		uint64_t regi, uint64_t min, uint64_t max)
+{
+	uint64_t s = 0, a = 0, r = 0, lo = 0, hi = 0;
+
+	if (monitor_attached()) {
+		return (-1);
+	}
+
+	if (damon_attrs_apply(sample, aggr, regi, min, max) != 0) {
+		return (-1);
+	}
 
-	sprintf(cmd, "echo %ld %ld %ld %ld %ld > %s",
-			sample, aggr, regi, min, max,
-			attr);
-	system(cmd);
+	read_damon_attrs(DAMON_ATTRS_PATH, &s, &a, &r, &lo, &hi);
+	if (s != sample || a != aggr || r != regi || lo != min || hi != max) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * Count one region reported by the kdamond 'pid'. Called by the perf
+ * thread for every damon_aggregated sample, the only writer of the
+ * table. The disp thread reads the counters in kdamon_refresh().
+ */
+void kdamon_regions_account(int pid)
+{
+	kdamon_regions_add(pid, 1);
+}
+
+/*
+ * Count 'n' regions at once, for the region snapshots which stand for
+ * all of the aggregations since the last one.
+ */
+void kdamon_regions_add(int pid, uint64_t n)
+{
+	kdamon_regions_chunk_t *chunk = &s_kdamon_regions, *next;
+	kdamon_regions_t *kr;
+	int i;
+
+	for (;;) {
+		for (i = 0; i < KDAMON_REGIONS_CHUNK; i++) {
+			kr = &chunk->regions[i];
+			if (__atomic_load_n(&kr->pid, __ATOMIC_ACQUIRE) == pid) {
+				__atomic_add_fetch(&kr->nr_regions, n,
+						__ATOMIC_RELAXED);
+				return;
+			}
+
+			if (kr->pid == 0) {
+				kr->nr_regions = n;
+				__atomic_store_n(&kr->pid, pid, __ATOMIC_RELEASE);
+				return;
+			}
+		}
+
+		if ((next = chunk->next) == NULL) {
+			if ((next = zalloc(sizeof(kdamon_regions_chunk_t))) == NULL) {
+				return;
+			}
+
+			next->regions[0].nr_regions = n;
+			next->regions[0].pid = pid;
+			__atomic_store_n(&chunk->next, next, __ATOMIC_RELEASE);
+			return;
+		}
+
+		chunk = next;
+	}
+}
+
+/*
+ * The number of regions reported by the kdamond 'pid' so far.
+ */
+uint64_t kdamon_regions_get(int pid)
+{
+	kdamon_regions_chunk_t *chunk = &s_kdamon_regions;
+	kdamon_regions_t *kr;
+	int i;
+
+	while (chunk != NULL) {
+		for (i = 0; i < KDAMON_REGIONS_CHUNK; i++) {
+			kr = &chunk->regions[i];
+			if (__atomic_load_n(&kr->pid, __ATOMIC_ACQUIRE) == pid) {
+				return (__atomic_load_n(&kr->nr_regions,
+						__ATOMIC_RELAXED));
+			}
+		}
+
+		chunk = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE);
+	}
+
+	return (0);
+}
+
+/*
+ * Update the overhead of a kdamond since the last refresh: CPU% from
+ * /proc/<pid>/stat, region checks per second from the trace stream and
+ * the CPU cost per million region checks.
+ *
+ * Every damon_aggregated sample is one region of one aggregation, and
+ * each region is checked once per sampling interval, so the number of
+ * checks is nr_regions * (aggr / sample).
+ */
+static void kdamon_overhead_update(kdamon_t *kda, boolean_t pid_changed)
+{
+	uint64_t slice, ns, nr_regions;
+	double secs, cpu_ms, checks;
+
+	if (proc_slice_read(kda->pid, &slice) != 0) {
+		return;
+	}
+
+	ns = stats_ns();
+	nr_regions = kdamon_regions_get(kda->pid);
+
+	if (!pid_changed && kda->ns_last != 0 && ns > kda->ns_last &&
+	    slice >= kda->slice_last) {
+		secs = (double)(ns - kda->ns_last) / NS_SEC;
+		cpu_ms = (double)(slice - kda->slice_last) * 1000.0 /
+		    sysconf(_SC_CLK_TCK);
+		checks = (double)(nr_regions - kda->nr_regions_last);
+		if (kda->sampling_intval > 0) {
+			checks = checks * kda->aggregation_intval /
+			    kda->sampling_intval;
+		}
+
+		kda->cpu_usage = cpu_ms / 10.0 / secs;
+		kda->regions_sec = checks / secs;
+		kda->cost = (checks > 0) ? cpu_ms * 1000000.0 / checks : 0;
+	} else {
+		kda->cpu_usage = 0;
+		kda->regions_sec = 0;
+		kda->cost = 0;
+	}
+
+	kda->slice_last = slice;
+	kda->ns_last = ns;
+	kda->nr_regions_last = nr_regions;
 }
 
 void kdamon_refresh(void)
@@ -119,25 +340,55 @@ void kdamon_refresh(void)
 		"ps -e|grep kdamon|wc|awk '{print $1}'";
 	char kdamon_pid_cmd[64] = {0};
 	unsigned long kdamon_pid;
-	int i;
+	boolean_t pid_changed;
+	kdamon_t *kdamons;
+	int i, size;
 	uint64_t sampling_intval, aggr_intval, regions_update, min, max;
-	int nr_kdamons = (int)exec_cmd_return_ulong(nkdamons_cmd, 10);
+	int nr_kdamons;
 
-	read_damon_attrs("/sys/kernel/debug/damon/attrs", &sampling_intval,
+	/* The idle engine is a thread of datop, not a kdamond. */
+	if (idle_enabled()) {
+		nr_kdamons = (idle_tid() > 0) ? 1 : 0;
+	} else {
+		nr_kdamons = (int)exec_cmd_return_ulong(nkdamons_cmd, 10);
+	}
+
+	read_damon_attrs(DAMON_ATTRS_PATH, &sampling_intval,
 			&aggr_intval, &regions_update, &min, &max);
+	if (nr_kdamons > s_kdamon_group.kdamons_size) {
+		size = MAX(s_kdamon_group.kdamons_size * 2, nr_kdamons);
+		if ((kdamons = realloc(s_kdamon_group.kdamons,
+				sizeof(kdamon_t) * size)) == NULL) {
+			nr_kdamons = s_kdamon_group.kdamons_size;
+		} else {
+			(void)memset(&kdamons[s_kdamon_group.kdamons_size], 0,
+				sizeof(kdamon_t) *
+				(size - s_kdamon_group.kdamons_size));
+			s_kdamon_group.kdamons = kdamons;
+			s_kdamon_group.kdamons_size = size;
+		}
+	}
+
 	s_kdamon_group.nkdamons = nr_kdamons;
 	for (i=1; i<=nr_kdamons; i++) {
-		sprintf(kdamon_pid_cmd, "ps -e | grep kdamon | awk 'NR==%d {print $1}'", i);
-		kdamon_pid = exec_cmd_return_ulong(kdamon_pid_cmd, 10);
+		if (idle_enabled()) {
+			kdamon_pid = idle_tid();
+		} else {
+			sprintf(kdamon_pid_cmd, "ps -e | grep kdamon | awk 'NR==%d {print $1}'", i);
+			kdamon_pid = exec_cmd_return_ulong(kdamon_pid_cmd, 10);
+		}
+
 		if (kdamon_pid <= 0) {
 			stderr_print("kdamonn pid initial failed.");
 			break;
 		}
 
+		pid_changed = (s_kdamon_group.kdamons[i - 1].pid != (int)kdamon_pid);
 		s_kdamon_group.kdamons[i - 1].pid = kdamon_pid;
 		s_kdamon_group.kdamons[i - 1].sampling_intval = sampling_intval;
 		s_kdamon_group.kdamons[i - 1].aggregation_intval = aggr_intval;
 		s_kdamon_group.kdamons[i - 1].regions_update_intval = regions_update;
+		kdamon_overhead_update(&s_kdamon_group.kdamons[i - 1], pid_changed);
 	}
 }
 
@@ -148,6 +399,14 @@ int get_kdamon_pid(void)
 	char *endptr;
 	pid_t pid;
 
+	if (damon_sysfs_active()) {
+		return (damon_sysfs_kdamond_pid(0));
+	}
+
+	if (idle_enabled()) {
+		return (idle_tid());
+	}
+
 	if ((fd = open(damon_kdamon_pid, O_RDONLY)) < 0) {
 		stderr_print("kdamon_pid: No such file!\n");
 		return -1;
@@ -172,6 +431,10 @@ unsigned int get_nr_kdamon(void)
 
 kdamon_t *kdamon_get(int kid_idx)
 {
+	if ((kid_idx < 0) || (kid_idx >= s_kdamon_group.kdamons_size)) {
+		return (NULL);
+	}
+
 	return (&s_kdamon_group.kdamons[kid_idx]);
 }
 
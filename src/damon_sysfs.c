@@ -0,0 +1,1218 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the DAMON sysfs interface: datop starts its own
+ * kdamonds there when the kernel has it, so that the targets can be
+ * changed online ('state' = 'commit') instead of restarting DAMON and
+ * losing the regions of every target. The targets may be spread over
+ * several kdamonds (--kdamonds), each one is a kernel thread of its
+ * own and scans its share on another CPU. With --source regions, the
+ * regions are pulled through the tried regions of a 'stat' scheme
+ * once per refresh, instead of decoding every trace event. With
+ * --paddr, one kdamond per node monitors the physical memory of it.
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/damon.h"
+#include "include/stats.h"
+#include "include/warm.h"
+#include "include/damon_sysfs.h"
+#include "include/os/os_util.h"
+
+typedef struct _damon_sysfs_weight {
+	pid_t pid;
+	uint64_t weight;
+} damon_sysfs_weight_t;
+
+static damon_sysfs_t s_damon_sysfs = {
+	.want = 1,
+	.mutex = PTHREAD_MUTEX_INITIALIZER
+};
+
+static int damon_sysfs_vput(const char *val, const char *fmt, va_list ap)
+{
+	char path[PATH_MAX];
+	int fd, len = strlen(val), ret = -1;
+
+	(void)vsnprintf(path, sizeof(path), fmt, ap);
+	if ((fd = open(path, O_WRONLY)) < 0) {
+		debug_print(NULL, 2, "damon sysfs: can't open %s\n", path);
+		return (-1);
+	}
+
+	if (write(fd, val, len) == len) {
+		ret = 0;
+	} else {
+		debug_print(NULL, 2, "damon sysfs: write '%s' to %s "
+			    "failed (%d)\n", val, path, errno);
+	}
+
+	(void)close(fd);
+	return (ret);
+}
+
+static int damon_sysfs_put(const char *val, const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = damon_sysfs_vput(val, fmt, ap);
+	va_end(ap);
+	return (ret);
+}
+
+static int damon_sysfs_putu(uint64_t val, const char *fmt, ...)
+{
+	char buf[32];
+	va_list ap;
+	int ret;
+
+	(void)snprintf(buf, sizeof(buf), "%" PRIu64, val);
+	va_start(ap, fmt);
+	ret = damon_sysfs_vput(buf, fmt, ap);
+	va_end(ap);
+	return (ret);
+}
+
+static int damon_sysfs_get(char *buf, int size, const char *fmt, ...)
+{
+	char path[PATH_MAX];
+	va_list ap;
+	int fd, n;
+
+	va_start(ap, fmt);
+	(void)vsnprintf(path, sizeof(path), fmt, ap);
+	va_end(ap);
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return (-1);
+	}
+
+	n = read(fd, buf, size - 1);
+	(void)close(fd);
+	if (n < 0) {
+		return (-1);
+	}
+
+	buf[n] = 0;
+	buf[strcspn(buf, "\n")] = 0;
+	return (0);
+}
+
+/*
+ * --kdamonds N|node
+ */
+int damon_sysfs_kdamonds_parse(const char *str)
+{
+	char *end;
+	long n;
+
+	if (strcmp(str, "node") == 0) {
+		s_damon_sysfs.want = DAMON_SYSFS_NODE;
+		return (0);
+	}
+
+	n = strtol(str, &end, 10);
+	if (end == str || *end != 0 || n <= 0 || n > INT_MAX) {
+		return (-1);
+	}
+
+	s_damon_sysfs.want = (int)n;
+	return (0);
+}
+
+/*
+ * --source trace|regions
+ */
+int damon_sysfs_source_parse(const char *str)
+{
+	if (strcmp(str, "trace") == 0) {
+		s_damon_sysfs.snapshot = B_FALSE;
+	} else if (strcmp(str, "regions") == 0) {
+		s_damon_sysfs.snapshot = B_TRUE;
+	} else {
+		return (-1);
+	}
+
+	return (0);
+}
+
+boolean_t damon_sysfs_supported(void)
+{
+	return (access(DAMON_SYSFS_KDAMONDS "/nr_kdamonds", W_OK) == 0);
+}
+
+/*
+ * Return B_TRUE if any kdamond is on, datop's own or not.
+ */
+boolean_t damon_sysfs_busy(void)
+{
+	char buf[16];
+	int k, n;
+
+	if (damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_KDAMONDS
+			    "/nr_kdamonds") != 0) {
+		return (B_FALSE);
+	}
+
+	n = atoi(buf);
+	for (k = 0; k < n; k++) {
+		if (damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_KDAMONDS
+				    "/%d/state", k) == 0 &&
+		    strcmp(buf, "on") == 0) {
+			return (B_TRUE);
+		}
+	}
+
+	return (B_FALSE);
+}
+
+boolean_t damon_sysfs_staged(void)
+{
+	return (s_damon_sysfs.staged);
+}
+
+boolean_t damon_sysfs_active(void)
+{
+	return (s_damon_sysfs.active);
+}
+
+boolean_t damon_sysfs_snapshot_on(void)
+{
+	return (s_damon_sysfs.active && s_damon_sysfs.schemes);
+}
+
+int damon_sysfs_nkdamonds(void)
+{
+	return (s_damon_sysfs.nkdamonds);
+}
+
+static int damon_sysfs_attrs_write(int k, uint64_t sample, uint64_t aggr,
+		uint64_t update, uint64_t min, uint64_t max)
+{
+	if (damon_sysfs_putu(sample, DAMON_SYSFS_CTX
+			     "/monitoring_attrs/intervals/sample_us", k) != 0 ||
+	    damon_sysfs_putu(aggr, DAMON_SYSFS_CTX
+			     "/monitoring_attrs/intervals/aggr_us", k) != 0 ||
+	    damon_sysfs_putu(update, DAMON_SYSFS_CTX
+			     "/monitoring_attrs/intervals/update_us", k) != 0 ||
+	    damon_sysfs_putu(min, DAMON_SYSFS_CTX
+			     "/monitoring_attrs/nr_regions/min", k) != 0 ||
+	    damon_sysfs_putu(max, DAMON_SYSFS_CTX
+			     "/monitoring_attrs/nr_regions/max", k) != 0) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+/*
+ * Writing 'nr_targets' recreates all target directories, so every pid
+ * of the kdamond 'k' is written again.
+ */
+static int damon_sysfs_targets_write(int k)
+{
+	damon_kdamond_t *kd = &s_damon_sysfs.kdamonds[k];
+	int i;
+
+	if (damon_sysfs_putu(kd->npids, DAMON_SYSFS_CTX
+			     "/targets/nr_targets", k) != 0) {
+		return (-1);
+	}
+
+	for (i = 0; i < kd->npids; i++) {
+		if (damon_sysfs_putu(kd->pids[i], DAMON_SYSFS_CTX
+				     "/targets/%d/pid_target", k, i) != 0) {
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+static int damon_sysfs_target_add(damon_kdamond_t *kd, pid_t pid)
+{
+	pid_t *arr;
+	int size;
+
+	if (kd->npids == kd->size) {
+		size = MAX(kd->size * 2, 8);
+		if ((arr = realloc(kd->pids, sizeof(pid_t) * size)) == NULL) {
+			return (-1);
+		}
+
+		kd->pids = arr;
+		kd->size = size;
+	}
+
+	kd->pids[kd->npids++] = pid;
+	return (0);
+}
+
+/*
+ * The resident pages of 'pid', what a kdamond spends its time on
+ * roughly grows with them. Never 0, an idle target still costs.
+ */
+static uint64_t damon_sysfs_weight(pid_t pid)
+{
+	char path[64];
+	uint64_t size, rss = 0;
+	FILE *fp;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+	if ((fp = fopen(path, "r")) != NULL) {
+		if (fscanf(fp, "%" SCNu64 " %" SCNu64, &size, &rss) != 2) {
+			rss = 0;
+		}
+
+		(void)fclose(fp);
+	}
+
+	return (rss + 1);
+}
+
+static int weight_cmp(const void *a, const void *b)
+{
+	const damon_sysfs_weight_t *w1 = (const damon_sysfs_weight_t *)a;
+	const damon_sysfs_weight_t *w2 = (const damon_sysfs_weight_t *)b;
+
+	return ((w1->weight < w2->weight) - (w1->weight > w2->weight));
+}
+
+/*
+ * Hand 'pids' out to the kdamonds, the heaviest first, each one to the
+ * kdamond with the least load so far. A large target ends up with a
+ * kdamond of its own.
+ */
+static int damon_sysfs_assign(const pid_t *pids, int n)
+{
+	damon_sysfs_weight_t *w;
+	damon_kdamond_t *kd, *min;
+	int i, k, ret = -1;
+
+	if (n <= 0) {
+		return (0);
+	}
+
+	if ((w = malloc(sizeof(damon_sysfs_weight_t) * n)) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < n; i++) {
+		w[i].pid = pids[i];
+		w[i].weight = damon_sysfs_weight(pids[i]);
+	}
+
+	qsort(w, n, sizeof(damon_sysfs_weight_t), weight_cmp);
+	for (i = 0; i < n; i++) {
+		min = &s_damon_sysfs.kdamonds[0];
+		for (k = 1; k < s_damon_sysfs.nkdamonds; k++) {
+			kd = &s_damon_sysfs.kdamonds[k];
+			if (kd->load < min->load) {
+				min = kd;
+			}
+		}
+
+		if (damon_sysfs_target_add(min, w[i].pid) != 0) {
+			goto L_EXIT;
+		}
+
+		min->load += w[i].weight;
+	}
+
+	ret = 0;
+
+L_EXIT:
+	free(w);
+	return (ret);
+}
+
+static void damon_sysfs_reset(void)
+{
+	int k;
+
+	(void)pthread_mutex_lock(&s_damon_sysfs.mutex);
+	for (k = 0; k < s_damon_sysfs.nkdamonds; k++) {
+		free(s_damon_sysfs.kdamonds[k].pids);
+	}
+
+	free(s_damon_sysfs.kdamonds);
+	s_damon_sysfs.kdamonds = NULL;
+	s_damon_sysfs.nkdamonds = 0;
+	s_damon_sysfs.staged = B_FALSE;
+	s_damon_sysfs.active = B_FALSE;
+	s_damon_sysfs.schemes = B_FALSE;
+	(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+}
+
+/*
+ * The number of kdamonds to start for 'n' targets. For 'node', the
+ * nodes with CPUs are saved in 'nodes'.
+ */
+static int damon_sysfs_kdamonds_num(int n, int *nodes)
+{
+	int node_arr[NCPUS_MAX], cpu_arr[NCPUS_MAX];
+	int i, num, ncpus, nk = 0;
+
+	if (s_damon_sysfs.want != DAMON_SYSFS_NODE) {
+		return (MIN(s_damon_sysfs.want, n));
+	}
+
+	if (!os_sysfs_node_enum(node_arr, NCPUS_MAX, &num)) {
+		return (1);
+	}
+
+	for (i = 0; i < num && nk < n; i++) {
+		if (os_sysfs_cpu_enum(node_arr[i], cpu_arr, NCPUS_MAX,
+				      &ncpus) && ncpus > 0) {
+			nodes[nk++] = node_arr[i];
+		}
+	}
+
+	return (MAX(nk, 1));
+}
+
+/*
+ * Make sure there are 'nk' kdamonds and that none of them is busy, and
+ * allocate their state, the kdamond 'k' goes to the node 'nodes[k]'.
+ */
+static int damon_sysfs_kdamonds_init(int nk, const int *nodes)
+{
+	char buf[16];
+	int k, cur;
+
+	if (damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_KDAMONDS
+			    "/nr_kdamonds") != 0) {
+		return (-1);
+	}
+
+	/* Never take over the kdamonds somebody else has started. */
+	cur = atoi(buf);
+	for (k = 0; k < cur; k++) {
+		if (damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_KDAMONDS
+				    "/%d/state", k) != 0 ||
+		    strcmp(buf, "off") != 0) {
+			debug_print(NULL, 2, "damon sysfs: kdamond %d is "
+				    "busy\n", k);
+			return (-1);
+		}
+	}
+
+	if (nk != cur &&
+	    damon_sysfs_putu(nk, DAMON_SYSFS_KDAMONDS "/nr_kdamonds") != 0) {
+		return (-1);
+	}
+
+	damon_sysfs_reset();
+	(void)pthread_mutex_lock(&s_damon_sysfs.mutex);
+	if ((s_damon_sysfs.kdamonds = zalloc(sizeof(damon_kdamond_t) * nk)) ==
+	    NULL) {
+		(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+		return (-1);
+	}
+
+	s_damon_sysfs.nkdamonds = nk;
+	for (k = 0; k < nk; k++) {
+		s_damon_sysfs.kdamonds[k].node = nodes[k];
+	}
+
+	(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+	return (0);
+}
+
+/*
+ * Give every kdamond one context of the operations 'ops' with the
+ * current attributes (read_damon_attrs() has the ones datop uses) and
+ * its targets.
+ */
+static int damon_sysfs_contexts_write(const char *ops)
+{
+	uint64_t sample = 0, aggr = 0, update = 0, min = 0, max = 0;
+	int k;
+
+	read_damon_attrs(DAMON_ATTRS_PATH, &sample, &aggr,
+			 &update, &min, &max);
+
+	for (k = 0; k < s_damon_sysfs.nkdamonds; k++) {
+		if (damon_sysfs_put("1", DAMON_SYSFS_KDAMONDS
+				    "/%d/contexts/nr_contexts", k) != 0 ||
+		    damon_sysfs_put(ops, DAMON_SYSFS_CTX
+				    "/operations", k) != 0 ||
+		    (sample > 0 && aggr > 0 &&
+		     damon_sysfs_attrs_write(k, sample, aggr, update,
+					     min, max) != 0) ||
+		    damon_sysfs_targets_write(k) != 0) {
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * The scheme only counts ('stat'), and its access pattern is the
+ * widest one, so every region is tried. It's written out: some kernels
+ * start the maximums at 0, which matches no region. Without the scheme
+ * the trace events are used.
+ */
+static void damon_sysfs_schemes_write(void)
+{
+	int k;
+
+	s_damon_sysfs.schemes = s_damon_sysfs.snapshot;
+	for (k = 0; k < s_damon_sysfs.nkdamonds && s_damon_sysfs.schemes;
+	     k++) {
+		if (damon_sysfs_put("1", DAMON_SYSFS_CTX
+				    "/schemes/nr_schemes", k) != 0 ||
+		    damon_sysfs_put("stat", DAMON_SYSFS_CTX
+				    "/schemes/0/action", k) != 0 ||
+		    damon_sysfs_putu(ULONG_MAX, DAMON_SYSFS_CTX
+				     "/schemes/0/access_pattern/sz/max", k) != 0 ||
+		    damon_sysfs_putu(UINT_MAX, DAMON_SYSFS_CTX
+				     "/schemes/0/access_pattern/nr_accesses/max",
+				     k) != 0 ||
+		    damon_sysfs_putu(UINT_MAX, DAMON_SYSFS_CTX
+				     "/schemes/0/access_pattern/age/max", k) != 0) {
+			debug_print(NULL, 2, "damon sysfs: no scheme, the "
+				    "regions come from the trace events\n");
+			s_damon_sysfs.schemes = B_FALSE;
+		}
+	}
+}
+
+/*
+ * Set up the kdamonds to monitor 'pids', but don't start them, the
+ * init regions may be written in between.
+ */
+int damon_sysfs_setup(const pid_t *pids, int n)
+{
+	int nodes[NCPUS_MAX];
+	int k, nk;
+
+	if (!damon_sysfs_supported() || n <= 0) {
+		return (-1);
+	}
+
+	(void)memset(nodes, -1, sizeof(nodes));
+	nk = damon_sysfs_kdamonds_num(n, nodes);
+	if (damon_sysfs_kdamonds_init(nk, nodes) != 0) {
+		return (-1);
+	}
+
+	(void)pthread_mutex_lock(&s_damon_sysfs.mutex);
+	k = damon_sysfs_assign(pids, n);
+	(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+	if (k != 0 || damon_sysfs_contexts_write("vaddr") != 0) {
+		goto L_FAIL;
+	}
+
+	damon_sysfs_schemes_write();
+	debug_print(NULL, 2, "damon sysfs: %d targets on %d kdamonds\n",
+		    n, nk);
+	s_damon_sysfs.staged = B_TRUE;
+	return (0);
+
+L_FAIL:
+	damon_sysfs_reset();
+	return (-1);
+}
+
+/*
+ * Set up one 'paddr' kdamond for each node of 'nodes', with a single
+ * target whose regions are given by damon_sysfs_kdamond_regions().
+ * The physical address space has no pid to report in the trace
+ * events, so the regions are always pulled as snapshots.
+ */
+int damon_sysfs_paddr_setup(const int *nodes, int nk)
+{
+	int k;
+
+	if (!damon_sysfs_supported() || nk <= 0) {
+		return (-1);
+	}
+
+	if (damon_sysfs_kdamonds_init(nk, nodes) != 0) {
+		return (-1);
+	}
+
+	(void)pthread_mutex_lock(&s_damon_sysfs.mutex);
+	for (k = 0; k < nk; k++) {
+		if (damon_sysfs_target_add(&s_damon_sysfs.kdamonds[k], 0) != 0) {
+			break;
+		}
+	}
+
+	(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+	if (k < nk || damon_sysfs_contexts_write("paddr") != 0) {
+		goto L_FAIL;
+	}
+
+	s_damon_sysfs.snapshot = B_TRUE;
+	damon_sysfs_schemes_write();
+	if (!s_damon_sysfs.schemes) {
+		goto L_FAIL;
+	}
+
+	debug_print(NULL, 2, "damon sysfs: physical memory on %d kdamonds\n",
+		    nk);
+	s_damon_sysfs.staged = B_TRUE;
+	return (0);
+
+L_FAIL:
+	damon_sysfs_reset();
+	return (-1);
+}
+
+/*
+ * Write the regions of the only target of the kdamond 'k'.
+ */
+int damon_sysfs_kdamond_regions(int k, const damon_sysfs_range_t *ranges,
+		int n)
+{
+	int j;
+
+	if (k < 0 || k >= s_damon_sysfs.nkdamonds ||
+	    damon_sysfs_putu(n, DAMON_SYSFS_CTX
+			     "/targets/0/regions/nr_regions", k) != 0) {
+		return (-1);
+	}
+
+	for (j = 0; j < n; j++) {
+		if (damon_sysfs_putu(ranges[j].start, DAMON_SYSFS_CTX
+				     "/targets/0/regions/%d/start", k, j) != 0 ||
+		    damon_sysfs_putu(ranges[j].end, DAMON_SYSFS_CTX
+				     "/targets/0/regions/%d/end", k, j) != 0) {
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Bind the kdamond to the CPUs of its node. A node of memory only has
+ * no CPU to bind to.
+ */
+static void damon_sysfs_bind(damon_kdamond_t *kd)
+{
+	int cpu_arr[NCPUS_MAX], i, num;
+	cpu_set_t cs;
+
+	if (kd->node < 0 || kd->kpid <= 0 ||
+	    !os_sysfs_cpu_enum(kd->node, cpu_arr, NCPUS_MAX, &num) ||
+	    num <= 0) {
+		return;
+	}
+
+	CPU_ZERO(&cs);
+	for (i = 0; i < num; i++) {
+		CPU_SET(cpu_arr[i], &cs);
+	}
+
+	if (sched_setaffinity(kd->kpid, sizeof(cs), &cs) < 0) {
+		debug_print(NULL, 2, "damon sysfs: bind kdamond %d to "
+			    "node %d failed (%d)\n", kd->kpid, kd->node,
+			    errno);
+	}
+}
+
+int damon_sysfs_on(void)
+{
+	damon_kdamond_t *kd;
+	char buf[16];
+	int k;
+
+	if (!s_damon_sysfs.staged) {
+		return (-1);
+	}
+
+	s_damon_sysfs.staged = B_FALSE;
+	for (k = 0; k < s_damon_sysfs.nkdamonds; k++) {
+		kd = &s_damon_sysfs.kdamonds[k];
+		if (damon_sysfs_put("on", DAMON_SYSFS_KDAMONDS
+				    "/%d/state", k) != 0) {
+			goto L_FAIL;
+		}
+
+		if (damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_KDAMONDS
+				    "/%d/pid", k) == 0) {
+			kd->kpid = atoi(buf);
+		}
+
+		damon_sysfs_bind(kd);
+	}
+
+	s_damon_sysfs.active = B_TRUE;
+	return (0);
+
+L_FAIL:
+	while (--k >= 0) {
+		(void)damon_sysfs_put("off", DAMON_SYSFS_KDAMONDS
+				      "/%d/state", k);
+	}
+
+	damon_sysfs_reset();
+	return (-1);
+}
+
+void damon_sysfs_stop(void)
+{
+	int k;
+
+	if (s_damon_sysfs.active) {
+		for (k = 0; k < s_damon_sysfs.nkdamonds; k++) {
+			(void)damon_sysfs_put("off", DAMON_SYSFS_KDAMONDS
+					      "/%d/state", k);
+		}
+	}
+
+	damon_sysfs_reset();
+}
+
+static int int_cmp(const void *a, const void *b)
+{
+	const int *i1 = (const int *)a;
+	const int *i2 = (const int *)b;
+
+	return ((*i1 > *i2) - (*i1 < *i2));
+}
+
+static int pid_cmp(const void *a, const void *b)
+{
+	const pid_t *pid1 = (const pid_t *)a;
+	const pid_t *pid2 = (const pid_t *)b;
+
+	return ((*pid1 > *pid2) - (*pid1 < *pid2));
+}
+
+static boolean_t damon_sysfs_pid_in(pid_t pid, const pid_t *arr, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (arr[i] == pid) {
+			return (B_TRUE);
+		}
+	}
+
+	return (B_FALSE);
+}
+
+/*
+ * Bring the targets of the kdamond 'k' from 'old' to its current ones
+ * online. A target which moves to another index, or a new one which
+ * lands on an index used before, is given its regions explicitly.
+ */
+static int damon_sysfs_kdamond_commit(int k, const pid_t *old, int nold)
+{
+	damon_kdamond_t *kd = &s_damon_sysfs.kdamonds[k];
+	int i;
+
+	if (kd->npids == nold &&
+	    memcmp(kd->pids, old, sizeof(pid_t) * nold) == 0) {
+		return (0);
+	}
+
+	if (damon_sysfs_targets_write(k) != 0) {
+		return (-1);
+	}
+
+	for (i = 0; i < kd->npids && i < nold; i++) {
+		if (old[i] != kd->pids[i] &&
+		    warm_regions_stage(kd->pids[i]) != 0) {
+			return (-1);
+		}
+	}
+
+	return (damon_sysfs_put("commit", DAMON_SYSFS_KDAMONDS
+				"/%d/state", k));
+}
+
+/*
+ * Change the targets of the running kdamonds to 'pids' online. The
+ * kernel matches the targets of a commit by their index and keeps the
+ * regions of a target which is given none, so the remaining targets
+ * stay where they are and keep their order, and the new ones are
+ * handed out to the least loaded kdamonds. A kdamond left without
+ * targets would stop, DAMON is restarted then.
+ */
+int damon_sysfs_commit(const pid_t *pids, int n)
+{
+	damon_kdamond_t *kd;
+	pid_t *sorted, *fresh, **olds;
+	int *nolds;
+	int i, k, nk = s_damon_sysfs.nkdamonds, nfresh = 0, ncommits = 0;
+	int ret = -1;
+
+	if (!s_damon_sysfs.active || n <= 0) {
+		return (-1);
+	}
+
+	sorted = malloc(sizeof(pid_t) * n);
+	fresh = malloc(sizeof(pid_t) * n);
+	olds = zalloc(sizeof(pid_t *) * nk);
+	nolds = zalloc(sizeof(int) * nk);
+	if (sorted == NULL || fresh == NULL || olds == NULL || nolds == NULL) {
+		goto L_EXIT;
+	}
+
+	(void)memcpy(sorted, pids, sizeof(pid_t) * n);
+	qsort(sorted, n, sizeof(pid_t), pid_cmp);
+
+	/*
+	 * The kdamonds keep the targets which remain, the perf thread
+	 * maps the trace events with these lists.
+	 */
+	(void)pthread_mutex_lock(&s_damon_sysfs.mutex);
+	for (k = 0; k < nk; k++) {
+		kd = &s_damon_sysfs.kdamonds[k];
+		olds[k] = kd->pids;
+		nolds[k] = kd->npids;
+		kd->pids = NULL;
+		kd->npids = kd->size = 0;
+		kd->load = 0;
+		for (i = 0; i < nolds[k]; i++) {
+			if (bsearch(&olds[k][i], sorted, n, sizeof(pid_t),
+				    pid_cmp) == NULL) {
+				continue;
+			}
+
+			if (damon_sysfs_target_add(kd, olds[k][i]) != 0) {
+				(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+				goto L_EXIT;
+			}
+
+			kd->load += damon_sysfs_weight(olds[k][i]);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		for (k = 0; k < nk; k++) {
+			if (damon_sysfs_pid_in(pids[i], olds[k], nolds[k])) {
+				break;
+			}
+		}
+
+		if (k == nk) {
+			fresh[nfresh++] = pids[i];
+		}
+	}
+
+	i = damon_sysfs_assign(fresh, nfresh);
+	(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+	if (i != 0) {
+		goto L_EXIT;
+	}
+
+	for (k = 0; k < nk; k++) {
+		if (s_damon_sysfs.kdamonds[k].npids == 0) {
+			debug_print(NULL, 2, "damon sysfs: kdamond %d has no "
+				    "target left\n", k);
+			goto L_EXIT;
+		}
+	}
+
+	for (k = 0; k < nk; k++) {
+		if (damon_sysfs_kdamond_commit(k, olds[k], nolds[k]) != 0) {
+			goto L_EXIT;
+		}
+
+		ncommits++;
+	}
+
+	debug_print(NULL, 2, "damon sysfs: %d targets committed to %d "
+		    "kdamonds\n", n, ncommits);
+	ret = 0;
+
+L_EXIT:
+	for (k = 0; olds != NULL && k < nk; k++) {
+		free(olds[k]);
+	}
+
+	free(olds);
+	free(nolds);
+	free(sorted);
+	free(fresh);
+	return (ret);
+}
+
+/*
+ * Apply new attributes to the running kdamonds.
+ */
+int damon_sysfs_attrs_commit(uint64_t sample, uint64_t aggr, uint64_t update,
+		uint64_t min, uint64_t max)
+{
+	int k;
+
+	if (!s_damon_sysfs.active) {
+		return (-1);
+	}
+
+	for (k = 0; k < s_damon_sysfs.nkdamonds; k++) {
+		if (damon_sysfs_attrs_write(k, sample, aggr, update,
+					    min, max) != 0 ||
+		    damon_sysfs_put("commit", DAMON_SYSFS_KDAMONDS
+				    "/%d/state", k) != 0) {
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * All attributes of the kdamond 'k', in the order of the ATTR_* enum.
+ */
+int damon_sysfs_attrs_read(int k, uint64_t *attrs)
+{
+	static const char *names[ATTR_NUM] = {
+		"intervals/sample_us", "intervals/aggr_us",
+		"intervals/update_us", "nr_regions/min", "nr_regions/max"
+	};
+	char buf[32];
+	int i;
+
+	if (k < 0 || k >= s_damon_sysfs.nkdamonds) {
+		return (-1);
+	}
+
+	for (i = 0; i < ATTR_NUM; i++) {
+		if (damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_CTX
+				    "/monitoring_attrs/%s", k, names[i]) != 0) {
+			return (-1);
+		}
+
+		attrs[i] = strtoull(buf, NULL, 10);
+	}
+
+	return (0);
+}
+
+/*
+ * The sampling and aggregation intervals of the kdamond 'k' (us).
+ */
+int damon_sysfs_intervals(int k, uint64_t *sample, uint64_t *aggr)
+{
+	char buf[32];
+
+	if (damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_CTX
+			    "/monitoring_attrs/intervals/sample_us", k) != 0) {
+		return (-1);
+	}
+
+	*sample = strtoull(buf, NULL, 10);
+	if (damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_CTX
+			    "/monitoring_attrs/intervals/aggr_us", k) != 0) {
+		return (-1);
+	}
+
+	*aggr = strtoull(buf, NULL, 10);
+	return (0);
+}
+
+int damon_sysfs_kdamond_pid(int k)
+{
+	if (k < 0 || k >= s_damon_sysfs.nkdamonds) {
+		return (-1);
+	}
+
+	return (s_damon_sysfs.kdamonds[k].kpid);
+}
+
+/*
+ * The number of targets of the kdamond thread 'kpid', or -1.
+ */
+int damon_sysfs_kdamond_ntargets(int kpid)
+{
+	int k, n = -1;
+
+	(void)pthread_mutex_lock(&s_damon_sysfs.mutex);
+	for (k = 0; k < s_damon_sysfs.nkdamonds; k++) {
+		if (s_damon_sysfs.kdamonds[k].kpid == kpid) {
+			n = s_damon_sysfs.kdamonds[k].npids;
+			break;
+		}
+	}
+
+	(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+	return (n);
+}
+
+/*
+ * Map a trace event back to its target: 'kpid' is the kdamond which
+ * emitted the event and 'idx' the index of the target in its context.
+ * Return 0 if the target isn't known (any more).
+ */
+pid_t damon_sysfs_target_pid(int kpid, unsigned long idx)
+{
+	damon_kdamond_t *kd;
+	pid_t pid = 0;
+	int k;
+
+	(void)pthread_mutex_lock(&s_damon_sysfs.mutex);
+	for (k = 0; k < s_damon_sysfs.nkdamonds; k++) {
+		kd = &s_damon_sysfs.kdamonds[k];
+		if (kd->kpid == kpid) {
+			if (idx < (unsigned long)kd->npids) {
+				pid = kd->pids[idx];
+			}
+			break;
+		}
+	}
+
+	(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+	return (pid);
+}
+
+/*
+ * The kdamond and the index of the target 'pid'.
+ */
+static int damon_sysfs_target_find(pid_t pid, int *idx)
+{
+	damon_kdamond_t *kd;
+	int i, k;
+
+	for (k = 0; k < s_damon_sysfs.nkdamonds; k++) {
+		kd = &s_damon_sysfs.kdamonds[k];
+		for (i = 0; i < kd->npids; i++) {
+			if (kd->pids[i] == pid) {
+				*idx = i;
+				return (k);
+			}
+		}
+	}
+
+	return (-1);
+}
+
+int damon_sysfs_target_regions(pid_t pid, int n)
+{
+	int k, idx;
+
+	if ((k = damon_sysfs_target_find(pid, &idx)) < 0) {
+		return (-1);
+	}
+
+	return (damon_sysfs_putu(n, DAMON_SYSFS_CTX
+				 "/targets/%d/regions/nr_regions", k, idx));
+}
+
+int damon_sysfs_target_region(pid_t pid, int j, uint64_t start, uint64_t end)
+{
+	int k, idx;
+
+	if ((k = damon_sysfs_target_find(pid, &idx)) < 0) {
+		return (-1);
+	}
+
+	if (damon_sysfs_putu(start, DAMON_SYSFS_CTX
+			     "/targets/%d/regions/%d/start", k, idx, j) != 0) {
+		return (-1);
+	}
+
+	return (damon_sysfs_putu(end, DAMON_SYSFS_CTX
+				 "/targets/%d/regions/%d/end", k, idx, j));
+}
+
+static int damon_sysfs_getat(int dfd, int idx, const char *name,
+		uint64_t *val)
+{
+	char path[64], buf[32];
+	int fd, n;
+
+	(void)snprintf(path, sizeof(path), "%d/%s", idx, name);
+	if ((fd = openat(dfd, path, O_RDONLY)) < 0) {
+		return (-1);
+	}
+
+	n = read(fd, buf, sizeof(buf) - 1);
+	(void)close(fd);
+	if (n <= 0) {
+		return (-1);
+	}
+
+	buf[n] = 0;
+	*val = strtoull(buf, NULL, 10);
+	return (0);
+}
+
+static void damon_sysfs_segment_end(damon_sysfs_region_t *regs, int first,
+		int n)
+{
+	int i;
+
+	for (i = first; i < n; i++) {
+		regs[i].nr_regions = n - first;
+	}
+}
+
+/*
+ * Pull the regions of the kdamond 'k' through the tried regions of its
+ * 'stat' scheme. The region directories are listed with one pass over
+ * the directory and their files are opened relative to it. The kernel
+ * tries the targets in their order and the regions of a target by
+ * address, so the next target begins where the address goes down.
+ * Return the number of regions saved to 'regs', or -1.
+ */
+int damon_sysfs_snapshot(int k, damon_sysfs_region_t *regs, int size)
+{
+	char path[PATH_MAX], buf[32];
+	damon_sysfs_region_t *r;
+	damon_kdamond_t *kd;
+	struct dirent *ent;
+	pid_t *pids = NULL, kpid;
+	uint64_t start, end, nr_accesses, age, aggr_us, now, last;
+	int npids, nregions = 0, i, n = 0, t = 0, first = 0;
+	int *idx = NULL, *idx2, idx_size = 0;
+	DIR *dir;
+
+	(void)pthread_mutex_lock(&s_damon_sysfs.mutex);
+	if (k >= s_damon_sysfs.nkdamonds) {
+		(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+		return (-1);
+	}
+
+	kd = &s_damon_sysfs.kdamonds[k];
+	kpid = kd->kpid;
+	npids = kd->npids;
+	if ((pids = malloc(sizeof(pid_t) * MAX(npids, 1))) != NULL) {
+		(void)memcpy(pids, kd->pids, sizeof(pid_t) * npids);
+	}
+
+	now = stats_ns();
+	last = kd->snap_ns;
+	kd->snap_ns = now;
+	(void)pthread_mutex_unlock(&s_damon_sysfs.mutex);
+
+	if (pids == NULL ||
+	    damon_sysfs_put("update_schemes_tried_regions",
+			    DAMON_SYSFS_KDAMONDS "/%d/state", k) != 0) {
+		n = -1;
+		goto L_EXIT;
+	}
+
+	(void)snprintf(path, sizeof(path), DAMON_SYSFS_CTX
+		       "/schemes/0/tried_regions", k);
+	if ((dir = opendir(path)) == NULL) {
+		n = -1;
+		goto L_EXIT;
+	}
+
+	/*
+	 * The region directories are in the address order of their names,
+	 * which don't always start from 0.
+	 */
+	while ((ent = readdir(dir)) != NULL) {
+		if (!isdigit((unsigned char)ent->d_name[0])) {
+			continue;
+		}
+
+		if (nregions >= idx_size) {
+			idx_size = MAX(idx_size * 2, 256);
+			if ((idx2 = realloc(idx, sizeof(int) * idx_size)) ==
+			    NULL) {
+				break;
+			}
+
+			idx = idx2;
+		}
+
+		idx[nregions++] = atoi(ent->d_name);
+	}
+
+	if (nregions > 1) {
+		qsort(idx, nregions, sizeof(int), int_cmp);
+	}
+
+	for (i = 0; i < MIN(nregions, size); i++) {
+		if (damon_sysfs_getat(dirfd(dir), idx[i], "start",
+				      &start) != 0 ||
+		    damon_sysfs_getat(dirfd(dir), idx[i], "end", &end) != 0 ||
+		    damon_sysfs_getat(dirfd(dir), idx[i], "nr_accesses",
+				      &nr_accesses) != 0 ||
+		    damon_sysfs_getat(dirfd(dir), idx[i], "age", &age) != 0) {
+			break;
+		}
+
+		if (n > 0 && start < regs[n - 1].end) {
+			damon_sysfs_segment_end(regs, first, n);
+			first = n;
+			t++;
+		}
+
+		r = &regs[n++];
+		r->pid = (t < npids) ? pids[t] : 0;
+		r->start = start;
+		r->end = end;
+		r->nr_accesses = nr_accesses;
+		r->age = age;
+	}
+
+	(void)closedir(dir);
+	damon_sysfs_segment_end(regs, first, n);
+
+	/* The targets can't be told apart, wait for the next one. */
+	if (n > 0 && t + 1 != npids) {
+		debug_print(NULL, 2, "damon sysfs: kdamond %d has %d targets "
+			    "but %d in the snapshot\n", k, npids, t + 1);
+		n = 0;
+		goto L_EXIT;
+	}
+
+	/* A snapshot stands for the aggregations since the last one. */
+	if (n > 0 && last > 0 &&
+	    damon_sysfs_get(buf, sizeof(buf), DAMON_SYSFS_CTX
+			    "/monitoring_attrs/intervals/aggr_us", k) == 0 &&
+	    (aggr_us = strtoull(buf, NULL, 10)) > 0) {
+		kdamon_regions_add(kpid, (uint64_t)n *
+				   MAX((now - last) / 1000 / aggr_us, 1));
+	}
+
+L_EXIT:
+	free(idx);
+	free(pids);
+	return (n);
+}
@@ -44,6 +44,7 @@
 #include <sys/utsname.h>
 #include <signal.h>
 #include <libgen.h>
+#include <getopt.h>
 #include "include/types.h"
 #include "include/util.h"
 #include "include/proc.h"
@@ -52,6 +53,17 @@
 #include "include/util.h"
 #include "include/plat.h"
 #include "include/damon.h"
+#include "include/stats.h"
+#include "include/sweep.h"
+#include "include/autotune.h"
+#include "include/budget.h"
+#include "include/emit.h"
+#include "include/batch.h"
+#include "include/cgroup.h"
+#include "include/warm.h"
+#include "include/damon_sysfs.h"
+#include "include/paddr.h"
+#include "include/idle.h"
 #include "include/os/os_util.h"
 #include "include/os/os_perf.h"
 
@@ -68,16 +80,43 @@ extern int optopt;
 
 static void sigint_handler(int sig);
 static void print_usage(const char *exec_name);
-extern void read_damon_attrs(const char *attrs, uint64_t *sample, uint64_t *aggr,
-		uint64_t *regi, uint64_t *min, uint64_t *max);
-extern void write_damon_attrs(uint64_t sample, uint64_t aggr,
-		uint64_t regi, uint64_t min, uint64_t max);
 
 int numa_stat = 1;
 
 #define O_PID 0x0001
 #define O_NUM 0x0002
 #define O_REG 0x0004
+#define O_ATTACH 0x0008
+#define O_KDAMONDS 0x0010
+#define O_PADDR 0x0020
+
+/* Long options which have no short form. */
+#define OPT_BUDGET 256
+#define OPT_AUTOTUNE 257
+#define OPT_BATCH 258
+#define OPT_FORMAT 259
+#define OPT_DUMP_ROTATE 260
+#define OPT_DUMP_COMPRESS 261
+#define OPT_ATTACH 262
+#define OPT_WARM_START 263
+#define OPT_KDAMONDS 264
+#define OPT_SOURCE 265
+#define OPT_PADDR 266
+
+static struct option s_long_opts[] = {
+	{ "budget", required_argument, NULL, OPT_BUDGET },
+	{ "autotune", required_argument, NULL, OPT_AUTOTUNE },
+	{ "batch", required_argument, NULL, OPT_BATCH },
+	{ "format", required_argument, NULL, OPT_FORMAT },
+	{ "dump-rotate", required_argument, NULL, OPT_DUMP_ROTATE },
+	{ "dump-compress", required_argument, NULL, OPT_DUMP_COMPRESS },
+	{ "attach", no_argument, NULL, OPT_ATTACH },
+	{ "warm-start", required_argument, NULL, OPT_WARM_START },
+	{ "kdamonds", required_argument, NULL, OPT_KDAMONDS },
+	{ "source", required_argument, NULL, OPT_SOURCE },
+	{ "paddr", no_argument, NULL, OPT_PADDR },
+	{ NULL, 0, NULL, 0 }
+};
 
 /*
  * Print command-line help information.
@@ -90,9 +129,14 @@ static void print_usage(const char *exec_name)
 	buffer[PATH_MAX - 1] = 0;
 
 	stderr_print("Usage: %s [option(s)]\n", basename(buffer));
+	stderr_print("       %s sweep -p <pid> [option(s)], see 'sweep -h'\n",
+		     basename(buffer));
+	stderr_print("       %s validate -l <layout> [option(s)], see 'validate -h'\n",
+		     basename(buffer));
 	stderr_print("  -h    print help\n"
-		     "  -g    monitor all processes under this cgroup.\n"
-		     "        e.g. damontop -g /sys/fs/cgroup/memory/test/cgroup.procs.\n"
+		     "  -g    monitor all processes under these cgroups (and the\n"
+		     "        cgroups below them), the membership is followed.\n"
+		     "        e.g. damontop -g /sys/fs/cgroup/a.slice,/sys/fs/cgroup/b.\n"
 		     "  -d    path of the file to save the data in screen\n"
 		     "  -l    0/1/2, the level of output warning message\n"
 		     "  -f    path of the file to save warning message.\n"
@@ -109,7 +153,45 @@ static void print_usage(const char *exec_name)
 		     "        high  : high sampling precision\n"
 		     "                (high overhead, not recommended option)\n"
 		     "        low   : low sampling precision, suitable for high"
-		     " load system\n");
+		     " load system\n"
+		     "  --budget cpu=N%%,rss=N[KMG]\n"
+		     "        self-overhead budget, datop degrades itself when\n"
+		     "        exceeding it. e.g. damontop --budget cpu=2%%,rss=64M\n"
+		     "  --autotune cpu=N%%[,regions=N]\n"
+		     "        tune the DAMON attributes at runtime to keep kdamond\n"
+		     "        near the CPU target with the wanted regions.\n"
+		     "        e.g. damontop --autotune cpu=1%%,regions=200\n"
+		     "  --batch count[,secs]\n"
+		     "        no screen, write count intervals (5s by default)\n"
+		     "        of records to stdout, or to the -d file.\n"
+		     "        e.g. damontop -p <pid> --batch 60,10\n"
+		     "  --format text|jsonl|csv|bin\n"
+		     "        the format of the --batch records (default text).\n"
+		     "  --dump-rotate size=N[KMG][,time=S][,keep=N]\n"
+		     "        rotate the -d file by size and/or age.\n"
+		     "  --dump-compress gzip|zstd\n"
+		     "        compress the -d file.\n"
+		     "  --attach\n"
+		     "        observe the DAMON session which is already running,\n"
+		     "        its targets and attributes are left untouched.\n"
+		     "        can't be used with -g, -n, -p, -r, --autotune\n"
+		     "        or --kdamonds.\n"
+		     "  --warm-start <file>\n"
+		     "        save the DAMON regions to the file at exit (or on\n"
+		     "        the hotkey 'W'), seed DAMON with them at start.\n"
+		     "  --kdamonds N|node\n"
+		     "        spread the targets over N kdamonds, or one per NUMA\n"
+		     "        node bound to its CPUs (DAMON sysfs only).\n"
+		     "  --source trace|regions\n"
+		     "        read the regions from the trace events (default),\n"
+		     "        or pull a snapshot of them once per refresh\n"
+		     "        (DAMON sysfs only).\n"
+		     "  --paddr\n"
+		     "        monitor the physical memory of each NUMA node\n"
+		     "        instead of processes, and attribute it to the\n"
+		     "        memory cgroups, see the hotkey 'P' (DAMON sysfs\n"
+		     "        only). can't be used with -g, -n, -p, --attach,\n"
+		     "        --kdamonds, --warm-start or --batch.\n");
 }
 
 int plat_detect(void)
@@ -132,22 +214,26 @@ int main(int argc, char *argv[])
 	int ret = 1, debug_level = 0;
 	int options = 0;
 	FILE *log = NULL, *dump = NULL;
+	char *dump_path = NULL;
 	boolean_t locked = B_FALSE;
 	uint64_t orig_sampling_intval, orig_aggr_intval, orig_regions_update;
 	uint64_t orig_min, orig_max;
 	pid_t pid;
-	int c, fd, i;
+	int c;
 	const char delim[2] = ",";
 	char *token;
 	char *procs = NULL;
-	char *cgroup_path;
-	char cgroup_proc[512] = {0};
 
 	if (!os_authorized()) {
 		return (1);
 	}
 
-	if (access("/sys/kernel/debug/damon", 0)) {
+	/*
+	 * DAMON through debugfs or sysfs (or both). Without DAMON, the
+	 * page idle bits are sampled instead.
+	 */
+	if (access(DAMON_DEBUGFS, 0) && !damon_sysfs_supported() &&
+	    idle_select() != 0) {
 		stderr_print("Not support DAMON!\n");
 		goto L_EXIT0;
 	}
@@ -162,16 +248,32 @@ int main(int argc, char *argv[])
 	g_disp_intval = DISP_DEFAULT_INTVAL;
 	optind = 1;
 	opterr = 0;
-	(void)gettimeofday(&g_tvbase, 0);
+	monotonic_tv(&g_tvbase);
 
-	read_damon_attrs("/sys/kernel/debug/damon/attrs", &orig_sampling_intval,
-			&orig_aggr_intval, &orig_regions_update, &orig_min, &orig_max);
 	online_ncpu_refresh();
-	memset(&target_procs, 0, sizeof(target_procs));
+
+	/*
+	 * "datop sweep ..." runs the attributes sweep instead of the UI,
+	 * "datop validate ..." scores it against a datop-loadgen layout.
+	 */
+	if (argc >= 2 && (strcmp(argv[1], "sweep") == 0 ||
+	    strcmp(argv[1], "validate") == 0)) {
+		if (idle_enabled()) {
+			stderr_print("%s needs DAMON.\n", argv[1]);
+			goto L_EXIT0;
+		}
+
+		return (sweep_main(argc - 1, argv + 1));
+	}
+
+	read_damon_attrs(DAMON_ATTRS_PATH, &orig_sampling_intval,
+			&orig_aggr_intval, &orig_regions_update, &orig_min, &orig_max);
+	target_procs_reset();
 	/*
 	 * Parse command line arguments.
 	 */
-	while ((c = getopt(argc, argv, "g:d:l:o:p:f:n:t:hf:r:s:")) != EOF) {
+	while ((c = getopt_long(argc, argv, "g:d:l:o:p:f:n:t:hf:r:s:",
+				s_long_opts, NULL)) != EOF) {
 		switch (c) {
 		case 'h':
 			print_usage(argv[0]);
@@ -202,13 +304,16 @@ int main(int argc, char *argv[])
 
 		case 'n':
 			target_procs.nr_proc = atoi(optarg);
-			if ((target_procs.nr_proc < 0)
-					|| (target_procs.nr_proc > PROC_MAX)) {
+			if (target_procs.nr_proc < 0) {
 				stderr_print("Invalid process number %d.\n",
 						target_procs.nr_proc);
 				print_usage(argv[0]);
 				goto L_EXIT0;
 			}
+			if (target_procs_reserve(target_procs.nr_proc) != 0) {
+				stderr_print("Out of memory.\n");
+				goto L_EXIT0;
+			}
 			target_procs.ready = 0;
 			target_procs.last_ms = current_ms(&g_tvbase);
 			g_sortkey = SORT_KEY_CPU;
@@ -216,91 +321,38 @@ int main(int argc, char *argv[])
 			break;
 
 		case 'p':
-			procs = strdup(optarg);
-
-			memset(&target_procs, 0, sizeof(struct damon_proc_t));
-			token = strtok(optarg, delim);
-			target_procs.pid[0] = atoi(token);
-			target_procs.nr_proc++;
-			while (token != NULL) {
-				token = strtok(NULL, delim);
-				if (token == NULL)
-					break;
-				if (target_procs.nr_proc >= PROC_MAX) {
-					stderr_print("The traced proc number over %d.\n", PROC_MAX);
-					goto L_EXIT0;
-				}
-
+			target_procs_reset();
+			for (token = strtok(optarg, delim); token != NULL;
+			     token = strtok(NULL, delim)) {
 				pid = atoi(token);
 				if (pid <= 0) {
 					stderr_print("Invalid pid %d.\n", pid);
 					print_usage(argv[0]);
 					goto L_EXIT0;
 				}
-				target_procs.pid[target_procs.nr_proc] = pid;
-				target_procs.nr_proc++;
+
+				if (target_procs_add(pid) != 0) {
+					stderr_print("Out of memory.\n");
+					goto L_EXIT0;
+				}
 			}
 
+			target_procs_uniq();
+			free(procs);
+			procs = target_procs_str();
 			target_procs.ready = 1;
 			options |= O_PID;
 			break;
 
 		case 'g':
-			/* FIXME: only one cgroup supported now. */
-			cgroup_path = strdup(optarg);
-
-			if (access(cgroup_path, 0)) {
-				stderr_print("Found cgroup: %s failed!\n", cgroup_path);
-				free(cgroup_path);
-				goto L_EXIT0;
-			}
-
-			if ((fd = open(cgroup_path, O_RDONLY)) < 0) {
-				printf("%s: No such file!\n", cgroup_path);
-				free(cgroup_path);
-				goto L_EXIT0;
-			}
-
-			ret = read(fd, cgroup_proc, 512);
-			if (ret <= 0) {
-				perror("cgroup proc!\n");
-				free(cgroup_path);
+			if (cgroup_parse(optarg) <= 0) {
+				stderr_print("No process found in %s!\n",
+					     optarg);
 				goto L_EXIT0;
 			}
-			close(fd);
-			memset(&target_procs, 0, sizeof(struct damon_proc_t));
-
-			procs = strdup(cgroup_proc);
-			/* Replace char. */
-			for (i = 0; i < (int)strlen(procs); i++) {
-				if (procs[i] == '\n')
-					procs[i] = ',';
-			}
-
-			token = strtok(cgroup_proc, "\n");
-			target_procs.pid[0] = atoi(token);
-			target_procs.nr_proc++;
-			while (token != NULL) {
-				token = strtok(NULL, "\n");
-				if (token == NULL)
-					break;
-				if (target_procs.nr_proc >= PROC_MAX) {
-					stderr_print("The traced proc number over %d.\n", PROC_MAX);
-					goto L_EXIT0;
-				}
-
-				pid = atoi(token);
-				if (pid <= 0) {
-					stderr_print("Invalid pid %d.\n", pid);
-					print_usage(argv[0]);
-					goto L_EXIT0;
-				}
-				target_procs.pid[target_procs.nr_proc] = pid;
-				target_procs.nr_proc++;
-			}
 
-			free(cgroup_path);
-			target_procs.ready = 1;
+			free(procs);
+			procs = target_procs_str();
 			options |= O_PID;
 			break;
 
@@ -319,11 +371,6 @@ int main(int argc, char *argv[])
 				stderr_print("Invalid min/max regions: %d %d\n",
 						target_procs.max_regions, target_procs.max_regions);
 				goto L_EXIT0;
-			} else {
-				write_damon_attrs(orig_sampling_intval, orig_aggr_intval,
-						orig_regions_update,
-						target_procs.min_regions,
-						target_procs.max_regions);
 			}
 
 			options |= O_REG;
@@ -364,6 +411,7 @@ int main(int argc, char *argv[])
 				stderr_print("Cannot open '%s' for dump.\n", optarg);
 				goto L_EXIT0;
 			}
+			dump_path = optarg;
 			break;
 
 		case 't':
@@ -375,6 +423,97 @@ int main(int argc, char *argv[])
 			}
 			break;
 
+		case OPT_BUDGET:
+			if (budget_parse(optarg) != 0) {
+				stderr_print("Invalid budget '%s'.\n", optarg);
+				print_usage(argv[0]);
+				goto L_EXIT0;
+			}
+			break;
+
+		case OPT_AUTOTUNE:
+			if (autotune_parse(optarg) != 0) {
+				stderr_print("Invalid autotune '%s'.\n", optarg);
+				print_usage(argv[0]);
+				goto L_EXIT0;
+			}
+			break;
+
+		case OPT_BATCH:
+			if (batch_parse(optarg) != 0) {
+				stderr_print("Invalid batch '%s'.\n", optarg);
+				print_usage(argv[0]);
+				goto L_EXIT0;
+			}
+			break;
+
+		case OPT_DUMP_ROTATE:
+			if (dump_rotate_parse(optarg) != 0) {
+				stderr_print("Invalid dump-rotate '%s'.\n", optarg);
+				print_usage(argv[0]);
+				goto L_EXIT0;
+			}
+			break;
+
+		case OPT_DUMP_COMPRESS:
+			switch (dump_compress_parse(optarg)) {
+			case 0:
+				break;
+
+			case -2:
+				stderr_print("'%s' is not supported by this build.\n",
+					     optarg);
+				goto L_EXIT0;
+
+			default:
+				stderr_print("Invalid dump-compress '%s'.\n", optarg);
+				print_usage(argv[0]);
+				goto L_EXIT0;
+			}
+			break;
+
+		case OPT_WARM_START:
+			if (warm_parse(optarg) != 0) {
+				stderr_print("Invalid warm start file '%s'.\n",
+					     optarg);
+				goto L_EXIT0;
+			}
+			break;
+
+		case OPT_ATTACH:
+			options |= O_ATTACH;
+			break;
+
+		case OPT_KDAMONDS:
+			if (damon_sysfs_kdamonds_parse(optarg) != 0) {
+				stderr_print("Invalid kdamonds '%s'.\n", optarg);
+				print_usage(argv[0]);
+				goto L_EXIT0;
+			}
+
+			options |= O_KDAMONDS;
+			break;
+
+		case OPT_SOURCE:
+			if (damon_sysfs_source_parse(optarg) != 0) {
+				stderr_print("Invalid source '%s'.\n", optarg);
+				print_usage(argv[0]);
+				goto L_EXIT0;
+			}
+			break;
+
+		case OPT_PADDR:
+			options |= O_PADDR;
+			break;
+
+		case OPT_FORMAT:
+			if (emit_format_parse(optarg) != 0) {
+				stderr_print("Invalid format '%s'.\n", optarg);
+				print_usage(argv[0]);
+				goto L_EXIT0;
+			}
+			break;
+
 		case ':':
 			stderr_print("Missed argument for option %c.\n", optopt);
 			print_usage(argv[0]);
@@ -387,8 +526,61 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	if (target_procs.nr_proc == 0) {
+	if (idle_enabled() &&
+	    ((options & (O_ATTACH | O_KDAMONDS | O_PADDR)) || warm_enabled())) {
+		stderr_print("--attach, --kdamonds, --paddr and --warm-start "
+			     "need DAMON.\n");
+		goto L_EXIT0;
+	}
+
+	if (options & O_PADDR) {
+		if ((options & (O_PID | O_NUM | O_ATTACH | O_KDAMONDS)) ||
+		    cgroup_num() > 0 || target_procs.nr_proc > 0 ||
+		    warm_enabled() || batch_enabled()) {
+			stderr_print("--paddr can't be used with the options "
+				     "of the processes.\n");
+			goto L_EXIT0;
+		}
+
+		if (options & O_REG) {
+			write_damon_attrs(orig_sampling_intval,
+					  orig_aggr_intval,
+					  orig_regions_update,
+					  target_procs.min_regions,
+					  target_procs.max_regions);
+		}
+
+		/* No process to pick, the home window stays as it is. */
+		target_procs.ready = 1;
+	} else if (options & O_ATTACH) {
+		if ((options & (O_PID | O_NUM | O_REG | O_KDAMONDS)) ||
+		    cgroup_num() > 0 ||
+		    autotune_enabled() || target_procs.nr_proc > 0) {
+			stderr_print("--attach can't be used with the options "
+				     "changing DAMON.\n");
+			goto L_EXIT0;
+		}
+
+		if (monitor_attach() != 0) {
+			stderr_print("Attach to DAMON failed.\n");
+			goto L_EXIT0;
+		}
+
+		procs = target_procs_str();
+	} else if (options & O_REG) {
+		/* Not before here, --attach could follow -r. */
+		write_damon_attrs(orig_sampling_intval, orig_aggr_intval,
+				orig_regions_update,
+				target_procs.min_regions,
+				target_procs.max_regions);
+	}
+
+	if (target_procs.nr_proc == 0 && !(options & O_PADDR)) {
 		/* set process number by default. */
+		if (target_procs_reserve(3) != 0) {
+			goto L_EXIT0;
+		}
+
 		target_procs.nr_proc = 3;
 		target_procs.ready = 0;
 		target_procs.last_ms = current_ms(&g_tvbase);
@@ -396,13 +588,27 @@ int main(int argc, char *argv[])
 		g_disp_intval = DISP_MIN_INTVAL;
 	}
 
-	if (!procs && argc >= 2) {
+	if (!procs && argc >= 2 && !(options & O_PADDR)) {
 		stderr_print("Missed argument for option.\n");
 		print_usage(argv[0]);
 		goto L_EXIT0;
 	}
 
-	printf("Start monitoring %s ...\n", procs);
+	/* In batch mode, the dump file receives the records. */
+	if (batch_enabled()) {
+		batch_output_set(dump);
+		dump = NULL;
+	} else if (options & O_PADDR) {
+		printf("Start monitoring the physical memory ...\n");
+	} else {
+		if (idle_enabled()) {
+			printf("No DAMON, the accesses are sampled through "
+			       "%s.\n", IDLE_BITMAP);
+		}
+
+		printf("%s %s ...\n", (options & O_ATTACH) ?
+		       "Attach to monitoring" : "Start monitoring", procs);
+	}
 	/* procs = "pid1,pid2,pid3" */
 	if (options & O_PID) {
 		if (monitor_start(procs) < 0) {
@@ -411,6 +617,13 @@ int main(int argc, char *argv[])
 			goto L_EXIT0;
 		}
 		free(procs);
+	} else if (options & O_ATTACH) {
+		free(procs);
+	} else if (options & O_PADDR) {
+		if (paddr_start() != 0) {
+			stderr_print("Monitor the physical memory failed.\n");
+			goto L_EXIT0;
+		}
 	}
 
 	if (plat_detect() != 0) {
@@ -419,7 +632,11 @@ int main(int argc, char *argv[])
 		goto L_EXIT0;
 	}
 
-	if (os_damontop_lock(&locked) != 0) {
+	/*
+	 * An attached datop never writes to DAMON, several of them can
+	 * observe the same kdamond.
+	 */
+	if (!(options & O_ATTACH) && os_damontop_lock(&locked) != 0) {
 		stderr_print("Fail to lock damontop!\n");
 		goto L_EXIT0;
 	}
@@ -435,7 +652,7 @@ int main(int argc, char *argv[])
 
 	log = NULL;
 
-	if (dump_init(dump) != 0) {
+	if (dump_init(dump, dump_path) != 0) {
 		goto L_EXIT2;
 	}
 
@@ -445,6 +662,10 @@ int main(int argc, char *argv[])
 		goto L_EXIT3;
 	}
 
+	stats_init();
+	budget_init();
+	autotune_init();
+
 	/*
 	 * Initialize for the "window-switching" table.
 	 */
@@ -460,6 +681,22 @@ int main(int argc, char *argv[])
 	os_calibrate(&g_nsofclk, &g_clkofsec);
 
 	debug_print(NULL, 2, "Detected %d online CPUs\n", g_ncpus);
+
+	if (batch_enabled()) {
+		if ((signal(SIGINT, sigint_handler) == SIG_ERR) ||
+		    (signal(SIGHUP, sigint_handler) == SIG_ERR) ||
+		    (signal(SIGQUIT, sigint_handler) == SIG_ERR) ||
+		    (signal(SIGTERM, sigint_handler) == SIG_ERR) ||
+		    (signal(SIGPIPE, sigint_handler) == SIG_ERR)) {
+			goto L_EXIT5;
+		}
+
+		if (batch_run() == 0) {
+			ret = 0;
+		}
+		goto L_EXIT5;
+	}
+
 	stderr_print("DamonTOP is starting ...\n");
 
 	if (disp_cons_ctl_init() != 0) {
@@ -486,7 +723,7 @@ int main(int argc, char *argv[])
 	}
 
 	/*
-	 * Initialize for display and create console thread & display thread.
+	 * Initialize for display and create display thread.
 	 */
 	if (disp_init() != 0) {
 		perf_fini();
@@ -498,13 +735,8 @@ int main(int argc, char *argv[])
 	 * exit when user hits the hotkey 'Q' or press "CTRL+C".
 	 */
 	disp_dispthr_quit_wait();
-
-	/*
-	 * Notify cons thread to exit.
-	 */
-	disp_consthr_quit();
-
 	disp_fini();
+	stats_dump();
 	stderr_print("DamonTop is exiting ...\n");
 	(void)fflush(stdout);
 	ret = 0;
@@ -513,7 +745,11 @@ L_EXIT7:
 	disp_cons_ctl_fini();
 
 L_EXIT5:
+	/* The regions are still there, save them before stopping. */
+	(void)warm_save();
 	monitor_exit();		/* Stop tracing pid when exiting */
+	budget_fini();
+	autotune_fini();
 	/* restore DAMON config */
 	if (options & O_REG)
 		write_damon_attrs(orig_sampling_intval, orig_aggr_intval,
@@ -535,6 +771,9 @@ L_EXIT1:
 	exit_msg_print();
 
 L_EXIT0:
+	paddr_fini();
+	cgroup_fini();
+	warm_fini();
 	if (dump != NULL) {
 		(void)fclose(dump);
 	}
@@ -576,6 +815,11 @@ static void sigint_handler(int sig)
 		return;
 	}
 
+	if (batch_enabled()) {
+		batch_quit();
+		return;
+	}
+
 	/*
 	 * It's same as the operation when user hits the hotkey 'Q'.
 	 */
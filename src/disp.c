@@ -40,6 +40,9 @@
 #include <pthread.h>
 #include <time.h>
 #include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <curses.h>
 #include "include/types.h"
 #include "include/util.h"
@@ -49,6 +52,10 @@
 #include "include/cmd.h"
 #include "include/win.h"
 #include "include/damon.h"
+#include "include/stats.h"
+#include "include/budget.h"
+#include "include/cgroup.h"
+#include "include/warm.h"
 
 int g_run_secs;
 int g_disp_intval;
@@ -58,7 +65,6 @@ static cons_ctl_t s_cons_ctl;
 
 static int disp_start(void);
 static void *disp_handler(void *);
-static void *cons_handler(void *);
 
 static int mutex_cond_init(pthread_mutex_t * mutex, pthread_cond_t * cond)
 {
@@ -86,12 +92,15 @@ static void mutex_cond_fini(pthread_mutex_t * mutex, pthread_cond_t * cond)
 static int disp_ctl_init(void)
 {
 	(void)memset(&s_disp_ctl, 0, sizeof(s_disp_ctl));
+	s_disp_ctl.epfd = -1;
+	s_disp_ctl.evfd = -1;
+	s_disp_ctl.tfd = -1;
 
-	if (mutex_cond_init(&s_disp_ctl.mutex, &s_disp_ctl.cond) != 0)
+	if (pthread_mutex_init(&s_disp_ctl.mutex, NULL) != 0)
 		return -1;
 
 	if (mutex_cond_init(&s_disp_ctl.mutex2, &s_disp_ctl.cond2) != 0) {
-		mutex_cond_fini(&s_disp_ctl.mutex, &s_disp_ctl.cond);
+		(void)pthread_mutex_destroy(&s_disp_ctl.mutex);
 		return -1;
 	}
 
@@ -99,18 +108,77 @@ static int disp_ctl_init(void)
 	return (0);
 }
 
+static void fd_close(int *fd)
+{
+	if (*fd >= 0) {
+		(void)close(*fd);
+		*fd = -1;
+	}
+}
+
 /*
  * Clean up the resources of display control structure.
  */
 static void disp_ctl_fini(void)
 {
 	if (s_disp_ctl.inited) {
-		mutex_cond_fini(&s_disp_ctl.mutex, &s_disp_ctl.cond);
+		fd_close(&s_disp_ctl.epfd);
+		fd_close(&s_disp_ctl.evfd);
+		fd_close(&s_disp_ctl.tfd);
+		(void)pthread_mutex_destroy(&s_disp_ctl.mutex);
 		mutex_cond_fini(&s_disp_ctl.mutex2, &s_disp_ctl.cond2);
 		s_disp_ctl.inited = B_FALSE;
 	}
 }
 
+static int epoll_fd_add(int epfd, int fd)
+{
+	struct epoll_event ev;
+
+	(void)memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	return (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev));
+}
+
+/*
+ * The 'disp thread' waits in one epoll set for everything: the keys
+ * from stdin, the resize notification from the console pipe, the
+ * flags set by other threads (eventfd) and the refresh timer.
+ */
+static int disp_loop_init(void)
+{
+	if ((s_disp_ctl.epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		return (-1);
+	}
+
+	if ((s_disp_ctl.evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		return (-1);
+	}
+
+	if ((s_disp_ctl.tfd = timerfd_create(CLOCK_MONOTONIC,
+	    TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+		return (-1);
+	}
+
+	if ((epoll_fd_add(s_disp_ctl.epfd, STDIN_FILENO) != 0) ||
+	    (epoll_fd_add(s_disp_ctl.epfd, s_cons_ctl.pipe[0]) != 0) ||
+	    (epoll_fd_add(s_disp_ctl.epfd, s_disp_ctl.evfd) != 0) ||
+	    (epoll_fd_add(s_disp_ctl.epfd, s_disp_ctl.tfd) != 0)) {
+		return (-1);
+	}
+
+	/*
+	 * The cgroup membership changes (-g).
+	 */
+	if ((cgroup_fd() >= 0) &&
+	    (epoll_fd_add(s_disp_ctl.epfd, cgroup_fd()) != 0)) {
+		return (-1);
+	}
+
+	return (0);
+}
+
 /*
  * Initialization for the display control structure and
  * creating 'disp thread'.
@@ -121,7 +189,7 @@ int disp_init(void)
 		return (-1);
 	}
 
-	if (disp_start() != 0) {
+	if ((disp_loop_init() != 0) || (disp_start() != 0)) {
 		disp_ctl_fini();
 		return (-1);
 	}
@@ -131,13 +199,27 @@ int disp_init(void)
 
 /*
  * Before free the resources of display control structure,
- * make sure the 'disp thread' and 'cons thread' quit yet.
+ * make sure the 'disp thread' quits yet.
  */
 void disp_fini(void)
 {
 	disp_ctl_fini();
 }
 
+/*
+ * Initialization for the modes without display (e.g. sweep), which
+ * only wait for the perf thread by disp_flag2_wait().
+ */
+int disp_sync_init(void)
+{
+	return (disp_ctl_init());
+}
+
+void disp_sync_fini(void)
+{
+	disp_ctl_fini();
+}
+
 /*
  * Initialization for the console control structure.
  */
@@ -165,28 +247,18 @@ void disp_cons_ctl_fini(void)
 }
 
 /*
- * Send a character '<PIPE_CHAR_QUIT>' to pipe to notify the
- * 'cons thread' to quit.
+ * Set the flag for 'disp thread' and wake it up. The sync modes
+ * (no 'disp thread') have no eventfd.
  */
-void disp_consthr_quit(void)
-{
-	char c;
-
-	debug_print(NULL, 2, "Send PIPE_CHAR_QUIT to cons thread\n");
-	c = PIPE_CHAR_QUIT;
-	if (write(s_cons_ctl.pipe[1], &c, 1) == -1) {
-		debug_print(NULL, 2, "Fail to write PIPE_CHAR_QUIT"
-			    " to pipe\n");
-	}
-
-	(void)pthread_join(s_cons_ctl.thr, NULL);
-	debug_print(NULL, 2, "cons thread exit yet\n");
-}
-
 static void dispthr_flagset_nolock(disp_flag_t flag)
 {
+	uint64_t one = 1;
+
 	s_disp_ctl.flag = flag;
-	(void)pthread_cond_signal(&s_disp_ctl.cond);
+	if ((s_disp_ctl.evfd >= 0) &&
+	    (write(s_disp_ctl.evfd, &one, sizeof(one)) != sizeof(one))) {
+		debug_print(NULL, 2, "Fail to kick the disp thread\n");
+	}
 }
 
 static void dispthr_flagset_lock(disp_flag_t flag)
@@ -229,8 +301,8 @@ void disp_maplist_data_fail(void)
 }
 
 /*
- * The handler of signal 'SIGWINCH'. The function sends a 'refresh'
- * command to 'cons thread' to let it do a refresh operation.
+ * The handler of signal 'SIGWINCH'. The function writes to the console
+ * pipe to let 'disp thread' do a resize operation.
  */
 /* ARGSUSED */
 void disp_on_resize(int sig __attribute__ ((unused)))
@@ -250,38 +322,42 @@ void disp_intval(char *buf, int size)
 }
 
 /*
- * Create 'disp thread' and 'cons thread'.
+ * Create 'disp thread'.
  */
 static int disp_start(void)
 {
-	if (pthread_create(&s_cons_ctl.thr, NULL, cons_handler, NULL) != 0) {
-		debug_print(NULL, 2, "Create cons thread failed.\n");
-		return (-1);
-	}
-
 	if (pthread_create(&s_disp_ctl.thr, NULL, disp_handler, NULL) != 0) {
 		debug_print(NULL, 2, "Create disp thread failed.\n");
-		disp_consthr_quit();
 		return (-1);
 	}
 
 	return (0);
 }
 
-static void timeout_set(struct timespec *timeout, int nsec)
+/*
+ * (Re)start the refresh timer. The timer is periodic, so the refresh
+ * cadence doesn't drift by the time spent on sampling and drawing.
+ */
+static void disp_timer_arm(void)
 {
-	struct timeval tv;
+	struct itimerspec its;
+	int secs = MAX(budget_disp_intval(g_disp_intval), 1);
+
+	(void)memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = secs;
+	its.it_interval.tv_sec = secs;
+	if (timerfd_settime(s_disp_ctl.tfd, 0, &its, NULL) != 0) {
+		debug_print(NULL, 2, "disp: timerfd_settime failed (%d)\n",
+			    errno);
+	}
 
-	(void)gettimeofday(&tv, NULL);
-	timeout->tv_sec = tv.tv_sec + nsec;
-	timeout->tv_nsec = tv.tv_usec * 1000;
+	s_disp_ctl.timer_secs = secs;
 }
 
 /*
  * The common entry for processing command.
  */
-static void
-cmd_received(cmd_t * cmd, boolean_t * quit, struct timespec *timeout)
+static void cmd_received(cmd_t * cmd, boolean_t * quit)
 {
 	boolean_t badcmd, execute;
 	int cmd_id = CMD_ID(cmd);
@@ -294,6 +370,13 @@ cmd_received(cmd_t * cmd, boolean_t * quit, struct timespec *timeout)
 		*quit = B_TRUE;
 		return;
 
+	case CMD_SAVE_ID:
+		/*
+		 * User hit the hotkey 'W' to save the regions now.
+		 */
+		(void)warm_save();
+		return;
+
 	case CMD_RESIZE_ID:
 		/*
 		 * The screen resize signal would trigger this
@@ -309,14 +392,14 @@ cmd_received(cmd_t * cmd, boolean_t * quit, struct timespec *timeout)
 			execute = B_FALSE;
 		}
 
-		timeout_set(timeout, g_disp_intval);
+		disp_timer_arm();
 		break;
 
 	case CMD_REFRESH_ID:
 		/*
 		 * User hit the hotkey 'R' to refresh current window.
 		 */
-		timeout_set(timeout, g_disp_intval);
+		disp_timer_arm();
 		break;
 	}
 
@@ -357,37 +440,151 @@ static void scroll_enter(void)
 	}
 }
 
-static boolean_t consthr_init_wait(void)
+/*
+ * Handle the keys the user hit. The keys are handled right here in
+ * 'disp thread', so a key is on screen after one render. Return
+ * B_FALSE if stdin is readable but no key can be read, i.e. the
+ * associated terminal is lost.
+ */
+static boolean_t keys_handle(boolean_t * quit)
+{
+	int c, cmd_id, nkeys = 0;
+	unsigned char ch;
+	uint64_t start_ns;
+	cmd_t cmd;
+
+	while (!(*quit) && ((c = getch()) != ERR)) {
+		nkeys++;
+		start_ns = stats_ns();
+		ch = tolower((unsigned char)c);
+		dump_write("\n<-- User hit the key '%c' "
+			   "(ascii = %d) -->\n", ch, (int)ch);
+
+		cmd_id = cmd_id_get(ch);
+		if (cmd_id != CMD_INVALID_ID) {
+			(void)memset(&cmd, 0, sizeof(cmd));
+			CMD_ID_SET(&cmd, cmd_id);
+			cmd_received(&cmd, quit);
+		} else {
+			/*
+			 * Hit the keys 'UP'/'DOWN'/'ENTER'
+			 */
+			switch (ch) {
+			case 2:	/* KEY DOWN */
+				key_scroll(SCROLL_DOWN);
+				break;
+
+			case 3:	/* KEY UP */
+				key_scroll(SCROLL_UP);
+				break;
+
+			case 13:	/* enter. */
+				scroll_enter();
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		stats_stage_end(STATS_STAGE_CONS, start_ns);
+	}
+
+	return (nkeys > 0);
+}
+
+/*
+ * Handle the flag set by other threads.
+ */
+static void flag_handle(boolean_t * quit)
 {
-	struct timespec timeout;
 	disp_flag_t flag;
-	int status = 0;
+	uint64_t n;
+	cmd_t cmd;
+
+	if (read(s_disp_ctl.evfd, &n, sizeof(n)) != sizeof(n)) {
+		return;
+	}
 
-	timeout_set(&timeout, g_disp_intval);
 	(void)pthread_mutex_lock(&s_disp_ctl.mutex);
 	flag = s_disp_ctl.flag;
+	if (flag == DISP_FLAG_CMD) {
+		(void)memcpy(&cmd, &s_disp_ctl.cmd, sizeof(cmd));
+	}
 
-	/*
-	 * The cons thread issues a command to go to home window
-	 * when it completes the initialization.
-	 */
-	while ((flag != DISP_FLAG_CMD) && (flag != DISP_FLAG_QUIT)) {
-		status = pthread_cond_timedwait(&s_disp_ctl.cond,
-						&s_disp_ctl.mutex, &timeout);
+	s_disp_ctl.flag = DISP_FLAG_NONE;
+	(void)pthread_mutex_unlock(&s_disp_ctl.mutex);
 
-		if (status == ETIMEDOUT) {
-			break;
+	switch (flag) {
+	case DISP_FLAG_QUIT:
+		debug_print(NULL, 2, "disp: received DISP_FLAG_QUIT\n");
+		*quit = B_TRUE;
+		break;
+
+	case DISP_FLAG_CMD:
+		cmd_received(&cmd, quit);
+		if (*quit) {
+			debug_print(NULL, 2,
+				    "disp thread received CMD_QUIT_ID\n");
 		}
+		break;
 
-		flag = s_disp_ctl.flag;
+	case DISP_FLAG_PROFILING_DATA_READY:
+	case DISP_FLAG_ML_DATA_READY:
+		/*
+		 * Show the page.
+		 */
+		(void)page_next_execute(B_FALSE);
+		break;
+
+	case DISP_FLAG_PROFILING_DATA_FAIL:
+	case DISP_FLAG_ML_DATA_FAIL:
+		/*
+		 * Received the notification that the perf counting
+		 * was failed.
+		 */
+		debug_print(NULL, 2, "disp: profiling data failed.\n");
+		disp_go_home();
+		break;
+
+	default:
+		break;
 	}
+}
 
-	(void)pthread_mutex_unlock(&s_disp_ctl.mutex);
-	if ((status == ETIMEDOUT) || (flag == DISP_FLAG_QUIT)) {
-		return (B_FALSE);
+/*
+ * The refresh timer expired, force a 'refresh' operation.
+ */
+static void timer_handle(void)
+{
+	uint64_t n;
+	cmd_t cmd;
+
+	if (read(s_disp_ctl.tfd, &n, sizeof(n)) != sizeof(n)) {
+		return;
 	}
 
-	return (B_TRUE);
+	if (page_current_get() != NULL) {
+		(void)memset(&cmd, 0, sizeof(cmd));
+		CMD_ID_SET(&cmd, CMD_REFRESH_ID);
+		cmd_execute(&cmd, NULL);
+	}
+}
+
+/*
+ * The console pipe only carries the resize notification.
+ */
+static void pipe_handle(boolean_t * quit)
+{
+	unsigned char ch;
+	cmd_t cmd;
+
+	if ((read(s_cons_ctl.pipe[0], &ch, 1) == 1) &&
+	    (ch == PIPE_CHAR_RESIZE)) {
+		(void)memset(&cmd, 0, sizeof(cmd));
+		CMD_ID_SET(&cmd, CMD_RESIZE_ID);
+		cmd_received(&cmd, quit);
+	}
 }
 
 /*
@@ -396,28 +593,21 @@ static boolean_t consthr_init_wait(void)
 /* ARGSUSED */
 static void *disp_handler(void *arg __attribute__ ((unused)))
 {
-	disp_flag_t flag;
-	int status = 0;
-	cmd_t cmd;
-	boolean_t quit, pagelist_inited = B_FALSE;
-	struct timespec timeout;
+	struct epoll_event evs[4];
+	boolean_t quit = B_FALSE, pagelist_inited = B_FALSE;
+	boolean_t curses_inited = B_FALSE;
 	uint64_t start_ms;
 	int64_t diff_ms;
+	int i, n;
 
-	/*
-	 * Wait cons thread to complete initialization.
-	 */
-	if (!consthr_init_wait()) {
-		debug_print(NULL, 2, "Timeout for waiting cons thread to "
-			    "complete initialization\n");
-
-		/*
-		 * The cons thread should exit with error or startup failed,
-		 * disp thread stops running.
-		 */
+	if (!reg_curses_init(B_TRUE)) {
 		goto L_EXIT;
 	}
 
+	curses_inited = B_TRUE;
+	budget_thread_register("disp");
+	win_fix_init();
+
 	/*
 	 * DamonToP contains multiple windows. It uses double linked list
 	 * to link all of windows.
@@ -425,118 +615,58 @@ static void *disp_handler(void *arg __attribute__ ((unused)))
 	page_list_init();
 	pagelist_inited = B_TRUE;
 
-	timeout_set(&timeout, 0);
+	/*
+	 * Excute "home" command. It shows the DamonTop default page.
+	 */
+	disp_go_home();
+	disp_timer_arm();
 	start_ms = current_ms(&g_tvbase);
 
-	for (;;) {
-		status = 0;
-		(void)pthread_mutex_lock(&s_disp_ctl.mutex);
-		flag = s_disp_ctl.flag;
-		while (flag == DISP_FLAG_NONE) {
-			status = pthread_cond_timedwait(&s_disp_ctl.cond,
-							&s_disp_ctl.mutex,
-							&timeout);
-			flag = s_disp_ctl.flag;
-			if (status == ETIMEDOUT) {
-				break;
+	while (!quit) {
+		if ((n = epoll_wait(s_disp_ctl.epfd, evs,
+				    sizeof(evs) / sizeof(evs[0]), -1)) < 0) {
+			if (errno == EINTR) {
+				continue;
 			}
-		}
 
-		if (flag == DISP_FLAG_CMD) {
-			(void)memcpy(&cmd, &s_disp_ctl.cmd, sizeof(cmd));
+			debug_print(NULL, 2, "disp: epoll_wait failed (%d)\n",
+				    errno);
+			break;
 		}
 
-		s_disp_ctl.flag = DISP_FLAG_NONE;
-		(void)pthread_mutex_unlock(&s_disp_ctl.mutex);
+		for (i = 0; (i < n) && !quit; i++) {
+			if (evs[i].data.fd == STDIN_FILENO) {
+				if (!keys_handle(&quit) ||
+				    (evs[i].events & (EPOLLHUP | EPOLLERR))) {
+					debug_print(NULL, 2, "disp: "
+						    "the terminal is lost.\n");
+					quit = B_TRUE;
+				}
+			} else if (evs[i].data.fd == s_cons_ctl.pipe[0]) {
+				pipe_handle(&quit);
+			} else if (evs[i].data.fd == s_disp_ctl.evfd) {
+				flag_handle(&quit);
+			} else if (evs[i].data.fd == s_disp_ctl.tfd) {
+				timer_handle();
+				/* Catch the forks and exits, -g only. */
+				cgroup_events_handle();
+			} else if (evs[i].data.fd == cgroup_fd()) {
+				cgroup_events_handle();
+			}
+		}
 
 		diff_ms = current_ms(&g_tvbase) - start_ms;
 		if (g_run_secs <= diff_ms / MS_SEC) {
 			g_run_secs = TIME_NSEC_MAX;
 			debug_print(NULL, 2, "disp: it's time to exit\n");
-			continue;
 		}
 
-		if ((status == ETIMEDOUT) && (flag == DISP_FLAG_NONE)) {
-			if (page_current_get() == NULL) {
-				timeout_set(&timeout, g_disp_intval);
-				continue;
-			}
-
-			/*
-			 * Force a 'refresh' operation.
-			 */
-			CMD_ID_SET(&cmd, CMD_REFRESH_ID);
-			cmd_execute(&cmd, NULL);
-			timeout_set(&timeout, g_disp_intval);
-			continue;
-		}
-
-		switch (flag) {
-		case DISP_FLAG_QUIT:
-			debug_print(NULL, 2, "disp: received DISP_FLAG_QUIT\n");
-			goto L_EXIT;
-
-		case DISP_FLAG_CMD:
-			cmd_received(&cmd, &quit, &timeout);
-			if (quit) {
-				debug_print(NULL, 2,
-					    "disp thread received CMD_QUIT_ID\n");
-				goto L_EXIT;
-			}
-			break;
-
-		case DISP_FLAG_PROFILING_DATA_READY:
-		case DISP_FLAG_ML_DATA_READY:
-			/*
-			 * Show the page.
-			 */
-			(void)page_next_execute(B_FALSE);
-			timeout_set(&timeout, g_disp_intval);
-			break;
-
-		case DISP_FLAG_PROFILING_DATA_FAIL:
-		case DISP_FLAG_ML_DATA_FAIL:
-			/*
-			 * Received the notification that the perf counting
-			 * was failed.
-			 */
-			debug_print(NULL, 2,
-				    "disp: profiling data failed.\n");
-			disp_go_home();
-			break;
-
-		case DISP_FLAG_SCROLLUP:
-			/*
-			 * User hits the "UP" key.
-			 */
-			key_scroll(SCROLL_UP);
-			if (status == ETIMEDOUT) {
-				timeout_set(&timeout, g_disp_intval);
-			}
-			break;
-
-		case DISP_FLAG_SCROLLDOWN:
-			/*
-			 * User hits the "DOWN" key.
-			 */
-			key_scroll(SCROLL_DOWN);
-			if (status == ETIMEDOUT) {
-				timeout_set(&timeout, g_disp_intval);
-			}
-			break;
-
-		case DISP_FLAG_SCROLLENTER:
-			/*
-			 * User selects a scroll item and hit the "ENTER".
-			 */
-			scroll_enter();
-			if (status == ETIMEDOUT) {
-				timeout_set(&timeout, g_disp_intval);
-			}
-			break;
-
-		default:
-			break;
+		/*
+		 * The interval might be changed (e.g. by the budget).
+		 */
+		if (MAX(budget_disp_intval(g_disp_intval), 1) !=
+		    s_disp_ctl.timer_secs) {
+			disp_timer_arm();
 		}
 	}
 
@@ -550,138 +680,11 @@ L_EXIT:
 	 */
 	perf_fini();
 
-	debug_print(NULL, 2, "disp thread is exiting\n");
-	return (NULL);
-}
-
-/*
- * The handler of 'cons thread'
- */
-/* ARGSUSED */
-static void *cons_handler(void *arg __attribute__ ((unused)))
-{
-	int c, cmd_id;
-	unsigned char ch;
-
-	if (!reg_curses_init(B_TRUE)) {
-		goto L_EXIT;
-	}
-
-	win_fix_init();
-
-	/*
-	 * Excute "home" command. It shows the DamonTop default page.
-	 */
-	disp_go_home();
-
-	for (;;) {
-		FD_ZERO(&s_cons_ctl.fds);
-		FD_SET(STDIN_FILENO, &s_cons_ctl.fds);
-		FD_SET(s_cons_ctl.pipe[0], &s_cons_ctl.fds);
-
-		/*
-		 * Wait one character from "stdin" or pipe.
-		 */
-		if (select(s_cons_ctl.pipe[0] + 1, &s_cons_ctl.fds,
-			   NULL, NULL, NULL) > 0) {
-			if (FD_ISSET(s_cons_ctl.pipe[0], &s_cons_ctl.fds)) {
-				if (read(s_cons_ctl.pipe[0], &ch, 1) == 1) {
-					/*
-					 * Character is from pipe.
-					 */
-					if (ch == PIPE_CHAR_QUIT) {
-						/*
-						 * Received a QUIT notification,
-						 * "console thread" will be quit
-						 */
-						debug_print(NULL, 2, "cons: "
-							    "received PIPE_CHAR_QUIT\n");
-						break;
-					}
-
-					if (ch == PIPE_CHAR_RESIZE) {
-						/*
-						 * Send the "RESIZE" command
-						 * to "display thread".
-						 */
-						(void)
-						    pthread_mutex_lock
-						    (&s_disp_ctl.mutex);
-
-						CMD_ID_SET(&s_disp_ctl.cmd,
-							   CMD_RESIZE_ID);
-						dispthr_flagset_nolock
-						    (DISP_FLAG_CMD);
-
-						(void)
-						    pthread_mutex_unlock
-						    (&s_disp_ctl.mutex);
-					}
-				}
-			} else {
-				/*
-				 * Character is from STDIN.
-				 */
-				if ((c = getch()) == ERR) {
-					/*
-					 * It's possile if the associated
-					 * terminal is lost.
-					 */
-					debug_print(NULL, 2, "cons: "
-						    "getch() failed.\n");
-					break;
-				}
-
-				ch = tolower((unsigned char)c);
-				dump_write("\n<-- User hit the key '%c' "
-					   "(ascii = %d) -->\n", ch, (int)ch);
-
-				cmd_id = cmd_id_get(ch);
-				if (cmd_id != CMD_INVALID_ID) {
-					/*
-					 * The character is a command. Send
-					 * the command to 'disp thread'.
-					 */
-					(void)pthread_mutex_lock(&s_disp_ctl.
-								 mutex);
-
-					CMD_ID_SET(&s_disp_ctl.cmd, cmd_id);
-					dispthr_flagset_nolock(DISP_FLAG_CMD);
-
-					(void)pthread_mutex_unlock(&s_disp_ctl.
-								   mutex);
-				} else {
-					/*
-					 * Hit the keys 'UP'/'DOWN'/'ENTER'
-					 */
-					switch (ch) {
-					case 2:	/* KEY DOWN */
-						dispthr_flagset_lock
-						    (DISP_FLAG_SCROLLDOWN);
-						break;
-
-					case 3:	/* KEY UP */
-						dispthr_flagset_lock
-						    (DISP_FLAG_SCROLLUP);
-						break;
-
-					case 13:	/* enter. */
-						dispthr_flagset_lock
-						    (DISP_FLAG_SCROLLENTER);
-						break;
-
-					default:
-						break;
-					}
-				}
-			}
-		}
+	if (curses_inited) {
+		reg_curses_fini();
 	}
 
-	reg_curses_fini();
-
-L_EXIT:
-	debug_print(NULL, 2, "cons thread is exiting\n");
+	debug_print(NULL, 2, "disp thread is exiting\n");
 	return (NULL);
 }
 
@@ -0,0 +1,646 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the dump file writer (-d). dump_write() appends to
+ * the front chunk, and at the end of every screen update (an epoch) the
+ * chunk is handed to the writer thread, which writes, compresses and
+ * rotates the file. When the writer is still busy with the previous
+ * epoch, the new one is dropped as a whole and counted, so that the
+ * display and perf threads never wait for the disk.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <limits.h>
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#define	DUMP_GZIP
+#include <zlib.h>
+#endif
+#if defined(HAVE_LIBZSTD) && defined(HAVE_ZSTD_H)
+#define	DUMP_ZSTD
+#include <zstd.h>
+#endif
+#include "include/types.h"
+#include "include/util.h"
+#include "include/stats.h"
+
+#define	DUMP_CHUNK_INIT		(64 * 1024)
+#define	DUMP_CHUNK_MAX		(64 * 1024 * 1024)
+#define	DUMP_ZBUF_SIZE		(64 * 1024)
+#define	DUMP_ROTATE_KEEP	4
+
+typedef struct _dump_chunk {
+	char *buf;
+	size_t len;
+	size_t cap;
+	boolean_t dropped;	/* rest of the epoch is discarded */
+} dump_chunk_t;
+
+typedef struct _dump_ctl {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thr;
+	boolean_t inited;
+	boolean_t quit;
+	FILE *fout;
+	const char *path;
+	dump_chunk_t chunks[2];
+	dump_chunk_t *front;		/* filled by dump_write() */
+	dump_chunk_t *back;		/* written by the writer thread */
+	boolean_t back_busy;
+	dump_chunk_t cache;		/* the cache mode lines */
+	boolean_t cache_mode;
+	uint64_t file_bytes;
+	uint64_t file_ms;
+#ifdef DUMP_GZIP
+	z_stream zs;
+#endif
+#ifdef DUMP_ZSTD
+	ZSTD_CCtx *zcctx;
+#endif
+	boolean_t zstarted;
+	char zbuf[DUMP_ZBUF_SIZE];
+} dump_ctl_t;
+
+static dump_ctl_t s_dump_ctl;
+static dump_compress_t s_dump_compress = DUMP_COMPRESS_NONE;
+static uint64_t s_rotate_bytes;
+static int s_rotate_secs;
+static int s_rotate_keep = DUMP_ROTATE_KEEP;
+
+/*
+ * Parse "size=N[KMG][,time=S][,keep=N]".
+ */
+int dump_rotate_parse(const char *spec)
+{
+	char buf[128], *token, *saveptr = NULL, *end;
+	double v;
+
+	if (spec == NULL || strlen(spec) >= sizeof(buf)) {
+		return (-1);
+	}
+
+	(void)strncpy(buf, spec, sizeof(buf));
+	for (token = strtok_r(buf, ",", &saveptr); token != NULL;
+	    token = strtok_r(NULL, ",", &saveptr)) {
+		if (strncasecmp(token, "size=", 5) == 0) {
+			v = strtod(token + 5, &end);
+			if (end == token + 5 || v <= 0.0) {
+				return (-1);
+			}
+			switch (*end) {
+			case 'g':
+			case 'G':
+				v *= 1024.0;
+				/* FALLTHROUGH */
+			case 'm':
+			case 'M':
+				v *= 1024.0;
+				/* FALLTHROUGH */
+			case 'k':
+			case 'K':
+				v *= 1024.0;
+				end++;
+				break;
+			case 0:
+				break;
+			default:
+				return (-1);
+			}
+			if (*end != 0) {
+				return (-1);
+			}
+			s_rotate_bytes = (uint64_t)v;
+		} else if (strncasecmp(token, "time=", 5) == 0) {
+			v = strtod(token + 5, &end);
+			if (end == token + 5 || *end != 0 || v < 1.0 ||
+			    v > INT_MAX) {
+				return (-1);
+			}
+			s_rotate_secs = (int)v;
+		} else if (strncasecmp(token, "keep=", 5) == 0) {
+			v = strtod(token + 5, &end);
+			if (end == token + 5 || *end != 0 || v < 1.0 ||
+			    v > 99) {
+				return (-1);
+			}
+			s_rotate_keep = (int)v;
+		} else {
+			return (-1);
+		}
+	}
+
+	return ((s_rotate_bytes > 0 || s_rotate_secs > 0) ? 0 : -1);
+}
+
+/*
+ * "gzip" or "zstd", when this build has the library. -1 if unknown,
+ * -2 if not available.
+ */
+int dump_compress_parse(const char *name)
+{
+	if (strcasecmp(name, "none") == 0) {
+		s_dump_compress = DUMP_COMPRESS_NONE;
+	} else if (strcasecmp(name, "gzip") == 0) {
+#ifdef DUMP_GZIP
+		s_dump_compress = DUMP_COMPRESS_GZIP;
+#else
+		return (-2);
+#endif
+	} else if (strcasecmp(name, "zstd") == 0) {
+#ifdef DUMP_ZSTD
+		s_dump_compress = DUMP_COMPRESS_ZSTD;
+#else
+		return (-2);
+#endif
+	} else {
+		return (-1);
+	}
+
+	return (0);
+}
+
+static int write_full(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = write(fd, buf, len)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return (-1);
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return (0);
+}
+
+static int file_write(dump_ctl_t *ctl, const char *buf, size_t len)
+{
+	if (write_full(fileno(ctl->fout), buf, len) != 0) {
+		return (-1);
+	}
+
+	ctl->file_bytes += len;
+	return (0);
+}
+
+/*
+ * Compress 'buf' into the file. 'last' ends the stream (on rotation
+ * and exit), otherwise the output is flushed so that the file can be
+ * followed.
+ */
+static int zwrite(dump_ctl_t *ctl, const char *buf, size_t len,
+		boolean_t last __attribute__ ((unused)))
+{
+#ifdef DUMP_GZIP
+	z_stream *zs = &ctl->zs;
+	int ret;
+#endif
+#ifdef DUMP_ZSTD
+	ZSTD_inBuffer in = { buf, len, 0 };
+	ZSTD_outBuffer out;
+	size_t remaining;
+#endif
+
+	switch (s_dump_compress) {
+#ifdef DUMP_GZIP
+	case DUMP_COMPRESS_GZIP:
+		if (!ctl->zstarted) {
+			(void)memset(zs, 0, sizeof(z_stream));
+			if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			    15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+				return (-1);
+			}
+			ctl->zstarted = B_TRUE;
+		}
+
+		zs->next_in = (Bytef *)buf;
+		zs->avail_in = len;
+		do {
+			zs->next_out = (Bytef *)ctl->zbuf;
+			zs->avail_out = DUMP_ZBUF_SIZE;
+			ret = deflate(zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+			if (ret == Z_STREAM_ERROR ||
+			    file_write(ctl, ctl->zbuf,
+			    DUMP_ZBUF_SIZE - zs->avail_out) != 0) {
+				return (-1);
+			}
+		} while (zs->avail_out == 0 || (last && ret != Z_STREAM_END));
+
+		if (last) {
+			(void)deflateEnd(zs);
+			ctl->zstarted = B_FALSE;
+		}
+		return (0);
+#endif
+
+#ifdef DUMP_ZSTD
+	case DUMP_COMPRESS_ZSTD:
+		if (ctl->zcctx == NULL &&
+		    (ctl->zcctx = ZSTD_createCCtx()) == NULL) {
+			return (-1);
+		}
+		ctl->zstarted = B_TRUE;
+
+		do {
+			out.dst = ctl->zbuf;
+			out.size = DUMP_ZBUF_SIZE;
+			out.pos = 0;
+			remaining = ZSTD_compressStream2(ctl->zcctx, &out, &in,
+			    last ? ZSTD_e_end : ZSTD_e_flush);
+			if (ZSTD_isError(remaining) ||
+			    file_write(ctl, ctl->zbuf, out.pos) != 0) {
+				return (-1);
+			}
+		} while (remaining != 0);
+
+		if (last) {
+			ctl->zstarted = B_FALSE;
+		}
+		return (0);
+#endif
+
+	default:
+		if (len == 0) {
+			return (0);
+		}
+		return (file_write(ctl, buf, len));
+	}
+}
+
+/*
+ * path -> path.1 -> ... -> path.<keep>, then start a new file.
+ */
+static void dump_rotate(dump_ctl_t *ctl)
+{
+	char from[PATH_MAX], to[PATH_MAX];
+	FILE *fout;
+	int i;
+
+	if (ctl->zstarted) {
+		(void)zwrite(ctl, NULL, 0, B_TRUE);
+	}
+
+	for (i = s_rotate_keep - 1; i > 0; i--) {
+		(void)snprintf(from, sizeof(from), "%s.%d", ctl->path, i);
+		(void)snprintf(to, sizeof(to), "%s.%d", ctl->path, i + 1);
+		(void)rename(from, to);
+	}
+
+	(void)snprintf(to, sizeof(to), "%s.1", ctl->path);
+	(void)rename(ctl->path, to);
+
+	if ((fout = fopen(ctl->path, "w")) == NULL) {
+		debug_print(NULL, 2, "dump: cannot open %s\n", ctl->path);
+		return;
+	}
+
+	(void)fclose(ctl->fout);
+	ctl->fout = fout;
+	ctl->file_bytes = 0;
+	ctl->file_ms = current_ms(&g_tvbase);
+}
+
+static void dump_out(dump_ctl_t *ctl, dump_chunk_t *chunk)
+{
+	if (chunk->len == 0) {
+		return;
+	}
+
+	if (zwrite(ctl, chunk->buf, chunk->len, B_FALSE) != 0) {
+		debug_print(NULL, 2, "dump: write failed\n");
+	}
+
+	if (ctl->path == NULL) {
+		return;
+	}
+
+	if ((s_rotate_bytes > 0 && ctl->file_bytes >= s_rotate_bytes) ||
+	    (s_rotate_secs > 0 && current_ms(&g_tvbase) - ctl->file_ms >=
+	    (uint64_t)s_rotate_secs * MS_SEC)) {
+		dump_rotate(ctl);
+	}
+}
+
+/* ARGSUSED */
+static void *dump_handler(void *arg __attribute__ ((unused)))
+{
+	dump_ctl_t *ctl = &s_dump_ctl;
+
+	(void)pthread_mutex_lock(&ctl->mutex);
+	for (;;) {
+		while (!ctl->back_busy && !ctl->quit) {
+			(void)pthread_cond_wait(&ctl->cond, &ctl->mutex);
+		}
+
+		if (!ctl->back_busy) {
+			break;
+		}
+
+		(void)pthread_mutex_unlock(&ctl->mutex);
+		dump_out(ctl, ctl->back);
+		(void)pthread_mutex_lock(&ctl->mutex);
+
+		ctl->back->len = 0;
+		ctl->back_busy = B_FALSE;
+	}
+	(void)pthread_mutex_unlock(&ctl->mutex);
+
+	return (NULL);
+}
+
+/*
+ * Initialization for dump control structure. 'path' is the name of
+ * 'dump_file', it's needed for the rotation.
+ */
+int dump_init(FILE *dump_file, const char *path)
+{
+	dump_ctl_t *ctl = &s_dump_ctl;
+
+	(void)memset(ctl, 0, sizeof(dump_ctl_t));
+	if ((ctl->fout = dump_file) == NULL) {
+		return (0);
+	}
+
+	ctl->path = path;
+	ctl->file_ms = current_ms(&g_tvbase);
+	ctl->front = &ctl->chunks[0];
+	ctl->back = &ctl->chunks[1];
+
+	if (pthread_mutex_init(&ctl->mutex, NULL) != 0) {
+		return (-1);
+	}
+
+	if (pthread_cond_init(&ctl->cond, NULL) != 0) {
+		(void)pthread_mutex_destroy(&ctl->mutex);
+		return (-1);
+	}
+
+	if (pthread_create(&ctl->thr, NULL, dump_handler, NULL) != 0) {
+		(void)pthread_cond_destroy(&ctl->cond);
+		(void)pthread_mutex_destroy(&ctl->mutex);
+		return (-1);
+	}
+
+	ctl->inited = B_TRUE;
+	return (0);
+}
+
+/*
+ * Stop the writer thread, then write what is left synchronously.
+ */
+void dump_fini(void)
+{
+	dump_ctl_t *ctl = &s_dump_ctl;
+	int i;
+
+	if (ctl->inited) {
+		(void)pthread_mutex_lock(&ctl->mutex);
+		ctl->quit = B_TRUE;
+		(void)pthread_cond_signal(&ctl->cond);
+		(void)pthread_mutex_unlock(&ctl->mutex);
+		(void)pthread_join(ctl->thr, NULL);
+
+		dump_out(ctl, ctl->front);
+		dump_out(ctl, &ctl->cache);
+		if (ctl->zstarted) {
+			(void)zwrite(ctl, NULL, 0, B_TRUE);
+		}
+
+		(void)pthread_cond_destroy(&ctl->cond);
+		(void)pthread_mutex_destroy(&ctl->mutex);
+		ctl->inited = B_FALSE;
+	}
+
+#ifdef DUMP_ZSTD
+	if (ctl->zcctx != NULL) {
+		(void)ZSTD_freeCCtx(ctl->zcctx);
+	}
+#endif
+
+	if (ctl->fout != NULL) {
+		(void)fclose(ctl->fout);
+	}
+
+	for (i = 0; i < 2; i++) {
+		free(ctl->chunks[i].buf);
+	}
+
+	free(ctl->cache.buf);
+	(void)memset(ctl, 0, sizeof(dump_ctl_t));
+}
+
+/*
+ * Append to the chunk, growing it as needed. The content of an epoch
+ * which would exceed DUMP_CHUNK_MAX is dropped.
+ */
+static void chunk_vprintf(dump_chunk_t *chunk, const char *fmt, va_list ap)
+{
+	va_list aq;
+	size_t cap;
+	char *buf;
+	int n;
+
+	if (chunk->dropped) {
+		return;
+	}
+
+	for (;;) {
+		va_copy(aq, ap);
+		n = vsnprintf(chunk->buf + chunk->len, chunk->cap - chunk->len,
+		    fmt, aq);
+		va_end(aq);
+		if (n < 0) {
+			return;
+		}
+
+		if (chunk->len + n < chunk->cap) {
+			chunk->len += n;
+			return;
+		}
+
+		cap = (chunk->cap == 0) ? DUMP_CHUNK_INIT : chunk->cap * 2;
+		while (cap <= chunk->len + n) {
+			cap *= 2;
+		}
+
+		if (cap > DUMP_CHUNK_MAX ||
+		    (buf = realloc(chunk->buf, cap)) == NULL) {
+			chunk->len = 0;
+			chunk->dropped = B_TRUE;
+			stats_count_add(STATS_COUNT_DUMP_DROP, 1);
+			return;
+		}
+
+		chunk->buf = buf;
+		chunk->cap = cap;
+	}
+}
+
+static void chunk_append(dump_chunk_t *dst, dump_chunk_t *src)
+{
+	size_t cap;
+	char *buf;
+
+	/*
+	 * A dropped source leaves a hole in the destination's epoch, and
+	 * nothing is appended to a destination which is already dropped.
+	 */
+	if (src->dropped || dst->dropped) {
+		if (!dst->dropped) {
+			dst->len = 0;
+			dst->dropped = B_TRUE;
+		}
+		src->len = 0;
+		src->dropped = B_FALSE;
+		return;
+	}
+
+	if (src->len == 0) {
+		return;
+	}
+
+	if (dst->len + src->len >= dst->cap) {
+		cap = (dst->cap == 0) ? DUMP_CHUNK_INIT : dst->cap;
+		while (cap <= dst->len + src->len) {
+			cap *= 2;
+		}
+
+		if (cap > DUMP_CHUNK_MAX ||
+		    (buf = realloc(dst->buf, cap)) == NULL) {
+			dst->len = 0;
+			dst->dropped = B_TRUE;
+			src->len = 0;
+			stats_count_add(STATS_COUNT_DUMP_DROP, 1);
+			return;
+		}
+
+		dst->buf = buf;
+		dst->cap = cap;
+	}
+
+	(void)memcpy(dst->buf + dst->len, src->buf, src->len);
+	dst->len += src->len;
+	dst->buf[dst->len] = 0;
+	src->len = 0;
+}
+
+/*
+ * Write the message into dump file.
+ */
+void dump_write(const char *fmt, ...)
+{
+	dump_ctl_t *ctl = &s_dump_ctl;
+	va_list ap;
+
+	if (!ctl->inited) {
+		return;
+	}
+
+	(void)pthread_mutex_lock(&ctl->mutex);
+	va_start(ap, fmt);
+	chunk_vprintf(ctl->cache_mode ? &ctl->cache : ctl->front, fmt, ap);
+	va_end(ap);
+	(void)pthread_mutex_unlock(&ctl->mutex);
+}
+
+/*
+ * The end of a screen update: hand the front chunk to the writer, or
+ * drop it if the writer has not finished the previous one yet.
+ */
+void dump_epoch_end(void)
+{
+	dump_ctl_t *ctl = &s_dump_ctl;
+	dump_chunk_t *chunk;
+
+	if (!ctl->inited) {
+		return;
+	}
+
+	(void)pthread_mutex_lock(&ctl->mutex);
+	if (ctl->front->dropped) {
+		/* Already counted when the epoch was dropped. */
+		ctl->front->len = 0;
+		ctl->front->dropped = B_FALSE;
+	} else if (ctl->front->len > 0) {
+		if (ctl->back_busy) {
+			ctl->front->len = 0;
+			stats_count_add(STATS_COUNT_DUMP_DROP, 1);
+		} else {
+			chunk = ctl->back;
+			ctl->back = ctl->front;
+			ctl->front = chunk;
+			ctl->back_busy = B_TRUE;
+			(void)pthread_cond_signal(&ctl->cond);
+		}
+	}
+	(void)pthread_mutex_unlock(&ctl->mutex);
+}
+
+void dump_cache_enable(void)
+{
+	s_dump_ctl.cache_mode = B_TRUE;
+}
+
+void dump_cache_disable(void)
+{
+	s_dump_ctl.cache_mode = B_FALSE;
+}
+
+/*
+ * Append the cached lines after what was written since.
+ */
+void dump_cache_flush(void)
+{
+	dump_ctl_t *ctl = &s_dump_ctl;
+
+	if (!ctl->inited) {
+		return;
+	}
+
+	(void)pthread_mutex_lock(&ctl->mutex);
+	chunk_append(ctl->front, &ctl->cache);
+	ctl->cache_mode = B_FALSE;
+	(void)pthread_mutex_unlock(&ctl->mutex);
+}
@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the structured output of the batch mode: text,
+ * JSON lines, CSV and a binary columnar frame per epoch. Each epoch is
+ * serialized from the aggregation tables into one buffer (or a few
+ * column arrays) and handed to a single writev().
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/emit.h"
+
+#define	EMIT_TEXT_INIT		(64 * 1024)
+#define	EMIT_ARR_INIT		256
+
+static emit_fmt_t s_emit_fmt = EMIT_FMT_TEXT;
+
+static const char *s_col_name[EMIT_COL_NUM] = {
+	"start", "end", "access", "age", "local", "remote"
+};
+
+int emit_format_parse(const char *name)
+{
+	if (strcasecmp(name, "text") == 0) {
+		s_emit_fmt = EMIT_FMT_TEXT;
+	} else if (strcasecmp(name, "jsonl") == 0) {
+		s_emit_fmt = EMIT_FMT_JSONL;
+	} else if (strcasecmp(name, "csv") == 0) {
+		s_emit_fmt = EMIT_FMT_CSV;
+	} else if (strcasecmp(name, "bin") == 0) {
+		s_emit_fmt = EMIT_FMT_BIN;
+	} else {
+		return (-1);
+	}
+
+	return (0);
+}
+
+emit_fmt_t emit_format(void)
+{
+	return (s_emit_fmt);
+}
+
+void emit_epoch_init(emit_epoch_t *ep)
+{
+	(void)memset(ep, 0, sizeof(emit_epoch_t));
+}
+
+void emit_epoch_fini(emit_epoch_t *ep)
+{
+	int i;
+
+	free(ep->procs);
+	for (i = 0; i < EMIT_COL_NUM; i++) {
+		free(ep->cols[i]);
+	}
+
+	free(ep->text);
+	(void)memset(ep, 0, sizeof(emit_epoch_t));
+}
+
+void emit_epoch_begin(emit_epoch_t *ep, uint32_t seq, uint64_t ms)
+{
+	ep->seq = seq;
+	ep->ms = ms;
+	ep->nprocs = 0;
+	ep->nregions = 0;
+	ep->text_len = 0;
+}
+
+int emit_proc_add(emit_epoch_t *ep, pid_t pid, const char *name,
+		uint64_t nr_regions)
+{
+	emit_bin_proc_t *procs, *p;
+	int cap;
+
+	if (ep->nprocs == ep->procs_cap) {
+		cap = (ep->procs_cap == 0) ? EMIT_ARR_INIT : ep->procs_cap * 2;
+		if ((procs = realloc(ep->procs,
+		    cap * sizeof(emit_bin_proc_t))) == NULL) {
+			return (-1);
+		}
+		ep->procs = procs;
+		ep->procs_cap = cap;
+	}
+
+	p = &ep->procs[ep->nprocs++];
+	(void)memset(p, 0, sizeof(emit_bin_proc_t));
+	p->pid = pid;
+	p->nr_regions = (uint32_t)nr_regions;
+	p->first = ep->nregions;
+	(void)strncpy(p->name, name, EMIT_NAME_SIZE - 1);
+	return (0);
+}
+
+/*
+ * Add a region to the last process.
+ */
+int emit_region_add(emit_epoch_t *ep, count_value_t *cv)
+{
+	uint64_t *col;
+	int cap, i;
+
+	if (ep->nprocs == 0) {
+		return (-1);
+	}
+
+	if (ep->nregions == ep->regions_cap) {
+		cap = (ep->regions_cap == 0) ?
+		    EMIT_ARR_INIT : ep->regions_cap * 2;
+		for (i = 0; i < EMIT_COL_NUM; i++) {
+			if ((col = realloc(ep->cols[i],
+			    cap * sizeof(uint64_t))) == NULL) {
+				return (-1);
+			}
+			ep->cols[i] = col;
+		}
+		ep->regions_cap = cap;
+	}
+
+	i = ep->nregions++;
+	ep->cols[EMIT_COL_START][i] = cv->counts[PERF_COUNT_DAMON_START];
+	ep->cols[EMIT_COL_END][i] = cv->counts[PERF_COUNT_DAMON_END];
+	ep->cols[EMIT_COL_ACCESS][i] = cv->counts[PERF_COUNT_DAMON_NR_ACCESS];
+	ep->cols[EMIT_COL_AGE][i] = cv->counts[PERF_COUNT_DAMON_AGE];
+	ep->cols[EMIT_COL_LOCAL][i] = cv->counts[PERF_COUNT_DAMON_LOCAL];
+	ep->cols[EMIT_COL_REMOTE][i] = cv->counts[PERF_COUNT_DAMON_REMOTE];
+	ep->procs[ep->nprocs - 1].count++;
+	return (0);
+}
+
+/*
+ * Append to the text buffer, growing it as needed.
+ */
+static int text_printf(emit_epoch_t *ep, const char *fmt, ...)
+{
+	va_list ap;
+	size_t cap;
+	char *text;
+	int n;
+
+	for (;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(ep->text + ep->text_len,
+		    ep->text_cap - ep->text_len, fmt, ap);
+		va_end(ap);
+		if (n < 0) {
+			return (-1);
+		}
+
+		if (ep->text_len + n < ep->text_cap) {
+			ep->text_len += n;
+			return (0);
+		}
+
+		cap = (ep->text_cap == 0) ? EMIT_TEXT_INIT : ep->text_cap * 2;
+		while (cap <= ep->text_len + n) {
+			cap *= 2;
+		}
+
+		if ((text = realloc(ep->text, cap)) == NULL) {
+			return (-1);
+		}
+		ep->text = text;
+		ep->text_cap = cap;
+	}
+}
+
+/*
+ * The process name as a JSON string, without the quotes.
+ */
+static void json_name(const char *name, char *buf, int size)
+{
+	int i, j = 0;
+
+	for (i = 0; name[i] != 0 && j < size - 7; i++) {
+		if (name[i] == '"' || name[i] == '\\') {
+			buf[j++] = '\\';
+			buf[j++] = name[i];
+		} else if ((unsigned char)name[i] < 0x20) {
+			j += snprintf(buf + j, size - j, "\\u%04x",
+			    (unsigned char)name[i]);
+		} else {
+			buf[j++] = name[i];
+		}
+	}
+
+	buf[j] = 0;
+}
+
+/*
+ * The process name as a CSV field, quoted if needed.
+ */
+static void csv_name(const char *name, char *buf, int size)
+{
+	int i, j = 0;
+
+	if (strpbrk(name, ",\"\n") == NULL) {
+		(void)snprintf(buf, size, "%s", name);
+		return;
+	}
+
+	buf[j++] = '"';
+	for (i = 0; name[i] != 0 && j < size - 3; i++) {
+		if (name[i] == '"') {
+			buf[j++] = '"';
+		}
+		buf[j++] = name[i];
+	}
+
+	buf[j++] = '"';
+	buf[j] = 0;
+}
+
+static int text_build(emit_epoch_t *ep)
+{
+	emit_bin_proc_t *p;
+	uint64_t **c = ep->cols;
+	char name[EMIT_NAME_SIZE * 6 + 1];
+	int i, j, ret = 0;
+
+	ep->text_len = 0;
+	if (s_emit_fmt == EMIT_FMT_TEXT) {
+		ret |= text_printf(ep, "interval %u %" PRIu64 " %d\n",
+		    ep->seq, ep->ms, ep->nprocs);
+	} else if (s_emit_fmt == EMIT_FMT_JSONL) {
+		ret |= text_printf(ep, "{\"seq\":%u,\"ms\":%" PRIu64
+		    ",\"procs\":[", ep->seq, ep->ms);
+	}
+
+	for (i = 0; i < ep->nprocs; i++) {
+		p = &ep->procs[i];
+		switch (s_emit_fmt) {
+		case EMIT_FMT_TEXT:
+			ret |= text_printf(ep, "proc %d %u %u %s\n", p->pid,
+			    p->nr_regions, p->count, p->name);
+			break;
+
+		case EMIT_FMT_JSONL:
+			json_name(p->name, name, sizeof(name));
+			ret |= text_printf(ep, "%s{\"pid\":%d,\"name\":\"%s\","
+			    "\"nr_regions\":%u,\"regions\":[",
+			    (i > 0) ? "," : "", p->pid, name, p->nr_regions);
+			break;
+
+		case EMIT_FMT_CSV:
+			csv_name(p->name, name, sizeof(name));
+			break;
+
+		default:
+			break;
+		}
+
+		for (j = p->first; j < (int)(p->first + p->count); j++) {
+			switch (s_emit_fmt) {
+			case EMIT_FMT_TEXT:
+				ret |= text_printf(ep, "region %d 0x%" PRIx64
+				    " 0x%" PRIx64 " %" PRIu64 " %" PRIu64
+				    " %" PRIu64 " %" PRIu64 "\n", p->pid,
+				    c[0][j], c[1][j], c[2][j], c[3][j],
+				    c[4][j], c[5][j]);
+				break;
+
+			case EMIT_FMT_JSONL:
+				ret |= text_printf(ep, "%s[%" PRIu64 ",%" PRIu64
+				    ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+				    ",%" PRIu64 "]", (j > (int)p->first) ?
+				    "," : "", c[0][j], c[1][j], c[2][j],
+				    c[3][j], c[4][j], c[5][j]);
+				break;
+
+			case EMIT_FMT_CSV:
+				ret |= text_printf(ep, "%u,%" PRIu64 ",%d,%s,%u,"
+				    "%" PRIu64 ",%" PRIu64 ",%" PRIu64
+				    ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+				    ep->seq, ep->ms, p->pid, name,
+				    p->nr_regions, c[0][j], c[1][j], c[2][j],
+				    c[3][j], c[4][j], c[5][j]);
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		if (s_emit_fmt == EMIT_FMT_JSONL) {
+			ret |= text_printf(ep, "]}");
+		}
+	}
+
+	if (s_emit_fmt == EMIT_FMT_JSONL) {
+		ret |= text_printf(ep, "]}\n");
+	}
+
+	return (ret);
+}
+
+/*
+ * writev() until everything is written.
+ */
+static int writev_full(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t n;
+
+	while (iovcnt > 0) {
+		if ((n = writev(fd, iov, iovcnt)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return (-1);
+		}
+
+		while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * The lines written once before the first epoch: a comment for the
+ * text format and the column names for CSV.
+ */
+int emit_header_write(int fd, emit_epoch_t *ep, const char *comment)
+{
+	struct iovec iov;
+	int ret = 0;
+
+	ep->text_len = 0;
+	if (s_emit_fmt == EMIT_FMT_TEXT) {
+		ret = text_printf(ep, "# %s\n", comment);
+	} else if (s_emit_fmt == EMIT_FMT_CSV) {
+		ret = text_printf(ep, "seq,ms,pid,name,nr_regions,%s,%s,%s,%s,"
+		    "%s,%s\n", s_col_name[0], s_col_name[1], s_col_name[2],
+		    s_col_name[3], s_col_name[4], s_col_name[5]);
+	}
+
+	if (ret != 0 || ep->text_len == 0) {
+		return (ret);
+	}
+
+	iov.iov_base = ep->text;
+	iov.iov_len = ep->text_len;
+	return (writev_full(fd, &iov, 1));
+}
+
+int emit_epoch_write(int fd, emit_epoch_t *ep)
+{
+	struct iovec iov[2 + EMIT_COL_NUM];
+	emit_bin_hdr_t hdr;
+	size_t cols_size = (size_t)ep->nregions * sizeof(uint64_t);
+	int i, n = 0;
+
+	if (s_emit_fmt != EMIT_FMT_BIN) {
+		if (text_build(ep) != 0) {
+			return (-1);
+		}
+
+		iov[n].iov_base = ep->text;
+		iov[n++].iov_len = ep->text_len;
+		return (writev_full(fd, iov, n));
+	}
+
+	(void)memset(&hdr, 0, sizeof(hdr));
+	hdr.len = sizeof(hdr) + ep->nprocs * sizeof(emit_bin_proc_t) +
+	    EMIT_COL_NUM * cols_size;
+	hdr.magic = EMIT_BIN_MAGIC;
+	hdr.version = EMIT_BIN_VERSION;
+	hdr.ncols = EMIT_COL_NUM;
+	hdr.seq = ep->seq;
+	hdr.ms = ep->ms;
+	hdr.nprocs = ep->nprocs;
+	hdr.nregions = ep->nregions;
+
+	iov[n].iov_base = &hdr;
+	iov[n++].iov_len = sizeof(hdr);
+	if (ep->nprocs > 0) {
+		iov[n].iov_base = ep->procs;
+		iov[n++].iov_len = ep->nprocs * sizeof(emit_bin_proc_t);
+	}
+
+	for (i = 0; i < EMIT_COL_NUM && cols_size > 0; i++) {
+		iov[n].iov_base = ep->cols[i];
+		iov[n++].iov_len = cols_size;
+	}
+
+	return (writev_full(fd, iov, n));
+}
@@ -0,0 +1,974 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * This file contains the page idle engine, the fallback for the kernels
+ * built without DAMON. A thread runs the loop of a kdamond over the
+ * target processes: one page of each region is sampled, its pfn is
+ * found in /proc/<pid>/pagemap and its bit is set in the page_idle
+ * bitmap, and a bit cleared by the next check means the page was
+ * accessed. The regions are merged, aged and split like DAMON does and
+ * the aggregations are handed out as the region snapshots of sysfs, so
+ * the rest of datop doesn't see the difference.
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/damon.h"
+#include "include/damon_sysfs.h"
+#include "include/stats.h"
+#include "include/idle.h"
+
+#define	IDLE_DIFF(a, b)	(((a) > (b)) ? ((a) - (b)) : ((b) - (a)))
+
+static idle_engine_t s_idle = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.bitmap_fd = -1,
+	.sample_us = DAMON_DEF_SAMPLE_US,
+	.aggr_us = DAMON_DEF_AGGR_US,
+	.update_us = DAMON_DEF_UPDATE_US,
+	.min_regions = DAMON_DEF_MIN_REGIONS,
+	.max_regions = DAMON_DEF_MAX_REGIONS
+};
+
+/*
+ * A random number in [0, n).
+ */
+static uint64_t idle_rand(uint64_t n)
+{
+	uint64_t v;
+
+	if (n == 0) {
+		return (0);
+	}
+
+	v = ((uint64_t)rand_r(&s_idle.seed) << 31) ^ rand_r(&s_idle.seed);
+	return (v % n);
+}
+
+static int pid_cmp(const void *a, const void *b)
+{
+	const pid_t *pid1 = (const pid_t *)a;
+	const pid_t *pid2 = (const pid_t *)b;
+
+	return ((*pid1 > *pid2) - (*pid1 < *pid2));
+}
+
+static uint64_t idle_region_size(const idle_region_t *r)
+{
+	return (r->end - r->start);
+}
+
+static int idle_total_regions(void)
+{
+	int i, n = 0;
+
+	for (i = 0; i < s_idle.ntargets; i++) {
+		n += s_idle.targets[i].nregions;
+	}
+
+	return (n);
+}
+
+/*
+ * The "three regions" of DAMON: the mappings of 'pid' without the two
+ * biggest gaps between them, which are usually the ones below the
+ * stack and after the heap. Return the number of ranges saved in
+ * 'ranges' (1 if there are not enough gaps), 0 if nothing is mapped.
+ */
+static int idle_three_regions(pid_t pid, damon_sysfs_range_t *ranges)
+{
+	char path[PATH_MAX];
+	damon_sysfs_range_t gaps[2], tmp;
+	uint64_t start, end, first = 0, prev = 0;
+	int nvmas = 0;
+	FILE *fp;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+	if ((fp = fopen(path, "r")) == NULL) {
+		return (0);
+	}
+
+	(void)memset(gaps, 0, sizeof(gaps));
+	while (fscanf(fp, "%" SCNx64 "-%" SCNx64 "%*[^\n]",
+		      &start, &end) == 2) {
+		/* [vsyscall] is in the kernel half. */
+		if (start >= (1ULL << 63) || end <= start) {
+			continue;
+		}
+
+		if (nvmas == 0) {
+			first = start;
+		} else if (start > prev) {
+			tmp.start = prev;
+			tmp.end = start;
+			if (tmp.end - tmp.start > gaps[0].end - gaps[0].start) {
+				gaps[1] = gaps[0];
+				gaps[0] = tmp;
+			} else if (tmp.end - tmp.start >
+				   gaps[1].end - gaps[1].start) {
+				gaps[1] = tmp;
+			}
+		}
+
+		prev = end;
+		nvmas++;
+	}
+
+	(void)fclose(fp);
+	if (nvmas == 0) {
+		return (0);
+	}
+
+	if (gaps[1].end == 0) {
+		ranges[0].start = first;
+		ranges[0].end = prev;
+		return (1);
+	}
+
+	if (gaps[0].start > gaps[1].start) {
+		tmp = gaps[0];
+		gaps[0] = gaps[1];
+		gaps[1] = tmp;
+	}
+
+	ranges[0].start = first;
+	ranges[0].end = gaps[0].start;
+	ranges[1].start = gaps[0].end;
+	ranges[1].end = gaps[1].start;
+	ranges[2].start = gaps[1].end;
+	ranges[2].end = prev;
+	return (3);
+}
+
+/*
+ * Fit the regions of 't' to 'ranges' the way DAMON applies the three
+ * regions: the regions out of the ranges are dropped, the ones across
+ * an edge are cut at it, the first and the last regions in a range are
+ * stretched to its edges and a range without any region gets a new one.
+ */
+static int idle_regions_apply(idle_target_t *t,
+		const damon_sysfs_range_t *ranges, int n)
+{
+	idle_region_t *arr, *r;
+	int i, j, k = 0, first, size;
+
+	size = (t->nregions + 1) * n;
+	if ((arr = zalloc(sizeof(idle_region_t) * size)) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < n; i++) {
+		first = k;
+		for (j = 0; j < t->nregions; j++) {
+			r = &t->regions[j];
+			if (r->end <= ranges[i].start ||
+			    r->start >= ranges[i].end) {
+				continue;
+			}
+
+			arr[k] = *r;
+			arr[k].start = MAX(r->start, ranges[i].start);
+			arr[k].end = MIN(r->end, ranges[i].end);
+			k++;
+		}
+
+		if (k == first) {
+			arr[k].start = ranges[i].start;
+			arr[k].end = ranges[i].end;
+			k++;
+		} else {
+			arr[first].start = ranges[i].start;
+			arr[k - 1].end = ranges[i].end;
+		}
+	}
+
+	free(t->regions);
+	t->regions = arr;
+	t->nregions = k;
+	t->size = size;
+	return (0);
+}
+
+/*
+ * Cut the regions of 't' evenly, so the target starts with at least
+ * 'min_regions' regions.
+ */
+static int idle_regions_even(idle_target_t *t)
+{
+	idle_region_t *arr, *r;
+	uint64_t total = 0, piece, start;
+	int i, k = 0, size = 0;
+
+	for (i = 0; i < t->nregions; i++) {
+		total += idle_region_size(&t->regions[i]);
+	}
+
+	piece = total / s_idle.min_regions / s_idle.pgsize * s_idle.pgsize;
+	piece = MAX(piece, (uint64_t)s_idle.pgsize);
+	for (i = 0; i < t->nregions; i++) {
+		size += (int)((idle_region_size(&t->regions[i]) +
+			       piece - 1) / piece);
+	}
+
+	if ((arr = zalloc(sizeof(idle_region_t) * MAX(size, 1))) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < t->nregions; i++) {
+		r = &t->regions[i];
+		for (start = r->start; start < r->end; start += piece) {
+			arr[k].start = start;
+			arr[k].end = MIN(start + piece, r->end);
+			k++;
+		}
+	}
+
+	free(t->regions);
+	t->regions = arr;
+	t->nregions = k;
+	t->size = MAX(size, 1);
+	return (0);
+}
+
+/*
+ * Split each region of 't' into 'nsubs' pieces at random points, every
+ * piece keeps the counters of its region.
+ */
+static int idle_regions_split(idle_target_t *t, int nsubs)
+{
+	idle_region_t *arr, cur;
+	uint64_t sz, piece;
+	int i, j, k = 0, size;
+
+	size = MAX(t->nregions * nsubs, 1);
+	if ((arr = malloc(sizeof(idle_region_t) * size)) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < t->nregions; i++) {
+		cur = t->regions[i];
+		for (j = 1; j < nsubs; j++) {
+			/* Somewhere between 10% and 90% of the region. */
+			sz = idle_region_size(&cur);
+			piece = sz / 10 * (1 + idle_rand(9));
+			piece = piece / s_idle.pgsize * s_idle.pgsize;
+			if (piece == 0 || piece >= sz) {
+				break;
+			}
+
+			arr[k] = cur;
+			arr[k].end = cur.start + piece;
+			k++;
+			cur.start += piece;
+		}
+
+		arr[k++] = cur;
+	}
+
+	free(t->regions);
+	t->regions = arr;
+	t->nregions = k;
+	t->size = size;
+	return (0);
+}
+
+static uint32_t idle_wavg(uint32_t a, uint64_t sa, uint32_t b, uint64_t sb)
+{
+	return ((uint32_t)(((double)a * sa + (double)b * sb) / (sa + sb)));
+}
+
+/*
+ * Merge the adjacent regions of 't' which have similar access counts,
+ * as long as the merged region is not over 'sz_limit'.
+ */
+static void idle_regions_merge(idle_target_t *t, uint32_t thres,
+		uint64_t sz_limit)
+{
+	idle_region_t *p, *r;
+	uint64_t sp, sr;
+	int i, n = 0;
+
+	for (i = 0; i < t->nregions; i++) {
+		r = &t->regions[i];
+		if (n > 0) {
+			p = &t->regions[n - 1];
+			sp = idle_region_size(p);
+			sr = idle_region_size(r);
+			if (p->end == r->start &&
+			    IDLE_DIFF(p->nr_accesses, r->nr_accesses) <= thres &&
+			    sp + sr <= sz_limit) {
+				p->nr_accesses = idle_wavg(p->nr_accesses, sp,
+							   r->nr_accesses, sr);
+				p->age = idle_wavg(p->age, sp, r->age, sr);
+				p->end = r->end;
+				continue;
+			}
+		}
+
+		if (n != i) {
+			t->regions[n] = *r;
+		}
+
+		n++;
+	}
+
+	t->nregions = n;
+}
+
+/*
+ * Save the regions of the aggregation to the snapshot, it's what the
+ * next idle_snapshot() gets.
+ */
+static void idle_publish(void)
+{
+	damon_sysfs_region_t *snap, *s;
+	idle_target_t *t;
+	int i, j, n = idle_total_regions();
+
+	if (n > s_idle.snap_size) {
+		if ((snap = realloc(s_idle.snap,
+				    sizeof(damon_sysfs_region_t) * n)) == NULL) {
+			return;
+		}
+
+		s_idle.snap = snap;
+		s_idle.snap_size = n;
+	}
+
+	n = 0;
+	for (i = 0; i < s_idle.ntargets; i++) {
+		t = &s_idle.targets[i];
+		for (j = 0; j < t->nregions; j++) {
+			s = &s_idle.snap[n++];
+			s->pid = t->pid;
+			s->start = t->regions[j].start;
+			s->end = t->regions[j].end;
+			s->nr_accesses = t->regions[j].nr_accesses;
+			s->age = t->regions[j].age;
+			s->nr_regions = t->nregions;
+		}
+	}
+
+	s_idle.nsnap = n;
+	s_idle.naggrs++;
+}
+
+/*
+ * The end of an aggregation interval: age, merge, publish, reset and
+ * split the regions, in the order of kdamond_merge_regions(),
+ * kdamond_reset_aggregated() and kdamond_split_regions().
+ */
+static void idle_aggregate(void)
+{
+	uint32_t max_access, thres;
+	uint64_t total = 0, sz_limit;
+	idle_target_t *t;
+	idle_region_t *r;
+	int i, j, nregions, nsubs = 2;
+
+	max_access = (uint32_t)MAX(s_idle.aggr_us / s_idle.sample_us, 1);
+	thres = MAX(max_access / 10, 1);
+	for (i = 0; i < s_idle.ntargets; i++) {
+		t = &s_idle.targets[i];
+		for (j = 0; j < t->nregions; j++) {
+			r = &t->regions[j];
+			if (IDLE_DIFF(r->nr_accesses,
+				      r->last_nr_accesses) > thres) {
+				r->age = 0;
+			} else {
+				r->age++;
+			}
+
+			total += idle_region_size(r);
+		}
+	}
+
+	sz_limit = MAX(total / s_idle.min_regions, (uint64_t)s_idle.pgsize);
+	do {
+		nregions = 0;
+		for (i = 0; i < s_idle.ntargets; i++) {
+			idle_regions_merge(&s_idle.targets[i], thres, sz_limit);
+			nregions += s_idle.targets[i].nregions;
+		}
+
+		thres *= 2;
+	} while ((uint64_t)nregions > s_idle.max_regions &&
+		 thres / 2 < max_access);
+
+	idle_publish();
+
+	for (i = 0; i < s_idle.ntargets; i++) {
+		t = &s_idle.targets[i];
+		for (j = 0; j < t->nregions; j++) {
+			t->regions[j].last_nr_accesses =
+			    t->regions[j].nr_accesses;
+			t->regions[j].nr_accesses = 0;
+		}
+	}
+
+	if ((uint64_t)nregions > s_idle.max_regions / 2) {
+		return;
+	}
+
+	/* Maybe the middle of the region is accessed differently. */
+	if (s_idle.last_nregions == nregions &&
+	    (uint64_t)nregions < s_idle.max_regions / 3) {
+		nsubs = 3;
+	}
+
+	for (i = 0; i < s_idle.ntargets; i++) {
+		(void)idle_regions_split(&s_idle.targets[i], nsubs);
+	}
+
+	s_idle.last_nregions = nregions;
+}
+
+/*
+ * Refit the regions to the current mappings of the targets.
+ */
+static void idle_update(void)
+{
+	damon_sysfs_range_t ranges[3];
+	int i, n;
+
+	for (i = 0; i < s_idle.ntargets; i++) {
+		if ((n = idle_three_regions(s_idle.targets[i].pid,
+					    ranges)) > 0) {
+			(void)idle_regions_apply(&s_idle.targets[i], ranges, n);
+		}
+	}
+}
+
+/*
+ * Read or write the bitmap words of the sampled pages. The samples are
+ * sorted by pfn, so the words nearby go in one run and a sampling step
+ * costs a few syscalls rather than one per page. A write only sets the
+ * bits of the samples, the bits of the other pages in a word are
+ * ignored by the kernel when they're 0.
+ */
+static void idle_bitmap_io(boolean_t set)
+{
+	idle_sample_t *s = s_idle.samples;
+	uint64_t first, last, w, *words = s_idle.words;
+	size_t len;
+	boolean_t ok;
+	int i = 0, j, k;
+
+	while (i < s_idle.nsamples) {
+		first = last = s[i].pfn / 64;
+		for (j = i + 1; j < s_idle.nsamples; j++) {
+			w = s[j].pfn / 64;
+			if (w - last > IDLE_RUN_GAP ||
+			    w - first >= IDLE_RUN_WORDS) {
+				break;
+			}
+
+			last = w;
+		}
+
+		len = sizeof(uint64_t) * (last - first + 1);
+		if (set) {
+			(void)memset(words, 0, len);
+			for (k = i; k < j; k++) {
+				words[s[k].pfn / 64 - first] |=
+				    1ULL << (s[k].pfn % 64);
+			}
+
+			ok = (pwrite(s_idle.bitmap_fd, words, len,
+				     (off_t)(first * sizeof(uint64_t))) ==
+			      (ssize_t)len);
+		} else {
+			ok = (pread(s_idle.bitmap_fd, words, len,
+				    (off_t)(first * sizeof(uint64_t))) ==
+			      (ssize_t)len);
+		}
+
+		/* After a write, 'idle' only tells if the bit was written. */
+		for (k = i; k < j; k++) {
+			s[k].idle = ok && (set ||
+			    ((words[s[k].pfn / 64 - first] >>
+			      (s[k].pfn % 64)) & 1));
+		}
+
+		i = j;
+	}
+}
+
+static int idle_sample_cmp(const void *a, const void *b)
+{
+	const idle_sample_t *s1 = (const idle_sample_t *)a;
+	const idle_sample_t *s2 = (const idle_sample_t *)b;
+
+	return ((s1->pfn > s2->pfn) - (s1->pfn < s2->pfn));
+}
+
+static int idle_sample_add(uint64_t pfn, idle_region_t *r)
+{
+	idle_sample_t *arr;
+	int size;
+
+	if (s_idle.nsamples == s_idle.samples_size) {
+		size = MAX(s_idle.samples_size * 2, 64);
+		if ((arr = realloc(s_idle.samples,
+				   sizeof(idle_sample_t) * size)) == NULL) {
+			return (-1);
+		}
+
+		s_idle.samples = arr;
+		s_idle.samples_size = size;
+	}
+
+	s_idle.samples[s_idle.nsamples].pfn = pfn;
+	s_idle.samples[s_idle.nsamples].region = r;
+	s_idle.samples[s_idle.nsamples].idle = B_FALSE;
+	s_idle.nsamples++;
+	return (0);
+}
+
+/*
+ * Pick a random page of each region and set its idle bit. A page not
+ * present can't be sampled in this step, nor can a page whose bit
+ * doesn't stick (it's not on the LRU lists).
+ */
+static void idle_prepare(void)
+{
+	idle_target_t *t;
+	idle_region_t *r;
+	uint64_t addr, ent, npages;
+	int i, j, n;
+
+	s_idle.nsamples = 0;
+	for (i = 0; i < s_idle.ntargets; i++) {
+		t = &s_idle.targets[i];
+		if (t->pagemap_fd < 0) {
+			continue;
+		}
+
+		for (j = 0; j < t->nregions; j++) {
+			r = &t->regions[j];
+			if ((npages = idle_region_size(r) / s_idle.pgsize) == 0) {
+				continue;
+			}
+
+			addr = r->start + idle_rand(npages) * s_idle.pgsize;
+			if (pread(t->pagemap_fd, &ent, sizeof(ent),
+				  (off_t)(addr / s_idle.pgsize * sizeof(ent))) !=
+			    sizeof(ent)) {
+				continue;
+			}
+
+			if (!(ent & IDLE_PM_PRESENT) ||
+			    (ent & IDLE_PM_PFN_MASK) == 0) {
+				continue;
+			}
+
+			if (idle_sample_add(ent & IDLE_PM_PFN_MASK, r) != 0) {
+				break;
+			}
+		}
+	}
+
+	qsort(s_idle.samples, s_idle.nsamples, sizeof(idle_sample_t),
+	      idle_sample_cmp);
+	idle_bitmap_io(B_TRUE);
+	idle_bitmap_io(B_FALSE);
+
+	for (i = 0, n = 0; i < s_idle.nsamples; i++) {
+		if (s_idle.samples[i].idle) {
+			s_idle.samples[n++] = s_idle.samples[i];
+		}
+	}
+
+	s_idle.nsamples = n;
+}
+
+/*
+ * The end of a sampling interval, a sampled page with its idle bit
+ * cleared was accessed.
+ */
+static void idle_check(void)
+{
+	int i;
+
+	idle_bitmap_io(B_FALSE);
+	for (i = 0; i < s_idle.nsamples; i++) {
+		if (!s_idle.samples[i].idle) {
+			s_idle.samples[i].region->nr_accesses++;
+		}
+	}
+
+	s_idle.nsamples = 0;
+}
+
+/*
+ * Sleep for a sampling interval, the mutex is released meanwhile.
+ * Return B_TRUE if the engine is asked to quit.
+ */
+static boolean_t idle_sleep(void)
+{
+	struct timespec ts;
+
+	stats_ts(stats_ns() + s_idle.sample_us * NS_USEC, &ts);
+	while (!s_idle.quit &&
+	       pthread_cond_timedwait(&s_idle.cond, &s_idle.mutex, &ts) == 0) {
+		;
+	}
+
+	return (s_idle.quit);
+}
+
+/*
+ * The handler of the engine thread, the loop of kdamond_fn().
+ */
+/* ARGSUSED */
+static void *idle_handler(void *arg __attribute__ ((unused)))
+{
+	uint64_t now, next_aggr, next_update;
+
+	s_idle.tid = (pid_t)syscall(SYS_gettid);
+	(void)pthread_mutex_lock(&s_idle.mutex);
+	now = stats_ns() / NS_USEC;
+	next_aggr = now + s_idle.aggr_us;
+	next_update = now + s_idle.update_us;
+	idle_prepare();
+
+	while (!idle_sleep()) {
+		idle_check();
+		now = stats_ns() / NS_USEC;
+		if (now >= next_aggr) {
+			idle_aggregate();
+			next_aggr = now + s_idle.aggr_us;
+		}
+
+		if (now >= next_update) {
+			idle_update();
+			next_update = now + s_idle.update_us;
+		}
+
+		idle_prepare();
+	}
+
+	(void)pthread_mutex_unlock(&s_idle.mutex);
+	debug_print(NULL, 2, "idle: the engine thread is exiting\n");
+	return (NULL);
+}
+
+static void idle_target_init(idle_target_t *t, pid_t pid)
+{
+	damon_sysfs_range_t ranges[3];
+	char path[PATH_MAX];
+	int n;
+
+	(void)memset(t, 0, sizeof(idle_target_t));
+	t->pid = pid;
+	(void)snprintf(path, sizeof(path), "/proc/%d/pagemap", pid);
+	t->pagemap_fd = open(path, O_RDONLY);
+
+	if ((n = idle_three_regions(pid, ranges)) > 0 &&
+	    idle_regions_apply(t, ranges, n) == 0) {
+		(void)idle_regions_even(t);
+	}
+}
+
+static void idle_target_free(idle_target_t *t)
+{
+	if (t->pagemap_fd >= 0) {
+		(void)close(t->pagemap_fd);
+	}
+
+	free(t->regions);
+	(void)memset(t, 0, sizeof(idle_target_t));
+	t->pagemap_fd = -1;
+}
+
+/*
+ * Make 'pids' the targets, the regions of the targets kept are kept.
+ * Called with the mutex held.
+ */
+static int idle_commit(const pid_t *pids, int n)
+{
+	idle_target_t *arr;
+	int i, j;
+
+	if ((arr = zalloc(sizeof(idle_target_t) * MAX(n, 1))) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < s_idle.ntargets; j++) {
+			if (s_idle.targets[j].pid == pids[i]) {
+				arr[i] = s_idle.targets[j];
+				(void)memset(&s_idle.targets[j], 0,
+					     sizeof(idle_target_t));
+				s_idle.targets[j].pagemap_fd = -1;
+				break;
+			}
+		}
+
+		if (j == s_idle.ntargets) {
+			idle_target_init(&arr[i], pids[i]);
+		}
+	}
+
+	for (j = 0; j < s_idle.ntargets; j++) {
+		idle_target_free(&s_idle.targets[j]);
+	}
+
+	free(s_idle.targets);
+	s_idle.targets = arr;
+	s_idle.ntargets = n;
+
+	/* The samples point to the old regions. */
+	s_idle.nsamples = 0;
+	return (0);
+}
+
+/*
+ * Use the engine if the kernel has no DAMON. It needs the page_idle
+ * bitmap (CONFIG_IDLE_PAGE_TRACKING) and the pfns of pagemap, i.e.
+ * root or CAP_SYS_ADMIN.
+ */
+int idle_select(void)
+{
+	pthread_condattr_t attr;
+
+	if (access(IDLE_BITMAP, R_OK | W_OK) != 0) {
+		return (-1);
+	}
+
+	(void)pthread_condattr_init(&attr);
+	(void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	(void)pthread_cond_init(&s_idle.cond, &attr);
+	(void)pthread_condattr_destroy(&attr);
+
+	s_idle.pgsize = sysconf(_SC_PAGESIZE);
+	s_idle.seed = (unsigned int)(getpid() ^ time(NULL));
+	s_idle.enabled = B_TRUE;
+	return (0);
+}
+
+boolean_t idle_enabled(void)
+{
+	return (s_idle.enabled);
+}
+
+pid_t idle_tid(void)
+{
+	return (s_idle.tid);
+}
+
+/*
+ * Monitor the processes 'pids', the thread is started if it isn't
+ * running yet.
+ */
+int idle_start(const pid_t *pids, int n)
+{
+	int ret;
+
+	if (!s_idle.enabled) {
+		return (-1);
+	}
+
+	(void)pthread_mutex_lock(&s_idle.mutex);
+	ret = idle_commit(pids, n);
+	(void)pthread_mutex_unlock(&s_idle.mutex);
+	if (ret != 0 || s_idle.running) {
+		return (ret);
+	}
+
+	if (s_idle.words == NULL &&
+	    (s_idle.words = malloc(sizeof(uint64_t) *
+				   IDLE_RUN_WORDS)) == NULL) {
+		return (-1);
+	}
+
+	if ((s_idle.bitmap_fd = open(IDLE_BITMAP, O_RDWR)) < 0) {
+		stderr_print("Failed to open %s (%d)\n", IDLE_BITMAP, errno);
+		return (-1);
+	}
+
+	s_idle.quit = B_FALSE;
+	if (pthread_create(&s_idle.thr, NULL, idle_handler, NULL) != 0) {
+		debug_print(NULL, 2, "Create the idle engine thread failed.\n");
+		(void)close(s_idle.bitmap_fd);
+		s_idle.bitmap_fd = -1;
+		return (-1);
+	}
+
+	s_idle.running = B_TRUE;
+	debug_print(NULL, 2, "idle: the engine monitors %d processes\n", n);
+	return (0);
+}
+
+void idle_stop(void)
+{
+	int i;
+
+	if (s_idle.running) {
+		(void)pthread_mutex_lock(&s_idle.mutex);
+		s_idle.quit = B_TRUE;
+		(void)pthread_cond_signal(&s_idle.cond);
+		(void)pthread_mutex_unlock(&s_idle.mutex);
+		(void)pthread_join(s_idle.thr, NULL);
+		s_idle.running = B_FALSE;
+	}
+
+	if (s_idle.bitmap_fd >= 0) {
+		(void)close(s_idle.bitmap_fd);
+		s_idle.bitmap_fd = -1;
+	}
+
+	for (i = 0; i < s_idle.ntargets; i++) {
+		idle_target_free(&s_idle.targets[i]);
+	}
+
+	free(s_idle.targets);
+	free(s_idle.samples);
+	free(s_idle.snap);
+	free(s_idle.words);
+	s_idle.targets = NULL;
+	s_idle.samples = NULL;
+	s_idle.snap = NULL;
+	s_idle.words = NULL;
+	s_idle.ntargets = s_idle.nsamples = s_idle.samples_size = 0;
+	s_idle.nsnap = s_idle.snap_size = 0;
+	s_idle.naggrs = 0;
+	s_idle.tid = 0;
+}
+
+/*
+ * Get the sorted pids of the targets, like damon_status_get() gets
+ * them from the debugfs. The caller frees '*pids'.
+ */
+int idle_targets_load(pid_t **pids, int *npids)
+{
+	pid_t *arr;
+	int i, n;
+
+	*pids = NULL;
+	*npids = 0;
+	if (!s_idle.running) {
+		return (-1);
+	}
+
+	(void)pthread_mutex_lock(&s_idle.mutex);
+	n = s_idle.ntargets;
+	if ((arr = malloc(sizeof(pid_t) * MAX(n, 1))) == NULL) {
+		(void)pthread_mutex_unlock(&s_idle.mutex);
+		return (-1);
+	}
+
+	for (i = 0; i < n; i++) {
+		arr[i] = s_idle.targets[i].pid;
+	}
+
+	(void)pthread_mutex_unlock(&s_idle.mutex);
+	qsort(arr, n, sizeof(pid_t), pid_cmp);
+	*pids = arr;
+	*npids = n;
+	return (0);
+}
+
+void idle_attrs_get(uint64_t *sample_us, uint64_t *aggr_us,
+		uint64_t *update_us, uint64_t *min_regions, uint64_t *max_regions)
+{
+	(void)pthread_mutex_lock(&s_idle.mutex);
+	*sample_us = s_idle.sample_us;
+	*aggr_us = s_idle.aggr_us;
+	*update_us = s_idle.update_us;
+	*min_regions = s_idle.min_regions;
+	*max_regions = s_idle.max_regions;
+	(void)pthread_mutex_unlock(&s_idle.mutex);
+}
+
+/*
+ * Change the attrs online, they're checked like DAMON checks them.
+ */
+int idle_attrs_set(uint64_t sample_us, uint64_t aggr_us, uint64_t update_us,
+		uint64_t min_regions, uint64_t max_regions)
+{
+	if (sample_us == 0 || aggr_us < sample_us || update_us == 0 ||
+	    min_regions < 3 || max_regions < min_regions) {
+		return (-1);
+	}
+
+	(void)pthread_mutex_lock(&s_idle.mutex);
+	s_idle.sample_us = sample_us;
+	s_idle.aggr_us = aggr_us;
+	s_idle.update_us = update_us;
+	s_idle.min_regions = min_regions;
+	s_idle.max_regions = max_regions;
+	(void)pthread_mutex_unlock(&s_idle.mutex);
+	return (0);
+}
+
+/*
+ * Copy the regions of the last aggregation to 'regs', the records are
+ * the ones of damon_sysfs_snapshot(). Return the number of regions, 0
+ * if there is no aggregation since the last call.
+ */
+int idle_snapshot(damon_sysfs_region_t *regs, int size)
+{
+	uint64_t naggrs;
+	int n;
+
+	if (!s_idle.running) {
+		return (0);
+	}
+
+	(void)pthread_mutex_lock(&s_idle.mutex);
+	naggrs = s_idle.naggrs;
+	n = (naggrs > 0) ? MIN(s_idle.nsnap, size) : 0;
+	if (n > 0) {
+		(void)memcpy(regs, s_idle.snap,
+			     sizeof(damon_sysfs_region_t) * n);
+	}
+
+	s_idle.naggrs = 0;
+	(void)pthread_mutex_unlock(&s_idle.mutex);
+
+	if (n > 0) {
+		kdamon_regions_add(s_idle.tid, (uint64_t)n * naggrs);
+	}
+
+	return (n);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DAMONTOP_AUTOTUNE_H
+#define _DAMONTOP_AUTOTUNE_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define	AUTOTUNE_PERIOD_MS	5000	/* feedback period */
+#define	AUTOTUNE_STREAK		2	/* periods in a row before acting */
+#define	AUTOTUNE_HIGH_PCT	120	/* over target: coarser */
+#define	AUTOTUNE_LOW_PCT	60	/* under target: finer */
+#define	AUTOTUNE_SAMPLE_MAX	100000	/* us */
+#define	AUTOTUNE_REGIONS_MIN	10
+#define	AUTOTUNE_REGIONS_DEFAULT	1000
+
+extern int autotune_parse(const char *);
+extern boolean_t autotune_enabled(void);
+extern void autotune_init(void);
+extern void autotune_fini(void);
+extern void autotune_tick(void);
+extern int autotune_status_build(char *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_AUTOTUNE_H */
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DAMONTOP_BUDGET_H
+#define _DAMONTOP_BUDGET_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Degradation levels. Each level keeps the degradations of the lower
+ * levels and adds one more.
+ */
+#define	BUDGET_LEVEL_NONE	0
+#define	BUDGET_LEVEL_INTVAL	1	/* display interval doubled */
+#define	BUDGET_LEVEL_MAPS	2	/* maps reloaded every few ticks */
+#define	BUDGET_LEVEL_ROWS	3	/* fewer visible rows */
+#define	BUDGET_LEVEL_REGIONS	4	/* DAMON max_regions halved */
+#define	BUDGET_LEVEL_SAMPLE	5	/* DAMON sampling rate halved */
+#define	BUDGET_LEVEL_MAX	BUDGET_LEVEL_SAMPLE
+
+#define	BUDGET_MAPS_PERIOD	4	/* reload maps every N ticks */
+#define	BUDGET_ROWS_MAX		32	/* visible rows when degraded */
+#define	BUDGET_CALM_TICKS	3	/* ticks under 70% before restoring */
+#define	BUDGET_CALM_PCT		70
+
+extern int budget_parse(const char *);
+extern void budget_init(void);
+extern void budget_fini(void);
+extern void budget_thread_register(const char *);
+extern void budget_tick(void);
+extern int budget_level(void);
+extern int budget_disp_intval(int);
+extern boolean_t budget_maps_skip(void);
+extern int budget_rows(int);
+extern int budget_title_build(char *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_BUDGET_H */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DAMONTOP_CGROUP_H
+#define _DAMONTOP_CGROUP_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define	CGROUP_MOUNT		"/sys/fs/cgroup"
+#define	CGROUP_NAME_SIZE	128
+#define	CGROUP_EVBUF_SIZE	4096
+#define	CGROUP_RESCAN_SECS	2
+
+typedef struct _cgroup {
+	char path[PATH_MAX];
+	char name[CGROUP_NAME_SIZE];
+	int wd_dir;	/* child cgroups created, or the cgroup removed */
+	int wd_procs;	/* cgroup.procs */
+	int wd_events;	/* cgroup.events, cgroup v2 only */
+	pid_t *pids;	/* sorted */
+	int npids;
+	int pids_size;
+} cgroup_t;
+
+/*
+ * The monitored cgroups. The table is built in main() before the
+ * threads start, after that only the disp thread (or the batch loop)
+ * touches it, so there is no lock.
+ */
+typedef struct _cgroup_group {
+	cgroup_t **cgroups;
+	int ncgroups;
+	int size;
+	int ifd;	/* inotify */
+	pid_t *targets;	/* the pids written to DAMON, sorted */
+	int ntargets;
+	uint64_t rescan_ns;	/* the last time cgroup.procs were read */
+} cgroup_group_t;
+
+/* One line of the cgroup view. */
+typedef struct _cgroup_line {
+	char name[CGROUP_NAME_SIZE];
+	int nprocs;
+	int nregions;
+	uint64_t wss;		/* bytes of the regions accessed */
+	uint64_t hot;		/* bytes of the hot regions */
+	uint64_t local;
+	uint64_t remote;
+} cgroup_line_t;
+
+extern int cgroup_parse(const char *);
+extern void cgroup_fini(void);
+extern int cgroup_num(void);
+extern int cgroup_fd(void);
+extern void cgroup_events_handle(void);
+extern int cgroup_lines_fill(cgroup_line_t *, int);
+extern void cgroup_caption_build(char *, int);
+extern void cgroup_str_build(char *, int, int, void *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_CGROUP_H */
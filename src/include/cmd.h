@@ -51,6 +51,12 @@ extern "C" {
 #define CMD_5_CHAR		'5'
 #define CMD_MAP_GET_CHAR	'm'
 #define CMD_MAP_STOP_CHAR	's'
+#define CMD_SELFSTATS_CHAR	't'
+#define CMD_CGROUP_CHAR		'c'
+#define CMD_SAVE_CHAR		'w'
+#define CMD_ZOOM_CHAR		'z'
+#define CMD_UNZOOM_CHAR		'u'
+#define CMD_PADDR_CHAR		'p'
 
 typedef enum {
 	CMD_INVALID_ID = 0,
@@ -70,9 +76,15 @@ typedef enum {
 	CMD_QUIT_ID,
 	CMD_BACK_ID,
 	CMD_RESIZE_ID,
+	CMD_SELFSTATS_ID,
+	CMD_CGROUP_ID,
+	CMD_SAVE_ID,
+	CMD_ZOOM_ID,
+	CMD_UNZOOM_ID,
+	CMD_PADDR_ID,
 } cmd_id_t;
 
-#define CMD_NUM	25
+#define CMD_NUM	26
 
 typedef struct _cmd_home {
 	cmd_id_t id;
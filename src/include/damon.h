@@ -41,6 +41,26 @@ extern "C" {
 
 #define INVALID_CPUID	-1
 
+#define	DAMON_DEBUGFS		"/sys/kernel/debug/damon"
+#define	DAMON_ATTRS_PATH	DAMON_DEBUGFS "/attrs"
+
+/* The defaults of DAMON. */
+#define	DAMON_DEF_SAMPLE_US	5000
+#define	DAMON_DEF_AGGR_US	100000
+#define	DAMON_DEF_UPDATE_US	1000000
+#define	DAMON_DEF_MIN_REGIONS	10
+#define	DAMON_DEF_MAX_REGIONS	1000
+
+/* The DAMON attributes, in the order of the 'attrs' file. */
+enum {
+	ATTR_SAMPLE = 0,
+	ATTR_AGGR,
+	ATTR_UPDATE,
+	ATTR_MIN,
+	ATTR_MAX,
+	ATTR_NUM
+};
+
 /* Number of online CPUs */
 extern int g_ncpus;
 
@@ -51,11 +71,37 @@ typedef struct _kdamon {
 	int aggregation_intval;
 	int regions_update_intval;
 	count_value_t countval;
+	/* overhead, updated by kdamon_refresh() */
+	uint64_t slice_last;	/* utime + stime, clock ticks */
+	uint64_t ns_last;
+	uint64_t nr_regions_last;
+	double cpu_usage;	/* % of one CPU */
+	double regions_sec;	/* region checks per second */
+	double cost;		/* CPU ms per million region checks */
 } kdamon_t;
 
+/* Regions reported in the trace stream by one kdamond. */
+typedef struct _kdamon_regions {
+	int pid;
+	uint64_t nr_regions;
+} kdamon_regions_t;
+
+#define	KDAMON_REGIONS_CHUNK	32
+
+/*
+ * The table of kdamon_regions_t is a list of chunks. The perf thread
+ * appends a chunk when all slots are taken, the chunks are never freed,
+ * so the readers walk the list without lock.
+ */
+typedef struct _kdamon_regions_chunk {
+	kdamon_regions_t regions[KDAMON_REGIONS_CHUNK];
+	struct _kdamon_regions_chunk *next;
+} kdamon_regions_chunk_t;
+
 typedef struct _kdamon_group {
 	pthread_mutex_t mutex;
-	kdamon_t kdamons[NR_KDAMON_MAX];
+	kdamon_t *kdamons;
+	int kdamons_size;
 	int nkdamons;
 	int intval_ms;
 	boolean_t inited;
@@ -66,6 +112,16 @@ extern void kdamon_refresh(void);
 extern kdamon_t *kdamon_get(int kid_idx);
 extern int get_kdamon_pid(void);
 extern unsigned int get_nr_kdamon(void);
+extern void kdamon_regions_account(int);
+extern void kdamon_regions_add(int, uint64_t);
+extern uint64_t kdamon_regions_get(int);
+extern boolean_t damon_debugfs_supported(void);
+extern void read_damon_attrs(const char *, uint64_t *, uint64_t *,
+		uint64_t *, uint64_t *, uint64_t *);
+extern void write_damon_attrs(uint64_t, uint64_t, uint64_t, uint64_t,
+		uint64_t);
+extern int write_damon_attrs_check(uint64_t, uint64_t, uint64_t, uint64_t,
+		uint64_t);
 uint64_t get_max_countval(count_value_t * countval_arr,
 		ui_count_id_t ui_count_id);
 
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _DAMONTOP_DAMON_SYSFS_H
+#define _DAMONTOP_DAMON_SYSFS_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define	DAMON_SYSFS_ADMIN	"/sys/kernel/mm/damon/admin"
+#define	DAMON_SYSFS_KDAMONDS	DAMON_SYSFS_ADMIN "/kdamonds"
+
+/* Each kdamond started by datop has one context, 'vaddr' or 'paddr'. */
+#define	DAMON_SYSFS_CTX		DAMON_SYSFS_KDAMONDS "/%d/contexts/0"
+
+/* --kdamonds node: one kdamond per NUMA node, bound to its CPUs. */
+#define	DAMON_SYSFS_NODE	(-1)
+
+/*
+ * A kdamond started by datop through sysfs. 'pids' is the order of the
+ * targets committed last, the kernel matches the targets of a commit
+ * and reports them in the trace events by their index.
+ */
+typedef struct _damon_kdamond {
+	pid_t kpid;		/* the kernel thread */
+	int node;		/* bound to the node, or -1 */
+	pid_t *pids;
+	int npids;
+	int size;
+	uint64_t load;		/* resident pages of the targets */
+	uint64_t snap_ns;	/* the last region snapshot */
+} damon_kdamond_t;
+
+/* A region of a tried regions snapshot. */
+typedef struct _damon_sysfs_region {
+	pid_t pid;
+	uint64_t start;
+	uint64_t end;
+	uint32_t nr_accesses;
+	uint32_t age;
+	uint32_t nr_regions;	/* of the target */
+} damon_sysfs_region_t;
+
+/* A physical address range, the init region of a 'paddr' target. */
+typedef struct _damon_sysfs_range {
+	uint64_t start;
+	uint64_t end;
+} damon_sysfs_range_t;
+
+typedef struct _damon_sysfs {
+	boolean_t staged;	/* set up, not turned on yet */
+	boolean_t active;
+	boolean_t snapshot;	/* --source regions */
+	boolean_t schemes;	/* the 'stat' scheme is set up */
+	int want;		/* --kdamonds, or DAMON_SYSFS_NODE */
+	pthread_mutex_t mutex;	/* the perf thread maps the trace events */
+	damon_kdamond_t *kdamonds;
+	int nkdamonds;
+} damon_sysfs_t;
+
+extern int damon_sysfs_kdamonds_parse(const char *);
+extern int damon_sysfs_source_parse(const char *);
+extern boolean_t damon_sysfs_supported(void);
+extern boolean_t damon_sysfs_busy(void);
+extern boolean_t damon_sysfs_staged(void);
+extern boolean_t damon_sysfs_active(void);
+extern boolean_t damon_sysfs_snapshot_on(void);
+extern int damon_sysfs_setup(const pid_t *, int);
+extern int damon_sysfs_paddr_setup(const int *, int);
+extern int damon_sysfs_kdamond_regions(int, const damon_sysfs_range_t *, int);
+extern int damon_sysfs_on(void);
+extern int damon_sysfs_commit(const pid_t *, int);
+extern int damon_sysfs_attrs_commit(uint64_t, uint64_t, uint64_t, uint64_t,
+		uint64_t);
+extern void damon_sysfs_stop(void);
+extern int damon_sysfs_nkdamonds(void);
+extern int damon_sysfs_attrs_read(int, uint64_t *);
+extern int damon_sysfs_intervals(int, uint64_t *, uint64_t *);
+extern int damon_sysfs_kdamond_pid(int);
+extern int damon_sysfs_kdamond_ntargets(int);
+extern pid_t damon_sysfs_target_pid(int, unsigned long);
+extern int damon_sysfs_target_regions(pid_t, int);
+extern int damon_sysfs_target_region(pid_t, int, uint64_t, uint64_t);
+extern int damon_sysfs_snapshot(int, damon_sysfs_region_t *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_DAMON_SYSFS_H */
@@ -15,7 +15,6 @@ extern "C" {
 
 #define DISP_MIN_INTVAL 1
 #define DISP_DEFAULT_INTVAL 5
-#define PIPE_CHAR_QUIT 'q'
 #define PIPE_CHAR_RESIZE 'r'
 
 extern int g_disp_intval;
@@ -35,7 +34,6 @@ typedef enum {
 
 typedef struct _disp_ctl {
 	pthread_mutex_t mutex;
-	pthread_cond_t cond;
 	pthread_mutex_t mutex2;
 	pthread_cond_t cond2;
 	pthread_t thr;
@@ -44,11 +42,13 @@ typedef struct _disp_ctl {
 	disp_flag_t flag;
 	disp_flag_t flag2;
 	int intval_ms;
+	int epfd;		/* event loop of 'disp thread' */
+	int evfd;		/* eventfd, kicked when 'flag' is set */
+	int tfd;		/* timerfd (CLOCK_MONOTONIC) for refresh */
+	int timer_secs;		/* the period 'tfd' is armed with */
 } disp_ctl_t;
 
 typedef struct _cons_ctl {
-	fd_set fds;
-	pthread_t thr;
 	int pipe[2];
 	boolean_t inited;
 } cons_ctl_t;
@@ -57,9 +57,10 @@ extern int g_run_secs;
 
 extern int disp_init(void);
 extern void disp_fini(void);
+extern int disp_sync_init(void);
+extern void disp_sync_fini(void);
 extern int disp_cons_ctl_init(void);
 extern void disp_cons_ctl_fini(void);
-extern void disp_consthr_quit(void);
 extern void disp_profiling_data_ready(int);
 extern void disp_profiling_data_fail(void);
 extern void disp_maplist_data_ready(int);
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DAMONTOP_EMIT_H
+#define _DAMONTOP_EMIT_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	EMIT_FMT_TEXT = 0,
+	EMIT_FMT_JSONL,
+	EMIT_FMT_CSV,
+	EMIT_FMT_BIN
+} emit_fmt_t;
+
+#define	EMIT_NAME_SIZE		16
+
+/* The region columns, in this order in the binary frame. */
+typedef enum {
+	EMIT_COL_START = 0,
+	EMIT_COL_END,
+	EMIT_COL_ACCESS,
+	EMIT_COL_AGE,
+	EMIT_COL_LOCAL,
+	EMIT_COL_REMOTE
+} emit_col_t;
+
+#define	EMIT_COL_NUM		6
+
+/*
+ * The binary frame of one epoch (native byte order):
+ *   emit_bin_hdr_t
+ *   emit_bin_proc_t[nprocs]
+ *   uint64_t[nregions] for each of the EMIT_COL_NUM columns
+ * 'len' is the size of the whole frame, header included.
+ */
+#define	EMIT_BIN_MAGIC		0x504f5444	/* "DTOP" */
+#define	EMIT_BIN_VERSION	1
+
+typedef struct _emit_bin_hdr {
+	uint32_t len;
+	uint32_t magic;
+	uint16_t version;
+	uint16_t ncols;
+	uint32_t seq;
+	uint64_t ms;
+	uint32_t nprocs;
+	uint32_t nregions;
+} emit_bin_hdr_t;
+
+typedef struct _emit_bin_proc {
+	int32_t pid;
+	uint32_t nr_regions;	/* DAMON regions of the target */
+	uint32_t first;		/* index of its first region */
+	uint32_t count;		/* number of its regions */
+	char name[EMIT_NAME_SIZE];
+} emit_bin_proc_t;
+
+/* The aggregation tables of one epoch, copied out of track_proc_t. */
+typedef struct _emit_epoch {
+	uint32_t seq;
+	uint64_t ms;
+	emit_bin_proc_t *procs;
+	int nprocs;
+	int procs_cap;
+	uint64_t *cols[EMIT_COL_NUM];
+	int nregions;
+	int regions_cap;
+	char *text;		/* the serialized epoch, for the text formats */
+	size_t text_len;
+	size_t text_cap;
+} emit_epoch_t;
+
+extern int emit_format_parse(const char *);
+extern emit_fmt_t emit_format(void);
+extern void emit_epoch_init(emit_epoch_t *);
+extern void emit_epoch_fini(emit_epoch_t *);
+extern void emit_epoch_begin(emit_epoch_t *, uint32_t, uint64_t);
+extern int emit_proc_add(emit_epoch_t *, pid_t, const char *, uint64_t);
+extern int emit_region_add(emit_epoch_t *, count_value_t *);
+extern int emit_header_write(int, emit_epoch_t *, const char *);
+extern int emit_epoch_write(int, emit_epoch_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_EMIT_H */
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DAMONTOP_IDLE_H
+#define _DAMONTOP_IDLE_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "types.h"
+#include "damon_sysfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define	IDLE_BITMAP		"/sys/kernel/mm/page_idle/bitmap"
+
+/*
+ * The bitmap is read and written in runs of 64-bit words: the words of
+ * the sampled pfns which are at most IDLE_RUN_GAP words apart go in one
+ * pread/pwrite of at most IDLE_RUN_WORDS words.
+ */
+#define	IDLE_RUN_GAP		8
+#define	IDLE_RUN_WORDS		512
+
+#define	IDLE_PM_PRESENT		(1ULL << 63)
+#define	IDLE_PM_PFN_MASK	((1ULL << 55) - 1)
+
+typedef struct _idle_region {
+	uint64_t start;
+	uint64_t end;
+	uint32_t nr_accesses;
+	uint32_t last_nr_accesses;
+	uint32_t age;
+} idle_region_t;
+
+typedef struct _idle_target {
+	pid_t pid;
+	int pagemap_fd;
+	idle_region_t *regions;
+	int nregions;
+	int size;
+} idle_target_t;
+
+/* A page sampled in a region, and whether its idle bit is set. */
+typedef struct _idle_sample {
+	uint64_t pfn;
+	idle_region_t *region;
+	boolean_t idle;
+} idle_sample_t;
+
+/*
+ * The page idle engine, used when the kernel has no DAMON. Its thread
+ * does what a kdamond does, with the idle bits of the sampled pages in
+ * place of the accessed bits. The mutex is held by the thread except
+ * while it sleeps, the targets and the snapshot are changed under it.
+ */
+typedef struct _idle_engine {
+	boolean_t enabled;	/* DAMON is missing, this is the engine */
+	boolean_t running;
+	boolean_t quit;
+	pthread_t thr;
+	pid_t tid;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int bitmap_fd;
+	long pgsize;
+	unsigned int seed;
+	uint64_t sample_us;
+	uint64_t aggr_us;
+	uint64_t update_us;
+	uint64_t min_regions;
+	uint64_t max_regions;
+	int last_nregions;	/* after the last split */
+	idle_target_t *targets;
+	int ntargets;
+	idle_sample_t *samples;	/* sorted by pfn */
+	int nsamples;
+	int samples_size;
+	uint64_t *words;	/* IDLE_RUN_WORDS */
+	damon_sysfs_region_t *snap;	/* the last aggregation */
+	int nsnap;
+	int snap_size;
+	uint64_t naggrs;	/* aggregations since the last pull */
+} idle_engine_t;
+
+extern int idle_select(void);
+extern boolean_t idle_enabled(void);
+extern int idle_start(const pid_t *, int);
+extern void idle_stop(void);
+extern pid_t idle_tid(void);
+extern int idle_targets_load(pid_t **, int *);
+extern void idle_attrs_get(uint64_t *, uint64_t *, uint64_t *, uint64_t *,
+		uint64_t *);
+extern int idle_attrs_set(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t);
+extern int idle_snapshot(damon_sysfs_region_t *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_IDLE_H */
@@ -66,6 +66,12 @@ typedef struct _perf_cpu {
 
 typedef int (*pfn_perf_cpu_op_t)(struct _perf_cpu *, void *);
 
+/* The ring buffer of one more kdamond. */
+typedef struct _perf_damon_ring {
+	int perf_fd;
+	void *map_base;
+} perf_damon_ring_t;
+
 typedef struct _perf_damon_event {
 	int cpuid;
 	int perf_fd;
@@ -74,6 +80,8 @@ typedef struct _perf_damon_event {
 	int map_mask;
 	void *map_base;
 	count_value_t countval_last;
+	perf_damon_ring_t *rings;	/* the kdamonds but the first */
+	int nrings;
 } perf_damon_event_t;
 
 struct _perf_ctl;
@@ -82,6 +90,7 @@ struct _track_proc;
 
 extern boolean_t os_profiling_started(struct _perf_ctl *);
 extern int os_profiling_start(struct _perf_ctl *, union _perf_task *);
+extern int __profiling_smpl(void);
 extern int os_profiling_smpl(struct _perf_ctl *, union _perf_task *, int *);
 extern int os_profiling_partpause(struct _perf_ctl *, union _perf_task *);
 extern int os_profiling_multipause(struct _perf_ctl *, union _perf_task *);
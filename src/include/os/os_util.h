@@ -65,6 +65,7 @@ extern int processor_bind(int cpu);
 extern int processor_unbind(void);
 extern void os_calibrate(double *nsofclk, uint64_t *clkofsec);
 extern boolean_t os_sysfs_cpu_enum(int, int *, int, int *);
+extern boolean_t os_sysfs_node_enum(int *, int, int *);
 extern int os_sysfs_online_ncpus(void);
 
 #ifdef __cplusplus
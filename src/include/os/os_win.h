@@ -41,7 +41,7 @@ extern "C" {
 #endif
 
 #define	NOTE_MAP_LIST \
-	"Q: Quit; H: Home; B: Back; R: Refresh"
+	"Q: Quit; H: Home; B: Back; R: Refresh; Z/U: Zoom in/out"
 
 #define	NOTE_LATNODE \
 	"Q: Quit; H: Home; B: Back; R: Refresh"
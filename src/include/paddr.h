@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DAMONTOP_PADDR_H
+#define _DAMONTOP_PADDR_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "types.h"
+#include "cgroup.h"
+#include "damon_sysfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define	PADDR_NODE_PATH		"/sys/devices/system/node"
+#define	PADDR_MEMORY_PATH	"/sys/devices/system/memory"
+#define	PADDR_KPAGECGROUP	"/proc/kpagecgroup"
+#define	PADDR_KPAGEFLAGS	"/proc/kpageflags"
+
+/*
+ * The pages of a region looked up in /proc/kpage*: PADDR_SPOTS runs
+ * of PADDR_SPOT_PFNS pages spread over the region, one pread of each
+ * file per run.
+ */
+#define	PADDR_SPOTS		4
+#define	PADDR_SPOT_PFNS		16
+#define	PADDR_PFNS_MAX		(PADDR_SPOTS * PADDR_SPOT_PFNS)
+
+/* The regions of one snapshot of a kdamond. */
+#define	PADDR_REGIONS_MAX	8192
+
+/* An unknown memory cgroup walks the cgroup tree again at most so often. */
+#define	PADDR_NAMES_INTVAL_MS	10000
+
+/* The bits of /proc/kpageflags, see include/uapi/linux/kernel-page-flags.h */
+#define	PADDR_KPF_BUDDY		10
+#define	PADDR_KPF_NOPAGE	20
+
+/* A NUMA node, monitored by a kdamond of its own. */
+typedef struct _paddr_node {
+	int nid;
+	damon_sysfs_range_t *ranges;
+	int nranges;
+	int size;
+	uint64_t total;		/* bytes of the ranges */
+} paddr_node_t;
+
+/*
+ * One line of the paddr view: the first ones are the nodes, then the
+ * memory cgroups the pages of the regions are charged to.
+ */
+typedef struct _paddr_line {
+	char name[CGROUP_NAME_SIZE];
+	int nid;		/* -1 for a cgroup */
+	uint64_t ino;		/* of the memory cgroup */
+	int nregions;
+	uint64_t size;		/* bytes, estimated for a cgroup */
+	uint64_t wss;		/* bytes of the regions accessed */
+	uint64_t hot;		/* bytes of the hot regions */
+	uint64_t access;	/* nr_accesses by bytes */
+} paddr_line_t;
+
+typedef struct _paddr_table {
+	paddr_line_t *lines;
+	int nlines;
+	int size;
+} paddr_table_t;
+
+/* The inode of a memory cgroup and its path. */
+typedef struct _paddr_cgname {
+	uint64_t ino;
+	char name[CGROUP_NAME_SIZE];
+} paddr_cgname_t;
+
+/*
+ * The perf thread builds 'work' from the snapshots and swaps it with
+ * 'pub' under the mutex, the disp thread copies 'pub' to the view.
+ * The names of the cgroups are only touched by the disp thread.
+ */
+typedef struct _paddr {
+	boolean_t enabled;
+	pthread_mutex_t mutex;
+	paddr_node_t *nodes;
+	int nnodes;
+	int kpc_fd;		/* /proc/kpagecgroup */
+	int kpf_fd;		/* /proc/kpageflags */
+	long pgsize;
+	damon_sysfs_region_t *regs;
+	paddr_table_t work;
+	paddr_table_t pub;
+	paddr_cgname_t *names;
+	int nnames;
+	int names_size;
+	uint64_t names_ms;	/* the last walk */
+} paddr_t;
+
+extern int paddr_start(void);
+extern void paddr_fini(void);
+extern boolean_t paddr_enabled(void);
+extern int paddr_smpl(void);
+extern int paddr_nlines(void);
+extern int paddr_lines_fill(paddr_line_t *, int);
+extern int paddr_nnodes(void);
+extern boolean_t paddr_cgroup_on(void);
+extern void paddr_caption_build(char *, int);
+extern void paddr_str_build(char *, int, int, void *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_PADDR_H */
@@ -15,6 +15,7 @@ extern "C" {
 
 #define	PERF_WAIT_NSEC	60
 #define	PERF_INTVAL_MIN_MS	1000
+#define	PERF_TASK_QUEUE_SIZE	16
 
 typedef enum {
 	PERF_STATUS_IDLE = 0,
@@ -84,7 +85,9 @@ typedef union _perf_task {
 	task_allstop_t allstop;
 	task_profiling_t profiling;
 	task_partpause_t partpause;
+	task_multipause_t multipause;
 	task_restore_t restore;
+	task_multi_restore_t multi_restore;
 	task_ml_t ll;
 } perf_task_t;
 
@@ -97,14 +100,38 @@ typedef union _perf_task {
 #define	PERF_PROFILING_STARTED \
 	(s_perf_ctl.status == PERF_STATUS_PROFILING_STARTED)
 
+/*
+ * A queued task. The token is handed out by perf_task_set() and is
+ * used to wait for the completion of this very task.
+ */
+typedef struct _perf_task_entry {
+	perf_task_t task;
+	uint64_t token;
+} perf_task_entry_t;
+
+/*
+ * The status a task ended with, kept with its full token so that a
+ * waiter can tell its own result from a later task in the same slot.
+ */
+typedef struct _perf_task_result {
+	uint64_t token;
+	perf_status_t status;
+} perf_task_result_t;
+
 typedef struct _perf_ctl {
 	pthread_mutex_t mutex;
-	pthread_cond_t cond;
+	pthread_cond_t cond;	/* queue not empty / not full / quit */
 	pthread_mutex_t status_mutex;
 	pthread_cond_t status_cond;
 	perf_status_t status;
 	pthread_t thr;
-	perf_task_t task;
+	perf_task_entry_t queue[PERF_TASK_QUEUE_SIZE];
+	int queue_head;
+	int queue_num;
+	uint64_t token_last;	/* protected by 'mutex' */
+	boolean_t quit;		/* protected by 'mutex' */
+	uint64_t token_done;	/* protected by 'status_mutex' */
+	perf_task_result_t results[PERF_TASK_QUEUE_SIZE * 2];
 	boolean_t inited;
 	uint64_t last_ms;
 } perf_ctl_t;
@@ -124,8 +151,8 @@ extern void perf_status_set(perf_status_t);
 extern void perf_status_set_no_signal(perf_status_t);
 extern void* perf_priv_alloc(boolean_t *);
 extern void perf_priv_free(void *);
-extern void perf_task_set(perf_task_t *);
-extern int perf_status_wait(perf_status_t);
+extern uint64_t perf_task_set(perf_task_t *);
+extern int perf_status_wait(uint64_t, perf_status_t);
 extern void perf_smpl_wait(void);
 extern void perf_maplist_status_set(void);
 extern void sys_profiling_config(perf_count_id_t perf_count_id, plat_event_config_t *cfg);
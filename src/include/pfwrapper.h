@@ -110,7 +110,8 @@ int pf_profiling_start(void);
 int pf_profiling_stop(void);
 int pf_profiling_allstart(struct _perf_cpu *);
 int pf_profiling_allstop(struct _perf_cpu *);
-void pf_profiling_record(pf_profiling_rec_t *, int *);
+int pf_profiling_nrings(void);
+void pf_profiling_record(int, pf_profiling_rec_t *, int *);
 void pf_resource_free(void);
 
 #ifdef __cplusplus
@@ -44,12 +44,15 @@ extern "C" {
 #endif
 
 #define PROC_NAME_SIZE 16
-#define PROC_HASHTBL_SIZE 128
+#define PROC_PIDTBL_MIN 256
 #define PROC_RECORD_MAX 256
-#define PROC_MAX 50
 
-#define PROC_HASHTBL_INDEX(pid)	\
-	((int)(pid) % PROC_HASHTBL_SIZE)
+/*
+ * The pid table is open-addressed with linear probing, its size is
+ * always a power of 2.
+ */
+#define PROC_PIDTBL_INDEX(pid, mask)	\
+	((int)(((uint32_t)(pid) * 2654435761U) & (uint32_t)(mask)))
 
 extern pid_t damontop_pid;
 
@@ -77,8 +80,6 @@ typedef struct _track_proc {
 	int nr_nonzero;
 	cpu_slice_t slice[2];
 	uint64_t cpu_usage;
-	struct _track_proc *hash_prev;
-	struct _track_proc *hash_next;
 	struct _track_proc *sort_prev;
 	struct _track_proc *sort_next;
 } track_proc_t;
@@ -90,7 +91,8 @@ typedef struct _proc_group {
 	int nlwps;
 	int sort_idx;
 	boolean_t inited;
-	track_proc_t *hashtbl[PROC_HASHTBL_SIZE];
+	int pidtbl_size;
+	track_proc_t **pidtbl;
 	track_proc_t *latest;
 	track_proc_t **sort_arr;
 } proc_group_t;
@@ -99,12 +101,23 @@ struct damon_proc_t {
 	int min_regions;
 	int max_regions;
 	int nr_proc;
-	pid_t pid[PROC_MAX];
+	int pid_size;
+	pid_t *pid;
 	uint64_t last_ms;
 	int ready; /* 0: Not, 1: Run monitor is ok */
 };
 extern struct damon_proc_t target_procs;
 
+/*
+ * One record of a sampling batch, the 'countval' goes to the slot 'num'
+ * of the process 'pid'.
+ */
+typedef struct _proc_commit {
+	pid_t pid;
+	int num;
+	count_value_t countval;
+} proc_commit_t;
+
 extern int proc_group_init(void);
 extern void proc_group_fini(void);
 extern track_proc_t *proc_find(pid_t);
@@ -118,6 +131,7 @@ extern void proc_enum_update(pid_t);
 extern int proc_refcount_inc(track_proc_t *);
 extern void proc_refcount_dec(track_proc_t *);
 extern int proc_countval_update(track_proc_t *, int, perf_count_id_t, uint64_t);
+extern void proc_commit(proc_commit_t *, int);
 extern void proc_intval_update(int);
 extern int proc_intval_get(track_proc_t *);
 extern void proc_profiling_clear(void);
@@ -125,8 +139,17 @@ extern uint64_t proc_countval_sum(count_value_t *, ui_count_id_t);
 extern void proc_countvalue_sort(count_value_t * sort_countval_arr, int *nonzero);
 extern int monitor_start(char *procs);
 extern void monitor_exit(void);
+extern int monitor_update(void);
+extern int monitor_attach(void);
+extern boolean_t monitor_attached(void);
 extern int proc_monitor(void);
+extern void target_procs_reset(void);
+extern int target_procs_reserve(int);
+extern int target_procs_add(pid_t);
+extern void target_procs_uniq(void);
+extern char *target_procs_str(void);
 extern int cpu_slice_proc_load(track_proc_t * proc);
+extern int proc_slice_read(pid_t, uint64_t *);
 
 #ifdef __cplusplus
 }
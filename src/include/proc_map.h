@@ -110,6 +110,8 @@ struct _track_proc;
 
 int map_init(void);
 void map_fini(void);
+int map_file_read(const char *, map_proc_t *);
+int map_read(pid_t, map_proc_t *);
 int map_proc_load(struct _track_proc *);
 int map_proc_fini(struct _track_proc *);
 map_entry_t* map_entry_find(struct _track_proc *, uint64_t, uint64_t);
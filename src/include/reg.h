@@ -55,6 +55,8 @@ typedef struct _scroll_line {
 	int page_start;
 } scroll_line_t;
 
+struct _reg_row;
+
 typedef struct _win_reg {
 	void *hdl;
 	int begin_x;	/* offset to stdscr */
@@ -64,8 +66,12 @@ typedef struct _win_reg {
 	unsigned int mode;
 	int nlines_total;
 	void *buf;
+	int nlines_buf;		/* lines 'buf' can hold */
 	void (*line_get)(struct _win_reg *, int, char *, int);
 	scroll_line_t scroll;
+	struct _reg_row *rows;	/* what is on screen, per line */
+	uint64_t epoch;		/* bumped by reg_erase() */
+	uint64_t gen;		/* see reg_damage_reset() */
 } win_reg_t;
 
 /* Screen dimension */
@@ -75,6 +81,7 @@ extern int g_scr_width;
 extern int reg_init(win_reg_t *, int, int, int, int, unsigned int);
 extern void reg_buf_init(win_reg_t *, void *,
 	void (*line_get)(win_reg_t *, int, char *, int));
+extern void *reg_buf_reserve(win_reg_t *, int, size_t);
 extern void reg_scroll_init(win_reg_t *, boolean_t);
 extern void reg_erase(win_reg_t *);
 extern void reg_refresh(win_reg_t *);
@@ -84,8 +91,10 @@ extern void reg_win_destroy(win_reg_t *seg);
 extern void reg_line_write(win_reg_t *, int, reg_align_t, char *);
 extern void reg_highlight_write(win_reg_t *, int, int, char *);
 extern void reg_line_scroll(win_reg_t *, int);
-extern void reg_scroll_show(win_reg_t *, void *, int,
+extern void reg_scroll_show(win_reg_t *, void *, int, int,
 	void (*str_build_func)(char *, int, int, void *));
+extern void reg_scroll_window(win_reg_t *, int, int *, int *);
+extern void reg_damage_reset(void);
 extern boolean_t reg_curses_init(boolean_t);
 extern void reg_curses_fini(void);
 
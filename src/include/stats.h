@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DAMONTOP_STATS_H
+#define _DAMONTOP_STATS_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include <time.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Log-linear histogram: values below 8 have their own bucket, above that
+ * every power of two is split into 8 linear sub-buckets (error < 12.5%).
+ */
+#define	STATS_HIST_SUBBITS	3
+#define	STATS_HIST_SUBNUM	(1 << STATS_HIST_SUBBITS)
+#define	STATS_HIST_NBUCKETS	((64 - STATS_HIST_SUBBITS + 1) * STATS_HIST_SUBNUM)
+
+#define	STATS_NAME_SIZE		16
+
+typedef enum {
+	STATS_STAGE_SMPL = 0,	/* perf: os_profiling_smpl() */
+	STATS_STAGE_PROCWALK,	/* perf: walking /proc */
+	STATS_STAGE_DRAIN,	/* perf: draining the perf ring */
+	STATS_STAGE_INGEST,	/* perf: records to track_proc_t */
+	STATS_STAGE_MAPS,	/* disp: parsing /proc/<pid>/maps */
+	STATS_STAGE_SORT,	/* disp: sorting processes/regions */
+	STATS_STAGE_CMD,	/* disp: cmd_execute() */
+	STATS_STAGE_DRAW,	/* disp: page_show() */
+	STATS_STAGE_CONS,	/* cons: hotkey to command */
+	STATS_STAGE_EMIT	/* main: --batch records */
+} stats_stage_t;
+
+#define	STATS_STAGE_NUM		10
+
+typedef enum {
+	STATS_COUNT_TICK = 0,		/* sampling ticks */
+	STATS_COUNT_DRAIN_BYTES,	/* bytes drained from perf ring */
+	STATS_COUNT_DRAIN_RECS,		/* samples drained from perf ring */
+	STATS_COUNT_LOST,		/* samples lost by the kernel */
+	STATS_COUNT_DUMP_DROP		/* dump epochs dropped */
+} stats_count_t;
+
+#define	STATS_COUNT_NUM		5
+
+typedef struct _stats_hist {
+	uint64_t buckets[STATS_HIST_NBUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+} stats_hist_t;
+
+typedef struct _stats_stage_snap {
+	char name[STATS_NAME_SIZE];
+	char thread[STATS_NAME_SIZE];
+	uint64_t count;
+	uint64_t p50_ns;
+	uint64_t p99_ns;
+	uint64_t max_ns;
+	uint64_t avg_ns;
+} stats_stage_snap_t;
+
+typedef struct _stats_snap {
+	stats_stage_snap_t stages[STATS_STAGE_NUM];
+	uint64_t ticks;
+	double syscalls_per_tick;
+	double bytes_per_tick;
+	double recs_per_tick;
+	uint64_t lost;
+	uint64_t dump_drops;
+} stats_snap_t;
+
+extern void stats_init(void);
+extern uint64_t stats_ns(void);
+extern void stats_ts(uint64_t, struct timespec *);
+extern uint64_t stats_cpu_ns(void);
+extern void stats_stage_add(stats_stage_t, uint64_t);
+extern void stats_stage_end(stats_stage_t, uint64_t);
+extern void stats_count_add(stats_count_t, uint64_t);
+extern uint64_t stats_count_get(stats_count_t);
+extern void stats_snapshot(stats_snap_t *);
+extern void stats_summary_build(char *, int, stats_snap_t *);
+extern void stats_caption_build(char *, int);
+extern void stats_str_build(char *, int, int, void *);
+extern void stats_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_STATS_H */
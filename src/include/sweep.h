@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DAMONTOP_SWEEP_H
+#define _DAMONTOP_SWEEP_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define	SWEEP_GRID_MAX		16
+#define	SWEEP_WINDOW_DEFAULT	10	/* seconds per setting */
+#define	SWEEP_SAMPLES_DEFAULT	"5000,10000,20000,40000"
+#define	SWEEP_REGIONS_DEFAULT	"1000,500,200,100"
+#define	SWEEP_LAYOUT_BUF_MAX	16
+
+/* One interval of a heat profile, as +/- events on the address axis. */
+typedef struct _sweep_event {
+	uint64_t addr;
+	double delta;
+} sweep_event_t;
+
+typedef struct _sweep_prof {
+	sweep_event_t *ev;
+	int nev;
+	int cap;
+} sweep_prof_t;
+
+/* The ground truth written by datop-loadgen. */
+typedef struct _sweep_layout_buf {
+	char cls[8];		/* hot, warm or cold */
+	uint64_t start;
+	uint64_t end;
+	double rate;
+} sweep_layout_buf_t;
+
+typedef struct _sweep_layout {
+	pid_t pid;
+	int nbufs;
+	sweep_layout_buf_t bufs[SWEEP_LAYOUT_BUF_MAX];
+} sweep_layout_t;
+
+typedef struct _sweep_result {
+	uint64_t sample;
+	uint64_t aggr;
+	uint64_t min_regions;
+	uint64_t max_regions;
+	double kdamond_cpu;
+	double datop_cpu;
+	uint64_t lost;
+	double nr_regions;	/* regions per aggregation */
+	double score;
+	double precision;	/* -1: no layout */
+	boolean_t applied;
+} sweep_result_t;
+
+extern int sweep_main(int, char **);
+extern int sweep_prof_add(sweep_prof_t *, uint64_t, uint64_t, double);
+extern void sweep_prof_free(sweep_prof_t *);
+extern double sweep_prof_score(sweep_prof_t *, sweep_prof_t *);
+extern int sweep_layout_load(const char *, sweep_layout_t *);
+extern double sweep_prof_precision(sweep_prof_t *, sweep_layout_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_SWEEP_H */
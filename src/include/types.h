@@ -117,7 +117,6 @@ typedef enum {
 } ui_count_id_t;
 
 
-#define NR_KDAMON_MAX	128
 #define NCPUS_MAX		256
 #define NPROCS_MAX		4096
 
@@ -51,9 +51,12 @@ extern "C" {
 #define	MIN(a, b) ((a) < (b) ? (a) : (b))
 #endif
 
+#ifndef MAX
+#define	MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
 #define	ASSERT(expr) assert(expr)
 
-#define	DUMP_CACHE_SIZE	256*1024
 #define	LOGFILE_PATH	"/tmp/damontop.log"
 
 typedef struct _debug_ctl {
@@ -61,13 +64,11 @@ typedef struct _debug_ctl {
 	boolean_t inited;
 } debug_ctl_t;
 
-typedef struct _dump_ctl {
-	FILE *fout;
-	char *cache;
-	char *pcur;
-	int rest_size;
-	boolean_t cache_mode;
-} dump_ctl_t;
+typedef enum {
+	DUMP_COMPRESS_NONE = 0,
+	DUMP_COMPRESS_GZIP,
+	DUMP_COMPRESS_ZSTD
+} dump_compress_t;
 
 extern struct timeval g_tvbase;
 extern int g_pagesize;
@@ -77,17 +78,23 @@ extern void *zalloc(size_t n);
 extern int debug_init(int, FILE *);
 extern void debug_fini(void);
 extern void debug_print(FILE *out, int level, const char *fmt, ...);
+extern void monotonic_tv(struct timeval *);
 extern uint64_t current_ms(struct timeval *);
 extern void sleep_ms(int ms);
 extern double ratio(uint64_t value1, uint64_t value2);
+extern int procfs_walk(char *, int **, int *);
 extern int procfs_enum_id(char *, int **, int *);
 extern int procfs_proc_enum(pid_t **, int *);
+extern int damon_target_ids_load(pid_t **, int *);
 extern void exit_msg_put(const char *fmt, ...);
 extern void exit_msg_print(void);
 extern uint64_t cyc2ns(uint64_t);
-extern int dump_init(FILE *);
+extern int dump_init(FILE *, const char *);
 extern void dump_fini(void);
 extern void dump_write(const char *fmt, ...);
+extern void dump_epoch_end(void);
+extern int dump_rotate_parse(const char *);
+extern int dump_compress_parse(const char *);
 extern void dump_cache_enable(void);
 extern void dump_cache_disable(void);
 extern void dump_cache_flush(void);
@@ -98,6 +105,7 @@ extern uint64_t rdtsc(void);
 extern int arch__cpuinfo_freq(double *freq, char *unit);
 extern int is_userspace(uint64_t);
 extern unsigned long exec_cmd_return_ulong(char *cmd, int base);
+extern int pct_parse(const char *, double *);
 
 #ifdef __cplusplus
 }
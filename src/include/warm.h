@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _DAMONTOP_WARM_H
+#define _DAMONTOP_WARM_H
+
+#include <sys/types.h>
+#include <inttypes.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define	WARM_CMDLINE_SIZE	512
+#define	WARM_CGROUP_SIZE	256
+#define	WARM_LINE_SIZE		1024
+
+/*
+ * A saved target is used only when at least this percent of its
+ * regions (in bytes) is still mapped in the new target.
+ */
+#define	WARM_COVER_MIN		50
+
+typedef struct _warm_region {
+	uint64_t start;
+	uint64_t end;
+} warm_region_t;
+
+/*
+ * The region layout of one target, as saved in the warm-start file.
+ * The target is matched by the cmdline, then by the cgroup, since the
+ * pid rarely survives the restart of a service.
+ */
+typedef struct _warm_target {
+	pid_t pid;
+	char cgroup[WARM_CGROUP_SIZE];
+	char cmdline[WARM_CMDLINE_SIZE];
+	warm_region_t *regions;
+	int nregions;
+	int regions_size;
+	boolean_t used;
+} warm_target_t;
+
+typedef struct _warm_layout {
+	warm_target_t *targets;
+	int ntargets;
+	int size;
+} warm_layout_t;
+
+typedef struct _warm_zoom {
+	boolean_t zoomed;
+	pid_t pid;
+	uint64_t start;
+	uint64_t end;
+} warm_zoom_t;
+
+extern int warm_parse(const char *);
+extern boolean_t warm_enabled(void);
+extern void warm_fini(void);
+extern int warm_save(void);
+extern void warm_seed(void);
+extern int warm_regions_stage(pid_t);
+extern int warm_zoom(pid_t, uint64_t, uint64_t);
+extern int warm_unzoom(void);
+extern boolean_t warm_zoomed(pid_t, uint64_t *, uint64_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DAMONTOP_WARM_H */
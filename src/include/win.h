@@ -49,15 +49,16 @@ extern int g_sortkey;
 #define	WIN_PROCNAME_SIZE	12
 #define	WIN_DESCBUF_SIZE	32
 #define	WIN_LINECHAR_MAX	1024
-#define	WIN_NLINES_MAX		4096
+#define	WIN_PREFETCH_LINES	16
 
 #define	GO_HOME_WAIT	3
 
 #define	NOTE_DEFAULT \
-	"Q: Quit; H: Home; B: Back; R: Refresh; D: DAMON"
+	"Q: Quit; H: Home; B: Back; R: Refresh; D: DAMON; T: Stats; C: Cgroup; " \
+	"P: Paddr"
 
 #define	NOTE_TOPNPROC_RAW \
-	"Q: Quit; H: Home; R: Refresh; D: DAMON"
+	"Q: Quit; H: Home; R: Refresh; D: DAMON; T: Stats; C: Cgroup; P: Paddr"
 
 #define NOTE_TOPNPROC	NOTE_DEFAULT
 
@@ -65,7 +66,7 @@ extern int g_sortkey;
 
 #define	NOTE_MONIPROC \
 	"Q: Quit; H: Home; B: Back; R: Refresh; " \
-	"D: DAMON; L: Map-list"
+	"D: DAMON; L: Map-list; T: Stats; Z/U: Zoom in/out"
 
 #define	NOTE_MONILWP 	NOTE_MONIPROC
 
@@ -74,6 +75,9 @@ extern int g_sortkey;
 
 #define	NOTE_DAMON_OVERVIEW NOTE_NONODE
 #define	NOTE_DAMON_DETAIL NOTE_NONODE
+#define	NOTE_SELFSTATS NOTE_NONODE
+#define	NOTE_CGROUP NOTE_NONODE
+#define	NOTE_PADDR NOTE_NONODE
 
 #define	NOTE_INVALID_PID \
 	"Invalid process id! (Q: Quit; H: Home)"
@@ -119,6 +123,8 @@ extern int g_sortkey;
 #define	CAPTION_AVGLAT		"LAT(ns)"
 #define	CAPTION_NPROC		"NPROC"
 #define	CAPTION_RSS			"RSS"
+#define	CAPTION_REGIONS_SEC	"REGIONS/s"
+#define	CAPTION_COST		"MS/MCHK"
 #define CAPTION_LLC_OCCUPANCY	"LLC.OCCUPANCY(MB)"
 #define CAPTION_TOTAL_BW	"MBAND.TOTAL"
 #define CAPTION_LOCAL_BW	"MBAND.LOCAL"
@@ -129,6 +135,9 @@ typedef enum {
 	WIN_TYPE_MAPLIST_PROC,
 	WIN_TYPE_DAMON_OVERVIEW,
 	WIN_TYPE_DAMON_DETAIL,
+	WIN_TYPE_SELFSTATS,
+	WIN_TYPE_CGROUP,
+	WIN_TYPE_PADDR,
 } win_type_t;
 
 #define	WIN_TYPE_NUM		20
@@ -192,6 +201,7 @@ typedef struct _topnproc_line {
 	char map_attr[4 + 1];
 	int pid;
 	int nlwp;
+	boolean_t resolved;	/* map_name/map_attr are filled */
 } topnproc_line_t;
 
 typedef struct _dyn_moniproc {
@@ -208,6 +218,7 @@ typedef struct _moni_line {
 	char map_name[WIN_DESCBUF_SIZE];
 	char map_attr[4 + 1];
 	pid_t pid;
+	boolean_t resolved;	/* map_name/map_attr are filled */
 } moni_line_t;
 
 typedef struct _dyn_topnlwp {
@@ -256,10 +267,11 @@ typedef struct _damon_overview_line {
 	int nid;
 	int pid; /* kdamon pid */
 	int nr_proc;
-	double rss;
 	int sample; /* us */
 	int aggr;
 	int update;
+	double regions_sec; /* region checks per second */
+	double cost; /* CPU ms per million region checks */
 } damon_overview_line_t;
 
 typedef struct _dyn_damondetail {
@@ -270,6 +282,27 @@ typedef struct _dyn_damondetail {
 	win_reg_t hint;
 } dyn_damondetail_t;
 
+typedef struct _dyn_selfstats {
+	win_reg_t msg;
+	win_reg_t caption;
+	win_reg_t data;
+	win_reg_t hint;
+} dyn_selfstats_t;
+
+typedef struct _dyn_cgroup {
+	win_reg_t msg;
+	win_reg_t caption;
+	win_reg_t data;
+	win_reg_t hint;
+} dyn_cgroup_t;
+
+typedef struct _dyn_paddr {
+	win_reg_t msg;
+	win_reg_t caption;
+	win_reg_t data;
+	win_reg_t hint;
+} dyn_paddr_t;
+
 typedef struct _dyn_warn {
 	win_reg_t msg;
 	win_reg_t pad;
@@ -287,6 +320,8 @@ typedef struct _dyn_warn {
 #define	DYN_DAMON_DETAIL(page) \
 	((dyn_damondetail_t *)((page)->dyn_win.dyn))
 
+struct _page;
+
 /* CPU unhalted cycles in a second */
 extern uint64_t g_clkofsec;
 
@@ -304,7 +339,10 @@ extern maplist_line_t* win_maplist_buf_create(track_proc_t *, int *);
 extern void win_maplist_buf_fill(maplist_line_t *, int, track_proc_t *);
 extern int win_maplist_cmp(const void *, const void *);
 extern void win_maplist_str_build(char *, int, int, void *);
+extern void topnproc_str_build(char *, int, int, void *);
+extern void moni_str_build(char *, int, int, void *);
 extern void win_size2str(uint64_t, char *, int);
+extern int win_zoom_range(struct _page *, pid_t *, uint64_t *, uint64_t *);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,483 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains datop-loadgen, a deterministic memory access workload
+ * for the precision and overhead testing of datop.
+ *
+ * Each buffer is touched (one write per page) by its own thread at a known
+ * rate, in passes per second over the whole buffer, in sequential, random
+ * (fixed seed) or strided page order. The ground-truth layout is written
+ * once the buffers are faulted in, and is read by "datop validate".
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <numa.h>
+
+#define	LG_BUF_MAX		16
+#define	LG_CLASS_SIZE		8
+#define	LG_STRIDE_PAGES		16
+#define	LG_NS_SEC		1000000000ULL
+#define	LG_SEED_DEFAULT		0x5eed
+
+typedef enum {
+	LG_PATTERN_SEQ = 0,
+	LG_PATTERN_RAND,
+	LG_PATTERN_STRIDE,
+	LG_PATTERN_NUM
+} lg_pattern_t;
+
+static const char *s_pattern_name[LG_PATTERN_NUM] = {
+	"seq", "rand", "stride"
+};
+
+typedef struct _lg_buf {
+	char cls[LG_CLASS_SIZE];	/* hot, warm or cold */
+	size_t size;
+	double rate;			/* passes per second */
+	lg_pattern_t pattern;
+	int node;			/* -1: not bound */
+	char *addr;
+	size_t npages;
+	size_t *order;			/* page order of one pass */
+	uint64_t passes;
+	pthread_t thr;
+} lg_buf_t;
+
+static lg_buf_t s_bufs[LG_BUF_MAX];
+static int s_nbufs;
+static size_t s_pagesize;
+static volatile sig_atomic_t s_quit;
+
+static void lg_usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-b class:size:rate[:pattern[:node]]]... "
+		"[-t secs] [-o layout] [-s seed]\n", name);
+	fprintf(stderr,
+		"  -b    a buffer, may be repeated (max %d).\n"
+		"        class  : hot, warm or cold (the ground truth)\n"
+		"        size   : bytes, with K/M/G suffix\n"
+		"        rate   : passes over the buffer per second (0: never)\n"
+		"        pattern: seq (default), rand or stride\n"
+		"        node   : NUMA node to allocate on (default: none)\n"
+		"        default: -b hot:64M:20:rand -b warm:64M:2 "
+		"-b cold:256M:0\n"
+		"  -t    run time in seconds (default: until SIGINT)\n"
+		"  -o    path of the layout file (default: stdout)\n"
+		"  -s    seed of the random page order\n", LG_BUF_MAX);
+}
+
+static uint64_t lg_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * LG_NS_SEC + (uint64_t)ts.tv_nsec);
+}
+
+static int lg_size_parse(const char *str, size_t *size)
+{
+	char *end;
+	double v;
+
+	v = strtod(str, &end);
+	if (end == str || v <= 0) {
+		return (-1);
+	}
+
+	switch (*end) {
+	case 'g':
+	case 'G':
+		v *= 1024;
+		/* FALLTHROUGH */
+	case 'm':
+	case 'M':
+		v *= 1024;
+		/* FALLTHROUGH */
+	case 'k':
+	case 'K':
+		v *= 1024;
+		end++;
+		break;
+	default:
+		break;
+	}
+
+	if (*end != 0) {
+		return (-1);
+	}
+
+	*size = (size_t)v;
+	return (0);
+}
+
+/*
+ * Parse "class:size:rate[:pattern[:node]]".
+ */
+static int lg_buf_parse(const char *spec, lg_buf_t *buf)
+{
+	char str[128], *field[5], *saveptr = NULL, *end;
+	int n = 0, i;
+
+	if (strlen(spec) >= sizeof(str)) {
+		return (-1);
+	}
+
+	(void)strncpy(str, spec, sizeof(str));
+	for (field[n] = strtok_r(str, ":", &saveptr); field[n] != NULL;
+	    field[n] = strtok_r(NULL, ":", &saveptr)) {
+		if (++n == 5) {
+			break;
+		}
+	}
+
+	if (n < 3 || strlen(field[0]) >= LG_CLASS_SIZE) {
+		return (-1);
+	}
+
+	if (strcmp(field[0], "hot") != 0 && strcmp(field[0], "warm") != 0 &&
+	    strcmp(field[0], "cold") != 0) {
+		return (-1);
+	}
+
+	memset(buf, 0, sizeof(lg_buf_t));
+	(void)strcpy(buf->cls, field[0]);
+	if (lg_size_parse(field[1], &buf->size) != 0) {
+		return (-1);
+	}
+
+	buf->rate = strtod(field[2], &end);
+	if (end == field[2] || *end != 0 || buf->rate < 0) {
+		return (-1);
+	}
+
+	buf->pattern = LG_PATTERN_SEQ;
+	if (n > 3) {
+		for (i = 0; i < LG_PATTERN_NUM; i++) {
+			if (strcmp(field[3], s_pattern_name[i]) == 0) {
+				break;
+			}
+		}
+		if (i == LG_PATTERN_NUM) {
+			return (-1);
+		}
+		buf->pattern = (lg_pattern_t)i;
+	}
+
+	buf->node = -1;
+	if (n > 4) {
+		buf->node = strtol(field[4], &end, 10);
+		if (end == field[4] || *end != 0 || buf->node < 0) {
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * xorshift64, so the random order only depends on the seed.
+ */
+static uint64_t lg_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return (x);
+}
+
+static int lg_order_init(lg_buf_t *buf, uint64_t seed)
+{
+	size_t i, j, k, tmp;
+
+	if ((buf->order = malloc(sizeof(size_t) * buf->npages)) == NULL) {
+		return (-1);
+	}
+
+	switch (buf->pattern) {
+	case LG_PATTERN_STRIDE:
+		k = 0;
+		for (i = 0; i < LG_STRIDE_PAGES; i++) {
+			for (j = i; j < buf->npages; j += LG_STRIDE_PAGES) {
+				buf->order[k++] = j;
+			}
+		}
+		break;
+
+	case LG_PATTERN_RAND:
+		for (i = 0; i < buf->npages; i++) {
+			buf->order[i] = i;
+		}
+		for (i = buf->npages - 1; i > 0; i--) {
+			j = lg_rand(&seed) % (i + 1);
+			tmp = buf->order[i];
+			buf->order[i] = buf->order[j];
+			buf->order[j] = tmp;
+		}
+		break;
+
+	default:
+		for (i = 0; i < buf->npages; i++) {
+			buf->order[i] = i;
+		}
+		break;
+	}
+
+	return (0);
+}
+
+static int lg_buf_alloc(lg_buf_t *buf, uint64_t seed)
+{
+	buf->size = (buf->size + s_pagesize - 1) / s_pagesize * s_pagesize;
+	buf->npages = buf->size / s_pagesize;
+
+	if (buf->node >= 0) {
+		if (numa_available() < 0 || buf->node > numa_max_node()) {
+			fprintf(stderr, "NUMA node %d is not available.\n",
+				buf->node);
+			return (-1);
+		}
+		buf->addr = numa_alloc_onnode(buf->size, buf->node);
+	} else {
+		buf->addr = mmap(NULL, buf->size, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf->addr == MAP_FAILED) {
+			buf->addr = NULL;
+		}
+	}
+
+	if (buf->addr == NULL) {
+		fprintf(stderr, "Fail to allocate %zu bytes.\n", buf->size);
+		return (-1);
+	}
+
+	/* No THP, DAMON regions should follow the buffers exactly. */
+	(void)madvise(buf->addr, buf->size, MADV_NOHUGEPAGE);
+
+	/* Fault in all the pages, cold buffers are resident too. */
+	memset(buf->addr, 1, buf->size);
+	return (lg_order_init(buf, seed));
+}
+
+static void lg_buf_free(lg_buf_t *buf)
+{
+	if (buf->addr != NULL) {
+		if (buf->node >= 0) {
+			numa_free(buf->addr, buf->size);
+		} else {
+			(void)munmap(buf->addr, buf->size);
+		}
+	}
+
+	free(buf->order);
+}
+
+/*
+ * Touch the buffer 'rate' times per second. Each pass is scheduled at
+ * an absolute time, so a slow pass doesn't shift the following ones.
+ */
+static void *lg_touch_thread(void *arg)
+{
+	lg_buf_t *buf = (lg_buf_t *)arg;
+	volatile char *p = buf->addr;
+	uint64_t period, next;
+	struct timespec ts;
+	size_t i;
+
+	if (buf->rate <= 0) {
+		return (NULL);
+	}
+
+	period = (uint64_t)((double)LG_NS_SEC / buf->rate);
+	next = lg_ns();
+	while (!s_quit) {
+		for (i = 0; i < buf->npages && !s_quit; i++) {
+			p[buf->order[i] * s_pagesize]++;
+		}
+		__atomic_add_fetch(&buf->passes, 1, __ATOMIC_RELAXED);
+
+		next += period;
+		ts.tv_sec = next / LG_NS_SEC;
+		ts.tv_nsec = next % LG_NS_SEC;
+		(void)clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+
+	return (NULL);
+}
+
+/*
+ * The layout, one buffer per line:
+ * buf <class> <start> <end> <rate> <pattern> <node>
+ */
+static void lg_layout_write(FILE *fp)
+{
+	lg_buf_t *buf;
+	int i;
+
+	fprintf(fp, "# datop-loadgen layout v1\n");
+	fprintf(fp, "pid %d\n", (int)getpid());
+	fprintf(fp, "pagesize %zu\n", s_pagesize);
+	fprintf(fp, "# buf class start end rate pattern node\n");
+	for (i = 0; i < s_nbufs; i++) {
+		buf = &s_bufs[i];
+		fprintf(fp, "buf %s 0x%" PRIxPTR " 0x%" PRIxPTR " %.3f %s %d\n",
+			buf->cls, (uintptr_t)buf->addr,
+			(uintptr_t)buf->addr + buf->size, buf->rate,
+			s_pattern_name[buf->pattern], buf->node);
+	}
+
+	fflush(fp);
+}
+
+static void lg_sig_handler(int sig __attribute__ ((unused)))
+{
+	s_quit = 1;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *defaults[] = {
+		"hot:64M:20:rand", "warm:64M:2", "cold:256M:0"
+	};
+	uint64_t seed = LG_SEED_DEFAULT, start_ns;
+	FILE *layout = stdout;
+	double secs;
+	int c, i, run_secs = 0, ret = 1;
+
+	s_pagesize = (size_t)sysconf(_SC_PAGESIZE);
+	while ((c = getopt(argc, argv, "b:t:o:s:h")) != EOF) {
+		switch (c) {
+		case 'b':
+			if (s_nbufs >= LG_BUF_MAX ||
+			    lg_buf_parse(optarg, &s_bufs[s_nbufs]) != 0) {
+				fprintf(stderr, "Invalid buffer '%s'.\n", optarg);
+				lg_usage(argv[0]);
+				return (1);
+			}
+			s_nbufs++;
+			break;
+
+		case 't':
+			run_secs = atoi(optarg);
+			break;
+
+		case 'o':
+			if ((layout = fopen(optarg, "w")) == NULL) {
+				fprintf(stderr, "Cannot open '%s'.\n", optarg);
+				return (1);
+			}
+			break;
+
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			if (seed == 0) {
+				seed = LG_SEED_DEFAULT;
+			}
+			break;
+
+		case 'h':
+		default:
+			lg_usage(argv[0]);
+			return (c == 'h' ? 0 : 1);
+		}
+	}
+
+	if (s_nbufs == 0) {
+		for (i = 0; i < (int)(sizeof(defaults) / sizeof(defaults[0]));
+		    i++) {
+			(void)lg_buf_parse(defaults[i], &s_bufs[s_nbufs++]);
+		}
+	}
+
+	for (i = 0; i < s_nbufs; i++) {
+		if (lg_buf_alloc(&s_bufs[i], seed + i) != 0) {
+			goto L_EXIT;
+		}
+	}
+
+	(void)signal(SIGINT, lg_sig_handler);
+	(void)signal(SIGTERM, lg_sig_handler);
+	lg_layout_write(layout);
+
+	start_ns = lg_ns();
+	for (i = 0; i < s_nbufs; i++) {
+		if (pthread_create(&s_bufs[i].thr, NULL, lg_touch_thread,
+		    &s_bufs[i]) != 0) {
+			s_quit = 1;
+			s_nbufs = i;
+			break;
+		}
+	}
+
+	while (!s_quit) {
+		if (run_secs > 0 &&
+		    lg_ns() - start_ns >= (uint64_t)run_secs * LG_NS_SEC) {
+			break;
+		}
+		(void)usleep(100000);
+	}
+
+	s_quit = 1;
+	for (i = 0; i < s_nbufs; i++) {
+		(void)pthread_join(s_bufs[i].thr, NULL);
+	}
+
+	/* The achieved rates, to check that the workload kept up. */
+	secs = (double)(lg_ns() - start_ns) / LG_NS_SEC;
+	for (i = 0; i < s_nbufs; i++) {
+		fprintf(stderr, "%-5s %10zu KiB  rate %8.3f/s  achieved "
+			"%8.3f/s\n", s_bufs[i].cls, s_bufs[i].size / 1024,
+			s_bufs[i].rate, (double)s_bufs[i].passes / secs);
+	}
+
+	ret = 0;
+
+L_EXIT:
+	for (i = 0; i < LG_BUF_MAX; i++) {
+		lg_buf_free(&s_bufs[i]);
+	}
+
+	if (layout != stdout) {
+		(void)fclose(layout);
+	}
+
+	return (ret);
+}
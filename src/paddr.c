@@ -0,0 +1,751 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * This file contains the physical address monitoring (--paddr): one
+ * DAMON 'paddr' kdamond per NUMA node covers the memory ranges of the
+ * node, and the regions of its snapshots are attributed to the memory
+ * cgroups by looking up a bounded number of their pages in
+ * /proc/kpagecgroup and /proc/kpageflags.
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/win.h"
+#include "include/cgroup.h"
+#include "include/damon_sysfs.h"
+#include "include/paddr.h"
+#include "include/os/os_util.h"
+
+static paddr_t s_paddr = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.kpc_fd = -1,
+	.kpf_fd = -1
+};
+
+/* The cgroup tree nftw() is walking, the names are relative to it. */
+static const char *s_paddr_walk_root;
+
+static int u64_cmp(const void *a, const void *b)
+{
+	const uint64_t *v1 = (const uint64_t *)a;
+	const uint64_t *v2 = (const uint64_t *)b;
+
+	return ((*v1 > *v2) - (*v1 < *v2));
+}
+
+static uint64_t paddr_block_size(void)
+{
+	char buf[32];
+	FILE *fp;
+	uint64_t size = 0;
+
+	if ((fp = fopen(PADDR_MEMORY_PATH "/block_size_bytes", "r")) != NULL) {
+		if (fgets(buf, sizeof(buf), fp) != NULL) {
+			size = strtoull(buf, NULL, 16);
+		}
+
+		(void)fclose(fp);
+	}
+
+	return (size);
+}
+
+/*
+ * An offline memory block has no page, DAMON would only find it idle.
+ */
+static boolean_t paddr_block_online(uint64_t block)
+{
+	char path[PATH_MAX], buf[16] = { 0 };
+	boolean_t online = B_TRUE;
+	FILE *fp;
+
+	(void)snprintf(path, sizeof(path), PADDR_MEMORY_PATH
+		       "/memory%" PRIu64 "/state", block);
+	if ((fp = fopen(path, "r")) != NULL) {
+		if (fgets(buf, sizeof(buf), fp) != NULL) {
+			online = (strncmp(buf, "online", 6) == 0);
+		}
+
+		(void)fclose(fp);
+	}
+
+	return (online);
+}
+
+static int paddr_range_add(paddr_node_t *node, uint64_t start, uint64_t end)
+{
+	damon_sysfs_range_t *arr;
+	int size;
+
+	if (node->nranges > 0 && node->ranges[node->nranges - 1].end == start) {
+		node->ranges[node->nranges - 1].end = end;
+		return (0);
+	}
+
+	if (node->nranges == node->size) {
+		size = MAX(node->size * 2, 8);
+		if ((arr = realloc(node->ranges,
+		    sizeof(damon_sysfs_range_t) * size)) == NULL) {
+			return (-1);
+		}
+
+		node->ranges = arr;
+		node->size = size;
+	}
+
+	node->ranges[node->nranges].start = start;
+	node->ranges[node->nranges].end = end;
+	node->nranges++;
+	return (0);
+}
+
+/*
+ * The memory ranges of the node: its memory blocks ("memoryN" in the
+ * node directory) are listed, and the adjacent ones are merged.
+ */
+static int paddr_node_load(paddr_node_t *node, uint64_t block_size)
+{
+	char path[PATH_MAX];
+	struct dirent *ent;
+	uint64_t *blocks = NULL, *arr;
+	int i, n = 0, size = 0, ret = -1;
+	DIR *dir;
+
+	(void)snprintf(path, sizeof(path), PADDR_NODE_PATH "/node%d",
+		       node->nid);
+	if ((dir = opendir(path)) == NULL) {
+		return (-1);
+	}
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (strncmp(ent->d_name, "memory", 6) != 0 ||
+		    ent->d_name[6] < '0' || ent->d_name[6] > '9') {
+			continue;
+		}
+
+		if (n == size) {
+			size = MAX(size * 2, 64);
+			if ((arr = realloc(blocks, sizeof(uint64_t) * size)) ==
+			    NULL) {
+				goto L_EXIT;
+			}
+
+			blocks = arr;
+		}
+
+		blocks[n++] = strtoull(ent->d_name + 6, NULL, 10);
+	}
+
+	qsort(blocks, n, sizeof(uint64_t), u64_cmp);
+	for (i = 0; i < n; i++) {
+		if (!paddr_block_online(blocks[i])) {
+			continue;
+		}
+
+		if (paddr_range_add(node, blocks[i] * block_size,
+				    (blocks[i] + 1) * block_size) != 0) {
+			goto L_EXIT;
+		}
+
+		node->total += block_size;
+	}
+
+	ret = 0;
+
+L_EXIT:
+	(void)closedir(dir);
+	free(blocks);
+	return (ret);
+}
+
+static void paddr_nodes_free(void)
+{
+	int i;
+
+	for (i = 0; i < s_paddr.nnodes; i++) {
+		free(s_paddr.nodes[i].ranges);
+	}
+
+	free(s_paddr.nodes);
+	s_paddr.nodes = NULL;
+	s_paddr.nnodes = 0;
+}
+
+/*
+ * The online nodes which have memory.
+ */
+static int paddr_nodes_load(void)
+{
+	int node_arr[NCPUS_MAX], i, num;
+	uint64_t block_size;
+	paddr_node_t *node;
+
+	if ((block_size = paddr_block_size()) == 0 ||
+	    !os_sysfs_node_enum(node_arr, NCPUS_MAX, &num) || num <= 0) {
+		return (-1);
+	}
+
+	if ((s_paddr.nodes = zalloc(sizeof(paddr_node_t) * num)) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < num; i++) {
+		node = &s_paddr.nodes[s_paddr.nnodes];
+		node->nid = node_arr[i];
+		if (paddr_node_load(node, block_size) != 0) {
+			paddr_nodes_free();
+			return (-1);
+		}
+
+		if (node->nranges == 0) {
+			free(node->ranges);
+			(void)memset(node, 0, sizeof(paddr_node_t));
+			continue;
+		}
+
+		debug_print(NULL, 2, "paddr: node %d has %d ranges, %" PRIu64
+			    " bytes\n", node->nid, node->nranges, node->total);
+		s_paddr.nnodes++;
+	}
+
+	return ((s_paddr.nnodes > 0) ? 0 : -1);
+}
+
+/*
+ * Start one 'paddr' kdamond for each node with memory. The cgroups are
+ * only attributed if the kpage files can be read.
+ */
+int paddr_start(void)
+{
+	int nodes[NCPUS_MAX], k;
+
+	if (!damon_sysfs_supported()) {
+		stderr_print("--paddr needs the DAMON sysfs interface.\n");
+		return (-1);
+	}
+
+	if (paddr_nodes_load() != 0) {
+		stderr_print("No memory found in %s.\n", PADDR_NODE_PATH);
+		return (-1);
+	}
+
+	if ((s_paddr.regs = zalloc(sizeof(damon_sysfs_region_t) *
+				   PADDR_REGIONS_MAX)) == NULL) {
+		goto L_FAIL;
+	}
+
+	for (k = 0; k < s_paddr.nnodes; k++) {
+		nodes[k] = s_paddr.nodes[k].nid;
+	}
+
+	if (damon_sysfs_paddr_setup(nodes, s_paddr.nnodes) != 0) {
+		goto L_FAIL;
+	}
+
+	for (k = 0; k < s_paddr.nnodes; k++) {
+		if (damon_sysfs_kdamond_regions(k, s_paddr.nodes[k].ranges,
+						s_paddr.nodes[k].nranges) != 0) {
+			damon_sysfs_stop();
+			goto L_FAIL;
+		}
+	}
+
+	if (damon_sysfs_on() != 0) {
+		goto L_FAIL;
+	}
+
+	s_paddr.pgsize = sysconf(_SC_PAGESIZE);
+	s_paddr.kpc_fd = open(PADDR_KPAGECGROUP, O_RDONLY);
+	s_paddr.kpf_fd = open(PADDR_KPAGEFLAGS, O_RDONLY);
+	if (!paddr_cgroup_on()) {
+		debug_print(NULL, 2, "paddr: can't read the kpage files (%d), "
+			    "no cgroup is attributed\n", errno);
+	}
+
+	s_paddr.enabled = B_TRUE;
+	return (0);
+
+L_FAIL:
+	paddr_fini();
+	return (-1);
+}
+
+void paddr_fini(void)
+{
+	if (s_paddr.kpc_fd >= 0) {
+		(void)close(s_paddr.kpc_fd);
+	}
+
+	if (s_paddr.kpf_fd >= 0) {
+		(void)close(s_paddr.kpf_fd);
+	}
+
+	paddr_nodes_free();
+	free(s_paddr.regs);
+	free(s_paddr.work.lines);
+	free(s_paddr.pub.lines);
+	free(s_paddr.names);
+	(void)memset(&s_paddr.work, 0, sizeof(paddr_table_t));
+	(void)memset(&s_paddr.pub, 0, sizeof(paddr_table_t));
+	s_paddr.regs = NULL;
+	s_paddr.names = NULL;
+	s_paddr.nnames = s_paddr.names_size = 0;
+	s_paddr.kpc_fd = s_paddr.kpf_fd = -1;
+	s_paddr.enabled = B_FALSE;
+}
+
+boolean_t paddr_enabled(void)
+{
+	return (s_paddr.enabled);
+}
+
+int paddr_nnodes(void)
+{
+	return (s_paddr.nnodes);
+}
+
+boolean_t paddr_cgroup_on(void)
+{
+	return (s_paddr.kpc_fd >= 0 && s_paddr.kpf_fd >= 0);
+}
+
+/*
+ * Start the table over with one line per node.
+ */
+static int paddr_table_reset(paddr_table_t *t)
+{
+	paddr_line_t *line;
+	int i;
+
+	if (t->size < s_paddr.nnodes) {
+		if ((line = realloc(t->lines, sizeof(paddr_line_t) *
+				    s_paddr.nnodes)) == NULL) {
+			return (-1);
+		}
+
+		t->lines = line;
+		t->size = s_paddr.nnodes;
+	}
+
+	(void)memset(t->lines, 0, sizeof(paddr_line_t) * s_paddr.nnodes);
+	for (i = 0; i < s_paddr.nnodes; i++) {
+		line = &t->lines[i];
+		line->nid = s_paddr.nodes[i].nid;
+		line->size = s_paddr.nodes[i].total;
+		(void)snprintf(line->name, sizeof(line->name), "node%d",
+			       line->nid);
+	}
+
+	t->nlines = s_paddr.nnodes;
+	return (0);
+}
+
+/*
+ * The line of the memory cgroup 'ino' in the work table.
+ */
+static paddr_line_t *paddr_memcg_line(uint64_t ino)
+{
+	paddr_table_t *t = &s_paddr.work;
+	paddr_line_t *line;
+	int i, size;
+
+	for (i = s_paddr.nnodes; i < t->nlines; i++) {
+		if (t->lines[i].ino == ino) {
+			return (&t->lines[i]);
+		}
+	}
+
+	if (t->nlines == t->size) {
+		size = MAX(t->size * 2, 16);
+		if ((line = realloc(t->lines, sizeof(paddr_line_t) * size)) ==
+		    NULL) {
+			return (NULL);
+		}
+
+		t->lines = line;
+		t->size = size;
+	}
+
+	line = &t->lines[t->nlines++];
+	(void)memset(line, 0, sizeof(paddr_line_t));
+	line->nid = -1;
+	line->ino = ino;
+	return (line);
+}
+
+static void paddr_line_add(paddr_line_t *line, uint64_t bytes,
+		uint32_t nr_accesses, uint64_t hot_access)
+{
+	line->nregions++;
+	if (nr_accesses > 0) {
+		line->wss += bytes;
+	}
+
+	if (nr_accesses >= hot_access) {
+		line->hot += bytes;
+	}
+
+	line->access += bytes * nr_accesses;
+}
+
+/*
+ * Read the memory cgroups and the flags of 'n' pages from 'pfn' on,
+ * with one pread of each kpage file. Return the pages read.
+ */
+static int paddr_pfns_read(uint64_t pfn, int n, uint64_t *cgs,
+		uint64_t *flags)
+{
+	off_t off = (off_t)(pfn * sizeof(uint64_t));
+	ssize_t len1, len2;
+
+	len1 = pread(s_paddr.kpc_fd, cgs, sizeof(uint64_t) * n, off);
+	len2 = pread(s_paddr.kpf_fd, flags, sizeof(uint64_t) * n, off);
+	if (len1 <= 0 || len2 <= 0) {
+		return (0);
+	}
+
+	return (MIN(len1, len2) / sizeof(uint64_t));
+}
+
+/*
+ * Add the region 'r' of the node 'k' to the work table. The bytes of
+ * the region are split over the memory cgroups by the share of the
+ * looked up pages charged to each one. The free pages (and the holes)
+ * count for nobody.
+ */
+static void paddr_region_account(int k, damon_sysfs_region_t *r,
+		uint64_t hot_access)
+{
+	uint64_t cgs[PADDR_PFNS_MAX], flags[PADDR_PFNS_MAX];
+	uint64_t inos[PADDR_PFNS_MAX], first, npfns, pfn, bytes, share;
+	int counts[PADDR_PFNS_MAX];
+	int s, nspots, span, i, j, n, nsampled = 0, ninos = 0;
+	paddr_line_t *line;
+
+	if (r->end <= r->start) {
+		return;
+	}
+
+	bytes = r->end - r->start;
+	paddr_line_add(&s_paddr.work.lines[k], bytes, r->nr_accesses,
+		       hot_access);
+	if (!paddr_cgroup_on()) {
+		return;
+	}
+
+	first = r->start / s_paddr.pgsize;
+	npfns = MAX(bytes / s_paddr.pgsize, 1);
+	if (npfns <= PADDR_PFNS_MAX) {
+		nspots = 1;
+		span = (int)npfns;
+	} else {
+		nspots = PADDR_SPOTS;
+		span = PADDR_SPOT_PFNS;
+	}
+
+	for (s = 0; s < nspots; s++) {
+		pfn = first;
+		if (nspots > 1) {
+			pfn += (npfns - span) * s / (nspots - 1);
+		}
+
+		n = paddr_pfns_read(pfn, span, cgs, flags);
+		for (i = 0; i < n; i++) {
+			nsampled++;
+			if (flags[i] & ((1ULL << PADDR_KPF_BUDDY) |
+					(1ULL << PADDR_KPF_NOPAGE))) {
+				continue;
+			}
+
+			for (j = 0; j < ninos && inos[j] != cgs[i]; j++)
+				;
+
+			if (j == ninos) {
+				inos[ninos] = cgs[i];
+				counts[ninos++] = 0;
+			}
+
+			counts[j]++;
+		}
+	}
+
+	for (j = 0; j < ninos; j++) {
+		if ((line = paddr_memcg_line(inos[j])) == NULL) {
+			break;
+		}
+
+		share = bytes * counts[j] / nsampled;
+		line->size += share;
+		paddr_line_add(line, share, r->nr_accesses, hot_access);
+	}
+}
+
+/*
+ * Pull a snapshot of the regions of every node, and publish what they
+ * add up to. Called by the perf thread, return the number of regions.
+ */
+int paddr_smpl(void)
+{
+	paddr_table_t t;
+	uint64_t sample, aggr, hot_access;
+	int k, i, n, nregions = 0;
+
+	if (!s_paddr.enabled || paddr_table_reset(&s_paddr.work) != 0) {
+		return (0);
+	}
+
+	for (k = 0; k < MIN(s_paddr.nnodes, damon_sysfs_nkdamonds()); k++) {
+		if ((n = damon_sysfs_snapshot(k, s_paddr.regs,
+					      PADDR_REGIONS_MAX)) <= 0) {
+			continue;
+		}
+
+		/*
+		 * A region can be found accessed at most aggr / sample
+		 * times in one aggregation, the hot ones reach half of
+		 * that.
+		 */
+		hot_access = 1;
+		if (damon_sysfs_intervals(k, &sample, &aggr) == 0 &&
+		    sample > 0) {
+			hot_access = MAX(aggr / sample / 2, 1);
+		}
+
+		for (i = 0; i < n; i++) {
+			paddr_region_account(k, &s_paddr.regs[i], hot_access);
+		}
+
+		nregions += n;
+	}
+
+	(void)pthread_mutex_lock(&s_paddr.mutex);
+	t = s_paddr.pub;
+	s_paddr.pub = s_paddr.work;
+	s_paddr.work = t;
+	(void)pthread_mutex_unlock(&s_paddr.mutex);
+	return (nregions);
+}
+
+int paddr_nlines(void)
+{
+	int n;
+
+	(void)pthread_mutex_lock(&s_paddr.mutex);
+	n = s_paddr.pub.nlines;
+	(void)pthread_mutex_unlock(&s_paddr.mutex);
+	return (n);
+}
+
+static int paddr_cgname_cmp(const void *a, const void *b)
+{
+	const paddr_cgname_t *n1 = (const paddr_cgname_t *)a;
+	const paddr_cgname_t *n2 = (const paddr_cgname_t *)b;
+
+	return ((n1->ino > n2->ino) - (n1->ino < n2->ino));
+}
+
+/* ARGSUSED */
+static int paddr_cgname_walk(const char *path, const struct stat *st,
+		int flag, struct FTW *ftwbuf __attribute__ ((unused)))
+{
+	paddr_cgname_t *arr, *cn;
+	const char *name;
+	int size;
+
+	if (flag != FTW_D) {
+		return (0);
+	}
+
+	if (s_paddr.nnames == s_paddr.names_size) {
+		size = MAX(s_paddr.names_size * 2, 64);
+		if ((arr = realloc(s_paddr.names,
+		    sizeof(paddr_cgname_t) * size)) == NULL) {
+			return (-1);
+		}
+
+		s_paddr.names = arr;
+		s_paddr.names_size = size;
+	}
+
+	cn = &s_paddr.names[s_paddr.nnames++];
+	cn->ino = st->st_ino;
+	name = path + strlen(s_paddr_walk_root);
+	(void)snprintf(cn->name, sizeof(cn->name), "%s",
+		       (*name == '\0') ? "/" : name + 1);
+	return (0);
+}
+
+/*
+ * Map the inodes of the memory cgroups to their paths, from the memory
+ * hierarchy of cgroup v1 if it's there, else from the cgroup v2 tree.
+ */
+static void paddr_cgnames_load(void)
+{
+	s_paddr.nnames = 0;
+	s_paddr.names_ms = current_ms(&g_tvbase);
+	s_paddr_walk_root = (access(CGROUP_MOUNT "/memory/memory.stat", R_OK)
+			     == 0) ? CGROUP_MOUNT "/memory" : CGROUP_MOUNT;
+	if (nftw(s_paddr_walk_root, paddr_cgname_walk, 16,
+		 FTW_PHYS | FTW_MOUNT) != 0) {
+		debug_print(NULL, 2, "paddr: walk %s failed\n",
+			    s_paddr_walk_root);
+	}
+
+	qsort(s_paddr.names, s_paddr.nnames, sizeof(paddr_cgname_t),
+	      paddr_cgname_cmp);
+}
+
+static const char *paddr_cgname_find(uint64_t ino)
+{
+	paddr_cgname_t key, *cn;
+
+	key.ino = ino;
+	cn = bsearch(&key, s_paddr.names, s_paddr.nnames,
+		     sizeof(paddr_cgname_t), paddr_cgname_cmp);
+	return ((cn != NULL) ? cn->name : NULL);
+}
+
+static int paddr_line_cmp(const void *a, const void *b)
+{
+	const paddr_line_t *l1 = (const paddr_line_t *)a;
+	const paddr_line_t *l2 = (const paddr_line_t *)b;
+
+	if (l1->hot != l2->hot) {
+		return ((l1->hot < l2->hot) ? 1 : -1);
+	}
+
+	if (l1->wss != l2->wss) {
+		return ((l1->wss < l2->wss) ? 1 : -1);
+	}
+
+	return (strcmp(l1->name, l2->name));
+}
+
+/*
+ * Copy the lines of the last snapshots to 'lines': the nodes, then the
+ * memory cgroups sorted by the hot bytes. A cgroup created since the
+ * last walk of the cgroup tree walks it again, a removed one which
+ * still has pages charged (it's offline) is shown by its inode.
+ * Return the number of lines.
+ */
+int paddr_lines_fill(paddr_line_t *lines, int nlines)
+{
+	const char *name;
+	boolean_t walked = B_FALSE;
+	int i, n;
+
+	(void)pthread_mutex_lock(&s_paddr.mutex);
+	n = MIN(s_paddr.pub.nlines, nlines);
+	if (n > 0) {
+		(void)memcpy(lines, s_paddr.pub.lines,
+			     sizeof(paddr_line_t) * n);
+	}
+
+	(void)pthread_mutex_unlock(&s_paddr.mutex);
+
+	for (i = MIN(s_paddr.nnodes, n); i < n; i++) {
+		if (lines[i].ino == 0) {
+			(void)strncpy(lines[i].name, "(not charged)",
+				      sizeof(lines[i].name) - 1);
+			continue;
+		}
+
+		if ((name = paddr_cgname_find(lines[i].ino)) == NULL &&
+		    !walked && (s_paddr.names_ms == 0 ||
+		     current_ms(&g_tvbase) - s_paddr.names_ms >=
+		     PADDR_NAMES_INTVAL_MS)) {
+			paddr_cgnames_load();
+			walked = B_TRUE;
+			name = paddr_cgname_find(lines[i].ino);
+		}
+
+		if (name != NULL) {
+			(void)strncpy(lines[i].name, name,
+				      sizeof(lines[i].name) - 1);
+		} else {
+			(void)snprintf(lines[i].name, sizeof(lines[i].name),
+				       "ino:%" PRIu64, lines[i].ino);
+		}
+	}
+
+	if (n > s_paddr.nnodes) {
+		qsort(lines + s_paddr.nnodes, n - s_paddr.nnodes,
+		      sizeof(paddr_line_t), paddr_line_cmp);
+	}
+
+	return (n);
+}
+
+void paddr_caption_build(char *buf, int size)
+{
+	(void)snprintf(buf, size, "%-28s%8s%9s%9s%9s%8s",
+		       "NODE/CGROUP", "REGIONS", "SIZE", "WSS", "HOT",
+		       CAPTION_NR_ACCESS);
+}
+
+/*
+ * Build the readable string for line 'idx' of the paddr view. ACCESS
+ * is the nr_accesses of the regions averaged by their bytes.
+ */
+void paddr_str_build(char *buf, int size, int idx, void *pv)
+{
+	paddr_line_t *line = &((paddr_line_t *)pv)[idx];
+	char name[32], total[16], wss[16], hot[16];
+	int len = strlen(line->name);
+
+	if (len > 27) {
+		(void)snprintf(name, sizeof(name), "..%.25s",
+			       line->name + len - 25);
+	} else {
+		(void)snprintf(name, sizeof(name), "%.27s", line->name);
+	}
+
+	win_size2str(line->size, total, sizeof(total));
+	win_size2str(line->wss, wss, sizeof(wss));
+	win_size2str(line->hot, hot, sizeof(hot));
+	(void)snprintf(buf, size, "%-28s%8d%9s%9s%9s%8.1f",
+		       name, line->nregions, total, wss, hot,
+		       (line->size > 0) ?
+		       (double)line->access / line->size : 0.0);
+}
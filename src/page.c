@@ -42,6 +42,7 @@
 #include "include/win.h"
 #include "include/perf.h"
 #include "include/damon.h"
+#include "include/stats.h"
 #include "include/os/os_page.h"
 
 static page_list_t s_page_list;
@@ -148,6 +149,9 @@ page_create(cmd_t *cmd)
  */
 static boolean_t page_show(page_t *page, boolean_t smpl)
 {
+	uint64_t start_ns;
+	boolean_t ret;
+
 	if (g_scr_height < 24 || g_scr_width < 80) {
 		dump_write("\n%s\n", "Terminal size is too small.");
 		dump_write("%s\n", "Please resize it to 80x24 or larger.");
@@ -165,7 +169,10 @@ static boolean_t page_show(page_t *page, boolean_t smpl)
 		return (B_TRUE);
 	}
 
-	return (page->dyn_win.draw(&page->dyn_win));
+	start_ns = stats_ns();
+	ret = page->dyn_win.draw(&page->dyn_win);
+	stats_stage_end(STATS_STAGE_DRAW, start_ns);
+	return (ret);
 }
 
 /*
@@ -181,8 +188,13 @@ page_next_execute(boolean_t smpl)
 		return (B_FALSE);
 	}
 
+	if (next_run != s_page_list.cur) {
+		reg_damage_reset();
+	}
+
 	ret = page_show(next_run, smpl);
 	s_page_list.cur = next_run;
+	dump_epoch_end();
 
 	if (smpl) {
 		s_page_list.next_run = next_run;
@@ -49,6 +49,8 @@
 #include "include/ui_perf_map.h"
 #include "include/plat.h"
 #include "include/damon.h"
+#include "include/budget.h"
+#include "include/stats.h"
 #include "include/os/os_perf.h"
 #include <strings.h>
 
@@ -121,12 +123,116 @@ static boolean_t task_valid(perf_task_t * task)
 	return (B_FALSE);
 }
 
-void perf_task_set(perf_task_t * task)
+/*
+ * A sampling request which only notifies 'disp thread' is the same
+ * as one still in the queue, the two are done by one sampling.
+ */
+static boolean_t task_coalesce(perf_task_t * t1, perf_task_t * t2)
 {
+	if (TASKID(t1) != TASKID(t2)) {
+		return (B_FALSE);
+	}
+
+	switch (TASKID(t1)) {
+	case PERF_PROFILING_SMPL_ID:
+		return (((task_profiling_t *)t1)->use_dispflag1 &&
+			((task_profiling_t *)t2)->use_dispflag1);
+
+	case PERF_MAPLIST_SMPL_ID:
+		return (((task_ml_t *)t1)->pid == ((task_ml_t *)t2)->pid);
+
+	default:
+		break;
+	}
+
+	return (B_FALSE);
+}
+
+/*
+ * Queue a task for 'perf thread'. Return the token to pass to
+ * perf_status_wait(). The caller blocks only if the queue is full,
+ * for PERF_WAIT_NSEC at most. Return 0 (never done) if the task
+ * can't be queued: the thread is gone or the queue stays full.
+ */
+uint64_t perf_task_set(perf_task_t * task)
+{
+	perf_task_entry_t *entry;
+	struct timespec timeout;
+	uint64_t token;
+	int i, s = 0;
+
 	(void)pthread_mutex_lock(&s_perf_ctl.mutex);
-	(void)memcpy(&s_perf_ctl.task, task, sizeof(perf_task_t));
-	(void)pthread_cond_signal(&s_perf_ctl.cond);
+	if (s_perf_ctl.quit) {
+		(void)pthread_mutex_unlock(&s_perf_ctl.mutex);
+		return (0);
+	}
+
+	for (i = 0; i < s_perf_ctl.queue_num; i++) {
+		entry = &s_perf_ctl.queue[(s_perf_ctl.queue_head + i) %
+					  PERF_TASK_QUEUE_SIZE];
+		if (task_coalesce(&entry->task, task)) {
+			token = entry->token;
+			(void)pthread_mutex_unlock(&s_perf_ctl.mutex);
+			return (token);
+		}
+	}
+
+	/* 'cond' waits on CLOCK_MONOTONIC, see perf_init() */
+	stats_ts(stats_ns() + (uint64_t)PERF_WAIT_NSEC * NS_SEC, &timeout);
+	while ((s_perf_ctl.queue_num == PERF_TASK_QUEUE_SIZE) &&
+	    !s_perf_ctl.quit && (s != ETIMEDOUT)) {
+		s = pthread_cond_timedwait(&s_perf_ctl.cond,
+					   &s_perf_ctl.mutex, &timeout);
+	}
+
+	if ((s_perf_ctl.queue_num == PERF_TASK_QUEUE_SIZE) ||
+	    s_perf_ctl.quit) {
+		(void)pthread_mutex_unlock(&s_perf_ctl.mutex);
+		debug_print(NULL, 2, "perf_task_set: task %d is not queued\n",
+			    TASKID(task));
+		return (0);
+	}
+
+	entry = &s_perf_ctl.queue[(s_perf_ctl.queue_head +
+				   s_perf_ctl.queue_num) % PERF_TASK_QUEUE_SIZE];
+	(void)memcpy(&entry->task, task, sizeof(perf_task_t));
+	entry->token = token = ++s_perf_ctl.token_last;
+	s_perf_ctl.queue_num++;
+	(void)pthread_cond_broadcast(&s_perf_ctl.cond);
 	(void)pthread_mutex_unlock(&s_perf_ctl.mutex);
+	return (token);
+}
+
+static void perf_task_get(perf_task_entry_t * entry)
+{
+	(void)pthread_mutex_lock(&s_perf_ctl.mutex);
+	while (s_perf_ctl.queue_num == 0) {
+		(void)pthread_cond_wait(&s_perf_ctl.cond, &s_perf_ctl.mutex);
+	}
+
+	(void)memcpy(entry, &s_perf_ctl.queue[s_perf_ctl.queue_head],
+		     sizeof(perf_task_entry_t));
+	s_perf_ctl.queue_head = (s_perf_ctl.queue_head + 1) %
+	    PERF_TASK_QUEUE_SIZE;
+	s_perf_ctl.queue_num--;
+	(void)pthread_cond_broadcast(&s_perf_ctl.cond);
+	(void)pthread_mutex_unlock(&s_perf_ctl.mutex);
+}
+
+/*
+ * Record the status a task ends with and wake up its waiter.
+ */
+static void perf_task_done(uint64_t token)
+{
+	perf_task_result_t *result;
+
+	(void)pthread_mutex_lock(&s_perf_ctl.status_mutex);
+	result = &s_perf_ctl.results[token % (PERF_TASK_QUEUE_SIZE * 2)];
+	result->token = token;
+	result->status = s_perf_ctl.status;
+	s_perf_ctl.token_done = token;
+	(void)pthread_cond_broadcast(&s_perf_ctl.status_cond);
+	(void)pthread_mutex_unlock(&s_perf_ctl.status_mutex);
 }
 
 void perf_status_set(perf_status_t status)
@@ -144,48 +250,38 @@ void perf_status_set_no_signal(perf_status_t status)
 	(void)pthread_mutex_unlock(&s_perf_ctl.status_mutex);
 }
 
-static boolean_t status_failed(perf_status_t status)
+/*
+ * Wait for the task with 'token' to be done, return 0 if it ends with
+ * the expected status. PERF_WAIT_NSEC only guards against a stuck
+ * 'perf thread'. The token 0 is a task which was never queued.
+ */
+int perf_status_wait(uint64_t token, perf_status_t status)
 {
-	switch (status) {
-	case PERF_STATUS_PROFILING_FAILED:
-		/* fall through */
-	case PERF_STATUS_ML_FAILED:
-		return (B_TRUE);
+	perf_task_result_t *result;
+	struct timespec timeout;
+	int s = 0, ret = -1;
 
-	default:
-		break;
+	if (token == 0) {
+		return (-1);
 	}
 
-	return (B_FALSE);
-}
-
-int perf_status_wait(perf_status_t status)
-{
-	struct timespec timeout;
-	struct timeval tv;
-	int s, ret = -1;
-
-	(void)gettimeofday(&tv, NULL);
-	timeout.tv_sec = tv.tv_sec + PERF_WAIT_NSEC;
-	timeout.tv_nsec = tv.tv_usec * 1000;
+	/* status_cond waits on CLOCK_MONOTONIC, see perf_init() */
+	stats_ts(stats_ns() + (uint64_t)PERF_WAIT_NSEC * NS_SEC, &timeout);
 
 	(void)pthread_mutex_lock(&s_perf_ctl.status_mutex);
-	for (;;) {
+	while ((s_perf_ctl.token_done < token) && (s != ETIMEDOUT)) {
 		s = pthread_cond_timedwait(&s_perf_ctl.status_cond,
 					   &s_perf_ctl.status_mutex, &timeout);
+	}
 
-		if (s_perf_ctl.status == status) {
-			ret = 0;
-			break;
-		}
-
-		if (status_failed(s_perf_ctl.status)) {
-			break;
-		}
-
-		if (s == ETIMEDOUT) {
-			break;
-		}
+	/*
+	 * A waiter which wakes up too late may find the slot reused by a
+	 * later task, its own result is lost then.
+	 */
+	result = &s_perf_ctl.results[token % (PERF_TASK_QUEUE_SIZE * 2)];
+	if ((s_perf_ctl.token_done >= token) && (result->token == token) &&
+	    (result->status == status)) {
+		ret = 0;
 	}
 
 	(void)pthread_mutex_unlock(&s_perf_ctl.status_mutex);
@@ -198,26 +294,26 @@ int perf_status_wait(perf_status_t status)
 /* ARGSUSED */
 static void *perf_handler(void *arg __attribute__ ((unused)))
 {
-	perf_task_t task;
+	perf_task_entry_t entry;
+	perf_task_t *task = &entry.task;
+	boolean_t quit = B_FALSE;
 	int intval_ms;
 
-	for (;;) {
-		(void)pthread_mutex_lock(&s_perf_ctl.mutex);
-		task = s_perf_ctl.task;
-		while (!task_valid(&task)) {
-			(void)pthread_cond_wait(&s_perf_ctl.cond,
-						&s_perf_ctl.mutex);
-			task = s_perf_ctl.task;
-		}
+	budget_thread_register("perf");
 
-		TASKID_SET(&s_perf_ctl.task, PERF_INVALID_ID);
-		(void)pthread_mutex_unlock(&s_perf_ctl.mutex);
+	while (!quit) {
+		perf_task_get(&entry);
+		if (!task_valid(task)) {
+			perf_task_done(entry.token);
+			continue;
+		}
 
-		switch (TASKID(&task)) {
+		switch (TASKID(task)) {
 		case PERF_QUIT_ID:
 			debug_print(NULL, 2, "perf_handler: received QUIT\n");
 			os_allstop();
-			goto L_EXIT;
+			quit = B_TRUE;
+			break;
 
 		case PERF_STOP_ID:
 			os_allstop();
@@ -225,45 +321,58 @@ static void *perf_handler(void *arg __attribute__ ((unused)))
 			break;
 
 		case PERF_PROFILING_START_ID:
-			if (os_profiling_start(&s_perf_ctl, &task) != 0) {
-				goto L_EXIT;
+			if (os_profiling_start(&s_perf_ctl, task) != 0) {
+				quit = B_TRUE;
 			}
 			break;
 
 		case PERF_PROFILING_SMPL_ID:
-			(void)os_profiling_smpl(&s_perf_ctl, &task, &intval_ms);
+			/*
+			 * Wait here rather than in the caller, the requests
+			 * coming in meanwhile are coalesced in the queue.
+			 */
+			perf_smpl_wait();
+			(void)os_profiling_smpl(&s_perf_ctl, task, &intval_ms);
 			break;
 
 		case PERF_PROFILING_PARTPAUSE_ID:
-			(void)os_profiling_partpause(&s_perf_ctl, &task);
+			(void)os_profiling_partpause(&s_perf_ctl, task);
 			break;
 
 		case PERF_PROFILING_MULTIPAUSE_ID:
-			(void)os_profiling_multipause(&s_perf_ctl, &task);
+			(void)os_profiling_multipause(&s_perf_ctl, task);
 			break;
 
 		case PERF_PROFILING_RESTORE_ID:
-			(void)os_profiling_restore(&s_perf_ctl, &task);
+			(void)os_profiling_restore(&s_perf_ctl, task);
 			break;
 
 		case PERF_PROFILING_MULTI_RESTORE_ID:
-			(void)os_profiling_multi_restore(&s_perf_ctl, &task);
+			(void)os_profiling_multi_restore(&s_perf_ctl, task);
 			break;
 
 		case PERF_MAPLIST_START_ID:
-			os_ml_start(&s_perf_ctl, &task);
+			os_ml_start(&s_perf_ctl, task);
 			break;
 
 		case PERF_MAPLIST_SMPL_ID:
-			os_maplist_events(&s_perf_ctl, &task, &intval_ms);
+			perf_smpl_wait();
+			os_maplist_events(&s_perf_ctl, task, &intval_ms);
 			break;
 
 		default:
 			break;
 		}
+
+		perf_task_done(entry.token);
 	}
 
-L_EXIT:
+	/* The tasks queued from now on fail at once, see perf_task_set() */
+	(void)pthread_mutex_lock(&s_perf_ctl.mutex);
+	s_perf_ctl.quit = B_TRUE;
+	(void)pthread_cond_broadcast(&s_perf_ctl.cond);
+	(void)pthread_mutex_unlock(&s_perf_ctl.mutex);
+
 	debug_print(NULL, 2, "perf thread is exiting.\n");
 	return (NULL);
 }
@@ -273,6 +382,7 @@ L_EXIT:
  */
 int perf_init(void)
 {
+	pthread_condattr_t attr;
 	boolean_t mutex_inited = B_FALSE;
 	boolean_t cond_inited = B_FALSE;
 	boolean_t status_mutex_inited = B_FALSE;
@@ -289,19 +399,26 @@ int perf_init(void)
 	}
 	mutex_inited = B_TRUE;
 
-	if (pthread_cond_init(&s_perf_ctl.cond, NULL) != 0) {
+	/* Both conditions wait on CLOCK_MONOTONIC. */
+	(void)pthread_condattr_init(&attr);
+	(void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	if (pthread_cond_init(&s_perf_ctl.cond, &attr) != 0) {
+		(void)pthread_condattr_destroy(&attr);
 		goto L_EXIT;
 	}
 	cond_inited = B_TRUE;
 
 	if (pthread_mutex_init(&s_perf_ctl.status_mutex, NULL) != 0) {
+		(void)pthread_condattr_destroy(&attr);
 		goto L_EXIT;
 	}
 	status_mutex_inited = B_TRUE;
 
-	if (pthread_cond_init(&s_perf_ctl.status_cond, NULL) != 0) {
+	if (pthread_cond_init(&s_perf_ctl.status_cond, &attr) != 0) {
+		(void)pthread_condattr_destroy(&attr);
 		goto L_EXIT;
 	}
+	(void)pthread_condattr_destroy(&attr);
 	status_cond_inited = B_TRUE;
 
 	if (pthread_create(&s_perf_ctl.thr, NULL, perf_handler, NULL) != 0) {
@@ -393,8 +510,8 @@ int perf_profiling_start(void)
 	(void)memset(&task, 0, sizeof(perf_task_t));
 	t = (task_profiling_t *) & task;
 	t->task_id = PERF_PROFILING_START_ID;
-	perf_task_set(&task);
-	return (perf_status_wait(PERF_STATUS_PROFILING_STARTED));
+	return (perf_status_wait(perf_task_set(&task),
+				 PERF_STATUS_PROFILING_STARTED));
 }
 
 /*
@@ -428,7 +545,6 @@ int perf_profiling_smpl(boolean_t use_dispflag1)
 	perf_task_t task;
 	task_profiling_t *t;
 
-	perf_smpl_wait();
 	(void)memset(&task, 0, sizeof(perf_task_t));
 	t = (task_profiling_t *) & task;
 	t->task_id = PERF_PROFILING_SMPL_ID;
@@ -489,8 +605,8 @@ int perf_maplist_start(pid_t pid)
 	t = (task_ml_t *) & task;
 	t->task_id = PERF_MAPLIST_START_ID;
 	t->pid = pid;
-	perf_task_set(&task);
-	return (perf_status_wait(PERF_STATUS_MAPLIST_STARTED));
+	return (perf_status_wait(perf_task_set(&task),
+				 PERF_STATUS_MAPLIST_STARTED));
 }
 
 int perf_maplist_smpl(pid_t pid)
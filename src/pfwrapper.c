@@ -15,6 +15,8 @@
 #include "./include/util.h"
 #include "./include/pfwrapper.h"
 #include "./include/damon.h"
+#include "./include/damon_sysfs.h"
+#include "./include/stats.h"
 #include "./include/os/os_perf.h"
 
 static int s_mapsize, s_mapmask, s_ringsize;
@@ -147,6 +149,70 @@ int get_perf_ringsize(void)
 	return s_ringsize;
 }
 
+static void pf_rings_free(void)
+{
+	perf_damon_ring_t *r;
+	int i;
+
+	for (i = 0; i < perf_damon_conf->nrings; i++) {
+		r = &perf_damon_conf->rings[i];
+		if (r->map_base != MAP_FAILED) {
+			munmap(r->map_base, s_mapsize);
+		}
+
+		if (r->perf_fd != INVALID_FD) {
+			close(r->perf_fd);
+		}
+	}
+
+	free(perf_damon_conf->rings);
+	perf_damon_conf->rings = NULL;
+	perf_damon_conf->nrings = 0;
+}
+
+/*
+ * The events of the other kdamonds started through sysfs. A per-task
+ * event can't be redirected to the ring buffer of another task, so
+ * every kdamond has a ring buffer of its own.
+ */
+static void pf_rings_setup(struct perf_event_attr *attr)
+{
+	perf_damon_ring_t *r;
+	int i, n = damon_sysfs_active() ? damon_sysfs_nkdamonds() - 1 : 0;
+	pid_t pid;
+
+	pf_rings_free();
+	if (n <= 0 ||
+	    (perf_damon_conf->rings = zalloc(sizeof(perf_damon_ring_t) * n)) ==
+	    NULL) {
+		return;
+	}
+
+	perf_damon_conf->nrings = n;
+	for (i = 0; i < n; i++) {
+		r = &perf_damon_conf->rings[i];
+		r->map_base = MAP_FAILED;
+		pid = damon_sysfs_kdamond_pid(i + 1);
+		if (pid <= 0 ||
+		    (r->perf_fd = pf_event_open(attr, pid, -1, -1,
+						PERF_FLAG_FD_CLOEXEC)) < 0) {
+			debug_print(NULL, 2, "pf_rings_setup: can't open the "
+				    "event of kdamond %d\n", pid);
+			r->perf_fd = INVALID_FD;
+			continue;
+		}
+
+		if ((r->map_base = mmap(NULL, s_mapsize, PROT_READ | PROT_WRITE,
+					MAP_SHARED, r->perf_fd, 0)) == MAP_FAILED) {
+			close(r->perf_fd);
+			r->perf_fd = INVALID_FD;
+			continue;
+		}
+
+		debug_print(NULL, 2, "begin to monitor: %d\n", pid);
+	}
+}
+
 /*
  * Setup perf for each kdamon.
  */
@@ -207,6 +273,7 @@ int pf_profiling_setup(int idx, pf_conf_t * conf)
 	}
 
 	debug_print(NULL, 2, "begin to monitor: %d\n", pid);
+	pf_rings_setup(&attr);
 
 	return 0;
 
@@ -215,10 +282,23 @@ L_FAILED:
 	return -1;
 }
 
+static void pf_rings_ioctl(unsigned long request)
+{
+	int i;
+
+	for (i = 0; i < perf_damon_conf->nrings; i++) {
+		if (perf_damon_conf->rings[i].perf_fd != INVALID_FD) {
+			(void)ioctl(perf_damon_conf->rings[i].perf_fd,
+				    request, 0);
+		}
+	}
+}
+
 int pf_profiling_start(void)
 {
 	int fd = perf_damon_conf->perf_fd;
 
+	pf_rings_ioctl(PERF_EVENT_IOC_ENABLE);
 	if (fd != INVALID_FD) {
 		return ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
 	}
@@ -230,6 +310,7 @@ int pf_profiling_stop(void)
 {
 	int fd = perf_damon_conf->perf_fd;
 
+	pf_rings_ioctl(PERF_EVENT_IOC_DISABLE);
 	if (fd != INVALID_FD) {
 		return ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
 	}
@@ -323,8 +404,8 @@ static int profiling_sample_read(struct perf_event_mmap_page *mhdr,
 		 * unsigned short common_type = raw2data(&data[0], 2);
 		 * unsigned char common_flags = raw2data(&data[2], 1);
 		 * unsigned char common_preempt_count = raw2data(&data[3], 1);
-		 * int common_pid = raw2data(&data[4], 4);
 		 */
+		int common_pid = raw2data(&data[4], 4);
 		unsigned long target_id = raw2data(&data[8], 8);
 		unsigned int nr_regions = raw2data(&data[16], 4);
 		unsigned long start = raw2data(&data[24], 8);
@@ -341,7 +422,14 @@ static int profiling_sample_read(struct perf_event_mmap_page *mhdr,
 		countval->counts[PERF_COUNT_DAMON_AGE] = age;
 		countval->counts[PERF_COUNT_DAMON_LOCAL] = local;
 		countval->counts[PERF_COUNT_DAMON_REMOTE] = remote;
-		rec->pid = target_id;
+		/*
+		 * Through sysfs, the target id is the index of the target
+		 * in the context of the kdamond which emitted the event.
+		 */
+		rec->pid = damon_sysfs_active() ?
+		    (unsigned long)damon_sysfs_target_pid(common_pid, target_id) :
+		    target_id;
+		kdamon_regions_account(common_pid);
 		free(data);
 	} else {
 		free(data);
@@ -385,46 +473,80 @@ profiling_recbuf_update(pf_profiling_rec_t * rec_arr, int *nrec,
 	*nrec += 1;
 }
 
-void pf_profiling_record(pf_profiling_rec_t * rec_arr,
+int pf_profiling_nrings(void)
+{
+	return (perf_damon_conf->nrings + 1);
+}
+
+/*
+ * Read the records from the ring buffer 'ring', 0 is the one of the
+ * first kdamond.
+ */
+void pf_profiling_record(int ring, pf_profiling_rec_t * rec_arr,
 		int *nrec)
 {
 	struct perf_event_mmap_page *mhdr = perf_damon_conf->map_base;
 	struct perf_event_header ehdr;
 	pf_profiling_rec_t rec;
-	int size;
+	uint64_t tail;
+	uint64_t lost[2];	/* id, lost */
+	int size, nsamples = 0;
 
 	if (nrec != NULL) {
 		*nrec = 0;
 	}
 
+	if (ring > 0) {
+		mhdr = perf_damon_conf->rings[ring - 1].map_base;
+	}
+
+	if (mhdr == MAP_FAILED) {
+		return;
+	}
+
+	tail = mhdr->data_tail;
+
 	/* update all record from ring buffer */
 	for (;;) {
 		if (mmap_buffer_read(mhdr, &ehdr, sizeof(ehdr)) == -1) {
-			return;
+			break;
 		}
 
 		if ((size = ehdr.size - sizeof(ehdr)) <= 0) {
 			mmap_buffer_reset(mhdr);
-			return;
+			break;
 		}
 
 		if ((ehdr.type == PERF_RECORD_SAMPLE) && (rec_arr != NULL)) {
 			if (profiling_sample_read(mhdr, size, &rec) == 0) {
 				profiling_recbuf_update(rec_arr, nrec, &rec);
+				nsamples++;
 			} else {
 				/* No valid record in ring buffer. */
-				return;
+				break;
+			}
+		} else if ((ehdr.type == PERF_RECORD_LOST) &&
+		    (size >= (int)sizeof(lost))) {
+			if (mmap_buffer_read(mhdr, lost, sizeof(lost)) == -1) {
+				break;
 			}
+			stats_count_add(STATS_COUNT_LOST, lost[1]);
+			mmap_buffer_skip(mhdr, size - sizeof(lost));
 		} else {
 			mmap_buffer_skip(mhdr, size);
 		}
 	}
+
+	stats_count_add(STATS_COUNT_DRAIN_BYTES, mhdr->data_tail - tail);
+	stats_count_add(STATS_COUNT_DRAIN_RECS, nsamples);
 }
 
 void pf_resource_free(void)
 {
 	int fd = perf_damon_conf->perf_fd;
 
+	pf_rings_free();
+
 		if (fd != INVALID_FD) {
 			close(fd);
 			perf_damon_conf->perf_fd = INVALID_FD;
@@ -49,10 +49,15 @@
 #include "include/util.h"
 #include "include/perf.h"
 #include "include/damon.h"
+#include "include/stats.h"
+#include "include/warm.h"
+#include "include/damon_sysfs.h"
+#include "include/idle.h"
 #include "include/os/os_util.h"
 
 static proc_group_t s_proc_group;
 struct damon_proc_t target_procs = {0};
+static boolean_t s_monitor_attached;
 pid_t damontop_pid;
 
 extern int numa_stat;
@@ -72,6 +77,14 @@ int proc_group_init(void)
 		return (-1);
 	}
 
+	if ((s_proc_group.pidtbl =
+	     zalloc(sizeof(track_proc_t *) * PROC_PIDTBL_MIN)) == NULL) {
+		(void)pthread_cond_destroy(&s_proc_group.cond);
+		(void)pthread_mutex_destroy(&s_proc_group.mutex);
+		return (-1);
+	}
+
+	s_proc_group.pidtbl_size = PROC_PIDTBL_MIN;
 	s_proc_group.inited = B_TRUE;
 	return (0);
 }
@@ -88,8 +101,6 @@ static void proc_free(track_proc_t * proc)
 		return;
 	}
 
-	s_proc_group.nprocs--;
-
 	if (proc->countval_arr != NULL) {
 		free(proc->countval_arr);
 	}
@@ -107,28 +118,19 @@ static void proc_free(track_proc_t * proc)
 static void
 proc_traverse(int (*func) (track_proc_t *, void *, boolean_t *), void *arg)
 {
-	track_proc_t *proc, *hash_next;
+	track_proc_t *proc;
 	boolean_t end;
-	int i, j = 0;
+	int i;
 
 	/*
 	 * The mutex of s_proc_group has been taken outside.
 	 */
-	for (i = 0; i < PROC_HASHTBL_SIZE; i++) {
-		proc = s_proc_group.hashtbl[i];
-		while (proc != NULL) {
-			j++;
-			hash_next = proc->hash_next;
+	for (i = 0; i < s_proc_group.pidtbl_size; i++) {
+		if ((proc = s_proc_group.pidtbl[i]) != NULL) {
 			func(proc, arg, &end);
 			if (end) {
 				return;
 			}
-
-			proc = hash_next;
-		}
-
-		if (j == s_proc_group.nprocs) {
-			return;
 		}
 	}
 }
@@ -178,18 +180,111 @@ void proc_group_fini(void)
 		free(s_proc_group.sort_arr);
 	}
 
+	free(s_proc_group.pidtbl);
+	s_proc_group.pidtbl = NULL;
 	(void)pthread_mutex_unlock(&s_proc_group.mutex);
 	(void)pthread_mutex_destroy(&s_proc_group.mutex);
 	(void)pthread_cond_destroy(&s_proc_group.cond);
 }
 
+/*
+ * Return the slot of pid in the pid table, -1 if it's not there.
+ */
+static int pidtbl_slot(pid_t pid)
+{
+	int mask = s_proc_group.pidtbl_size - 1;
+	int i = PROC_PIDTBL_INDEX(pid, mask);
+	track_proc_t *proc;
+
+	while ((proc = s_proc_group.pidtbl[i]) != NULL) {
+		if (proc->pid == pid) {
+			return (i);
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	return (-1);
+}
+
+/*
+ * Look for a process in the pid table, without taking a reference.
+ */
+static track_proc_t *pidtbl_lookup(pid_t pid)
+{
+	int i;
+
+	if ((i = pidtbl_slot(pid)) < 0) {
+		return (NULL);
+	}
+
+	return (s_proc_group.pidtbl[i]);
+}
+
+static void pidtbl_insert(track_proc_t ** tbl, int size, track_proc_t * proc)
+{
+	int mask = size - 1;
+	int i = PROC_PIDTBL_INDEX(proc->pid, mask);
+
+	while (tbl[i] != NULL) {
+		i = (i + 1) & mask;
+	}
+
+	tbl[i] = proc;
+}
+
+/*
+ * Rehash the pid table to 'size' slots.
+ */
+static int pidtbl_resize(int size)
+{
+	track_proc_t **tbl, *proc;
+	int i;
+
+	if ((tbl = zalloc(sizeof(track_proc_t *) * size)) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < s_proc_group.pidtbl_size; i++) {
+		if ((proc = s_proc_group.pidtbl[i]) != NULL) {
+			pidtbl_insert(tbl, size, proc);
+		}
+	}
+
+	free(s_proc_group.pidtbl);
+	s_proc_group.pidtbl = tbl;
+	s_proc_group.pidtbl_size = size;
+	return (0);
+}
+
+/*
+ * Keep the load factor of pid table between 1/8 and 1/2.
+ */
+static int pidtbl_fit(int nprocs)
+{
+	int size = s_proc_group.pidtbl_size;
+
+	while (nprocs * 2 > size) {
+		size *= 2;
+	}
+
+	while ((size > PROC_PIDTBL_MIN) && (nprocs * 8 < size)) {
+		size /= 2;
+	}
+
+	if (size == s_proc_group.pidtbl_size) {
+		return (0);
+	}
+
+	return (pidtbl_resize(size));
+}
+
 /*
  * Look for a process by specified pid.
  */
 static track_proc_t *proc_find_nolock(pid_t pid)
 {
 	track_proc_t *proc;
-	int hashidx;
 
 	/*
 	 * To speed up, check the "latest access" process first.
@@ -200,18 +295,7 @@ static track_proc_t *proc_find_nolock(pid_t pid)
 		goto L_EXIT;
 	}
 
-	/*
-	 * Scan the process hash table.
-	 */
-	hashidx = PROC_HASHTBL_INDEX(pid);
-	proc = s_proc_group.hashtbl[hashidx];
-	while (proc != NULL) {
-		if (proc->pid == pid) {
-			break;
-		}
-
-		proc = proc->hash_next;
-	}
+	proc = pidtbl_lookup(pid);
 
 L_EXIT:
 	if (proc != NULL) {
@@ -472,15 +556,10 @@ static void proc_sortkey(void)
 		return;
 	}
 
-	for (i = 0; i < PROC_HASHTBL_SIZE; i++) {
-		proc = s_proc_group.hashtbl[i];
-		while (proc != NULL) {
+	for (i = 0; (i < s_proc_group.pidtbl_size) &&
+	     (j < s_proc_group.nprocs); i++) {
+		if ((proc = s_proc_group.pidtbl[i]) != NULL) {
 			sort_arr[j++] = proc;
-			proc = proc->hash_next;
-		}
-
-		if (j == s_proc_group.nprocs) {
-			break;
 		}
 	}
 
@@ -499,11 +578,14 @@ static void proc_sortkey(void)
  */
 void proc_resort(sort_key_t sort)
 {
+	uint64_t start_ns = stats_ns();
+
 	/*
 	 * The lock of s_proc_group takes outside.
 	 */
 	proc_traverse(proc_key_compute, &sort);
 	proc_sortkey();
+	stats_stage_end(STATS_STAGE_SORT, start_ns);
 }
 
 static void moniproc_sortkey(track_proc_t *proc)
@@ -528,8 +610,11 @@ static void moniproc_sortkey(track_proc_t *proc)
  */
 void moniproc_resort(sort_key_t sort, track_proc_t *proc)
 {
+	uint64_t start_ns = stats_ns();
+
 	moniproc_traverse(moniproc_key_compute, proc, &sort);
 	moniproc_sortkey(proc);
+	stats_stage_end(STATS_STAGE_SORT, start_ns);
 }
 
 /*
@@ -554,7 +639,7 @@ track_proc_t *proc_sort_next(void)
 void proc_countvalue_sort(count_value_t * sort_countval_arr, int *nonzero)
 {
 	int i, j;
-	uint64_t start, end;
+	uint64_t start, end, start_ns = stats_ns();
 	int nr_nonzero = 0;
 
 	for (i = 0; i < PROC_RECORD_MAX; i++) {
@@ -621,59 +706,65 @@ void proc_countvalue_sort(count_value_t * sort_countval_arr, int *nonzero)
 	free(new_countval_arr);
 	free(countval_arr);
 	*nonzero = nr_nonzero;
+	stats_stage_end(STATS_STAGE_SORT, start_ns);
 }
 
 /*
- * Add a new proc in s_process_group->hashtbl.
+ * Add a new proc in s_process_group->pidtbl.
  */
 static int proc_group_add(track_proc_t * proc)
 {
-	track_proc_t *head;
-	int hashidx;
-
 	/*
 	 * The lock of table has been taken outside.
 	 */
-	hashidx = PROC_HASHTBL_INDEX(proc->pid);
-	if ((head = s_proc_group.hashtbl[hashidx]) != NULL) {
-		head->hash_prev = proc;
+	if (((s_proc_group.nprocs + 1) * 2 > s_proc_group.pidtbl_size) &&
+	    (pidtbl_resize(s_proc_group.pidtbl_size * 2) != 0) &&
+	    (s_proc_group.nprocs + 1 >= s_proc_group.pidtbl_size)) {
+		return (-1);
 	}
 
-	proc->hash_next = head;
-	proc->hash_prev = NULL;
-	s_proc_group.hashtbl[hashidx] = proc;
+	pidtbl_insert(s_proc_group.pidtbl, s_proc_group.pidtbl_size, proc);
 	s_proc_group.nprocs++;
 	return (0);
 }
 
 /*
- * Remove a specifiled proc from s_process_group->hashtbl.
+ * Remove a specifiled proc from s_process_group->pidtbl.
  */
 static void proc_group_remove(track_proc_t * proc)
 {
-	track_proc_t *prev, *next;
-	int hashidx;
+	track_proc_t *p;
+	int mask = s_proc_group.pidtbl_size - 1;
+	int i, j, k;
 
 	/*
 	 * The lock of table has been taken outside.
 	 */
-	hashidx = PROC_HASHTBL_INDEX(proc->pid);
+	if ((i = pidtbl_slot(proc->pid)) < 0) {
+		return;
+	}
 
 	/*
-	 * Remove it from process hash-list.
+	 * No tombstone: shift back the following entries of the probe
+	 * run which are allowed to sit in the hole.
 	 */
-	prev = proc->hash_prev;
-	next = proc->hash_next;
-	if (prev != NULL) {
-		prev->hash_next = next;
-	} else {
-		s_proc_group.hashtbl[hashidx] = next;
-	}
+	j = i;
+	for (;;) {
+		j = (j + 1) & mask;
+		if ((p = s_proc_group.pidtbl[j]) == NULL) {
+			break;
+		}
+
+		k = PROC_PIDTBL_INDEX(p->pid, mask);
+		if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j))) {
+			continue;
+		}
 
-	if (next != NULL) {
-		next->hash_prev = prev;
+		s_proc_group.pidtbl[i] = p;
+		i = j;
 	}
 
+	s_proc_group.pidtbl[i] = NULL;
 	s_proc_group.nprocs--;
 	if (s_proc_group.latest == proc) {
 		s_proc_group.latest = NULL;
@@ -721,15 +812,15 @@ static pid_t *pid_find(pid_t pid, pid_t * pid_arr, int num)
 }
 
 /*
- * The array 'procs_new' contains the latest valid pid. Scan the hashtbl to
+ * The array 'procs_new' contains the latest valid pid. Scan the pidtbl to
  * figure out the obsolete processes and remove them. For the new processes,
- * add them in hashtbl.
+ * add them in pidtbl.
  */
 static void proc_group_refresh(pid_t * procs_new, int nproc_new)
 {
-	track_proc_t *proc, *hash_next;
+	track_proc_t *proc, **obsolete_arr;
 	pid_t *p;
-	int i, j;
+	int i, j, nobsolete = 0;
 	boolean_t *exist_arr;
 
 	if ((exist_arr = zalloc(sizeof(boolean_t) * nproc_new)) == NULL) {
@@ -739,25 +830,38 @@ static void proc_group_refresh(pid_t * procs_new, int nproc_new)
 	qsort(procs_new, nproc_new, sizeof(pid_t), pid_cmp);
 
 	(void)pthread_mutex_lock(&s_proc_group.mutex);
-	for (i = 0; i < PROC_HASHTBL_SIZE; i++) {
-		proc = s_proc_group.hashtbl[i];
-		while (proc != NULL) {
-			hash_next = proc->hash_next;
-			if ((p =
-			     pid_find(proc->pid, procs_new,
-				      nproc_new)) == NULL) {
-				proc_group_remove(proc);
-				proc_free(proc);
-			} else {
-				j = ((uint64_t) p - (uint64_t) procs_new) /
-				    sizeof(pid_t);
-				exist_arr[j] = B_TRUE;
-			}
+	if ((obsolete_arr = zalloc(sizeof(track_proc_t *) *
+				   (s_proc_group.nprocs + 1))) == NULL) {
+		(void)pthread_mutex_unlock(&s_proc_group.mutex);
+		free(exist_arr);
+		return;
+	}
+
+	/*
+	 * Removing shifts the entries of pidtbl, so collect the obsolete
+	 * processes first.
+	 */
+	for (i = 0; i < s_proc_group.pidtbl_size; i++) {
+		if ((proc = s_proc_group.pidtbl[i]) == NULL) {
+			continue;
+		}
 
-			proc = hash_next;
+		if ((p = pid_find(proc->pid, procs_new, nproc_new)) == NULL) {
+			obsolete_arr[nobsolete++] = proc;
+		} else {
+			j = ((uint64_t) p - (uint64_t) procs_new) /
+			    sizeof(pid_t);
+			exist_arr[j] = B_TRUE;
 		}
 	}
 
+	for (i = 0; i < nobsolete; i++) {
+		proc_group_remove(obsolete_arr[i]);
+		proc_free(obsolete_arr[i]);
+	}
+
+	(void)pidtbl_fit(nproc_new);
+
 	for (i = 0; i < nproc_new; i++) {
 		if (!exist_arr[i]) {
 			if ((proc = proc_alloc()) != NULL) {
@@ -765,14 +869,16 @@ static void proc_group_refresh(pid_t * procs_new, int nproc_new)
 				(void)os_procfs_pname_get(proc->pid,
 							  proc->name,
 							  PROC_NAME_SIZE);
-				(void)proc_group_add(proc);
+				if (proc_group_add(proc) != 0) {
+					proc_free(proc);
+				}
 			}
 		}
 	}
 
-	s_proc_group.nprocs = nproc_new;
 	s_proc_group.nlwps = 0;
 	(void)pthread_mutex_unlock(&s_proc_group.mutex);
+	free(obsolete_arr);
 	free(exist_arr);
 }
 
@@ -859,6 +965,68 @@ proc_countval_update(track_proc_t * proc, int num,
 	return 0;
 }
 
+static int proc_commit_cmp(const void *a, const void *b)
+{
+	const proc_commit_t *c1 = (const proc_commit_t *)a;
+	const proc_commit_t *c2 = (const proc_commit_t *)b;
+
+	if (c1->pid != c2->pid) {
+		return ((c1->pid > c2->pid) ? 1 : -1);
+	}
+
+	return (c1->num - c2->num);
+}
+
+/*
+ * Commit a batch of sampling records. The batch is grouped by pid, so
+ * each target is looked up once and its records are copied under one
+ * acquisition of its lock. The table lock is held for the whole batch,
+ * it keeps the processes alive without touching the refcounts.
+ */
+void proc_commit(proc_commit_t * commit_arr, int ncommits)
+{
+	track_proc_t *proc;
+	int i, j, k;
+
+	for (i = 1; i < ncommits; i++) {
+		if (proc_commit_cmp(&commit_arr[i - 1], &commit_arr[i]) > 0) {
+			qsort(commit_arr, ncommits, sizeof(proc_commit_t),
+			      proc_commit_cmp);
+			break;
+		}
+	}
+
+	(void)pthread_mutex_lock(&s_proc_group.mutex);
+	for (i = 0; i < ncommits; i = j) {
+		for (j = i + 1; j < ncommits; j++) {
+			if (commit_arr[j].pid != commit_arr[i].pid) {
+				break;
+			}
+		}
+
+		if ((proc = pidtbl_lookup(commit_arr[i].pid)) == NULL) {
+			continue;
+		}
+
+		(void)pthread_mutex_lock(&proc->mutex);
+		if (!proc->removing) {
+			for (k = i; k < j; k++) {
+				if (commit_arr[k].num >= proc->record_max) {
+					break;
+				}
+
+				(void)memcpy(proc->countval_arr[commit_arr[k].num].counts,
+					     commit_arr[k].countval.counts,
+					     sizeof(commit_arr[k].countval.counts));
+			}
+		}
+
+		(void)pthread_mutex_unlock(&proc->mutex);
+	}
+
+	(void)pthread_mutex_unlock(&s_proc_group.mutex);
+}
+
 uint64_t proc_countval_sum(count_value_t * countval_arr,
 		ui_count_id_t ui_count_id)
 {
@@ -919,15 +1087,97 @@ void proc_profiling_clear(void)
 	proc_traverse(profiling_clear, NULL);
 }
 
+/*
+ * Read the 'monitor_on' file, return B_TRUE if DAMON is running.
+ * Without debugfs, the kdamonds of sysfs are asked instead.
+ */
+static boolean_t monitor_is_on(void)
+{
+	char data[8] = { 0 };
+	int fd;
+
+	if (!damon_debugfs_supported()) {
+		return (damon_sysfs_busy());
+	}
+
+	if ((fd = open("/sys/kernel/debug/damon/monitor_on", O_RDONLY)) < 0) {
+		stderr_print("monitor_on: No such file!\n");
+		return (B_FALSE);
+	}
+
+	if (read(fd, data, sizeof(data) - 1) < 0) {
+		stderr_print("/sys/kernel/debug/damon/monitor_on: read fail!\n");
+		(void)close(fd);
+		return (B_FALSE);
+	}
+
+	(void)close(fd);
+	return (strcmp(data, "on\n") == 0);
+}
+
+/*
+ * Attach to the DAMON session which is already running. The targets
+ * are taken from 'target_ids', and nothing is written to the DAMON
+ * control files from now on: monitor_start(), monitor_exit() and
+ * write_damon_attrs() turn into no-ops, so the kdamond (and the
+ * regions it has converged) is left as it is.
+ */
+int monitor_attach(void)
+{
+	pid_t *pids;
+	int i, num;
+
+	if (!damon_debugfs_supported()) {
+		stderr_print("--attach needs the DAMON debugfs interface.\n");
+		return (-1);
+	}
+
+	if (!monitor_is_on()) {
+		stderr_print("DAMON is not running, nothing to attach.\n");
+		return (-1);
+	}
+
+	if (damon_target_ids_load(&pids, &num) != 0) {
+		return (-1);
+	}
+
+	target_procs_reset();
+	for (i = 0; i < num; i++) {
+		if (target_procs_add(pids[i]) != 0) {
+			free(pids);
+			return (-1);
+		}
+	}
+
+	free(pids);
+	if (target_procs.nr_proc == 0) {
+		stderr_print("DAMON is running without any target.\n");
+		return (-1);
+	}
+
+	target_procs.ready = 1;
+	s_monitor_attached = B_TRUE;
+	debug_print(NULL, 2, "attached to kdamond %d, %d targets\n",
+		    get_kdamon_pid(), target_procs.nr_proc);
+	return (0);
+}
+
+boolean_t monitor_attached(void)
+{
+	return (s_monitor_attached);
+}
+
 int monitor_start(char *procs)
 {
 	struct stat sts;
 	char proc_pid[16] = { 0 };
 	char *cmd;
-	char data[8] = { 0 };
-	int ret = 0, fd;
 	int i;
 
+	if (s_monitor_attached) {
+		return 0;
+	}
+
 	for (i = 0; i < target_procs.nr_proc; i++) {
 		sprintf(proc_pid, "/proc/%d", target_procs.pid[i]);
 		if (stat(proc_pid, &sts) == -1 && errno == ENOENT) {
@@ -936,20 +1186,32 @@ int monitor_start(char *procs)
 		}
 	}
 
-	if ((fd = open("/sys/kernel/debug/damon/monitor_on", O_RDONLY)) < 0) {
-		printf("kdamon_pid: No such file!\n");
-		return -1;
+	/* No DAMON, the page idle engine does its work. */
+	if (idle_enabled()) {
+		return (idle_start(target_procs.pid, target_procs.nr_proc));
 	}
 
-	ret = read(fd, data, 8);
-	if (ret < 0) {
-		perror("kdamon_pid!\n");
+	if (monitor_is_on()) {
+		stderr_print("DAMON had been enabled, see --attach\n");
 		return -1;
 	}
-	close(fd);
 
-	if (!strcmp(data, "on\n")) {
-		stderr_print("DAMON had been enabled\n");
+	/*
+	 * Prefer the sysfs interface, the targets can be changed online
+	 * there. The NUMA statistics only exist in debugfs though.
+	 */
+	if (!numa_stat &&
+	    damon_sysfs_setup(target_procs.pid, target_procs.nr_proc) == 0) {
+		warm_seed();
+		if (damon_sysfs_on() == 0) {
+			return 0;
+		}
+
+		debug_print(NULL, 2, "DAMON sysfs failed, fall back to debugfs\n");
+	}
+
+	if (!damon_debugfs_supported()) {
+		stderr_print("DAMON sysfs failed!\n");
 		return -1;
 	}
 
@@ -964,6 +1226,8 @@ int monitor_start(char *procs)
 	system(cmd);
 	free(cmd);
 
+	/* Before the monitoring is on, the init regions are read then. */
+	warm_seed();
 	system("echo on > /sys/kernel/debug/damon/monitor_on");
 	if (numa_stat)
 		system("echo on > /sys/kernel/debug/damon/numa_stat");
@@ -973,22 +1237,22 @@ int monitor_start(char *procs)
 
 void monitor_exit(void)
 {
-	int fd, ret = 0;
-	char data[8] = {0};
+	if (s_monitor_attached) {
+		/* The session isn't ours, leave it running. */
+		return;
+	}
 
-	if ((fd = open("/sys/kernel/debug/damon/monitor_on", O_RDONLY)) < 0) {
-		stderr_print("monitor_on: No such file!\n");
+	if (idle_enabled()) {
+		idle_stop();
 		return;
 	}
 
-	ret = read(fd, data, 8);
-	if (ret < 0) {
-		stderr_print("/sys/kernel/debug/damon/monitor_on: read fail!\n");
+	if (damon_sysfs_active()) {
+		damon_sysfs_stop();
 		return;
 	}
-	close(fd);
 
-	if (!strcmp(data, "on\n"))
+	if (damon_debugfs_supported() && monitor_is_on())
 		system("echo off > /sys/kernel/debug/damon/monitor_on");
 }
 
@@ -1013,7 +1277,11 @@ static int file2str(const char *directory, const char *what, char *ret, int cap)
 	return num_read;
 }
 
-static int do_stats(pid_t pid, uint64_t *slice)
+/*
+ * Read the CPU time (utime + stime, in clock ticks) of a process
+ * from /proc/<pid>/stat.
+ */
+int proc_slice_read(pid_t pid, uint64_t *slice)
 {
 	char sbuf[1024] = {0};
 	char discard_str[1024] = {0};
@@ -1087,7 +1355,7 @@ int cpu_slice_proc_load(track_proc_t * proc)
 	if (total_slice == 0)
 		return -1;
 
-	ret = do_stats(proc->pid, &proc_slice);
+	ret = proc_slice_read(proc->pid, &proc_slice);
 	if (ret < 0)
 		return -1;
 
@@ -1098,7 +1366,7 @@ int cpu_slice_proc_load(track_proc_t * proc)
 		if (proc->slice[1].total_slice == 0) {
 			sleep_ms(5);
 			total_slice = read_cpu_jiffy();
-			do_stats(proc->pid, &proc_slice);
+			proc_slice_read(proc->pid, &proc_slice);
 			proc->slice[1].total_slice = total_slice;
 			proc->slice[1].process_slice = proc_slice;
 		}
@@ -1129,25 +1397,49 @@ int cpu_slice_proc_load(track_proc_t * proc)
 	return 0;
 }
 
+/*
+ * Apply the current target_procs to DAMON. When DAMON runs through
+ * sysfs the targets are committed online and the remaining ones keep
+ * their regions, else DAMON is restarted.
+ */
+int monitor_update(void)
+{
+	char *procs;
+	int ret = 0;
+
+	if (s_monitor_attached) {
+		return (0);
+	}
+
+	/* The engine keeps the regions of the remaining targets too. */
+	if (idle_enabled() && target_procs.nr_proc > 0) {
+		return (idle_start(target_procs.pid, target_procs.nr_proc));
+	}
+
+	if (target_procs.nr_proc > 0 &&
+	    damon_sysfs_commit(target_procs.pid, target_procs.nr_proc) == 0) {
+		return (0);
+	}
+
+	monitor_exit();
+	if (target_procs.nr_proc > 0 &&
+	    (procs = target_procs_str()) != NULL) {
+		ret = monitor_start(procs);
+		free(procs);
+	}
+
+	return (ret);
+}
+
 int proc_monitor(void)
 {
-	int i;
-	pid_t pid;
-	char *procs = (char *)malloc(target_procs.nr_proc * 8);
-	char pid_str[12] = {0};
-
-	memset(procs, 0, target_procs.nr_proc * 8);
-	for (i=0; i<target_procs.nr_proc; i++) {
-		pid = target_procs.pid[i];
-		if (i == 0)
-			sprintf(procs, "%d", pid);
-		else {
-			sprintf(pid_str, ",%d", pid);
-			strcat(procs, pid_str);
-			memset(pid_str, '\0', sizeof(pid_str));
-		}
+	char *procs;
+
+	if ((procs = target_procs_str()) == NULL) {
+		return target_procs.nr_proc;
 	}
-	monitor_start(procs);
+
+	(void)monitor_update();
 	target_procs.ready = 1;
 
 	perf_status_set(PERF_STATUS_IDLE);
@@ -1157,3 +1449,97 @@ int proc_monitor(void)
 
 	return target_procs.nr_proc;
 }
+
+/*
+ * Drop the target processes, the array is kept for reuse.
+ */
+void target_procs_reset(void)
+{
+	target_procs.nr_proc = 0;
+	target_procs.ready = 0;
+	target_procs.last_ms = 0;
+	if (target_procs.pid != NULL) {
+		(void)memset(target_procs.pid, 0,
+			     sizeof(pid_t) * target_procs.pid_size);
+	}
+}
+
+/*
+ * Make room for 'num' target processes.
+ */
+int target_procs_reserve(int num)
+{
+	pid_t *arr;
+	int size = MAX(target_procs.pid_size, 16);
+
+	if (num <= target_procs.pid_size) {
+		return (0);
+	}
+
+	while (size < num) {
+		size <<= 1;
+	}
+
+	if ((arr = realloc(target_procs.pid, sizeof(pid_t) * size)) == NULL) {
+		return (-1);
+	}
+
+	(void)memset(&arr[target_procs.pid_size], 0,
+		     sizeof(pid_t) * (size - target_procs.pid_size));
+	target_procs.pid = arr;
+	target_procs.pid_size = size;
+	return (0);
+}
+
+int target_procs_add(pid_t pid)
+{
+	if (target_procs_reserve(target_procs.nr_proc + 1) != 0) {
+		return (-1);
+	}
+
+	target_procs.pid[target_procs.nr_proc++] = pid;
+	return (0);
+}
+
+/*
+ * Sort the target processes and remove the duplicated ones.
+ */
+void target_procs_uniq(void)
+{
+	int i, j = 0;
+
+	if (target_procs.nr_proc == 0) {
+		return;
+	}
+
+	qsort(target_procs.pid, target_procs.nr_proc, sizeof(pid_t), pid_cmp);
+	for (i = 1; i < target_procs.nr_proc; i++) {
+		if (target_procs.pid[i] != target_procs.pid[j]) {
+			target_procs.pid[++j] = target_procs.pid[i];
+		}
+	}
+
+	target_procs.nr_proc = j + 1;
+}
+
+/*
+ * Build the "pid1,pid2,pid3" string of the target processes. The caller
+ * frees it.
+ */
+char *target_procs_str(void)
+{
+	char *procs;
+	int i, len = 0;
+	size_t size = (size_t)target_procs.nr_proc * 12 + 1;
+
+	if ((procs = zalloc(size)) == NULL) {
+		return (NULL);
+	}
+
+	for (i = 0; i < target_procs.nr_proc; i++) {
+		len += snprintf(procs + len, size - len, "%s%d",
+				(i == 0) ? "" : ",", target_procs.pid[i]);
+	}
+
+	return (procs);
+}
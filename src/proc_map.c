@@ -42,6 +42,7 @@
 #include "./include/util.h"
 #include "./include/proc.h"
 #include "./include/proc_map.h"
+#include "./include/stats.h"
 #include "./include/os/os_util.h"
 
 int map_init(void)
@@ -161,9 +162,11 @@ static void map_free(map_proc_t * map)
 	memset(map, 0, sizeof(map_proc_t));
 }
 
-static int map_read(pid_t pid, map_proc_t * map)
+/*
+ * Read a maps file: /proc/<pid>/maps, or a captured copy of one.
+ */
+int map_file_read(const char *path, map_proc_t * map)
 {
-	char path[PATH_MAX];
 	char line[MAPFILE_LINE_SIZE];
 	char addr_str[128], attr_str[128], off_str[128];
 	char fd_str[128], inode_str[128], path_str[PATH_MAX];
@@ -174,7 +177,6 @@ static int map_read(pid_t pid, map_proc_t * map)
 	FILE *fp;
 
 	memset(map, 0, sizeof(map_proc_t));
-	snprintf(path, sizeof(path), "/proc/%d/maps", pid);
 	if ((fp = fopen(path, "r")) == NULL) {
 		return (-1);
 	}
@@ -244,22 +246,31 @@ L_EXIT:
 	return (ret);
 }
 
+int map_read(pid_t pid, map_proc_t * map)
+{
+	char path[PATH_MAX];
+
+	(void) snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+	return (map_file_read(path, map));
+}
+
 int map_proc_load(track_proc_t * proc)
 {
 	map_proc_t *map = &proc->map;
 	map_proc_t new_map;
 	map_entry_t *old_entry;
-	int i;
+	uint64_t start_ns = stats_ns();
+	int i, ret;
 
 	if (!map->loaded) {
-		if (map_read(proc->pid, map) != 0) {
-			return (-1);
-		}
-
-		return (0);
+		ret = map_read(proc->pid, map);
+		stats_stage_end(STATS_STAGE_MAPS, start_ns);
+		return ((ret != 0) ? -1 : 0);
 	}
 
-	if (map_read(proc->pid, &new_map) != 0) {
+	ret = map_read(proc->pid, &new_map);
+	stats_stage_end(STATS_STAGE_MAPS, start_ns);
+	if (ret != 0) {
 		return (-1);
 	}
 
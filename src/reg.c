@@ -42,11 +42,28 @@
 #include "include/types.h"
 #include "include/win.h"
 #include "include/disp.h"
+#include "include/util.h"
+
+/*
+ * What one line of a 'reg' currently shows on screen. The text is kept
+ * in the raw form given to reg_line_write(), so the next write of the
+ * same line can be compared with it and only the changed cells touched,
+ * and so an unchanged line can still be dumped as it was built.
+ */
+typedef struct _reg_row {
+	uint64_t epoch;
+	uint64_t vhash;
+	int x;
+	unsigned int attr;
+	boolean_t valid;
+	char text[WIN_LINECHAR_MAX];
+} reg_row_t;
 
 int g_scr_height;
 int g_scr_width;
 
 static boolean_t s_curses_init = B_FALSE;
+static uint64_t s_reg_gen = 1;
 
 /*
  * Highlight the selected line.
@@ -127,6 +144,15 @@ reg_init(win_reg_t * r, int begin_x, int begin_y, int ncols, int nlines,
 	r->nlines_scr = nlines;
 	r->mode = mode;
 	r->hdl = reg_win_create(r);
+	r->rows = zalloc(sizeof(reg_row_t) * nlines);
+	r->epoch = 1;
+
+	/*
+	 * A new 'reg' might cover others on screen (e.g. the warning
+	 * message), so nothing cached can be trusted any more.
+	 */
+	reg_damage_reset();
+	r->gen = s_reg_gen;
 	return (r->begin_y + r->nlines_scr);
 }
 
@@ -141,6 +167,33 @@ reg_buf_init(win_reg_t * r, void *buf,
 	r->line_get = line_get;
 }
 
+/*
+ * Make sure the data buffer in 'reg' can hold 'nlines' lines. The
+ * buffer only grows, the lines already in it are kept. Return NULL
+ * if it can't be grown, the old buffer is still valid then.
+ */
+void *reg_buf_reserve(win_reg_t * r, int nlines, size_t line_size)
+{
+	void *buf;
+	int n;
+
+	if ((r->buf != NULL) && (nlines <= r->nlines_buf)) {
+		return (r->buf);
+	}
+
+	n = MAX(nlines, r->nlines_buf * 2);
+	n = MAX(n, 64);
+	if ((buf = realloc(r->buf, line_size * n)) == NULL) {
+		return (NULL);
+	}
+
+	(void)memset((char *)buf + line_size * r->nlines_buf, 0,
+		     line_size * (n - r->nlines_buf));
+	r->buf = buf;
+	r->nlines_buf = n;
+	return (buf);
+}
+
 /*
  * Initialization for 'scrolling'.
  */
@@ -153,12 +206,66 @@ void reg_scroll_init(win_reg_t * r, boolean_t enable)
 }
 
 /*
- * Erase the data in 'reg' on screen.
+ * Forget what all 'reg's think is on screen. Called when something else
+ * has drawn over them, e.g. a different page was shown.
+ */
+void reg_damage_reset(void)
+{
+	s_reg_gen++;
+}
+
+static void reg_damage_sync(win_reg_t * r)
+{
+	int i;
+
+	if (r->gen == s_reg_gen) {
+		return;
+	}
+
+	for (i = 0; i < r->nlines_scr; i++) {
+		r->rows[i].valid = B_FALSE;
+		r->rows[i].vhash = 0;
+		r->rows[i].epoch = 0;
+	}
+
+	r->gen = s_reg_gen;
+}
+
+/*
+ * Erase the data in 'reg'. The lines are not cleared here, the ones
+ * which are not written again before the refresh are cleared by
+ * reg_stale_clear().
  */
 void reg_erase(win_reg_t * r)
 {
 	if (r->hdl != NULL) {
-		(void)werase(r->hdl);
+		r->epoch++;
+	}
+}
+
+static void reg_stale_clear(win_reg_t * r)
+{
+	reg_row_t *row;
+	int i;
+
+	reg_damage_sync(r);
+	for (i = 0; i < r->nlines_scr; i++) {
+		row = &r->rows[i];
+		if (row->epoch == r->epoch) {
+			continue;
+		}
+
+		if (!row->valid || row->text[0] != '\0') {
+			(void)wmove(r->hdl, i, 0);
+			(void)wclrtoeol(r->hdl);
+		}
+
+		row->valid = B_TRUE;
+		row->text[0] = '\0';
+		row->x = 0;
+		row->attr = 0;
+		row->vhash = 0;
+		row->epoch = r->epoch;
 	}
 }
 
@@ -168,6 +275,7 @@ void reg_erase(win_reg_t * r)
 void reg_refresh(win_reg_t * r)
 {
 	if (r->hdl != NULL) {
+		reg_stale_clear(r);
 		(void)wrefresh(r->hdl);
 	}
 }
@@ -179,6 +287,7 @@ void reg_refresh(win_reg_t * r)
 void reg_refresh_nout(win_reg_t * r)
 {
 	if (r->hdl != NULL) {
+		reg_stale_clear(r);
 		(void)wnoutrefresh(r->hdl);
 	}
 }
@@ -200,59 +309,129 @@ void reg_win_destroy(win_reg_t * r)
 		(void)delwin(r->hdl);
 		r->hdl = NULL;
 	}
+
+	free(r->rows);
+	r->rows = NULL;
 }
 
 /*
- * Fill data in a line and display the line on screen.
+ * The content is a format string for historical reasons (callers
+ * escape '%' as "%%"), convert it to the text shown on screen.
  */
-void reg_line_write(win_reg_t * r, int line, reg_align_t align, char *content)
+static int reg_text_render(const char *content, char *text, int size)
 {
-	int pos_x = 0, len;
-
-	if (r->hdl == NULL) {
-		return;
-	}
+	int i = 0;
 
-	if (r->mode != 0) {
-		(void)wattron(r->hdl, r->mode);
-	}
-
-	len = strlen(content);
-	if (align == ALIGN_MIDDLE) {
-		pos_x = (r->ncols_scr - len) / 2;
-	}
+	while ((*content != '\0') && (*content != '\n') && (i < size - 1)) {
+		if ((content[0] == '%') && (content[1] == '%')) {
+			content++;
+		}
 
-	if (len > 0) {
-		(void)mvwprintw(r->hdl, line, pos_x, content);
+		text[i++] = *content++;
 	}
 
-	if (r->mode != 0) {
-		(void)wattroff(r->hdl, r->mode);
-	}
+	text[i] = '\0';
+	return (i);
 }
 
 /*
- * Fill data in one line and display it on screen with highlight.
+ * Show 'content' in a line, touching only the cells which differ from
+ * what the line showed before.
  */
-void reg_highlight_write(win_reg_t * r, int line, int align, char *content)
+static void reg_row_write(win_reg_t * r, int line, int align,
+	char *content, unsigned int attr)
 {
-	int pos_x = 0, len;
+	reg_row_t *row;
+	char text[WIN_LINECHAR_MAX], old[WIN_LINECHAR_MAX];
+	int len, olen, x = 0, i, j;
 
-	if (r->hdl == NULL) {
+	if ((r->hdl == NULL) || (line < 0) || (line >= r->nlines_scr)) {
 		return;
 	}
 
-	(void)wattron(r->hdl, A_REVERSE | A_BOLD);
-	len = strlen(content);
+	len = reg_text_render(content, text, sizeof(text));
 	if (align == ALIGN_MIDDLE) {
-		pos_x = (r->ncols_scr - len) / 2;
+		x = MAX((r->ncols_scr - len) / 2, 0);
+	}
+
+	if (len > r->ncols_scr - x) {
+		len = MAX(r->ncols_scr - x, 0);
+		text[len] = '\0';
+	}
+
+	reg_damage_sync(r);
+	row = &r->rows[line];
+	if (attr != 0) {
+		(void)wattron(r->hdl, attr);
+	}
+
+	if (row->epoch == r->epoch) {
+		/*
+		 * The line is already written since the last erase, draw
+		 * over it as before and repaint it in full next time.
+		 */
+		if (len > 0) {
+			(void)mvwaddnstr(r->hdl, line, x, text, len);
+		}
+
+		row->valid = B_FALSE;
+	} else if (row->valid && (row->x == x) && (row->attr == attr)) {
+		olen = MIN(reg_text_render(row->text, old, sizeof(old)),
+			   MAX(r->ncols_scr - x, 0));
+		for (i = 0; (i < len) && (i < olen) && (text[i] == old[i]); i++)
+			;
+
+		j = len;
+		if (len == olen) {
+			while ((j > i) && (text[j - 1] == old[j - 1])) {
+				j--;
+			}
+		}
+
+		if (j > i) {
+			(void)mvwaddnstr(r->hdl, line, x + i, text + i, j - i);
+		}
+
+		if (len < olen) {
+			(void)wmove(r->hdl, line, x + len);
+			(void)wclrtoeol(r->hdl);
+		}
+	} else {
+		(void)wmove(r->hdl, line, 0);
+		(void)wclrtoeol(r->hdl);
+		if (len > 0) {
+			(void)mvwaddnstr(r->hdl, line, x, text, len);
+		}
+
+		row->valid = B_TRUE;
 	}
 
-	if (len > 0) {
-		(void)mvwprintw(r->hdl, line, pos_x, content);
+	if (attr != 0) {
+		(void)wattroff(r->hdl, attr);
 	}
 
-	(void)wattroff(r->hdl, A_REVERSE | A_BOLD);
+	(void)strncpy(row->text, content, sizeof(row->text));
+	row->text[sizeof(row->text) - 1] = '\0';
+	row->x = x;
+	row->attr = attr;
+	row->vhash = 0;
+	row->epoch = r->epoch;
+}
+
+/*
+ * Fill data in a line and display the line on screen.
+ */
+void reg_line_write(win_reg_t * r, int line, reg_align_t align, char *content)
+{
+	reg_row_write(r, line, align, content, r->mode);
+}
+
+/*
+ * Fill data in one line and display it on screen with highlight.
+ */
+void reg_highlight_write(win_reg_t * r, int line, int align, char *content)
+{
+	reg_row_write(r, line, align, content, A_REVERSE | A_BOLD);
 }
 
 /*
@@ -305,14 +484,75 @@ void reg_line_scroll(win_reg_t * r, int scroll_type)
 }
 
 /*
- * Show the 'scrolling reg'.
+ * FNV-1a over the index and the bytes of one line item.
  */
-void
-reg_scroll_show(win_reg_t * r, void *lines, int nreqs,
+static uint64_t reg_item_hash(int idx, void *lines, int line_size)
+{
+	const unsigned char *p = (unsigned char *)lines +
+	    (size_t)idx * line_size;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	int i;
+
+	h = (h ^ (uint64_t)idx) * 0x100000001b3ULL;
+	for (i = 0; i < line_size; i++) {
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	}
+
+	return ((h != 0) ? h : 1);
+}
+
+/*
+ * Write one line of the 'scrolling reg'. If the line item is the same
+ * as the one the screen line was built from last time, the string is
+ * not built again and the line is kept as is.
+ */
+static void
+reg_scroll_line(win_reg_t * r, void *lines, int line_size, int idx,
+		boolean_t highlight,
 		void (*str_build_func) (char *, int, int, void *))
 {
-	int highlight, i, start, end;
 	char content[WIN_LINECHAR_MAX];
+	unsigned int attr = highlight ? (A_REVERSE | A_BOLD) : r->mode;
+	int line = idx - r->scroll.page_start;
+	uint64_t vhash = 0;
+	reg_row_t *row = NULL;
+
+	if ((r->hdl != NULL) && (line >= 0) && (line < r->nlines_scr)) {
+		reg_damage_sync(r);
+		row = &r->rows[line];
+	}
+
+	if ((row != NULL) && (line_size > 0)) {
+		vhash = reg_item_hash(idx, lines, line_size);
+		if (row->valid && (row->epoch != r->epoch) &&
+		    (row->attr == attr) && (row->vhash == vhash)) {
+			row->epoch = r->epoch;
+			dump_write("%s\n", row->text);
+			return;
+		}
+	}
+
+	content[0] = '\0';
+	str_build_func(content, sizeof(content), idx, lines);
+	dump_write("%s\n", content);
+	if (!highlight) {
+		reg_line_write(r, line, ALIGN_LEFT, content);
+	} else {
+		reg_highlight_write(r, line, ALIGN_LEFT, content);
+	}
+
+	if ((row != NULL) && row->valid) {
+		row->vhash = vhash;
+	}
+}
+
+/*
+ * Get the range of line items [start, end) which reg_scroll_show() shows
+ * for 'nreqs' items, moving the page to keep the highlighted line on it.
+ */
+void reg_scroll_window(win_reg_t * r, int nreqs, int *start, int *end)
+{
+	int highlight, i;
 
 	highlight = r->scroll.highlight;
 	if (highlight != -1) {
@@ -330,30 +570,41 @@ reg_scroll_show(win_reg_t * r, void *lines, int nreqs,
 			    (highlight / r->nlines_scr) * r->nlines_scr;
 		}
 
-		start = r->scroll.page_start;
+		*start = r->scroll.page_start;
 		i = MIN(nreqs, r->nlines_scr);
-		if ((end = start + i) > r->nlines_total) {
-			end = r->nlines_total;
+		if ((*end = *start + i) > r->nlines_total) {
+			*end = r->nlines_total;
 		}
 	} else {
+		*start = 0;
+		*end = MIN(nreqs, r->nlines_scr);
+	}
+}
+
+/*
+ * Show the 'scrolling reg'. 'line_size' is the size of one item in
+ * 'lines', 0 if the string built for an item depends on more than the
+ * item itself (the line is then always built again).
+ */
+void
+reg_scroll_show(win_reg_t * r, void *lines, int nreqs, int line_size,
+		void (*str_build_func) (char *, int, int, void *))
+{
+	int highlight, i, start, end;
+
+	reg_scroll_window(r, nreqs, &start, &end);
+	if ((highlight = r->scroll.highlight) == -1) {
 		highlight = 0;
-		start = 0;
-		end = MIN(nreqs, r->nlines_scr);
+	} else if (highlight >= r->nlines_total) {
+		highlight = r->nlines_total - 1;
 	}
 
 	for (i = start; i < end; i++) {
-		str_build_func(content, sizeof(content), i, lines);
-		dump_write("%s\n", content);
-		if (i != highlight) {
-			reg_line_write(r, i - r->scroll.page_start,
-				       ALIGN_LEFT, content);
-		}
+		reg_scroll_line(r, lines, line_size, i, (i == highlight),
+				str_build_func);
 	}
 
 	if ((highlight >= start) && (highlight < end)) {
-		str_build_func(content, sizeof(content), highlight, lines);
-		reg_highlight_write(r, highlight - r->scroll.page_start,
-				    ALIGN_LEFT, content);
 		r->scroll.highlight = highlight;
 	}
 }
@@ -388,7 +639,13 @@ boolean_t reg_curses_init(boolean_t first_load)
 	(void)noecho();
 	(void)curs_set(0);
 
+	/*
+	 * The 'disp thread' polls stdin and reads all the pending keys.
+	 */
+	(void)nodelay(stdscr, TRUE);
+
 	getmaxyx(stdscr, g_scr_height, g_scr_width);
+	reg_damage_reset();
 
 	/*
 	 * Set a window resize signal handler.
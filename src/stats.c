@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the self-statistics of datop: per-stage latency
+ * histograms and pipeline counters. The histograms are updated with
+ * atomic operations only, so any thread can record without locking.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/stats.h"
+
+static stats_hist_t s_stage_hist[STATS_STAGE_NUM];
+static uint64_t s_counts[STATS_COUNT_NUM];
+static uint64_t s_syscalls_base;
+
+static const char *s_stage_name[STATS_STAGE_NUM][2] = {
+	{ "smpl", "perf" },
+	{ "proc-walk", "perf" },
+	{ "ring-drain", "perf" },
+	{ "ingest", "perf" },
+	{ "maps-parse", "disp" },
+	{ "sort", "disp" },
+	{ "cmd", "disp" },
+	{ "draw", "disp" },
+	{ "hotkey", "disp" },
+	{ "emit", "main" }
+};
+
+/*
+ * Read and write syscalls issued by datop so far, from /proc/self/io.
+ * Returns 0 if the kernel has no task I/O accounting.
+ */
+static uint64_t syscalls_read(void)
+{
+	char line[128];
+	uint64_t val, total = 0;
+	FILE *fp;
+
+	if ((fp = fopen("/proc/self/io", "r")) == NULL) {
+		return (0);
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "syscr: %" SCNu64, &val) == 1 ||
+		    sscanf(line, "syscw: %" SCNu64, &val) == 1) {
+			total += val;
+		}
+	}
+
+	(void)fclose(fp);
+	return (total);
+}
+
+void stats_init(void)
+{
+	(void)memset(s_stage_hist, 0, sizeof(s_stage_hist));
+	(void)memset(s_counts, 0, sizeof(s_counts));
+	s_syscalls_base = syscalls_read();
+}
+
+uint64_t stats_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * NS_SEC + ts.tv_nsec);
+}
+
+/*
+ * Convert a stats_ns() time to the timespec of the waits on
+ * CLOCK_MONOTONIC, e.g. the deadline of pthread_cond_timedwait().
+ */
+void stats_ts(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / NS_SEC;
+	ts->tv_nsec = ns % NS_SEC;
+}
+
+/*
+ * The CPU time (user + system) of datop so far.
+ */
+uint64_t stats_cpu_ns(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0) {
+		return (0);
+	}
+
+	return (((uint64_t)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * NS_SEC +
+	    ((uint64_t)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * NS_USEC);
+}
+
+static int hist_index(uint64_t v)
+{
+	int msb;
+
+	if (v < STATS_HIST_SUBNUM) {
+		return ((int)v);
+	}
+
+	msb = 63 - __builtin_clzll(v);
+	return ((msb - STATS_HIST_SUBBITS + 1) * STATS_HIST_SUBNUM +
+		(int)((v >> (msb - STATS_HIST_SUBBITS)) &
+		(STATS_HIST_SUBNUM - 1)));
+}
+
+/*
+ * The largest value which falls in bucket 'idx'.
+ */
+static uint64_t hist_bucket_max(int idx)
+{
+	int shift;
+	uint64_t sub;
+
+	if (idx < STATS_HIST_SUBNUM) {
+		return ((uint64_t)idx);
+	}
+
+	shift = idx / STATS_HIST_SUBNUM - 1;
+	sub = STATS_HIST_SUBNUM + (idx % STATS_HIST_SUBNUM);
+	return (((sub + 1) << shift) - 1);
+}
+
+static void hist_add(stats_hist_t *hist, uint64_t v)
+{
+	uint64_t max;
+
+	__atomic_add_fetch(&hist->buckets[hist_index(v)], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&hist->count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&hist->sum, v, __ATOMIC_RELAXED);
+
+	max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+	while (v > max &&
+	    !__atomic_compare_exchange_n(&hist->max, &max, v, B_TRUE,
+	    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		;
+	}
+}
+
+/*
+ * Percentile 'pct' (0 - 100) of the histogram. The result is the upper
+ * bound of the bucket containing it, clamped to the recorded maximum.
+ */
+static uint64_t hist_percentile(stats_hist_t *hist, uint64_t count,
+		uint64_t max, int pct)
+{
+	uint64_t target, sum = 0;
+	int i;
+
+	if (count == 0) {
+		return (0);
+	}
+
+	target = (count * pct + 99) / 100;
+	for (i = 0; i < STATS_HIST_NBUCKETS; i++) {
+		sum += __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+		if (sum >= target) {
+			return (MIN(hist_bucket_max(i), max));
+		}
+	}
+
+	return (max);
+}
+
+void stats_stage_add(stats_stage_t stage, uint64_t ns)
+{
+	hist_add(&s_stage_hist[stage], ns);
+}
+
+/*
+ * Record the time elapsed since 'start_ns' (got from stats_ns()).
+ */
+void stats_stage_end(stats_stage_t stage, uint64_t start_ns)
+{
+	hist_add(&s_stage_hist[stage], stats_ns() - start_ns);
+}
+
+void stats_count_add(stats_count_t id, uint64_t val)
+{
+	__atomic_add_fetch(&s_counts[id], val, __ATOMIC_RELAXED);
+}
+
+uint64_t stats_count_get(stats_count_t id)
+{
+	return (__atomic_load_n(&s_counts[id], __ATOMIC_RELAXED));
+}
+
+void stats_snapshot(stats_snap_t *snap)
+{
+	stats_hist_t *hist;
+	stats_stage_snap_t *stage;
+	uint64_t ticks;
+	int i;
+
+	(void)memset(snap, 0, sizeof(stats_snap_t));
+	for (i = 0; i < STATS_STAGE_NUM; i++) {
+		hist = &s_stage_hist[i];
+		stage = &snap->stages[i];
+
+		(void)strncpy(stage->name, s_stage_name[i][0], STATS_NAME_SIZE);
+		(void)strncpy(stage->thread, s_stage_name[i][1],
+			      STATS_NAME_SIZE);
+		stage->name[STATS_NAME_SIZE - 1] = 0;
+		stage->thread[STATS_NAME_SIZE - 1] = 0;
+
+		stage->count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+		stage->max_ns = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+		if (stage->count > 0) {
+			stage->avg_ns = __atomic_load_n(&hist->sum,
+			    __ATOMIC_RELAXED) / stage->count;
+		}
+
+		stage->p50_ns = hist_percentile(hist, stage->count,
+						stage->max_ns, 50);
+		stage->p99_ns = hist_percentile(hist, stage->count,
+						stage->max_ns, 99);
+	}
+
+	ticks = __atomic_load_n(&s_counts[STATS_COUNT_TICK], __ATOMIC_RELAXED);
+	snap->ticks = ticks;
+	snap->lost = stats_count_get(STATS_COUNT_LOST);
+	snap->dump_drops = stats_count_get(STATS_COUNT_DUMP_DROP);
+	if (ticks > 0) {
+		snap->syscalls_per_tick =
+		    (double)(syscalls_read() - s_syscalls_base) / ticks;
+		snap->bytes_per_tick = (double)__atomic_load_n(
+		    &s_counts[STATS_COUNT_DRAIN_BYTES], __ATOMIC_RELAXED) / ticks;
+		snap->recs_per_tick = (double)__atomic_load_n(
+		    &s_counts[STATS_COUNT_DRAIN_RECS], __ATOMIC_RELAXED) / ticks;
+	}
+}
+
+void stats_summary_build(char *buf, int size, stats_snap_t *snap)
+{
+	(void)snprintf(buf, size,
+		       "ticks: %" PRIu64 ", syscalls/tick: %.1f, "
+		       "drained/tick: %.1f KiB (%.1f samples), lost: %" PRIu64
+		       ", dump drops: %" PRIu64,
+		       snap->ticks, snap->syscalls_per_tick,
+		       snap->bytes_per_tick / KB_BYTES, snap->recs_per_tick,
+		       snap->lost, snap->dump_drops);
+}
+
+void stats_caption_build(char *buf, int size)
+{
+	(void)snprintf(buf, size, "%12s%8s%10s%12s%12s%12s%12s",
+		       "STAGE", "THREAD", "COUNT", "P50(us)", "P99(us)",
+		       "MAX(us)", "AVG(us)");
+}
+
+/*
+ * Build the readable string for stage 'idx' of the snapshot 'pv'.
+ */
+void stats_str_build(char *buf, int size, int idx, void *pv)
+{
+	stats_snap_t *snap = (stats_snap_t *)pv;
+	stats_stage_snap_t *stage = &snap->stages[idx];
+
+	(void)snprintf(buf, size,
+		       "%12s%8s%10" PRIu64 "%12.1f%12.1f%12.1f%12.1f",
+		       stage->name, stage->thread, stage->count,
+		       (double)stage->p50_ns / NS_USEC,
+		       (double)stage->p99_ns / NS_USEC,
+		       (double)stage->max_ns / NS_USEC,
+		       (double)stage->avg_ns / NS_USEC);
+}
+
+/*
+ * Write the whole statistics to the dump file.
+ */
+void stats_dump(void)
+{
+	stats_snap_t snap;
+	char content[LINE_SIZE];
+	int i;
+
+	stats_snapshot(&snap);
+	stats_summary_build(content, sizeof(content), &snap);
+	dump_write("\n*** Self statistics (%s)\n", content);
+	stats_caption_build(content, sizeof(content));
+	dump_write("%s\n", content);
+
+	for (i = 0; i < STATS_STAGE_NUM; i++) {
+		stats_str_build(content, sizeof(content), i, &snap);
+		dump_write("%s\n", content);
+	}
+}
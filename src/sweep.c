@@ -0,0 +1,850 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file contains the 'datop sweep' mode. It runs the monitored
+ * workload under a grid of DAMON attributes for a fixed window each,
+ * and reports the overhead (kdamond CPU, datop CPU, lost samples) with
+ * the region count and an accuracy score against the highest
+ * resolution setting, as a table and optionally as CSV.
+ *
+ * 'datop validate' is the same run with the current attributes by
+ * default, scored against the ground truth written by datop-loadgen:
+ * the precision of the observed hot set.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <libgen.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/proc.h"
+#include "include/disp.h"
+#include "include/perf.h"
+#include "include/damon.h"
+#include "include/stats.h"
+#include "include/sweep.h"
+#include "include/os/os_perf.h"
+#include "include/os/os_util.h"
+
+#define	SWEEP_MONITOR_ON	"/sys/kernel/debug/damon/monitor_on"
+
+extern char *optarg;
+extern int optind;
+extern int opterr;
+extern int optopt;
+
+static void sweep_usage(const char *exec_name)
+{
+	char buffer[PATH_MAX];
+
+	(void)strncpy(buffer, exec_name, PATH_MAX);
+	buffer[PATH_MAX - 1] = 0;
+
+	stderr_print("Usage: %s sweep -p <pid>[,<pid>...] [option(s)]\n"
+		     "       %s validate -l <layout> [option(s)]\n",
+		     basename(buffer), basename(buffer));
+	stderr_print("  -p    the processes to monitor (the workload).\n"
+		     "  -l    the layout written by datop-loadgen, its pid is\n"
+		     "        monitored if -p is not given.\n"
+		     "  -s    sampling precision: normal, high or low.\n"
+		     "  -w    seconds to monitor for each setting (default %d).\n"
+		     "  -S    sampling intervals in us (default %s,\n"
+		     "        the current one for validate).\n"
+		     "  -R    max regions (default %s,\n"
+		     "        the current one for validate).\n"
+		     "  -o    path of the CSV file.\n"
+		     "        e.g. datop sweep -p 123 -w 20 -S 5000,20000 "
+		     "-R 1000,100 -o sweep.csv\n",
+		     SWEEP_WINDOW_DEFAULT, SWEEP_SAMPLES_DEFAULT,
+		     SWEEP_REGIONS_DEFAULT);
+}
+
+/*
+ * Parse "v1,v2,..." into 'arr', return the number of values or -1.
+ */
+static int sweep_list_parse(const char *str, uint64_t *arr, int max)
+{
+	char buf[256], *token, *saveptr = NULL, *end;
+	int n = 0;
+
+	if (strlen(str) >= sizeof(buf)) {
+		return (-1);
+	}
+
+	(void)strncpy(buf, str, sizeof(buf));
+	for (token = strtok_r(buf, ",", &saveptr); token != NULL;
+	    token = strtok_r(NULL, ",", &saveptr)) {
+		if (n >= max) {
+			return (-1);
+		}
+
+		arr[n] = strtoull(token, &end, 10);
+		if (end == token || *end != 0 || arr[n] == 0) {
+			return (-1);
+		}
+		n++;
+	}
+
+	return ((n > 0) ? n : -1);
+}
+
+static int u64_cmp_asc(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+static int u64_cmp_desc(const void *a, const void *b)
+{
+	return (u64_cmp_asc(b, a));
+}
+
+int sweep_prof_add(sweep_prof_t *prof, uint64_t start, uint64_t end,
+		double nr_access)
+{
+	sweep_event_t *ev;
+	int cap;
+
+	if (end <= start) {
+		return (0);
+	}
+
+	if (prof->nev + 2 > prof->cap) {
+		cap = (prof->cap == 0) ? 1024 : prof->cap * 2;
+		if ((ev = realloc(prof->ev, sizeof(sweep_event_t) * cap)) ==
+		    NULL) {
+			return (-1);
+		}
+		prof->ev = ev;
+		prof->cap = cap;
+	}
+
+	prof->ev[prof->nev].addr = start;
+	prof->ev[prof->nev++].delta = nr_access;
+	prof->ev[prof->nev].addr = end;
+	prof->ev[prof->nev++].delta = -nr_access;
+	return (0);
+}
+
+void sweep_prof_free(sweep_prof_t *prof)
+{
+	free(prof->ev);
+	(void)memset(prof, 0, sizeof(sweep_prof_t));
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+	const sweep_event_t *x = a, *y = b;
+
+	return ((x->addr > y->addr) - (x->addr < y->addr));
+}
+
+/*
+ * The total access mass (accesses * bytes) of a sorted profile.
+ */
+static double prof_mass(sweep_prof_t *prof)
+{
+	double d = 0, mass = 0;
+	int i;
+
+	for (i = 0; i < prof->nev; i++) {
+		if (i > 0) {
+			mass += d * (double)(prof->ev[i].addr -
+			    prof->ev[i - 1].addr);
+		}
+		d += prof->ev[i].delta;
+	}
+
+	return (mass);
+}
+
+/*
+ * Compare the access distribution of 'prof' with the reference: one
+ * minus half of the L1 distance between the two normalized heat
+ * profiles over the address space. 1 means the same distribution.
+ */
+double sweep_prof_score(sweep_prof_t *ref, sweep_prof_t *prof)
+{
+	double F, G, f = 0, g = 0, dist = 0;
+	uint64_t x, prev = 0;
+	boolean_t started = B_FALSE;
+	int i = 0, j = 0;
+
+	if (ref->nev == 0 || prof->nev == 0) {
+		return (0);
+	}
+
+	qsort(ref->ev, ref->nev, sizeof(sweep_event_t), event_cmp);
+	qsort(prof->ev, prof->nev, sizeof(sweep_event_t), event_cmp);
+	F = prof_mass(ref);
+	G = prof_mass(prof);
+	if (F <= 0 || G <= 0) {
+		return (0);
+	}
+
+	while (i < ref->nev || j < prof->nev) {
+		if (j >= prof->nev ||
+		    (i < ref->nev && ref->ev[i].addr <= prof->ev[j].addr)) {
+			x = ref->ev[i].addr;
+		} else {
+			x = prof->ev[j].addr;
+		}
+
+		if (started) {
+			dist += fabs(f / F - g / G) * (double)(x - prev);
+		}
+
+		while (i < ref->nev && ref->ev[i].addr == x) {
+			f += ref->ev[i++].delta;
+		}
+
+		while (j < prof->nev && prof->ev[j].addr == x) {
+			g += prof->ev[j++].delta;
+		}
+
+		prev = x;
+		started = B_TRUE;
+	}
+
+	return (1.0 - dist / 2.0);
+}
+
+/*
+ * Load the layout written by datop-loadgen:
+ *   pid <pid>
+ *   buf <class> <start> <end> <rate> <pattern> <node>
+ */
+int sweep_layout_load(const char *path, sweep_layout_t *layout)
+{
+	char line[LINE_SIZE], cls[8];
+	sweep_layout_buf_t *buf;
+	unsigned long long start, end;
+	double rate;
+	FILE *fp;
+	int pid;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		return (-1);
+	}
+
+	(void)memset(layout, 0, sizeof(sweep_layout_t));
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "pid %d", &pid) == 1) {
+			layout->pid = pid;
+			continue;
+		}
+
+		if (sscanf(line, "buf %7s %llx %llx %lf", cls, &start, &end,
+		    &rate) != 4 || end <= start) {
+			continue;
+		}
+
+		if (layout->nbufs >= SWEEP_LAYOUT_BUF_MAX) {
+			break;
+		}
+
+		buf = &layout->bufs[layout->nbufs++];
+		(void)strncpy(buf->cls, cls, sizeof(buf->cls));
+		buf->start = start;
+		buf->end = end;
+		buf->rate = rate;
+	}
+
+	(void)fclose(fp);
+	return ((layout->pid > 0 && layout->nbufs > 0) ? 0 : -1);
+}
+
+typedef struct _prof_seg {
+	uint64_t start;
+	uint64_t end;
+	double density;
+} prof_seg_t;
+
+static int seg_cmp(const void *a, const void *b)
+{
+	const prof_seg_t *x = a, *y = b;
+
+	return ((x->density < y->density) - (x->density > y->density));
+}
+
+static uint64_t layout_hot_overlap(sweep_layout_t *layout, uint64_t start,
+		uint64_t end)
+{
+	sweep_layout_buf_t *buf;
+	uint64_t lo, hi, sum = 0;
+	int i;
+
+	for (i = 0; i < layout->nbufs; i++) {
+		buf = &layout->bufs[i];
+		if (strcmp(buf->cls, "hot") != 0) {
+			continue;
+		}
+
+		lo = (start > buf->start) ? start : buf->start;
+		hi = (end < buf->end) ? end : buf->end;
+		if (hi > lo) {
+			sum += hi - lo;
+		}
+	}
+
+	return (sum);
+}
+
+/*
+ * The precision of the observed hot set: take the hottest bytes of the
+ * profile, as many as the hot buffers of the layout have, and return
+ * the fraction of them which is really in a hot buffer. -1 if the
+ * layout has no hot buffer or nothing was observed.
+ */
+double sweep_prof_precision(sweep_prof_t *prof, sweep_layout_t *layout)
+{
+	prof_seg_t *segs;
+	uint64_t k = 0, taken = 0, hit = 0, len;
+	double d = 0;
+	int i, nsegs = 0;
+
+	for (i = 0; i < layout->nbufs; i++) {
+		if (strcmp(layout->bufs[i].cls, "hot") == 0) {
+			k += layout->bufs[i].end - layout->bufs[i].start;
+		}
+	}
+
+	if (k == 0 || prof->nev == 0 ||
+	    (segs = malloc(sizeof(prof_seg_t) * prof->nev)) == NULL) {
+		return (-1);
+	}
+
+	qsort(prof->ev, prof->nev, sizeof(sweep_event_t), event_cmp);
+	for (i = 0; i < prof->nev; i++) {
+		if (i > 0 && d > 0 && prof->ev[i].addr > prof->ev[i - 1].addr) {
+			segs[nsegs].start = prof->ev[i - 1].addr;
+			segs[nsegs].end = prof->ev[i].addr;
+			segs[nsegs++].density = d;
+		}
+		d += prof->ev[i].delta;
+	}
+
+	qsort(segs, nsegs, sizeof(prof_seg_t), seg_cmp);
+	for (i = 0; i < nsegs && taken < k; i++) {
+		len = segs[i].end - segs[i].start;
+		if (len > k - taken) {
+			len = k - taken;
+		}
+		hit += layout_hot_overlap(layout, segs[i].start,
+		    segs[i].start + len);
+		taken += len;
+	}
+
+	free(segs);
+	return ((taken > 0) ? (double)hit / taken : -1);
+}
+
+/*
+ * Add the regions of the last sampling to the heat profiles.
+ */
+static void sweep_prof_collect(sweep_prof_t *profs)
+{
+	track_proc_t *proc;
+	count_value_t *cv;
+	int i, j;
+
+	for (i = 0; i < target_procs.nr_proc; i++) {
+		if ((proc = proc_find(target_procs.pid[i])) == NULL) {
+			continue;
+		}
+
+		(void)pthread_mutex_lock(&proc->mutex);
+		for (j = 0; j < proc->record_max; j++) {
+			cv = &proc->countval_arr[j];
+			(void)sweep_prof_add(&profs[i],
+			    cv->counts[PERF_COUNT_DAMON_START],
+			    cv->counts[PERF_COUNT_DAMON_END],
+			    (double)cv->counts[PERF_COUNT_DAMON_NR_ACCESS]);
+		}
+		(void)pthread_mutex_unlock(&proc->mutex);
+		proc_refcount_dec(proc);
+	}
+}
+
+/*
+ * Run one sampling and wait for the perf thread to complete it.
+ */
+static int sweep_smpl(sweep_prof_t *profs)
+{
+	if (perf_profiling_smpl(B_FALSE) != 0) {
+		return (-1);
+	}
+
+	if (disp_flag2_wait() != DISP_FLAG_PROFILING_DATA_READY) {
+		return (-1);
+	}
+
+	if (profs != NULL) {
+		sweep_prof_collect(profs);
+	}
+
+	return (0);
+}
+
+/*
+ * kdamond stops asynchronously after "off" is written.
+ */
+static void sweep_monitor_stop(void)
+{
+	char data[8];
+	int fd, i, ret;
+
+	monitor_exit();
+	for (i = 0; i < 50; i++) {
+		if ((fd = open(SWEEP_MONITOR_ON, O_RDONLY)) < 0) {
+			return;
+		}
+
+		(void)memset(data, 0, sizeof(data));
+		ret = read(fd, data, sizeof(data) - 1);
+		(void)close(fd);
+		if (ret <= 0 || strncmp(data, "off", 3) == 0) {
+			return;
+		}
+
+		sleep_ms(100);
+	}
+}
+
+/*
+ * Monitor the workload for 'window' seconds with the attributes of 'res'.
+ */
+static int sweep_run(const char *procs, sweep_result_t *res,
+		uint64_t update, int window, sweep_prof_t *profs)
+{
+	char *procs_copy;
+	uint64_t ns0, ns1, cpu0, cpu1, slice0 = 0, slice1 = 0, recs0, lost0;
+	double secs;
+	int i, pid;
+
+	sweep_monitor_stop();
+	if (write_damon_attrs_check(res->sample, res->aggr, update,
+	    res->min_regions, res->max_regions) != 0) {
+		stderr_print("Fail to set DAMON attrs %" PRIu64 " %" PRIu64
+			     " %" PRIu64 " %" PRIu64 " %" PRIu64 ".\n",
+			     res->sample, res->aggr, update,
+			     res->min_regions, res->max_regions);
+		return (-1);
+	}
+
+	if ((procs_copy = strdup(procs)) == NULL) {
+		return (-1);
+	}
+
+	if (monitor_start(procs_copy) < 0) {
+		free(procs_copy);
+		return (-1);
+	}
+
+	free(procs_copy);
+	res->applied = B_TRUE;
+
+	/* Drop what was left in the ring by the previous setting. */
+	sleep_ms(MS_SEC);
+	(void)sweep_smpl(NULL);
+
+	pid = get_kdamon_pid();
+	if (pid > 0) {
+		(void)proc_slice_read(pid, &slice0);
+	}
+
+	ns0 = stats_ns();
+	cpu0 = stats_cpu_ns();
+	recs0 = stats_count_get(STATS_COUNT_DRAIN_RECS);
+	lost0 = stats_count_get(STATS_COUNT_LOST);
+
+	for (i = 0; i < window; i++) {
+		sleep_ms(MS_SEC);
+		if (sweep_smpl(profs) != 0) {
+			break;
+		}
+	}
+
+	if (pid > 0) {
+		(void)proc_slice_read(pid, &slice1);
+	}
+
+	ns1 = stats_ns();
+	cpu1 = stats_cpu_ns();
+	sweep_monitor_stop();
+
+	secs = (double)(ns1 - ns0) / NS_SEC;
+	if (secs <= 0) {
+		return (-1);
+	}
+
+	if (slice1 >= slice0) {
+		res->kdamond_cpu = (double)(slice1 - slice0) * 100.0 /
+		    sysconf(_SC_CLK_TCK) / secs;
+	}
+
+	res->datop_cpu = (double)(cpu1 - cpu0) * 100.0 / NS_SEC / secs;
+	res->lost = stats_count_get(STATS_COUNT_LOST) - lost0;
+	res->nr_regions = (double)(stats_count_get(STATS_COUNT_DRAIN_RECS) -
+	    recs0) * res->aggr / (secs * USEC_MS * MS_SEC);
+	return (0);
+}
+
+static void sweep_report(sweep_result_t *res, int nres, FILE *csv)
+{
+	sweep_result_t *r;
+	char prec[16];
+	int i;
+
+	(void)printf("\n%10s%10s%14s%10s%9s%8s%10s%8s%8s\n",
+		     "SAMPLE(us)", "AGGR(us)", "REGIONS", "KDAMOND%",
+		     "DATOP%", "LOST", "NR_REG", "SCORE", "PREC");
+	if (csv != NULL) {
+		(void)fprintf(csv, "sample_us,aggr_us,min_regions,max_regions,"
+			      "kdamond_cpu_pct,datop_cpu_pct,lost,nr_regions,"
+			      "score,precision\n");
+	}
+
+	for (i = 0; i < nres; i++) {
+		r = &res[i];
+		if (!r->applied) {
+			(void)printf("%10" PRIu64 "%10" PRIu64 "%7" PRIu64
+				     "-%-6" PRIu64 "   (not applied)\n",
+				     r->sample, r->aggr, r->min_regions,
+				     r->max_regions);
+			continue;
+		}
+
+		if (r->precision >= 0) {
+			(void)snprintf(prec, sizeof(prec), "%.3f",
+				       r->precision);
+		} else {
+			(void)strcpy(prec, "-");
+		}
+
+		(void)printf("%10" PRIu64 "%10" PRIu64 "%7" PRIu64 "-%-6"
+			     PRIu64 "%10.2f%9.2f%8" PRIu64 "%10.0f%8.3f%8s\n",
+			     r->sample, r->aggr, r->min_regions,
+			     r->max_regions, r->kdamond_cpu, r->datop_cpu,
+			     r->lost, r->nr_regions, r->score, prec);
+		if (csv != NULL) {
+			(void)fprintf(csv, "%" PRIu64 ",%" PRIu64 ",%" PRIu64
+				      ",%" PRIu64 ",%.3f,%.3f,%" PRIu64
+				      ",%.1f,%.4f,%s\n", r->sample, r->aggr,
+				      r->min_regions, r->max_regions,
+				      r->kdamond_cpu, r->datop_cpu, r->lost,
+				      r->nr_regions, r->score,
+				      (r->precision >= 0) ? prec : "");
+		}
+	}
+}
+
+/*
+ * The entry of "datop sweep". argv[0] is "sweep".
+ */
+int sweep_main(int argc, char *argv[])
+{
+	uint64_t samples[SWEEP_GRID_MAX], regions[SWEEP_GRID_MAX];
+	uint64_t orig[5] = { 0 };
+	int nsamples, nregions, nres = 0, window = SWEEP_WINDOW_DEFAULT;
+	char *procs = NULL, *csv_path = NULL, *token;
+	const char *sample_str = SWEEP_SAMPLES_DEFAULT;
+	const char *region_str = SWEEP_REGIONS_DEFAULT;
+	sweep_result_t *res = NULL;
+	sweep_prof_t *ref = NULL, *cur = NULL, *prof;
+	sweep_layout_t layout;
+	char pid_str[16], orig_str[2][32];
+	FILE *csv = NULL;
+	boolean_t locked = B_FALSE, validate, grid_set = B_FALSE;
+	boolean_t ref_done = B_FALSE;
+	int c, i, j, k, ret = 1, layout_idx = -1;
+	pid_t pid;
+
+	validate = (strcmp(argv[0], "validate") == 0);
+	(void)memset(&layout, 0, sizeof(layout));
+	optind = 1;
+	opterr = 0;
+	while ((c = getopt(argc, argv, "p:w:S:R:o:l:s:h")) != EOF) {
+		switch (c) {
+		case 'p':
+			target_procs_reset();
+			for (token = strtok(optarg, ","); token != NULL;
+			    token = strtok(NULL, ",")) {
+				pid = atoi(token);
+				if (pid <= 0 || target_procs_add(pid) != 0) {
+					stderr_print("Invalid pid '%s'.\n", token);
+					goto L_EXIT0;
+				}
+			}
+			target_procs_uniq();
+			free(procs);
+			procs = target_procs_str();
+			target_procs.ready = 1;
+			break;
+
+		case 'w':
+			if ((window = atoi(optarg)) <= 0) {
+				stderr_print("Invalid window %s.\n", optarg);
+				goto L_EXIT0;
+			}
+			break;
+
+		case 'S':
+			sample_str = optarg;
+			grid_set = B_TRUE;
+			break;
+
+		case 'R':
+			region_str = optarg;
+			grid_set = B_TRUE;
+			break;
+
+		case 'l':
+			if (sweep_layout_load(optarg, &layout) != 0) {
+				stderr_print("Invalid layout '%s'.\n", optarg);
+				goto L_EXIT0;
+			}
+			break;
+
+		case 's':
+			if (strcasecmp(optarg, "high") == 0) {
+				g_precise = PRECISE_HIGH;
+			} else if (strcasecmp(optarg, "low") == 0) {
+				g_precise = PRECISE_LOW;
+			} else if (strcasecmp(optarg, "normal") == 0) {
+				g_precise = PRECISE_NORMAL;
+			} else {
+				stderr_print("Invalid sampling_precision '%s'.\n",
+					     optarg);
+				goto L_EXIT0;
+			}
+			break;
+
+		case 'o':
+			csv_path = optarg;
+			break;
+
+		case 'h':
+			sweep_usage(argv[0]);
+			ret = 0;
+			goto L_EXIT0;
+
+		default:
+			stderr_print("Unrecognized option %c.\n", optopt);
+			sweep_usage(argv[0]);
+			goto L_EXIT0;
+		}
+	}
+
+	if (procs == NULL && layout.pid > 0) {
+		(void)snprintf(pid_str, sizeof(pid_str), "%d", (int)layout.pid);
+		procs = strdup(pid_str);
+		target_procs_reset();
+		(void)target_procs_add(layout.pid);
+		target_procs.ready = 1;
+	}
+
+	if (procs == NULL || target_procs.nr_proc == 0 ||
+	    (validate && layout.pid == 0)) {
+		sweep_usage(argv[0]);
+		goto L_EXIT0;
+	}
+
+	for (k = 0; k < target_procs.nr_proc; k++) {
+		if (target_procs.pid[k] == layout.pid) {
+			layout_idx = k;
+		}
+	}
+
+	read_damon_attrs(DAMON_ATTRS_PATH, &orig[0], &orig[1], &orig[2],
+			&orig[3], &orig[4]);
+	if (orig[0] == 0 || orig[1] == 0) {
+		stderr_print("Cannot read the DAMON attrs.\n");
+		goto L_EXIT0;
+	}
+
+	/* validate runs with the current attributes by default */
+	if (validate && !grid_set) {
+		(void)snprintf(orig_str[0], sizeof(orig_str[0]),
+			       "%" PRIu64, orig[0]);
+		(void)snprintf(orig_str[1], sizeof(orig_str[1]),
+			       "%" PRIu64, orig[4]);
+		sample_str = orig_str[0];
+		region_str = orig_str[1];
+	}
+
+	if ((nsamples = sweep_list_parse(sample_str, samples,
+	    SWEEP_GRID_MAX)) < 0 ||
+	    (nregions = sweep_list_parse(region_str, regions,
+	    SWEEP_GRID_MAX)) < 0) {
+		stderr_print("Invalid sweep grid.\n");
+		goto L_EXIT0;
+	}
+
+	if (csv_path != NULL && (csv = fopen(csv_path, "w")) == NULL) {
+		stderr_print("Cannot open '%s' for CSV.\n", csv_path);
+		goto L_EXIT0;
+	}
+
+	/*
+	 * The first setting (shortest sampling, most regions) has the
+	 * highest resolution and is the reference of the score.
+	 */
+	qsort(samples, nsamples, sizeof(uint64_t), u64_cmp_asc);
+	qsort(regions, nregions, sizeof(uint64_t), u64_cmp_desc);
+	if ((res = zalloc(sizeof(sweep_result_t) * nsamples * nregions)) ==
+	    NULL ||
+	    (ref = zalloc(sizeof(sweep_prof_t) * target_procs.nr_proc)) ==
+	    NULL ||
+	    (cur = zalloc(sizeof(sweep_prof_t) * target_procs.nr_proc)) ==
+	    NULL) {
+		goto L_EXIT0;
+	}
+
+	for (i = 0; i < nsamples; i++) {
+		for (j = 0; j < nregions; j++) {
+			res[nres].sample = samples[i];
+			/* Keep the aggregation/sampling ratio. */
+			res[nres].aggr = samples[i] * orig[1] / orig[0];
+			res[nres].max_regions = regions[j];
+			res[nres].min_regions = MIN(orig[3], regions[j]);
+			res[nres].precision = -1;
+			nres++;
+		}
+	}
+
+	if (os_damontop_lock(&locked) != 0 || locked) {
+		stderr_print("Another damontop instance is running!\n");
+		goto L_EXIT0;
+	}
+
+	stats_init();
+	if (proc_group_init() != 0) {
+		goto L_EXIT1;
+	}
+
+	if (disp_sync_init() != 0) {
+		goto L_EXIT2;
+	}
+
+	if (perf_init() != 0) {
+		stderr_print("Fail to setup perf.\n");
+		goto L_EXIT3;
+	}
+
+	for (i = 0; i < nres; i++) {
+		(void)printf("[%d/%d] sample %" PRIu64 "us, aggr %" PRIu64
+			     "us, regions %" PRIu64 "-%" PRIu64 " ...\n",
+			     i + 1, nres, res[i].sample, res[i].aggr,
+			     res[i].min_regions, res[i].max_regions);
+		(void)fflush(stdout);
+
+		/*
+		 * The first applied setting is the reference, a failed run
+		 * leaves the reference to the next (and lower) one.
+		 */
+		prof = ref_done ? cur : ref;
+		if (sweep_run(procs, &res[i], orig[2], window, prof) != 0) {
+			res[i].applied = B_FALSE;
+			for (k = 0; k < target_procs.nr_proc; k++) {
+				sweep_prof_free(&prof[k]);
+			}
+			continue;
+		}
+
+		if (layout_idx >= 0) {
+			res[i].precision = sweep_prof_precision(
+			    &prof[layout_idx], &layout);
+		}
+
+		for (k = 0; k < target_procs.nr_proc; k++) {
+			if (!ref_done) {
+				res[i].score += 1.0;
+				continue;
+			}
+			res[i].score += sweep_prof_score(&ref[k], &cur[k]);
+			sweep_prof_free(&cur[k]);
+		}
+		res[i].score /= target_procs.nr_proc;
+
+		if (!ref_done && i > 0) {
+			stderr_print("The reference is the setting %d, the "
+				     "higher ones were not applied.\n", i + 1);
+		}
+
+		ref_done = B_TRUE;
+	}
+
+	if (!ref_done) {
+		stderr_print("No setting could be applied.\n");
+		goto L_EXIT4;
+	}
+
+	sweep_report(res, nres, csv);
+	ret = 0;
+
+L_EXIT4:
+	perf_fini();
+
+L_EXIT3:
+	disp_sync_fini();
+
+L_EXIT2:
+	sweep_monitor_stop();
+	write_damon_attrs(orig[0], orig[1], orig[2], orig[3], orig[4]);
+	proc_group_fini();
+
+L_EXIT1:
+	os_damontop_unlock();
+
+L_EXIT0:
+	if (ref != NULL && cur != NULL) {
+		for (k = 0; k < target_procs.nr_proc; k++) {
+			sweep_prof_free(&ref[k]);
+			sweep_prof_free(&cur[k]);
+		}
+	}
+
+	free(ref);
+	free(cur);
+	free(res);
+	free(procs);
+	if (csv != NULL) {
+		(void)fclose(csv);
+	}
+
+	return (ret);
+}
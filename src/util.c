@@ -51,7 +51,9 @@
 #include "include/util.h"
 #include "include/proc.h"
 #include "include/perf.h"
+#include "include/stats.h"
 #include "include/damon.h"
+#include "include/idle.h"
 #include "include/os/os_util.h"
 
 #define KERNEL_ADDR_START	0xffffffff80000000
@@ -62,7 +64,6 @@ struct timeval g_tvbase;
 static int s_debuglevel;
 static FILE *s_logfile;
 static debug_ctl_t s_debug_ctl;
-static dump_ctl_t s_dump_ctl;
 static char s_exit_msg[EXIT_MSG_SIZE];
 
 static unsigned int msdiff(struct timeval *, struct timeval *);
@@ -152,6 +153,45 @@ void debug_print(FILE * out, int level, const char *fmt, ...)
 	}
 }
 
+/*
+ * Parse a percentage, e.g. the "2%" of "cpu=2%" in --budget and
+ * --autotune, the '%' is optional. Return -1 if it's not a positive
+ * number.
+ */
+int pct_parse(const char *str, double *pct)
+{
+	char *end;
+	double v;
+
+	v = strtod(str, &end);
+	if (end == str || v <= 0.0) {
+		return (-1);
+	}
+
+	if (*end == '%') {
+		end++;
+	}
+
+	if (*end != 0) {
+		return (-1);
+	}
+
+	*pct = v;
+	return (0);
+}
+
+/*
+ * Get the time of CLOCK_MONOTONIC, so the intervals are not affected
+ * by the wall-clock jumps.
+ */
+void monotonic_tv(struct timeval *tv)
+{
+	uint64_t ns = stats_ns();
+
+	tv->tv_sec = ns / NS_SEC;
+	tv->tv_usec = (ns % NS_SEC) / NS_USEC;
+}
+
 /*
  * Get the current timestamp and convert it to milliseconds
  * (timing from damontop startup).
@@ -160,7 +200,7 @@ uint64_t current_ms(struct timeval *tvbase)
 {
 	struct timeval tvnow;
 
-	(void)gettimeofday(&tvnow, 0);
+	monotonic_tv(&tvnow);
 	return (msdiff(&tvnow, tvbase));
 }
 
@@ -218,6 +258,11 @@ static int get_damon_status(void)
 	char data[8] = {0};
 	int ret = 0, fd;
 
+	/* DAMON of sysfs doesn't filter the processes. */
+	if (!damon_debugfs_supported()) {
+		return 0;
+	}
+
 	if ((fd = open("/sys/kernel/debug/damon/monitor_on", O_RDONLY)) < 0) {
 		stderr_print("kdamon_pid: No such file!\n");
 		return 0;
@@ -239,67 +284,84 @@ static int get_damon_status(void)
 	return ret;
 }
 
+static int damon_pid_cmp(const void *a, const void *b)
+{
+	const pid_t *pid1 = (const pid_t *)a;
+	const pid_t *pid2 = (const pid_t *)b;
+
+	return ((*pid1 > *pid2) - (*pid1 < *pid2));
+}
+
 /*
- * The processes number that monitored in cpu utilization way will
- * be limited at 32.
+ * Read the pids from 'target_ids' into a sorted array. The file is
+ * parsed as a stream, there is no limit of the number of targets.
  */
-static int damon_is_target_proc(pid_t pid)
+int damon_target_ids_load(pid_t **pid_arr, int *num)
 {
-	char *target_ids = "/sys/kernel/debug/damon/target_ids";
-	int fd, ret = 0;
-	char data[32 * 8];
-	char *token;
-	pid_t pid2;
+	FILE *fp;
+	pid_t *arr = NULL, *arr2;
+	int pid, n = 0, size = 0;
 
-	if ((fd = open(target_ids, O_RDONLY)) < 0) {
+	*pid_arr = NULL;
+	*num = 0;
+	if ((fp = fopen("/sys/kernel/debug/damon/target_ids", "r")) == NULL) {
 		debug_print(NULL, 2, "target_ids: No such file!\n");
-		return 0;
+		return (-1);
 	}
 
-	memset(data, 0, 32*8 - 1);
-	ret = read(fd, data, 32*8);
-	if (ret < 0) {
-		debug_print(NULL, 2, "target_ids!\n");
-		close(fd);
-		return 0;
-	}
-	close(fd);
+	while (fscanf(fp, "%d", &pid) == 1) {
+		if (pid <= 0) {
+			debug_print(NULL, 2, "Invalid pid %d.\n", pid);
+			continue;
+		}
 
-	ret = 0;
-	token = strtok(data, " ");
-	pid2 = atoi(token);
-	if (pid2 == pid)
-		return 1;
-	while (token != NULL) {
-		token = strtok(NULL, " ");
-		if (token == NULL)
-			break;
+		if (n >= size) {
+			size = (size == 0) ? PROCFS_ID_NUM : (size << 1);
+			if ((arr2 = realloc(arr, size * sizeof(pid_t))) == NULL) {
+				free(arr);
+				(void)fclose(fp);
+				return (-1);
+			}
 
-		pid2 = atoi(token);
-		if (pid2 <= 0) {
-			debug_print(NULL, 2, "Invalid pid %d.\n", pid2);
-			break;
-		}
-		if (pid2 == pid) {
-			ret = 1;
-			break;
+			arr = arr2;
 		}
+
+		arr[n++] = pid;
 	}
 
-	return ret;
+	(void)fclose(fp);
+	if (n > 1) {
+		qsort(arr, n, sizeof(pid_t), damon_pid_cmp);
+	}
+
+	*pid_arr = arr;
+	*num = n;
+	return (0);
 }
 
-static int procfs_walk(char *path, int **id_arr, int *num)
+int procfs_walk(char *path, int **id_arr, int *num)
 {
 	static DIR *dirp;
 	struct dirent *dentp;
-	int i = 0, size = *num, id;
+	int i = 0, size = *num, id, ntargets = 0;
 	int *arr1 = *id_arr, *arr2;
+	pid_t *targets = NULL;
+	boolean_t damon_on;
 
 	if ((dirp = opendir(path)) == NULL) {
 		return (-1);
 	}
 
+	/*
+	 * When DAMON is on, only the processes traced in DAMON count.
+	 * Load the target ids once for the whole walk.
+	 */
+	if (idle_enabled()) {
+		damon_on = (idle_targets_load(&targets, &ntargets) == 0);
+	} else if ((damon_on = (get_damon_status() == 1))) {
+		(void)damon_target_ids_load(&targets, &ntargets);
+	}
+
 	while ((dentp = readdir(dirp)) != NULL) {
 		if (dentp->d_name[0] == '.') {
 			/* skip "." and ".." */
@@ -311,8 +373,8 @@ static int procfs_walk(char *path, int **id_arr, int *num)
 			continue;
 		}
 
-		if (get_damon_status() == 1 &&
-				damon_is_target_proc(id) == 0) {
+		if (damon_on && bsearch(&id, targets, ntargets, sizeof(pid_t),
+					damon_pid_cmp) == NULL) {
 			/* Not be traced in DAMON. */
 			continue;
 		}
@@ -324,6 +386,8 @@ static int procfs_walk(char *path, int **id_arr, int *num)
 			size = size << 1;
 			if ((arr2 = realloc(arr1, size * sizeof(int))) == NULL) {
 				free(arr1);
+				free(targets);
+				(void)closedir(dirp);
 				*id_arr = NULL;
 				*num = 0;
 				return (-1);
@@ -339,6 +403,7 @@ static int procfs_walk(char *path, int **id_arr, int *num)
 	*id_arr = arr1;
 	*num = i;
 
+	free(targets);
 	(void)closedir(dirp);
 	return (0);
 }
@@ -431,87 +496,6 @@ uint64_t cyc2ns(uint64_t cyc)
 	return (ns);
 }
 
-/*
- * Initialization for dump control structure.
- */
-int dump_init(FILE * dump_file)
-{
-	(void)memset(&s_dump_ctl, 0, sizeof(s_dump_ctl));
-	if ((s_dump_ctl.fout = dump_file) != NULL) {
-		if ((s_dump_ctl.cache = zalloc(DUMP_CACHE_SIZE)) == NULL) {
-			return (-1);
-		}
-
-		s_dump_ctl.pcur = s_dump_ctl.cache;
-		s_dump_ctl.rest_size = DUMP_CACHE_SIZE;
-	}
-
-	return (0);
-}
-
-/*
- * Clean up resources of dump control structure.
- */
-void dump_fini(void)
-{
-	if (s_dump_ctl.fout != NULL) {
-		(void)fclose(s_dump_ctl.fout);
-	}
-
-	if (s_dump_ctl.cache != NULL) {
-		free(s_dump_ctl.cache);
-	}
-}
-
-/*
- * Write the message into dump file.
- */
-void dump_write(const char *fmt, ...)
-{
-	va_list ap;
-	int n;
-
-	if (s_dump_ctl.fout == NULL) {
-		return;
-	}
-
-	if (!s_dump_ctl.cache_mode) {
-		va_start(ap, fmt);
-		(void)vfprintf(s_dump_ctl.fout, fmt, ap);
-		va_end(ap);
-		(void)fflush(s_dump_ctl.fout);
-	} else {
-		va_start(ap, fmt);
-		n = vsnprintf(s_dump_ctl.pcur, s_dump_ctl.rest_size, fmt, ap);
-		va_end(ap);
-		s_dump_ctl.pcur += n;
-		s_dump_ctl.rest_size -= n;
-	}
-}
-
-void dump_cache_enable(void)
-{
-	s_dump_ctl.cache_mode = B_TRUE;
-}
-
-void dump_cache_disable(void)
-{
-	s_dump_ctl.cache_mode = B_FALSE;
-}
-
-void dump_cache_flush(void)
-{
-	if (s_dump_ctl.fout != NULL) {
-		(void)fprintf(s_dump_ctl.fout, "%s", s_dump_ctl.cache);
-		(void)fflush(s_dump_ctl.fout);
-
-		(void)memset(s_dump_ctl.cache, 0, DUMP_CACHE_SIZE);
-		s_dump_ctl.pcur = s_dump_ctl.cache;
-		s_dump_ctl.rest_size = DUMP_CACHE_SIZE;
-		s_dump_ctl.cache_mode = B_FALSE;
-	}
-}
-
 /*
  * Print the message to STDERR.
  */
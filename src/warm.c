@@ -0,0 +1,851 @@
+/*
+ * Copyright (c) 2021, Alibaba Group Holding Limited
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * This file contains the programming of DAMON's 'init_regions':
+ *
+ * - the warm start: the region layout which DAMON has converged to is
+ *   saved per target, and the next run seeds DAMON with it, so that the
+ *   useful resolution is there after a couple of aggregations instead
+ *   of after minutes of splitting.
+ *
+ * - the zoom: DAMON is restarted with the regions of one target packed
+ *   into the selected range, the other targets keep their layout. The
+ *   zoom out restarts it with the layout from before the zoom.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include "include/types.h"
+#include "include/util.h"
+#include "include/proc.h"
+#include "include/damon.h"
+#include "include/damon_sysfs.h"
+#include "include/idle.h"
+#include "include/warm.h"
+
+#define	WARM_INIT_REGIONS	"/sys/kernel/debug/damon/init_regions"
+
+static char *s_warm_path;
+
+/* The layout written by the next warm_seed(). */
+static warm_layout_t s_warm_layout;
+static boolean_t s_warm_pending;
+
+/* The layout from before the zoom, restored by the zoom out. */
+static warm_layout_t s_zoom_saved;
+static warm_zoom_t s_zoom;
+
+/*
+ * "--warm-start <file>": the layout is saved to the file when datop
+ * exits (or on the hotkey 'W'), and loaded from it when DAMON starts.
+ */
+int warm_parse(const char *path)
+{
+	if (path == NULL || path[0] == 0) {
+		return (-1);
+	}
+
+	free(s_warm_path);
+	if ((s_warm_path = strdup(path)) == NULL) {
+		return (-1);
+	}
+
+	return (0);
+}
+
+boolean_t warm_enabled(void)
+{
+	return (s_warm_path != NULL);
+}
+
+static void warm_layout_free(warm_layout_t *layout)
+{
+	int i;
+
+	for (i = 0; i < layout->ntargets; i++) {
+		free(layout->targets[i].regions);
+	}
+
+	free(layout->targets);
+	(void)memset(layout, 0, sizeof(warm_layout_t));
+}
+
+void warm_fini(void)
+{
+	warm_layout_free(&s_warm_layout);
+	warm_layout_free(&s_zoom_saved);
+	free(s_warm_path);
+	s_warm_path = NULL;
+}
+
+static warm_target_t *warm_target_new(warm_layout_t *layout)
+{
+	warm_target_t *t;
+
+	if (array_alloc((void **)&layout->targets, &layout->ntargets,
+			&layout->size, sizeof(warm_target_t), 16) != 0) {
+		layout->ntargets = 0;
+		layout->size = 0;
+		return (NULL);
+	}
+
+	t = &layout->targets[layout->ntargets++];
+	(void)memset(t, 0, sizeof(warm_target_t));
+	return (t);
+}
+
+static int warm_region_add(warm_target_t *t, uint64_t start, uint64_t end)
+{
+	if (array_alloc((void **)&t->regions, &t->nregions, &t->regions_size,
+			sizeof(warm_region_t), PROC_RECORD_MAX) != 0) {
+		t->nregions = 0;
+		t->regions_size = 0;
+		return (-1);
+	}
+
+	t->regions[t->nregions].start = start;
+	t->regions[t->nregions].end = end;
+	t->nregions++;
+	return (0);
+}
+
+/*
+ * The blanks are replaced in the cgroup path, it's one field of the
+ * "target" line in the file.
+ */
+static void warm_cgroup_read(pid_t pid, char *buf, int size)
+{
+	char path[64], line[WARM_LINE_SIZE], *p;
+	FILE *fp;
+
+	buf[0] = 0;
+	(void)snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+	if ((fp = fopen(path, "r")) != NULL) {
+		/* The cgroup v2 line ("0::/path") wins over the v1 ones. */
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			if ((p = strchr(line, ':')) == NULL ||
+			    (p = strchr(p + 1, ':')) == NULL) {
+				continue;
+			}
+
+			if (buf[0] == 0 || strncmp(line, "0::", 3) == 0) {
+				(void)strncpy(buf, p + 1, size - 1);
+				buf[size - 1] = 0;
+			}
+
+			if (strncmp(line, "0::", 3) == 0) {
+				break;
+			}
+		}
+
+		(void)fclose(fp);
+	}
+
+	buf[strcspn(buf, "\n")] = 0;
+	for (p = buf; *p != 0; p++) {
+		if (*p == ' ' || *p == '\t') {
+			*p = '_';
+		}
+	}
+
+	if (buf[0] == 0) {
+		(void)strncpy(buf, "-", size);
+	}
+}
+
+static void warm_cmdline_read(pid_t pid, char *buf, int size)
+{
+	char path[64];
+	int fd, i, n = 0;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+	if ((fd = open(path, O_RDONLY)) >= 0) {
+		if ((n = read(fd, buf, size - 1)) < 0) {
+			n = 0;
+		}
+
+		(void)close(fd);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (buf[i] == 0 || buf[i] == '\n') {
+			buf[i] = ' ';
+		}
+	}
+
+	while (n > 0 && buf[n - 1] == ' ') {
+		n--;
+	}
+
+	buf[n] = 0;
+	if (n == 0) {
+		(void)strncpy(buf, "-", size);
+	}
+}
+
+/*
+ * Copy the latest regions of 'pid' into 'cv_arr', sorted by address.
+ * Return the number of regions.
+ */
+static int warm_proc_regions(pid_t pid, count_value_t *cv_arr)
+{
+	track_proc_t *proc;
+	int nr_nonzero;
+
+	if ((proc = proc_find(pid)) == NULL) {
+		return (0);
+	}
+
+	(void)memset(cv_arr, 0, sizeof(count_value_t) * PROC_RECORD_MAX);
+	(void)pthread_mutex_lock(&proc->mutex);
+	(void)memcpy(cv_arr, proc->countval_arr,
+		     sizeof(count_value_t) * MIN(proc->record_max,
+						 PROC_RECORD_MAX));
+	(void)pthread_mutex_unlock(&proc->mutex);
+	proc_refcount_dec(proc);
+
+	proc_countvalue_sort(cv_arr, &nr_nonzero);
+	return (nr_nonzero);
+}
+
+/*
+ * Take the current regions of 'pid' into 't'. The regions of older
+ * aggregations may overlap the latest ones, only the first of the
+ * overlapping regions is kept.
+ */
+static void warm_target_fill(warm_target_t *t, pid_t pid,
+			     count_value_t *cv_arr)
+{
+	count_value_t *cv;
+	uint64_t end;
+	int j, n;
+
+	n = warm_proc_regions(pid, cv_arr);
+	t->pid = pid;
+	for (j = 0, end = 0; j < n; j++) {
+		cv = &cv_arr[j];
+		if (cv->counts[PERF_COUNT_DAMON_START] < end ||
+		    cv->counts[PERF_COUNT_DAMON_END] <=
+		    cv->counts[PERF_COUNT_DAMON_START]) {
+			continue;
+		}
+
+		end = cv->counts[PERF_COUNT_DAMON_END];
+		if (warm_region_add(t, cv->counts[PERF_COUNT_DAMON_START],
+				    end) != 0) {
+			break;
+		}
+	}
+}
+
+/*
+ * Take the current region layout of all targets into 'layout'.
+ */
+static int warm_capture(warm_layout_t *layout)
+{
+	count_value_t *cv_arr;
+	warm_target_t *t;
+	int i;
+
+	warm_layout_free(layout);
+	if ((cv_arr = zalloc(sizeof(count_value_t) * PROC_RECORD_MAX)) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < target_procs.nr_proc; i++) {
+		if ((t = warm_target_new(layout)) == NULL) {
+			free(cv_arr);
+			return (-1);
+		}
+
+		warm_target_fill(t, target_procs.pid[i], cv_arr);
+		if (t->nregions == 0) {
+			layout->ntargets--;
+			continue;
+		}
+
+		warm_cmdline_read(t->pid, t->cmdline, sizeof(t->cmdline));
+		warm_cgroup_read(t->pid, t->cgroup, sizeof(t->cgroup));
+	}
+
+	free(cv_arr);
+	return (layout->ntargets);
+}
+
+static int warm_sysfs_regions(pid_t pid, warm_target_t *t)
+{
+	int j;
+
+	if (damon_sysfs_target_regions(pid, t->nregions) != 0) {
+		return (-1);
+	}
+
+	for (j = 0; j < t->nregions; j++) {
+		if (damon_sysfs_target_region(pid, j, t->regions[j].start,
+					      t->regions[j].end) != 0) {
+			return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Give the sysfs target 'pid' its current regions, or one region over
+ * all of its user mappings when datop has none yet.
+ */
+int warm_regions_stage(pid_t pid)
+{
+	char path[64], line[WARM_LINE_SIZE];
+	uint64_t lo, hi, first = 0, last = 0;
+	count_value_t *cv_arr;
+	warm_target_t t;
+	FILE *fp;
+	int ret;
+
+	if ((cv_arr = zalloc(sizeof(count_value_t) * PROC_RECORD_MAX)) == NULL) {
+		return (-1);
+	}
+
+	(void)memset(&t, 0, sizeof(t));
+	warm_target_fill(&t, pid, cv_arr);
+	free(cv_arr);
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+	if (t.nregions == 0 && (fp = fopen(path, "r")) != NULL) {
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			if (sscanf(line, "%" SCNx64 "-%" SCNx64, &lo, &hi) == 2 &&
+			    is_userspace(lo)) {
+				first = (first == 0) ? lo : first;
+				last = hi;
+			}
+		}
+
+		(void)fclose(fp);
+		if (first < last) {
+			(void)warm_region_add(&t, first, last);
+		}
+	}
+
+	ret = warm_sysfs_regions(pid, &t);
+	free(t.regions);
+	return (ret);
+}
+
+/*
+ * Save the region layout of all targets, or the one from before the
+ * zoom. The file is written aside and renamed, a crash in the middle
+ * never leaves a truncated layout. Return the number of targets saved,
+ * or -1 on failure.
+ */
+int warm_save(void)
+{
+	warm_layout_t cur, *layout = &s_zoom_saved;
+	warm_target_t *t;
+	char tmp[PATH_MAX];
+	FILE *fp;
+	int i, j;
+
+	if (s_warm_path == NULL) {
+		return (0);
+	}
+
+	if ((size_t)snprintf(tmp, sizeof(tmp), "%s.tmp", s_warm_path) >=
+	    sizeof(tmp)) {
+		return (-1);
+	}
+
+	(void)memset(&cur, 0, sizeof(cur));
+	if (!s_zoom.zoomed) {
+		layout = &cur;
+		if (warm_capture(layout) < 0) {
+			warm_layout_free(layout);
+			return (-1);
+		}
+	}
+
+	if ((fp = fopen(tmp, "w")) == NULL) {
+		debug_print(NULL, 2, "warm: can't open %s\n", tmp);
+		warm_layout_free(&cur);
+		return (-1);
+	}
+
+	(void)fprintf(fp, "# datop regions: \"target <pid> <cgroup> "
+		      "<cmdline>\", then \"<start> <end>\" per region\n");
+	for (i = 0; i < layout->ntargets; i++) {
+		t = &layout->targets[i];
+		(void)fprintf(fp, "target %d %s %s\n", t->pid, t->cgroup,
+			      t->cmdline);
+		for (j = 0; j < t->nregions; j++) {
+			(void)fprintf(fp, "%#" PRIx64 " %#" PRIx64 "\n",
+				      t->regions[j].start, t->regions[j].end);
+		}
+	}
+
+	i = layout->ntargets;
+	warm_layout_free(&cur);
+	if (ferror(fp) | fclose(fp)) {
+		debug_print(NULL, 2, "warm: write %s failed\n", tmp);
+		(void)unlink(tmp);
+		return (-1);
+	}
+
+	if (rename(tmp, s_warm_path) != 0) {
+		debug_print(NULL, 2, "warm: rename to %s failed\n",
+			    s_warm_path);
+		(void)unlink(tmp);
+		return (-1);
+	}
+
+	debug_print(NULL, 2, "warm: %d targets saved to %s\n", i,
+		    s_warm_path);
+	return (i);
+}
+
+static int warm_load(warm_layout_t *layout)
+{
+	char line[WARM_LINE_SIZE];
+	warm_target_t *t = NULL;
+	uint64_t start, end;
+	FILE *fp;
+	int off;
+
+	warm_layout_free(layout);
+	if ((fp = fopen(s_warm_path, "r")) == NULL) {
+		/* The first run, nothing saved yet. */
+		debug_print(NULL, 2, "warm: no layout in %s\n", s_warm_path);
+		return (0);
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\n")] = 0;
+		if (line[0] == '#' || line[0] == 0) {
+			continue;
+		}
+
+		if (strncmp(line, "target ", 7) != 0) {
+			if (t != NULL &&
+			    sscanf(line, "%" SCNx64 " %" SCNx64, &start, &end) == 2 &&
+			    start < end && (t->nregions == 0 ||
+			    start >= t->regions[t->nregions - 1].end)) {
+				(void)warm_region_add(t, start, end);
+			}
+
+			continue;
+		}
+
+		if ((t = warm_target_new(layout)) == NULL) {
+			break;
+		}
+
+		off = 0;
+		if (sscanf(line, "target %d %255s %n", &t->pid, t->cgroup,
+			   &off) < 2 || off == 0) {
+			layout->ntargets--;
+			t = NULL;
+			continue;
+		}
+
+		(void)strncpy(t->cmdline, line + off, sizeof(t->cmdline) - 1);
+	}
+
+	(void)fclose(fp);
+	return (layout->ntargets);
+}
+
+/*
+ * The same process (pid and cmdline) first, then the same cmdline,
+ * then the same cgroup.
+ */
+static warm_target_t *warm_match(warm_layout_t *layout, pid_t pid,
+				 const char *cmdline, const char *cgroup)
+{
+	warm_target_t *t;
+	int pass, i;
+
+	for (pass = 0; pass < 3; pass++) {
+		for (i = 0; i < layout->ntargets; i++) {
+			t = &layout->targets[i];
+			if (t->used || t->nregions == 0) {
+				continue;
+			}
+
+			if ((pass == 0 && t->pid == pid &&
+			     strcmp(t->cmdline, cmdline) == 0) ||
+			    (pass == 1 && strcmp(t->cmdline, cmdline) == 0) ||
+			    (pass == 2 && strcmp(t->cgroup, "-") != 0 &&
+			     strcmp(t->cgroup, cgroup) == 0)) {
+				t->used = B_TRUE;
+				return (t);
+			}
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Fit the saved regions to the new target 'pid': the regions which
+ * don't overlap any mapping are dropped (the layout of an other
+ * instance may be randomized differently), and the neighbours are
+ * merged down to 'max' regions. Return the number of regions left, 0
+ * if the layout doesn't fit the target.
+ */
+static int warm_regions_fit(pid_t pid, warm_target_t *t, int max)
+{
+	char path[64], line[WARM_LINE_SIZE];
+	uint64_t lo, hi, kept = 0, total = 0;
+	warm_region_t *r = t->regions;
+	FILE *fp;
+	int i = 0, n = 0;
+
+	(void)snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+	if ((fp = fopen(path, "r")) == NULL) {
+		return (0);
+	}
+
+	/* Both the mappings and the regions are sorted by address. */
+	while (i < t->nregions && fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%" SCNx64 "-%" SCNx64, &lo, &hi) != 2) {
+			continue;
+		}
+
+		while (i < t->nregions && r[i].start < hi) {
+			total += r[i].end - r[i].start;
+			if (r[i].end > lo) {
+				kept += r[i].end - r[i].start;
+				r[n++] = r[i];
+			}
+
+			i++;
+		}
+	}
+
+	(void)fclose(fp);
+	for (; i < t->nregions; i++) {
+		total += r[i].end - r[i].start;
+	}
+
+	if (n == 0 || kept * 100 < total * WARM_COVER_MIN) {
+		return (0);
+	}
+
+	while (max > 0 && n > max) {
+		for (i = 0; i < n; i += 2) {
+			r[i / 2].start = r[i].start;
+			r[i / 2].end = (i + 1 < n) ? r[i + 1].end : r[i].end;
+		}
+
+		n = (n + 1) / 2;
+	}
+
+	t->nregions = n;
+	return (n);
+}
+
+/*
+ * Write the matched layouts to 'init_regions'. The older kernels take
+ * the pid as the target id, the newer ones the index in 'target_ids'.
+ * With sysfs, the regions go to the directories of the targets.
+ */
+static int warm_regions_write(warm_target_t **matched, int by_index)
+{
+	warm_target_t *t;
+	char *buf;
+	size_t size = 1, len = 0;
+	int fd, i, j, ret = -1;
+
+	if (damon_sysfs_staged()) {
+		for (i = 0; i < target_procs.nr_proc; i++) {
+			if (matched[i] != NULL &&
+			    warm_sysfs_regions(target_procs.pid[i],
+					       matched[i]) != 0) {
+				return (-1);
+			}
+		}
+
+		return (0);
+	}
+
+	for (i = 0; i < target_procs.nr_proc; i++) {
+		if (matched[i] != NULL) {
+			size += matched[i]->nregions * 64;
+		}
+	}
+
+	if ((buf = zalloc(size)) == NULL) {
+		return (-1);
+	}
+
+	for (i = 0; i < target_procs.nr_proc; i++) {
+		if ((t = matched[i]) == NULL) {
+			continue;
+		}
+
+		for (j = 0; j < t->nregions; j++) {
+			len += snprintf(buf + len, size - len,
+					"%d %" PRIu64 " %" PRIu64 "\n",
+					by_index ? i : target_procs.pid[i],
+					t->regions[j].start, t->regions[j].end);
+		}
+	}
+
+	if ((fd = open(WARM_INIT_REGIONS, O_WRONLY)) >= 0) {
+		if (write(fd, buf, len) == (ssize_t)len) {
+			ret = 0;
+		}
+
+		(void)close(fd);
+	}
+
+	free(buf);
+	return (ret);
+}
+
+/*
+ * Seed DAMON with the pending layout (the zoom), or with the one saved
+ * in the --warm-start file. It's called between writing 'target_ids'
+ * and turning the monitoring on, the kernel drops the init regions
+ * whenever the targets are rewritten.
+ */
+void warm_seed(void)
+{
+	uint64_t sample = 0, aggr = 0, regions = 0, min = 0, max = 0;
+	char cmdline[WARM_CMDLINE_SIZE], cgroup[WARM_CGROUP_SIZE];
+	warm_target_t **matched;
+	int i, nmatched = 0;
+
+	if (!s_warm_pending) {
+		if (s_warm_path == NULL || warm_load(&s_warm_layout) <= 0) {
+			return;
+		}
+	}
+
+	s_warm_pending = B_FALSE;
+	if (!damon_sysfs_staged() && access(WARM_INIT_REGIONS, W_OK) != 0) {
+		debug_print(NULL, 2, "warm: %s isn't supported\n",
+			    WARM_INIT_REGIONS);
+		warm_layout_free(&s_warm_layout);
+		return;
+	}
+
+	if ((matched = zalloc(sizeof(warm_target_t *) *
+			      MAX(target_procs.nr_proc, 1))) == NULL) {
+		warm_layout_free(&s_warm_layout);
+		return;
+	}
+
+	read_damon_attrs(DAMON_ATTRS_PATH, &sample, &aggr,
+			 &regions, &min, &max);
+	for (i = 0; i < target_procs.nr_proc; i++) {
+		warm_cmdline_read(target_procs.pid[i], cmdline, sizeof(cmdline));
+		warm_cgroup_read(target_procs.pid[i], cgroup, sizeof(cgroup));
+		matched[i] = warm_match(&s_warm_layout, target_procs.pid[i],
+					cmdline, cgroup);
+		if (matched[i] != NULL &&
+		    warm_regions_fit(target_procs.pid[i], matched[i],
+				     (int)max) == 0) {
+			matched[i] = NULL;
+		}
+
+		if (matched[i] != NULL) {
+			nmatched++;
+		}
+	}
+
+	if (nmatched > 0 && warm_regions_write(matched, 0) != 0 &&
+	    warm_regions_write(matched, 1) != 0) {
+		debug_print(NULL, 2, "warm: %s is refused\n",
+			    WARM_INIT_REGIONS);
+		nmatched = 0;
+	}
+
+	debug_print(NULL, 2, "warm: %d of %d targets seeded\n", nmatched,
+		    target_procs.nr_proc);
+	free(matched);
+	warm_layout_free(&s_warm_layout);
+}
+
+/*
+ * Restart DAMON, warm_seed() writes the pending layout in between.
+ */
+static int warm_restart(void)
+{
+	char *procs;
+	int ret;
+
+	if ((procs = target_procs_str()) == NULL) {
+		return (-1);
+	}
+
+	s_warm_pending = B_TRUE;
+	monitor_exit();
+	ret = monitor_start(procs);
+	free(procs);
+	s_warm_pending = B_FALSE;
+	warm_layout_free(&s_warm_layout);
+
+	/* The regions from before the restart are stale. */
+	proc_profiling_clear();
+	return (ret);
+}
+
+static int warm_layout_copy(warm_layout_t *dst, warm_layout_t *src)
+{
+	warm_target_t *t;
+	int i, j;
+
+	warm_layout_free(dst);
+	for (i = 0; i < src->ntargets; i++) {
+		if ((t = warm_target_new(dst)) == NULL) {
+			return (-1);
+		}
+
+		(void)memcpy(t, &src->targets[i], sizeof(warm_target_t));
+		t->regions = NULL;
+		t->nregions = 0;
+		t->regions_size = 0;
+		for (j = 0; j < src->targets[i].nregions; j++) {
+			if (warm_region_add(t, src->targets[i].regions[j].start,
+					    src->targets[i].regions[j].end) != 0) {
+				return (-1);
+			}
+		}
+	}
+
+	return (0);
+}
+
+/*
+ * Zoom DAMON into [start, end) of 'pid': the max regions are spread
+ * evenly over the range and DAMON is restarted. DAMON itself stretches
+ * the first and the last region over the rest of the address space at
+ * the next regions update, so the target is still covered, coarsely.
+ * Zooming again from a zoomed layout keeps the layout to zoom out to.
+ */
+int warm_zoom(pid_t pid, uint64_t start, uint64_t end)
+{
+	uint64_t sample = 0, aggr = 0, regions = 0, min = 0, max = 0;
+	uint64_t len, step;
+	warm_target_t *t = NULL;
+	int i, n;
+
+	start &= ~((uint64_t)g_pagesize - 1);
+	if (monitor_attached() || idle_enabled() || end <= start) {
+		return (-1);
+	}
+
+	if (!s_zoom.zoomed && warm_capture(&s_zoom_saved) < 0) {
+		warm_layout_free(&s_zoom_saved);
+		return (-1);
+	}
+
+	if (warm_layout_copy(&s_warm_layout, &s_zoom_saved) != 0) {
+		warm_layout_free(&s_warm_layout);
+		return (-1);
+	}
+
+	for (i = 0; i < s_warm_layout.ntargets; i++) {
+		if (s_warm_layout.targets[i].pid == pid) {
+			t = &s_warm_layout.targets[i];
+			t->nregions = 0;
+			break;
+		}
+	}
+
+	if (t == NULL && (t = warm_target_new(&s_warm_layout)) == NULL) {
+		return (-1);
+	}
+
+	t->pid = pid;
+	warm_cmdline_read(pid, t->cmdline, sizeof(t->cmdline));
+	read_damon_attrs(DAMON_ATTRS_PATH, &sample, &aggr,
+			 &regions, &min, &max);
+
+	/* No region smaller than a page. */
+	len = end - start;
+	n = (int)MIN(MAX(max, 1), MAX(len / g_pagesize, 1));
+	step = (len / n + g_pagesize - 1) & ~((uint64_t)g_pagesize - 1);
+	for (i = 0; i < n && start + step * i < end; i++) {
+		if (warm_region_add(t, start + step * i,
+				    MIN(start + step * (i + 1), end)) != 0) {
+			warm_layout_free(&s_warm_layout);
+			return (-1);
+		}
+	}
+
+	if (warm_restart() != 0) {
+		return (-1);
+	}
+
+	s_zoom.zoomed = B_TRUE;
+	s_zoom.pid = pid;
+	s_zoom.start = start;
+	s_zoom.end = end;
+	debug_print(NULL, 2, "warm: zoom into %d 0x%" PRIx64 "-0x%" PRIx64
+		    ", %d regions\n", pid, start, end, t->nregions);
+	return (0);
+}
+
+/*
+ * Restart DAMON with the layout from before the zoom.
+ */
+int warm_unzoom(void)
+{
+	if (!s_zoom.zoomed) {
+		return (0);
+	}
+
+	s_zoom.zoomed = B_FALSE;
+	warm_layout_free(&s_warm_layout);
+	(void)memcpy(&s_warm_layout, &s_zoom_saved, sizeof(warm_layout_t));
+	(void)memset(&s_zoom_saved, 0, sizeof(warm_layout_t));
+	return (warm_restart());
+}
+
+/*
+ * Return B_TRUE if DAMON is zoomed into a range of 'pid'.
+ */
+boolean_t warm_zoomed(pid_t pid, uint64_t *start, uint64_t *end)
+{
+	if (!s_zoom.zoomed || s_zoom.pid != pid) {
+		return (B_FALSE);
+	}
+
+	*start = s_zoom.start;
+	*end = s_zoom.end;
+	return (B_TRUE);
+}
@@ -19,6 +19,13 @@
 #include "include/perf.h"
 #include "include/plat.h"
 #include "include/damon.h"
+#include "include/damon_sysfs.h"
+#include "include/stats.h"
+#include "include/cgroup.h"
+#include "include/paddr.h"
+#include "include/autotune.h"
+#include "include/budget.h"
+#include "include/warm.h"
 #include "include/os/os_util.h"
 #include "include/os/os_win.h"
 
@@ -134,7 +141,7 @@ no_numa_stat:
  * Build the readable string for data line.
  * (window type: "WIN_TYPE_TOPNPROC")
  */
-static void topnproc_str_build(char *buf, int size, int idx, void *pv)
+void topnproc_str_build(char *buf, int size, int idx, void *pv)
 {
 	topnproc_line_t *lines = (topnproc_line_t *) pv;
 	topnproc_line_t *line = &lines[idx];
@@ -142,6 +149,58 @@ static void topnproc_str_build(char *buf, int size, int idx, void *pv)
 	topnproc_data_build(buf, size, line);
 }
 
+/*
+ * Look up the memory area of the hottest record in the process
+ * address space. Called with the proc group lock held.
+ */
+static void topnproc_line_resolve(track_proc_t * proc, topnproc_line_t * line)
+{
+	map_entry_t *entry;
+	win_countvalue_t *value = &line->value;
+
+	if ((!proc->map.loaded || !budget_maps_skip()) &&
+	    map_proc_load(proc) != 0) {
+		win_warn_msg(WARN_INVALID_MAP);
+	}
+
+	if ((entry = map_entry_find_simiar(proc, value->start,
+					   value->end - value->start)) == NULL) {
+		strncpy(line->map_attr, "----", 4);
+		line->map_attr[4] = '\0';
+	} else {
+		/* Found */
+		attr_bitmap2str(entry->attr, line->map_attr);
+		line->map_attr[4] = '\0';
+		strncpy(line->map_name, entry->desc, sizeof(line->map_name));
+	}
+
+	line->resolved = B_TRUE;
+}
+
+/*
+ * Resolve a line which is scrolled into view after the refresh.
+ */
+static void topnproc_line_lazy_resolve(topnproc_line_t * line)
+{
+	track_proc_t *proc;
+
+	if (line->resolved) {
+		return;
+	}
+
+	if ((proc = proc_find(line->pid)) == NULL) {
+		strncpy(line->map_attr, "----", 4);
+		line->map_attr[4] = '\0';
+		line->resolved = B_TRUE;
+		return;
+	}
+
+	proc_group_lock();
+	topnproc_line_resolve(proc, line);
+	proc_group_unlock();
+	proc_refcount_dec(proc);
+}
+
 /*
  * Build the readable string for scrolling line.
  * (window type: "WIN_TYPE_TOPNPROC")
@@ -151,6 +210,7 @@ static void topnproc_line_get(win_reg_t * r, int idx, char *line, int size)
 	topnproc_line_t *lines;
 
 	lines = (topnproc_line_t *) (r->buf);
+	topnproc_line_lazy_resolve(&lines[idx]);
 	topnproc_str_build(line, size, idx, (void *)lines);
 }
 
@@ -161,14 +221,9 @@ static void topnproc_line_get(win_reg_t * r, int idx, char *line, int size)
 static dyn_topnproc_t *topnproc_dyn_create(int type)
 {
 	dyn_topnproc_t *dyn;
-	void *buf;
 	int i;
 
-	if ((buf = zalloc(sizeof(topnproc_line_t) * WIN_NLINES_MAX)) == NULL) {
-		return (NULL);
-	}
 	if ((dyn = zalloc(sizeof(dyn_topnproc_t))) == NULL) {
-		free(buf);
 		return (NULL);
 	}
 
@@ -184,7 +239,7 @@ static dyn_topnproc_t *topnproc_dyn_create(int type)
 		goto L_EXIT;
 
 	if (type == WIN_TYPE_TOPNPROC) {
-		reg_buf_init(&dyn->data, buf, topnproc_line_get);
+		reg_buf_init(&dyn->data, NULL, topnproc_line_get);
 	}
 
 	reg_scroll_init(&dyn->data, B_TRUE);
@@ -193,7 +248,6 @@ static dyn_topnproc_t *topnproc_dyn_create(int type)
 	return (dyn);
 L_EXIT:
 	free(dyn);
-	free(buf);
 	return (NULL);
 }
 
@@ -248,13 +302,12 @@ static int win_countvalue_fill(win_countvalue_t * cv,
 
 /*
  * Convert the perf data to the required format and copy
- * the converted result out via "line".
+ * the converted result out via "line". The memory area is looked up
+ * later by topnproc_line_resolve(), only for the lines to be shown.
  * (window type: "WIN_TYPE_TOPNPROC")
  */
 static void topnproc_data_save(track_proc_t * proc, topnproc_line_t * line)
 {
-	map_entry_t *entry;
-	uint64_t start, end;
 	uint64_t max_nr_access = 0;
 	int i;
 	count_value_t *countval_arr = proc->countval_arr;
@@ -274,19 +327,6 @@ static void topnproc_data_save(track_proc_t * proc, topnproc_line_t * line)
 		}
 	}
 
-	start = proc_countval_sum(max_countval_arr, UI_COUNT_DAMON_START);
-	end = proc_countval_sum(max_countval_arr, UI_COUNT_DAMON_END);
-
-	if ((entry = map_entry_find_simiar(proc, start, end - start)) == NULL) {
-		strncpy(line->map_attr, "----", 4);
-		line->map_attr[4] = '\0';
-	} else {
-		/* Found */
-		attr_bitmap2str(entry->attr, line->map_attr);
-		line->map_attr[4] = '\0';
-		strncpy(line->map_name, entry->desc, sizeof(line->map_name));
-	}
-
 	/*
 	 * Cut off the process name if it's too long.
 	 */
@@ -303,7 +343,7 @@ static void topnproc_data_show(dyn_win_t * win)
 	dyn_topnproc_t *dyn;
 	win_reg_t *r, *data_reg;
 	char content[WIN_LINECHAR_MAX], intval_buf[16];
-	int nprocs, i;
+	int nprocs, i, start, end;
 	track_proc_t *proc;
 	topnproc_line_t *lines;
 
@@ -312,8 +352,11 @@ static void topnproc_data_show(dyn_win_t * win)
 
 	/* Get the number of total processes and total threads */
 	proc_count(&nprocs);
-	nprocs = MIN(nprocs, WIN_NLINES_MAX);
-	data_reg->nlines_total = nprocs;
+	if (reg_buf_reserve(data_reg, nprocs, sizeof(topnproc_line_t)) == NULL) {
+		nprocs = MIN(nprocs, data_reg->nlines_buf);
+	}
+
+	data_reg->nlines_total = budget_rows(nprocs);
 
 	/*
 	 * Convert the sampling interval (nanosecond) to
@@ -353,6 +396,14 @@ static void topnproc_data_show(dyn_win_t * win)
 	reg_erase(data_reg);
 	lines = (topnproc_line_t *) (data_reg->buf);
 
+	/*
+	 * Only the lines on screen (plus a few around them to scroll to)
+	 * are resolved to memory areas now, the others when scrolled in.
+	 */
+	reg_scroll_window(data_reg, data_reg->nlines_total, &start, &end);
+	start = MAX(start - WIN_PREFETCH_LINES, 0);
+	end += WIN_PREFETCH_LINES;
+
 	/*
 	 * Sort the processes by specified metric which
 	 * is indicated by g_sortkey
@@ -368,9 +419,6 @@ static void topnproc_data_show(dyn_win_t * win)
 			break;
 		}
 
-		if (map_proc_load(proc) != 0) {
-			win_warn_msg(WARN_INVALID_MAP);
-		}
 		if (target_procs.ready != 1 &&
 				cpu_slice_proc_load(proc) != 0) {
 			win_warn_msg(WARN_INVALID_MAP);
@@ -379,6 +427,9 @@ static void topnproc_data_show(dyn_win_t * win)
 			target_procs.pid[i] = proc->pid;
 
 		topnproc_data_save(proc, &lines[i]);
+		if ((i >= start) && (i < end)) {
+			topnproc_line_resolve(proc, &lines[i]);
+		}
 	}
 
 	if (!target_procs.ready) {
@@ -390,6 +441,9 @@ static void topnproc_data_show(dyn_win_t * win)
 				break;
 			}
 			topnproc_data_save(proc, &lines[i]);
+			if ((i >= start) && (i < end)) {
+				topnproc_line_resolve(proc, &lines[i]);
+			}
 		}
 
 		if (intval_ms >= 10000) {
@@ -406,8 +460,8 @@ static void topnproc_data_show(dyn_win_t * win)
 	 * Display the processes with metrics in scrolling buffer
 	 */
 	if (win->type == WIN_TYPE_TOPNPROC) {
-		reg_scroll_show(data_reg, (void *)lines, nprocs,
-				topnproc_str_build);
+		reg_scroll_show(data_reg, (void *)lines, budget_rows(nprocs),
+				sizeof(topnproc_line_t), topnproc_str_build);
 	}
 
 	proc_group_unlock();
@@ -448,12 +502,22 @@ static void load_msg_show(void)
 }
 
 /*
- * Show the title "DamonTop v1.0, (C) 2021 Alibaba Corporation"
+ * Show the title "DamonTop v1.0, (C) 2021 Alibaba Corporation", followed by
+ * the budget status when --budget is specified.
  */
 void win_title_show(void)
 {
+	char title[WIN_LINECHAR_MAX], budget[LINE_SIZE];
+
+	if (budget_title_build(budget, sizeof(budget)) > 0) {
+		(void)snprintf(title, sizeof(title), "%s  %s",
+				DAMONTOP_TITLE, budget);
+	} else {
+		(void)snprintf(title, sizeof(title), "%s", DAMONTOP_TITLE);
+	}
+
 	reg_erase(&s_title_reg);
-	reg_line_write(&s_title_reg, 0, ALIGN_MIDDLE, DAMONTOP_TITLE);
+	reg_line_write(&s_title_reg, 0, ALIGN_MIDDLE, title);
 	reg_refresh_nout(&s_title_reg);
 }
 
@@ -628,7 +692,7 @@ static void moni_data_build(char *buf, int size, moni_line_t * line, int idx)
 /*
  * Build the readable string for data line.
  */
-static void moni_str_build(char *buf, int size, int idx, void *pv)
+void moni_str_build(char *buf, int size, int idx, void *pv)
 {
 	moni_line_t *lines = (moni_line_t *) pv;
 	moni_line_t *line = &lines[idx];
@@ -636,6 +700,70 @@ static void moni_str_build(char *buf, int size, int idx, void *pv)
 	moni_data_build(buf, size, line, idx);
 }
 
+/*
+ * Convert the perf data to the required format and copy
+ * the converted result out via "line". The memory area is looked up
+ * later by moniproc_line_resolve(), only for the lines to be shown.
+ */
+static void moniproc_data_save(track_proc_t * proc, int idx, moni_line_t * line)
+{
+	count_value_t *countval_arr = &proc->countval_arr[idx];
+
+	(void)memset(line, 0, sizeof(moni_line_t));
+	line->nid = 0;
+	line->pid = proc->pid;
+
+	(void)win_countvalue_fill(&line->value, countval_arr);
+}
+
+/*
+ * Look up the memory area of the record in the process address space.
+ * Called with the proc group lock held.
+ */
+static void moniproc_line_resolve(track_proc_t * proc, moni_line_t * line)
+{
+	map_entry_t *entry;
+	win_countvalue_t *value = &line->value;
+
+	if ((entry = map_entry_find_simiar(proc, value->start,
+					   value->end - value->start)) == NULL) {
+		strncpy(line->map_attr, "----", 4);
+		line->map_attr[4] = '\0';
+	} else {
+		/* Found */
+		attr_bitmap2str(entry->attr, line->map_attr);
+		line->map_attr[4] = '\0';
+		strncpy(line->map_name, entry->desc, WIN_DESCBUF_SIZE);
+		line->map_name[WIN_DESCBUF_SIZE - 1] = '\0';
+	}
+
+	line->resolved = B_TRUE;
+}
+
+/*
+ * Resolve a line which is scrolled into view after the refresh.
+ */
+static void moniproc_line_lazy_resolve(moni_line_t * line)
+{
+	track_proc_t *proc;
+
+	if (line->resolved) {
+		return;
+	}
+
+	if ((proc = proc_find(line->pid)) == NULL) {
+		strncpy(line->map_attr, "----", 4);
+		line->map_attr[4] = '\0';
+		line->resolved = B_TRUE;
+		return;
+	}
+
+	proc_group_lock();
+	moniproc_line_resolve(proc, line);
+	proc_group_unlock();
+	proc_refcount_dec(proc);
+}
+
 /*
  * Build the readable string for scrolling line.
  */
@@ -644,6 +772,7 @@ static void moni_line_get(win_reg_t * r, int idx, char *line, int size)
 	moni_line_t *lines;
 
 	lines = (moni_line_t *) (r->buf);
+	moniproc_line_lazy_resolve(&lines[idx]);
 	moni_str_build(line, size, idx, (void *)lines);
 }
 
@@ -653,14 +782,9 @@ static void moni_line_get(win_reg_t * r, int idx, char *line, int size)
 static dyn_moniproc_t *moniproc_dyn_create(pid_t pid)
 {
 	dyn_moniproc_t *dyn;
-	void *buf_cur;
 	int i;
 
-	if ((buf_cur = zalloc(sizeof(moni_line_t) * WIN_NLINES_MAX)) == NULL) {
-		return (NULL);
-	}
 	if ((dyn = zalloc(sizeof(dyn_moniproc_t))) == NULL) {
-		free(buf_cur);
 		return (NULL);
 	}
 
@@ -677,7 +801,7 @@ static dyn_moniproc_t *moniproc_dyn_create(pid_t pid)
 		      0)) < 0)
 		goto L_EXIT;
 
-	reg_buf_init(&dyn->data_cur, buf_cur, moni_line_get);
+	reg_buf_init(&dyn->data_cur, NULL, moni_line_get);
 	reg_scroll_init(&dyn->data_cur, B_TRUE);
 
 	(void)reg_init(&dyn->hint, 0, i, g_scr_width,
@@ -685,41 +809,9 @@ static dyn_moniproc_t *moniproc_dyn_create(pid_t pid)
 	return (dyn);
 L_EXIT:
 	free(dyn);
-	free(buf_cur);
 	return (NULL);
 }
 
-/*
- * Convert the perf data to the required format and copy
- * the converted result out via "line".
- */
-static void moniproc_data_save(track_proc_t * proc, int idx, moni_line_t * line)
-{
-	map_entry_t *entry;
-	uint64_t start, end;
-	count_value_t *countval_arr = &proc->countval_arr[idx];
-
-	(void)memset(line, 0, sizeof(moni_line_t));
-	start = proc_countval_sum(countval_arr, UI_COUNT_DAMON_START);
-	end = proc_countval_sum(countval_arr, UI_COUNT_DAMON_END);
-
-	if ((entry = map_entry_find_simiar(proc, start, end - start)) == NULL) {
-		strncpy(line->map_attr, "----", 4);
-		line->map_attr[4] = '\0';
-	} else {
-		/* Found */
-		attr_bitmap2str(entry->attr, line->map_attr);
-		line->map_attr[4] = '\0';
-		strncpy(line->map_name, entry->desc, WIN_DESCBUF_SIZE);
-		line->map_name[WIN_DESCBUF_SIZE - 1] = '\0';
-	}
-
-	line->nid = 0;
-	line->pid = proc->pid;
-
-	(void)win_countvalue_fill(&line->value, countval_arr);
-}
-
 void win_invalid_proc(void)
 {
 	win_warn_msg(WARN_INVALID_PID);
@@ -735,7 +827,8 @@ static boolean_t moniproc_data_show(dyn_win_t * win, boolean_t * note_out)
 	char content[WIN_LINECHAR_MAX], intval_buf[16];
 	pid_t pid;
 	track_proc_t *proc;
-	int i, nr_nonzero;
+	int i, nr_nonzero, start, end;
+	uint64_t zoom_start, zoom_end;
 	moni_line_t *lines;
 
 	dyn = (dyn_moniproc_t *) (win->dyn);
@@ -783,8 +876,16 @@ static boolean_t moniproc_data_show(dyn_win_t * win, boolean_t * note_out)
 
 	/* Display DAMON related stat */
 	r = &dyn->msg;
-	(void)snprintf(content, sizeof(content), "Current regions: %ld",
-			proc->countval_arr[0].counts[PERF_COUNT_DAMON_NR_REGIONS]);
+	if (warm_zoomed(proc->pid, &zoom_start, &zoom_end)) {
+		(void)snprintf(content, sizeof(content), "Current regions: %ld "
+			       "(zoomed into 0x%" PRIx64 "-0x%" PRIx64
+			       ", U: zoom out)",
+			       proc->countval_arr[0].counts[PERF_COUNT_DAMON_NR_REGIONS],
+			       zoom_start, zoom_end);
+	} else {
+		(void)snprintf(content, sizeof(content), "Current regions: %ld",
+			       proc->countval_arr[0].counts[PERF_COUNT_DAMON_NR_REGIONS]);
+	}
 	reg_line_write(r, 2, ALIGN_LEFT, content);
 	dump_write("\n*** %s\n", content);
 	reg_refresh_nout(r);
@@ -792,9 +893,15 @@ static boolean_t moniproc_data_show(dyn_win_t * win, boolean_t * note_out)
 	/* Set show lines. */
 	r = &dyn->data_cur;
 	reg_erase(r);
+	if (reg_buf_reserve(r, nr_nonzero, sizeof(moni_line_t)) == NULL) {
+		nr_nonzero = MIN(nr_nonzero, r->nlines_buf);
+	}
+
 	lines = (moni_line_t *) (r->buf);
-	nr_nonzero = MIN(nr_nonzero, WIN_NLINES_MAX);
-	r->nlines_total = nr_nonzero;
+	r->nlines_total = budget_rows(nr_nonzero);
+	reg_scroll_window(r, r->nlines_total, &start, &end);
+	start = MAX(start - WIN_PREFETCH_LINES, 0);
+	end += WIN_PREFETCH_LINES;
 
 	/*
 	 * Save the per-node data with metrics of a specified process
@@ -804,6 +911,9 @@ static boolean_t moniproc_data_show(dyn_win_t * win, boolean_t * note_out)
 	moniproc_resort(g_sortkey, proc);
 	for (i = 0; i < nr_nonzero; i++) {
 		moniproc_data_save(proc, i, &lines[i]);
+		if ((i >= start) && (i < end)) {
+			moniproc_line_resolve(proc, &lines[i]);
+		}
 	}
 	proc_group_unlock();
 
@@ -811,7 +921,8 @@ static boolean_t moniproc_data_show(dyn_win_t * win, boolean_t * note_out)
 	 * Display the detailed data with metrics of a specified process
 	 * in scrolling buffer
 	 */
-	reg_scroll_show(r, (void *)lines, nr_nonzero, moni_str_build);
+	reg_scroll_show(r, (void *)lines, budget_rows(nr_nonzero),
+			sizeof(moni_line_t), moni_str_build);
 	reg_refresh_nout(r);
 	proc_refcount_dec(proc);
 
@@ -1009,11 +1120,15 @@ static void damon_overview_data_save(int kid_idx,
 	}
 
 	line->pid = kdamon->pid;
-	line->nr_proc = 1;
-	line->rss = 0;
+	if ((line->nr_proc = damon_sysfs_kdamond_ntargets(kdamon->pid)) < 0) {
+		line->nr_proc = 1;
+	}
 	line->sample = kdamon->sampling_intval;
 	line->aggr = kdamon->aggregation_intval;
 	line->update = kdamon->regions_update_intval;
+	line->value.cpu = kdamon->cpu_usage;
+	line->regions_sec = kdamon->regions_sec;
+	line->cost = kdamon->cost;
 }
 
 static boolean_t damon_overview_data_show(dyn_win_t * win, boolean_t * note_out)
@@ -1064,7 +1179,7 @@ static boolean_t damon_overview_data_show(dyn_win_t * win, boolean_t * note_out)
 	/*
 	 * Display the per-node data in scrolling buffer
 	 */
-	reg_scroll_show(r, (void *)lines, nks, damon_overview_str_build);
+	reg_scroll_show(r, (void *)lines, nks, 0, damon_overview_str_build);
 	reg_refresh_nout(r);
 
 	/*
@@ -1072,8 +1187,16 @@ static boolean_t damon_overview_data_show(dyn_win_t * win, boolean_t * note_out)
 	 */
 	r = &dyn->hint;
 	reg_erase(r);
+	if (autotune_status_build(content, sizeof(content)) > 0) {
+		reg_line_write(r, r->nlines_scr - 5, ALIGN_LEFT, content);
+		dump_write("%s\n", content);
+	}
+
+	reg_line_write(r, r->nlines_scr - 3, ALIGN_LEFT,
+		       "CPU%% = kdamond CPU utilization (of one CPU), "
+		       "REGIONS/s = region checks per second");
 	reg_line_write(r, r->nlines_scr - 2, ALIGN_LEFT,
-		       "CPU%% = per-node CPU utilization");
+		       "MS/MCHK = kdamond CPU time (ms) per million region checks");
 	reg_refresh_nout(r);
 
 	return (B_TRUE);
@@ -1236,6 +1359,424 @@ static void damon_detail_win_destroy(dyn_win_t * win)
 	}
 }
 
+/*
+ * Build the readable string for scrolling line.
+ * (window type: "WIN_TYPE_SELFSTATS")
+ */
+static void selfstats_line_get(win_reg_t * r, int idx, char *line, int size)
+{
+	stats_str_build(line, size, idx, r->buf);
+}
+
+/*
+ * Initialize the display layout for window type "WIN_TYPE_SELFSTATS"
+ */
+static dyn_selfstats_t *selfstats_dyn_create(void)
+{
+	dyn_selfstats_t *dyn;
+	void *buf;
+	int i;
+
+	if ((buf = zalloc(sizeof(stats_snap_t))) == NULL) {
+		return (NULL);
+	}
+	if ((dyn = zalloc(sizeof(dyn_selfstats_t))) == NULL) {
+		free(buf);
+		return (NULL);
+	}
+
+	if ((i = reg_init(&dyn->msg, 0, 1, g_scr_width, 2, A_BOLD)) < 0)
+		goto L_EXIT;
+	if ((i = reg_init(&dyn->caption, 0, i, g_scr_width, 2,
+			  A_BOLD | A_UNDERLINE)) < 0)
+		goto L_EXIT;
+	if ((i = reg_init(&dyn->data, 0, i, g_scr_width,
+			  STATS_STAGE_NUM, 0)) < 0)
+		goto L_EXIT;
+
+	reg_buf_init(&dyn->data, buf, selfstats_line_get);
+	reg_scroll_init(&dyn->data, B_TRUE);
+
+	(void)reg_init(&dyn->hint, 0, i, g_scr_width,
+		       g_scr_height - i - 1, A_BOLD);
+	return (dyn);
+L_EXIT:
+	free(dyn);
+	free(buf);
+	return (NULL);
+}
+
+static boolean_t selfstats_data_show(dyn_win_t * win)
+{
+	dyn_selfstats_t *dyn = (dyn_selfstats_t *) (win->dyn);
+	stats_snap_t *snap;
+	win_reg_t *r;
+	char content[WIN_LINECHAR_MAX], summary[LINE_SIZE];
+
+	r = &dyn->data;
+	snap = (stats_snap_t *) (r->buf);
+	stats_snapshot(snap);
+
+	stats_summary_build(summary, sizeof(summary), snap);
+	(void)snprintf(content, sizeof(content),
+		       "Self statistics (%s)", summary);
+
+	r = &dyn->msg;
+	reg_erase(r);
+	reg_line_write(r, 1, ALIGN_LEFT, content);
+	reg_refresh_nout(r);
+	dump_write("\n*** %s\n", content);
+
+	stats_caption_build(content, sizeof(content));
+	r = &dyn->caption;
+	reg_erase(r);
+	reg_line_write(r, 1, ALIGN_LEFT, content);
+	dump_write("%s\n", content);
+	reg_refresh_nout(r);
+
+	r = &dyn->data;
+	reg_erase(r);
+	r->nlines_total = STATS_STAGE_NUM;
+	reg_scroll_show(r, (void *)snap, STATS_STAGE_NUM, 0, stats_str_build);
+	reg_refresh_nout(r);
+
+	r = &dyn->hint;
+	reg_erase(r);
+	reg_line_write(r, r->nlines_scr - 2, ALIGN_LEFT,
+		       "P50/P99/MAX = stage latency since start "
+		       "(log-linear histogram)");
+	reg_refresh_nout(r);
+
+	return (B_TRUE);
+}
+
+/*
+ * Display window on screen.
+ * (window type: "WIN_TYPE_SELFSTATS")
+ */
+static boolean_t selfstats_win_draw(dyn_win_t * win)
+{
+	boolean_t ret;
+
+	win_title_show();
+	ret = selfstats_data_show(win);
+	win_note_show(NOTE_SELFSTATS);
+	reg_update_all();
+	return (ret);
+}
+
+static void selfstats_win_scroll(dyn_win_t * win, int scroll_type)
+{
+	dyn_selfstats_t *dyn = (dyn_selfstats_t *) (win->dyn);
+
+	reg_line_scroll(&dyn->data, scroll_type);
+}
+
+/*
+ * Release the resources for window type "WIN_TYPE_SELFSTATS"
+ */
+static void selfstats_win_destroy(dyn_win_t * win)
+{
+	dyn_selfstats_t *dyn;
+
+	if ((dyn = win->dyn) != NULL) {
+		if (dyn->data.buf != NULL) {
+			free(dyn->data.buf);
+		}
+
+		reg_win_destroy(&dyn->msg);
+		reg_win_destroy(&dyn->caption);
+		reg_win_destroy(&dyn->data);
+		reg_win_destroy(&dyn->hint);
+		free(dyn);
+	}
+}
+
+/*
+ * Build the readable string for scrolling line.
+ * (window type: "WIN_TYPE_CGROUP")
+ */
+static void cgroup_line_get(win_reg_t * r, int idx, char *line, int size)
+{
+	cgroup_str_build(line, size, idx, r->buf);
+}
+
+/*
+ * Initialize the display layout for window type "WIN_TYPE_CGROUP"
+ */
+static dyn_cgroup_t *cgroup_dyn_create(void)
+{
+	dyn_cgroup_t *dyn;
+	int i;
+
+	if ((dyn = zalloc(sizeof(dyn_cgroup_t))) == NULL) {
+		return (NULL);
+	}
+
+	if ((i = reg_init(&dyn->msg, 0, 1, g_scr_width, 2, A_BOLD)) < 0)
+		goto L_EXIT;
+	if ((i = reg_init(&dyn->caption, 0, i, g_scr_width, 2,
+			  A_BOLD | A_UNDERLINE)) < 0)
+		goto L_EXIT;
+	if ((i = reg_init(&dyn->data, 0, i, g_scr_width,
+			  g_scr_height - i - 5, 0)) < 0)
+		goto L_EXIT;
+
+	reg_buf_init(&dyn->data, NULL, cgroup_line_get);
+	reg_scroll_init(&dyn->data, B_TRUE);
+
+	(void)reg_init(&dyn->hint, 0, i, g_scr_width,
+		       g_scr_height - i - 1, A_BOLD);
+	return (dyn);
+L_EXIT:
+	free(dyn);
+	return (NULL);
+}
+
+static boolean_t cgroup_data_show(dyn_win_t * win)
+{
+	dyn_cgroup_t *dyn = (dyn_cgroup_t *) (win->dyn);
+	cgroup_line_t *lines;
+	win_reg_t *r;
+	char content[WIN_LINECHAR_MAX], intval_buf[16];
+	int nlines = 0;
+
+	r = &dyn->data;
+	if ((lines = reg_buf_reserve(r, cgroup_num(),
+				     sizeof(cgroup_line_t))) != NULL) {
+		nlines = cgroup_lines_fill(lines, r->nlines_buf);
+	}
+
+	disp_intval(intval_buf, 16);
+	(void)snprintf(content, sizeof(content),
+		       "Monitoring %d cgroups, %d processes (interval: %s)",
+		       nlines, target_procs.nr_proc, intval_buf);
+
+	r = &dyn->msg;
+	reg_erase(r);
+	reg_line_write(r, 1, ALIGN_LEFT, content);
+	reg_refresh_nout(r);
+	dump_write("\n*** %s\n", content);
+
+	cgroup_caption_build(content, sizeof(content));
+	r = &dyn->caption;
+	reg_erase(r);
+	reg_line_write(r, 1, ALIGN_LEFT, content);
+	dump_write("%s\n", content);
+	reg_refresh_nout(r);
+
+	r = &dyn->data;
+	reg_erase(r);
+	r->nlines_total = nlines;
+	reg_scroll_show(r, r->buf, nlines, sizeof(cgroup_line_t),
+			cgroup_str_build);
+	reg_refresh_nout(r);
+
+	r = &dyn->hint;
+	reg_erase(r);
+	if (cgroup_num() == 0) {
+		reg_line_write(r, 1, ALIGN_LEFT,
+			       "No cgroup is monitored, specify them by -g");
+	}
+
+	reg_line_write(r, 2, ALIGN_LEFT,
+		       "WSS = size of accessed regions, HOT = size of regions "
+		       "accessed in half of the samples");
+	reg_refresh_nout(r);
+
+	return (B_TRUE);
+}
+
+/*
+ * Display window on screen.
+ * (window type: "WIN_TYPE_CGROUP")
+ */
+static boolean_t cgroup_win_draw(dyn_win_t * win)
+{
+	boolean_t ret;
+
+	win_title_show();
+	ret = cgroup_data_show(win);
+	win_note_show(NOTE_CGROUP);
+	reg_update_all();
+	return (ret);
+}
+
+static void cgroup_win_scroll(dyn_win_t * win, int scroll_type)
+{
+	dyn_cgroup_t *dyn = (dyn_cgroup_t *) (win->dyn);
+
+	reg_line_scroll(&dyn->data, scroll_type);
+}
+
+/*
+ * Release the resources for window type "WIN_TYPE_CGROUP"
+ */
+static void cgroup_win_destroy(dyn_win_t * win)
+{
+	dyn_cgroup_t *dyn;
+
+	if ((dyn = win->dyn) != NULL) {
+		if (dyn->data.buf != NULL) {
+			free(dyn->data.buf);
+		}
+
+		reg_win_destroy(&dyn->msg);
+		reg_win_destroy(&dyn->caption);
+		reg_win_destroy(&dyn->data);
+		reg_win_destroy(&dyn->hint);
+		free(dyn);
+	}
+}
+
+/*
+ * Build the readable string for scrolling line.
+ * (window type: "WIN_TYPE_PADDR")
+ */
+static void paddr_line_get(win_reg_t * r, int idx, char *line, int size)
+{
+	paddr_str_build(line, size, idx, r->buf);
+}
+
+/*
+ * Initialize the display layout for window type "WIN_TYPE_PADDR"
+ */
+static dyn_paddr_t *paddr_dyn_create(void)
+{
+	dyn_paddr_t *dyn;
+	int i;
+
+	if ((dyn = zalloc(sizeof(dyn_paddr_t))) == NULL) {
+		return (NULL);
+	}
+
+	if ((i = reg_init(&dyn->msg, 0, 1, g_scr_width, 2, A_BOLD)) < 0)
+		goto L_EXIT;
+	if ((i = reg_init(&dyn->caption, 0, i, g_scr_width, 2,
+			  A_BOLD | A_UNDERLINE)) < 0)
+		goto L_EXIT;
+	if ((i = reg_init(&dyn->data, 0, i, g_scr_width,
+			  g_scr_height - i - 5, 0)) < 0)
+		goto L_EXIT;
+
+	reg_buf_init(&dyn->data, NULL, paddr_line_get);
+	reg_scroll_init(&dyn->data, B_TRUE);
+
+	(void)reg_init(&dyn->hint, 0, i, g_scr_width,
+		       g_scr_height - i - 1, A_BOLD);
+	return (dyn);
+L_EXIT:
+	free(dyn);
+	return (NULL);
+}
+
+static boolean_t paddr_data_show(dyn_win_t * win)
+{
+	dyn_paddr_t *dyn = (dyn_paddr_t *) (win->dyn);
+	paddr_line_t *lines;
+	win_reg_t *r;
+	char content[WIN_LINECHAR_MAX], intval_buf[16];
+	int nlines = 0;
+
+	r = &dyn->data;
+	if ((lines = reg_buf_reserve(r, paddr_nlines(),
+				     sizeof(paddr_line_t))) != NULL) {
+		nlines = paddr_lines_fill(lines, r->nlines_buf);
+	}
+
+	disp_intval(intval_buf, 16);
+	(void)snprintf(content, sizeof(content),
+		       "Monitoring the physical memory of %d nodes, "
+		       "%d cgroups (interval: %s)", paddr_nnodes(),
+		       MAX(nlines - paddr_nnodes(), 0), intval_buf);
+
+	r = &dyn->msg;
+	reg_erase(r);
+	reg_line_write(r, 1, ALIGN_LEFT, content);
+	reg_refresh_nout(r);
+	dump_write("\n*** %s\n", content);
+
+	paddr_caption_build(content, sizeof(content));
+	r = &dyn->caption;
+	reg_erase(r);
+	reg_line_write(r, 1, ALIGN_LEFT, content);
+	dump_write("%s\n", content);
+	reg_refresh_nout(r);
+
+	r = &dyn->data;
+	reg_erase(r);
+	r->nlines_total = nlines;
+	reg_scroll_show(r, r->buf, nlines, sizeof(paddr_line_t),
+			paddr_str_build);
+	reg_refresh_nout(r);
+
+	r = &dyn->hint;
+	reg_erase(r);
+	if (!paddr_enabled()) {
+		reg_line_write(r, 1, ALIGN_LEFT,
+			       "The physical memory isn't monitored, "
+			       "start with --paddr");
+	} else if (!paddr_cgroup_on()) {
+		reg_line_write(r, 1, ALIGN_LEFT,
+			       "No cgroup, can't read " PADDR_KPAGECGROUP
+			       " or " PADDR_KPAGEFLAGS);
+	} else {
+		(void)snprintf(content, sizeof(content),
+			       "The cgroup sizes are estimated from up to %d "
+			       "pages of each region", PADDR_PFNS_MAX);
+		reg_line_write(r, 1, ALIGN_LEFT, content);
+	}
+
+	reg_line_write(r, 2, ALIGN_LEFT,
+		       "WSS = size of accessed regions, HOT = size of regions "
+		       "accessed in half of the samples");
+	reg_refresh_nout(r);
+
+	return (B_TRUE);
+}
+
+/*
+ * Display window on screen.
+ * (window type: "WIN_TYPE_PADDR")
+ */
+static boolean_t paddr_win_draw(dyn_win_t * win)
+{
+	boolean_t ret;
+
+	win_title_show();
+	ret = paddr_data_show(win);
+	win_note_show(NOTE_PADDR);
+	reg_update_all();
+	return (ret);
+}
+
+static void paddr_win_scroll(dyn_win_t * win, int scroll_type)
+{
+	dyn_paddr_t *dyn = (dyn_paddr_t *) (win->dyn);
+
+	reg_line_scroll(&dyn->data, scroll_type);
+}
+
+/*
+ * Release the resources for window type "WIN_TYPE_PADDR"
+ */
+static void paddr_win_destroy(dyn_win_t * win)
+{
+	dyn_paddr_t *dyn;
+
+	if ((dyn = win->dyn) != NULL) {
+		if (dyn->data.buf != NULL) {
+			free(dyn->data.buf);
+		}
+
+		reg_win_destroy(&dyn->msg);
+		reg_win_destroy(&dyn->caption);
+		reg_win_destroy(&dyn->data);
+		reg_win_destroy(&dyn->hint);
+		free(dyn);
+	}
+}
+
 void win_size2str(uint64_t size, char *buf, int bufsize)
 {
 	uint64_t i, j;
@@ -1512,7 +2053,7 @@ maplist_data_get(track_proc_t * proc, dyn_maplist_t * dyn)
 	 */
 	dyn->data.buf = (void *)maplist_buf;
 	reg_scroll_show(&dyn->data, (void *)(dyn->data.buf),
-			nlines, win_maplist_str_build);
+			nlines, sizeof(maplist_line_t), win_maplist_str_build);
 	reg_refresh_nout(&dyn->data);
 
 	return 0;
@@ -1559,6 +2100,50 @@ static void maplist_win_scroll(dyn_win_t * win, int scroll_type)
 	reg_line_scroll(&dyn->data, scroll_type);
 }
 
+/*
+ * Get the address range of the highlighted line, for the zoom.
+ * (window type: "WIN_TYPE_MONIPROC" and "WIN_TYPE_MAPLIST_PROC")
+ */
+int win_zoom_range(page_t *page, pid_t *pid, uint64_t *start, uint64_t *end)
+{
+	dyn_moniproc_t *moni;
+	dyn_maplist_t *ml;
+	moni_line_t *moni_line;
+	maplist_line_t *ml_line;
+	win_reg_t *r;
+
+	switch (PAGE_WIN_TYPE(page)) {
+	case WIN_TYPE_MONIPROC:
+		moni = DYN_MONI_PROC(page);
+		r = &moni->data_cur;
+		if (r->buf == NULL || r->scroll.highlight == -1) {
+			return (-1);
+		}
+
+		moni_line = &((moni_line_t *)(r->buf))[r->scroll.highlight];
+		*pid = moni->pid;
+		*start = moni_line->value.start;
+		*end = moni_line->value.end;
+		return (0);
+
+	case WIN_TYPE_MAPLIST_PROC:
+		ml = DYN_MAPLIST(page);
+		r = &ml->data;
+		if (r->buf == NULL || r->scroll.highlight == -1) {
+			return (-1);
+		}
+
+		ml_line = &((maplist_line_t *)(r->buf))[r->scroll.highlight];
+		*pid = ml->pid;
+		*start = ml_line->bufaddr.addr;
+		*end = ml_line->bufaddr.addr + ml_line->bufaddr.size;
+		return (0);
+
+	default:
+		return (-1);
+	}
+}
+
 /*
  * The common entry for all warning messages.
  */
@@ -1734,6 +2319,42 @@ int win_dyn_init(void *p)
 		win->destroy = damon_detail_win_destroy;
 		break;
 
+	case CMD_SELFSTATS_ID:
+		if ((win->dyn = selfstats_dyn_create()) == NULL) {
+			goto L_EXIT;
+		}
+
+		win->type = WIN_TYPE_SELFSTATS;
+		win->draw = selfstats_win_draw;
+		win->scroll = selfstats_win_scroll;
+		win->scroll_enter = NULL;
+		win->destroy = selfstats_win_destroy;
+		break;
+
+	case CMD_CGROUP_ID:
+		if ((win->dyn = cgroup_dyn_create()) == NULL) {
+			goto L_EXIT;
+		}
+
+		win->type = WIN_TYPE_CGROUP;
+		win->draw = cgroup_win_draw;
+		win->scroll = cgroup_win_scroll;
+		win->scroll_enter = NULL;
+		win->destroy = cgroup_win_destroy;
+		break;
+
+	case CMD_PADDR_ID:
+		if ((win->dyn = paddr_dyn_create()) == NULL) {
+			goto L_EXIT;
+		}
+
+		win->type = WIN_TYPE_PADDR;
+		win->draw = paddr_win_draw;
+		win->scroll = paddr_win_scroll;
+		win->scroll_enter = NULL;
+		win->destroy = paddr_win_destroy;
+		break;
+
 	case CMD_MAP_LIST_ID:
 		if ((win->dyn = maplist_dyn_create(page, &win->type)) == NULL) {
 			goto L_EXIT;